@@ -0,0 +1,108 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "aac.h"
+#include "bitstream.h"
+
+/* sampling frequencies by index, zero for reserved indexes */
+static const uint32 aac_sampling_frequencies[16] = {
+    96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050,
+    16000, 12000, 11025, 8000, 7350, 0, 0, 0
+};
+
+/**
+    Reads the audio object type, sampling frequency and channel configuration
+    of an AudioSpecificConfig, returning 0 if they are invalid
+*/
+int aac_read_audio_specific_config(const byte * data, size_t size, aac_config * config) {
+    bit_buffer bb;
+    uint32 index;
+
+    bb.start = (byte *)data;
+    bb.size = size;
+    bb.current = (byte *)data;
+    bb.read_bits = 0;
+
+    /* audio object type, with escape value */
+    if (!get_bits(&bb, 5, &config->object_type)) {
+        return 0;
+    }
+    if (config->object_type == 31) {
+        if (!get_bits(&bb, 6, &config->object_type)) {
+            return 0;
+        }
+        config->object_type += 32;
+    }
+
+    /* sampling frequency index, or explicit frequency */
+    if (!get_bits(&bb, 4, &index)) {
+        return 0;
+    }
+    if (index == 15) {
+        if (!get_bits(&bb, 24, &config->sampling_frequency)) {
+            return 0;
+        }
+    }
+    else {
+        config->sampling_frequency = aac_sampling_frequencies[index];
+    }
+
+    if (!get_bits(&bb, 4, &config->channel_configuration)) {
+        return 0;
+    }
+
+    return config->object_type != 0
+        && config->sampling_frequency != 0
+        && config->channel_configuration <= 7;
+}
+
+/**
+    Reads the configuration found in an ADTS header,
+    returning 0 if the data does not start with an ADTS header
+*/
+int aac_read_adts_header(const byte * data, size_t size, aac_config * config) {
+    uint32 index;
+
+    /* syncword, then layer always zero */
+    if (size < AAC_ADTS_HEADER_SIZE
+    || data[0] != 0xFF
+    || (data[1] & 0xF6) != 0xF0) {
+        return 0;
+    }
+
+    config->object_type = ((data[2] >> 6) & 0x03) + 1;
+
+    index = (data[2] >> 2) & 0x0F;
+    config->sampling_frequency = aac_sampling_frequencies[index];
+
+    config->channel_configuration = ((data[2] & 0x01) << 2) | ((data[3] >> 6) & 0x03);
+
+    return 1;
+}
+
+/**
+    Tells whether two AAC configurations are identical
+*/
+int aac_config_equals(const aac_config * config1, const aac_config * config2) {
+    return config1->object_type == config2->object_type
+        && config1->sampling_frequency == config2->sampling_frequency
+        && config1->channel_configuration == config2->channel_configuration;
+}
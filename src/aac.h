@@ -0,0 +1,59 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#ifndef __AAC_H__
+#define __AAC_H__
+
+#include "types.h"
+
+/* AAC audio object types */
+#define AAC_OBJECT_TYPE_MAIN    1
+#define AAC_OBJECT_TYPE_LC      2
+#define AAC_OBJECT_TYPE_SSR     3
+#define AAC_OBJECT_TYPE_LTP     4
+
+/* AAC syntactic elements */
+#define AAC_ELEMENT_SCE 0 /* single channel element */
+#define AAC_ELEMENT_CPE 1 /* channel pair element */
+
+/* ADTS header size, without CRC */
+#define AAC_ADTS_HEADER_SIZE 7
+
+/* AAC audio configuration */
+typedef struct __aac_config {
+    uint32 object_type;
+    uint32 sampling_frequency; /* in Hz */
+    uint32 channel_configuration; /* 0 if defined in a program config element */
+} aac_config;
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+int aac_read_audio_specific_config(const byte * data, size_t size, aac_config * config);
+int aac_read_adts_header(const byte * data, size_t size, aac_config * config);
+int aac_config_equals(const aac_config * config1, const aac_config * config2);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __AAC_H__ */
@@ -22,6 +22,7 @@
 #include <string.h>
 
 #include "amf.h"
+#include "util.h"
 
 /* function common to all array types */
 static void amf_list_init(amf_list * list) {
@@ -562,6 +563,36 @@ size_t amf_data_size(const amf_data * data) {
     return s;
 }
 
+/* determines the number of AMF data objects in the given tree */
+size_t amf_data_count_nodes(const amf_data * data) {
+    size_t n = 0;
+    amf_node * node;
+    if (data != NULL) {
+        n = 1;
+        switch (data->type) {
+            case AMF_TYPE_OBJECT:
+            case AMF_TYPE_ASSOCIATIVE_ARRAY:
+                node = amf_object_first(data);
+                while (node != NULL) {
+                    n += amf_data_count_nodes(amf_object_get_name(node));
+                    n += amf_data_count_nodes(amf_object_get_data(node));
+                    node = amf_object_next(node);
+                }
+                break;
+            case AMF_TYPE_ARRAY:
+                node = amf_array_first(data);
+                while (node != NULL) {
+                    n += amf_data_count_nodes(amf_array_get(node));
+                    node = amf_array_next(node);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return n;
+}
+
 /* write a number */
 static size_t amf_number_write(const amf_data * data, amf_write_proc write_proc, void * user_data) {
     number64 n = swap_number64(data->number_data);
@@ -1013,15 +1044,13 @@ amf_data * amf_object_delete(amf_data * data, const char * name) {
     if (data != NULL) {
         amf_node * node = amf_list_first(&data->list_data);
         while (node != NULL) {
-            node = node->next;
+            amf_node * data_node = node->next;
             if (strncmp((char*)(node->data->string_data.mbstr), name, (size_t)(node->data->string_data.size)) == 0) {
-                amf_node * data_node = node->next;
                 amf_data_free(amf_list_delete(&data->list_data, node));
                 return amf_list_delete(&data->list_data, data_node);
             }
-            else {
-                node = node->next;
-            }
+            /* we have to skip the element data to reach the next name */
+            node = (data_node != NULL) ? data_node->next : NULL;
         }
     }
     return NULL;
@@ -1164,15 +1193,13 @@ time_t amf_date_to_time_t(const amf_data * data) {
 }
 
 size_t amf_date_to_iso8601(const amf_data * data, char * buffer, size_t bufsize) {
-    struct tm * t;
+    struct tm tm;
     time_t time;
-    
+
     time = amf_date_to_time_t(data);
-    
-    tzset();
-    t = localtime(&time);
-    if (t != NULL) {
-        return strftime(buffer, bufsize, "%Y-%m-%dT%H:%M:%S", t);
+
+    if (flvmeta_localtime(&time, &tm) != NULL) {
+        return strftime(buffer, bufsize, "%Y-%m-%dT%H:%M:%S", &tm);
     }
     else {
         /* if we couldn't parse the date, use a default value */
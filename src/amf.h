@@ -132,6 +132,8 @@ amf_data * amf_data_buffer_read(byte * buffer, size_t maxbytes);
 amf_data * amf_data_file_read(FILE * stream);
 /* AMF data size */
 size_t     amf_data_size(const amf_data * data);
+/* number of AMF data objects in a tree, including names */
+size_t     amf_data_count_nodes(const amf_data * data);
 /* write encoded AMF data into a buffer */
 size_t     amf_data_buffer_write(amf_data * data, byte * buffer, size_t maxbytes);
 /* write encoded AMF data into a stream */
@@ -20,6 +20,7 @@
     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 */
 #include <stdlib.h>
+#include <string.h>
 
 #include "avc.h"
 #include "bitstream.h"
@@ -259,3 +260,86 @@ int read_avc_resolution(flv_stream * f, uint32 body_length, uint32 * width, uint
     free(sps_buffer);
     return FLV_OK;
 }
+
+/**
+    Gets the size in bytes of the NAL unit lengths declared in an
+    AVCDecoderConfigurationRecord, or 0 if the record is invalid
+*/
+size_t avc_get_nal_length_size(const byte * config, size_t config_size) {
+    size_t length_size;
+
+    if (config_size < sizeof(AVCDecoderConfigurationRecord)) {
+        return 0;
+    }
+
+    /* lengthSizeMinusOne can only be 0, 1, or 3 */
+    length_size = (size_t)(config[4] & 0x03) + 1;
+    return (length_size == 3) ? 0 : length_size;
+}
+
+/**
+    Tells whether a SPS or PPS NAL unit is declared as is
+    in an AVCDecoderConfigurationRecord
+*/
+int avc_has_parameter_set(const byte * config, size_t config_size, const byte * nal, size_t nal_size) {
+    size_t pos, count, length, i;
+    int list;
+
+    /* SPS list, then PPS list, after the first five fields of the record */
+    pos = 5;
+    for (list = 0; list < 2; ++list) {
+        if (pos >= config_size) {
+            return 0;
+        }
+        count = (list == 0) ? (config[pos] & 0x1F) : config[pos];
+        ++pos;
+
+        for (i = 0; i < count; ++i) {
+            if (config_size - pos < sizeof(uint16)) {
+                return 0;
+            }
+            length = ((size_t)config[pos] << 8) | config[pos + 1];
+            pos += sizeof(uint16);
+
+            if (length > config_size - pos) {
+                return 0;
+            }
+            if (length == nal_size && memcmp(config + pos, nal, nal_size) == 0) {
+                return 1;
+            }
+            pos += length;
+        }
+    }
+
+    return 0;
+}
+
+/**
+    Gets the next NAL unit from length-prefixed AVC video data, starting
+    at *pos: returns 1 and moves *pos after the NAL unit if it is complete,
+    0 at the end of the data, or -1 if its length exceeds the data
+*/
+int avc_get_next_nal_unit(const byte * data, size_t size, size_t length_size, size_t * pos, const byte ** nal, size_t * nal_size) {
+    size_t length, i;
+
+    if (*pos >= size) {
+        return 0;
+    }
+    if (size - *pos < length_size) {
+        return -1;
+    }
+
+    length = 0;
+    for (i = 0; i < length_size; ++i) {
+        length = (length << 8) | data[*pos + i];
+    }
+
+    if (length > size - *pos - length_size) {
+        return -1;
+    }
+
+    *nal = data + *pos + length_size;
+    *nal_size = length;
+    *pos += length_size + length;
+    return 1;
+}
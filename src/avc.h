@@ -25,12 +25,24 @@
 #include "types.h"
 #include "flv.h"
 
+/* AVC NAL unit types */
+#define AVC_NAL_UNIT_TYPE_IDR   5
+#define AVC_NAL_UNIT_TYPE_SPS   7
+#define AVC_NAL_UNIT_TYPE_PPS   8
+
+#define avc_nal_unit_type(nal)  ((nal)[0] & 0x1F)
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
 
 int read_avc_resolution(flv_stream * f, uint32 body_length, uint32 * width, uint32 * height);
 
+/* NAL units validation over AVC video data held in memory */
+size_t avc_get_nal_length_size(const byte * config, size_t config_size);
+int avc_has_parameter_set(const byte * config, size_t config_size, const byte * nal, size_t nal_size);
+int avc_get_next_nal_unit(const byte * data, size_t size, size_t length_size, size_t * pos, const byte ** nal, size_t * nal_size);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,541 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch.h"
+#include "pool.h"
+#include "util.h"
+
+#ifdef WIN32
+# define BATCH_PATH_SEPARATOR '\\'
+#else /* !WIN32 */
+# define BATCH_PATH_SEPARATOR '/'
+#endif /* WIN32 */
+
+/* directories nested deeper are not listed, which stops symbolic link loops */
+#define BATCH_MAX_DEPTH 64
+
+/* size of the buffer copying the set aside outputs */
+#define BATCH_COPY_BUFFER_SIZE 8192
+
+/* directory being listed */
+typedef struct __batch_directory {
+    flvmeta_dir * dir;
+    char * path;
+    int depth;
+    struct __batch_directory * parent;
+} batch_directory;
+
+/* input files of a batch */
+struct __batch_source {
+    char ** files;
+    size_t files_number;
+    size_t next_file;
+    const char * list_name; /* list not opened yet */
+    FILE * list;
+    char * line;
+    size_t line_size;
+    batch_directory * directory;
+};
+
+/* input file processed by a worker */
+typedef struct __batch_job {
+    flvmeta_task task;
+    flvmeta_opts options;
+    batch_command_proc command;
+    char * input_file;
+    char * output_file;
+    FILE * out;
+    int combined; /* whether the output is appended to the combined output */
+    int submitted;
+    int result;
+} batch_job;
+
+/* batch state */
+typedef struct __batch {
+    const flvmeta_opts * options;
+    batch_command_proc command;
+    batch_result_proc on_result;
+    void * user_data;
+    flvmeta_pool * pool;
+    batch_job * jobs;
+    size_t jobs_number;
+    size_t first_job;
+    size_t pending_jobs;
+    int result;
+} batch;
+
+char * batch_join_path(const char * directory, const char * name, const char * extension) {
+    size_t directory_length, name_length, extension_length;
+    char * path;
+    int separator;
+
+    directory_length = strlen(directory);
+    name_length = strlen(name);
+    extension_length = (extension != NULL) ? strlen(extension) : 0;
+    separator = (directory_length > 0 && directory[directory_length - 1] != BATCH_PATH_SEPARATOR
+        && directory[directory_length - 1] != '/');
+
+    path = (char *)malloc(directory_length + separator + name_length + extension_length + 1);
+    if (path == NULL) {
+        return NULL;
+    }
+
+    memcpy(path, directory, directory_length);
+    if (separator) {
+        path[directory_length] = BATCH_PATH_SEPARATOR;
+    }
+    memcpy(path + directory_length + separator, name, name_length);
+    if (extension_length > 0) {
+        memcpy(path + directory_length + separator + name_length, extension, extension_length);
+    }
+    path[directory_length + separator + name_length + extension_length] = '\0';
+    return path;
+}
+
+/* copy of a string */
+static char * batch_strdup(const char * str) {
+    return batch_join_path("", str, NULL);
+}
+
+const char * batch_get_basename(const char * path) {
+    const char * name = path;
+
+    for (; *path != '\0'; ++path) {
+        if (*path == '/' || *path == BATCH_PATH_SEPARATOR) {
+            name = path + 1;
+        }
+    }
+    return name;
+}
+
+int batch_has_flv_extension(const char * name) {
+    size_t length = strlen(name);
+
+    return (length > 4 && name[length - 4] == '.'
+        && tolower((unsigned char)name[length - 3]) == 'f'
+        && tolower((unsigned char)name[length - 2]) == 'l'
+        && tolower((unsigned char)name[length - 1]) == 'v');
+}
+
+const char * batch_get_output_extension(const flvmeta_opts * options) {
+    int format;
+
+    format = (options->command == FLVMETA_CHECK_COMMAND) ? options->check_report_format : options->dump_format;
+    switch (format) {
+        case FLVMETA_FORMAT_JSON: return ".json";
+        case FLVMETA_FORMAT_XML: return ".xml";
+        case FLVMETA_FORMAT_YAML: return ".yaml";
+        default: return ".txt";
+    }
+}
+
+/* start listing a directory, which takes ownership of the path if successful */
+static int batch_source_push_directory(batch_source * source, char * path) {
+    batch_directory * directory;
+    int depth;
+
+    depth = (source->directory != NULL) ? source->directory->depth + 1 : 0;
+    if (depth > BATCH_MAX_DEPTH) {
+        return ERROR_OPEN_READ;
+    }
+
+    directory = (batch_directory *)malloc(sizeof(batch_directory));
+    if (directory == NULL) {
+        return ERROR_MEMORY;
+    }
+
+    directory->dir = flvmeta_dir_open(path);
+    if (directory->dir == NULL) {
+        free(directory);
+        return ERROR_OPEN_READ;
+    }
+
+    directory->path = path;
+    directory->depth = depth;
+    directory->parent = source->directory;
+    source->directory = directory;
+    return OK;
+}
+
+/* stop listing the current directory */
+static void batch_source_pop_directory(batch_source * source) {
+    batch_directory * directory = source->directory;
+
+    source->directory = directory->parent;
+    flvmeta_dir_close(directory->dir);
+    free(directory->path);
+    free(directory);
+}
+
+/* next line of the list, without its line terminator, or NULL at the end */
+static const char * batch_source_read_line(batch_source * source) {
+    size_t length;
+
+    length = 0;
+    for (;;) {
+        if (source->line_size - length < 2) {
+            size_t size = (source->line_size > 0) ? source->line_size * 2 : 256;
+            char * line = (char *)realloc(source->line, size);
+            if (line == NULL) {
+                return NULL;
+            }
+            source->line = line;
+            source->line_size = size;
+        }
+
+        if (fgets(source->line + length, (int)(source->line_size - length), source->list) == NULL) {
+            if (length == 0) {
+                return NULL;
+            }
+            break;
+        }
+
+        length += strlen(source->line + length);
+        if (length > 0 && source->line[length - 1] == '\n') {
+            break;
+        }
+    }
+
+    while (length > 0 && (source->line[length - 1] == '\n' || source->line[length - 1] == '\r')) {
+        source->line[--length] = '\0';
+    }
+    return source->line;
+}
+
+batch_source * batch_source_new(const flvmeta_opts * options) {
+    batch_source * source;
+
+    source = (batch_source *)calloc(1, sizeof(batch_source));
+    if (source == NULL) {
+        return NULL;
+    }
+    source->files = options->batch_files;
+    source->files_number = options->batch_files_number;
+    source->list_name = options->batch_list;
+    return source;
+}
+
+char * batch_source_next(batch_source * source, int * result) {
+    const char * entry;
+    char * path;
+
+    *result = OK;
+    for (;;) {
+        /* files and subdirectories of the directory being listed */
+        while (source->directory != NULL) {
+            entry = flvmeta_dir_read(source->directory->dir);
+            if (entry == NULL) {
+                batch_source_pop_directory(source);
+                continue;
+            }
+
+            path = batch_join_path(source->directory->path, entry, NULL);
+            if (path == NULL) {
+                *result = ERROR_MEMORY;
+                return NULL;
+            }
+
+            if (flvmeta_is_directory(path)) {
+                *result = batch_source_push_directory(source, path);
+                if (*result != OK) {
+                    return path;
+                }
+            }
+            else if (batch_has_flv_extension(entry)) {
+                return path;
+            }
+            else {
+                free(path);
+            }
+        }
+
+        /* arguments, then lines of the list */
+        if (source->next_file < source->files_number) {
+            entry = source->files[source->next_file++];
+        }
+        else if (source->list_name != NULL) {
+            entry = source->list_name;
+            source->list_name = NULL;
+            source->list = (strcmp(entry, "-") != 0) ? fopen(entry, "r") : stdin;
+            if (source->list == NULL) {
+                *result = ERROR_OPEN_READ;
+                return batch_strdup(entry);
+            }
+            continue;
+        }
+        else if (source->list != NULL) {
+            entry = batch_source_read_line(source);
+            if (entry == NULL) {
+                if (source->list != stdin) {
+                    fclose(source->list);
+                }
+                source->list = NULL;
+                continue;
+            }
+            if (*entry == '\0') {
+                continue;
+            }
+        }
+        else {
+            return NULL;
+        }
+
+        path = batch_strdup(entry);
+        if (path == NULL) {
+            *result = ERROR_MEMORY;
+            return NULL;
+        }
+
+        /* the files given explicitly are processed whatever their extension */
+        if (flvmeta_is_directory(path)) {
+            *result = batch_source_push_directory(source, path);
+            if (*result != OK) {
+                return path;
+            }
+        }
+        else {
+            return path;
+        }
+    }
+}
+
+void batch_source_free(batch_source * source) {
+    if (source == NULL) {
+        return;
+    }
+    while (source->directory != NULL) {
+        batch_source_pop_directory(source);
+    }
+    if (source->list != NULL && source->list != stdin) {
+        fclose(source->list);
+    }
+    free(source->line);
+    free(source);
+}
+
+/* write the informative messages of a file along with its output */
+static void batch_print_message(const char * message, void * user_data) {
+    fputs(message, (FILE *)user_data);
+}
+
+/* worker task */
+static void batch_run_job(void * data) {
+    batch_job * job = (batch_job *)data;
+
+    job->result = job->command(&job->options);
+}
+
+/* prepare the processing of an input file, and submit it unless it has already failed */
+static int batch_start_job(batch * b, char * input_file, int result) {
+    batch_job * job;
+    const char * name;
+
+    job = &b->jobs[(b->first_job + b->pending_jobs) % b->jobs_number];
+    b->pending_jobs++;
+
+    memcpy(&job->options, b->options, sizeof(flvmeta_opts));
+    job->options.input_file = input_file;
+    job->options.output_file = input_file;
+    job->options.metadata = NULL;
+    job->options.jobs = 1;
+    job->command = b->command;
+    job->input_file = input_file;
+    job->output_file = NULL;
+    job->out = NULL;
+    job->combined = 1;
+    job->submitted = 0;
+    job->result = result;
+
+    if (result != OK) {
+        return OK;
+    }
+
+    /* per-file destination */
+    if (b->options->batch_output_dir != NULL) {
+        name = batch_get_basename(input_file);
+        if (b->options->command == FLVMETA_UPDATE_COMMAND) {
+            job->output_file = batch_join_path(b->options->batch_output_dir, name, NULL);
+        }
+        else {
+            job->output_file = batch_join_path(b->options->batch_output_dir, name, batch_get_output_extension(b->options));
+        }
+        if (job->output_file == NULL) {
+            job->result = ERROR_MEMORY;
+            return OK;
+        }
+        job->options.output_file = job->output_file;
+
+        if (b->options->command != FLVMETA_UPDATE_COMMAND) {
+            job->out = fopen(job->output_file, "w");
+            if (job->out == NULL) {
+                job->result = ERROR_OPEN_WRITE;
+                return OK;
+            }
+            job->combined = 0;
+        }
+    }
+
+    /* the output is set aside until the previous files are done */
+    if (job->combined) {
+        job->out = flvmeta_tmpfile();
+        if (job->out == NULL) {
+            job->result = ERROR_WRITE;
+            return ERROR_WRITE;
+        }
+    }
+
+    job->options.out = job->out;
+    if (job->options.message_proc != NULL) {
+        job->options.message_proc = batch_print_message;
+        job->options.message_user_data = job->out;
+    }
+
+    /* each update consumes its own copy of the added metadata */
+    if (b->options->metadata != NULL && b->options->command == FLVMETA_UPDATE_COMMAND) {
+        job->options.metadata = amf_data_clone(b->options->metadata);
+        if (job->options.metadata == NULL) {
+            job->result = ERROR_MEMORY;
+            return OK;
+        }
+    }
+
+    job->submitted = 1;
+    flvmeta_pool_submit(b->pool, &job->task, batch_run_job, job);
+    return OK;
+}
+
+int batch_copy_output(FILE * in, FILE * out, const char * input_file) {
+    char buffer[BATCH_COPY_BUFFER_SIZE];
+    size_t size;
+    int empty;
+
+    rewind(in);
+    empty = 1;
+    while ((size = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        if (empty) {
+            if (fprintf(out, "==> %s <==\n", input_file) < 0) {
+                return ERROR_WRITE;
+            }
+            empty = 0;
+        }
+        if (fwrite(buffer, 1, size, out) < size) {
+            return ERROR_WRITE;
+        }
+    }
+    return ferror(in) ? ERROR_WRITE : OK;
+}
+
+/* wait for the oldest input file, and report its result */
+static void batch_finish_job(batch * b) {
+    batch_job * job = &b->jobs[b->first_job];
+
+    if (job->submitted) {
+        flvmeta_pool_wait(b->pool, &job->task);
+    }
+
+    if (job->out != NULL) {
+        if (job->combined) {
+            if (b->result == OK) {
+                b->result = batch_copy_output(job->out, b->options->out, job->input_file);
+            }
+            fclose(job->out);
+        }
+        else if (fclose(job->out) != 0 && job->result == OK) {
+            job->result = ERROR_WRITE;
+        }
+    }
+
+    b->on_result(&job->options, job->result, b->user_data);
+
+    free(job->input_file);
+    free(job->output_file);
+    b->first_job = (b->first_job + 1) % b->jobs_number;
+    b->pending_jobs--;
+}
+
+int batch_run(const flvmeta_opts * options, batch_command_proc command, batch_result_proc on_result, void * user_data) {
+    batch b;
+    batch_source * source;
+    char * input_file;
+    int result;
+
+    b.options = options;
+    b.command = command;
+    b.on_result = on_result;
+    b.user_data = user_data;
+    b.first_job = 0;
+    b.pending_jobs = 0;
+    b.result = OK;
+
+    source = batch_source_new(options);
+    if (source == NULL) {
+        return ERROR_MEMORY;
+    }
+
+    b.pool = flvmeta_pool_new(options->jobs);
+    if (b.pool == NULL) {
+        batch_source_free(source);
+        return ERROR_MEMORY;
+    }
+
+    b.jobs_number = (size_t)flvmeta_pool_get_threads(b.pool) * BATCH_JOBS_PER_THREAD;
+    b.jobs = (batch_job *)calloc(b.jobs_number, sizeof(batch_job));
+    if (b.jobs == NULL) {
+        flvmeta_pool_free(b.pool);
+        batch_source_free(source);
+        return ERROR_MEMORY;
+    }
+
+    while (b.result == OK) {
+        if (b.pending_jobs == b.jobs_number) {
+            batch_finish_job(&b);
+            continue;
+        }
+
+        input_file = batch_source_next(source, &result);
+        if (input_file == NULL) {
+            if (result != OK) {
+                b.result = result;
+            }
+            break;
+        }
+
+        result = batch_start_job(&b, input_file, result);
+        if (result != OK) {
+            b.result = result;
+        }
+    }
+
+    /* report the files already submitted, even after a failure */
+    while (b.pending_jobs > 0) {
+        batch_finish_job(&b);
+    }
+
+    batch_source_free(source);
+    flvmeta_pool_free(b.pool);
+    free(b.jobs);
+    return b.result;
+}
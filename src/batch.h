@@ -0,0 +1,95 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include "flvmeta.h"
+
+/*
+    Batch mode: the command is run on every input file given as argument,
+    found in a directory, or listed in a file, on a pool of worker threads.
+    The output of each file is either written to its own file in the output
+    directory, or set aside and appended to the combined output in the order
+    of the input files.
+*/
+
+/* number of files processed or waiting for each thread */
+#define BATCH_JOBS_PER_THREAD 2
+
+/* command run on a single input file */
+typedef int (* batch_command_proc)(const flvmeta_opts * options);
+
+/* result of a single input file, reported in the order of the input files */
+typedef void (* batch_result_proc)(const flvmeta_opts * options, int result, void * user_data);
+
+/* input files of a batch, listed lazily from the arguments, directories and list */
+typedef struct __batch_source batch_source;
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+    run a command on every input file of the batch options,
+    returns OK unless the combined output cannot be written
+*/
+int batch_run(const flvmeta_opts * options, batch_command_proc command, batch_result_proc on_result, void * user_data);
+
+/* input files of the batch options, or NULL if they cannot be allocated */
+batch_source * batch_source_new(const flvmeta_opts * options);
+
+/*
+    next input file, which must be freed, or NULL at the end of the batch,
+    the result is OK for a file to process, or the error of an unreadable
+    list or directory, returned as a failed input file
+*/
+char * batch_source_next(batch_source * source, int * result);
+
+/* release the input files */
+void batch_source_free(batch_source * source);
+
+/*
+    path made of a directory, a file name, and an optional extension,
+    returns NULL if it cannot be allocated, or the path, which must be freed
+*/
+char * batch_join_path(const char * directory, const char * name, const char * extension);
+
+/* file name part of a path */
+const char * batch_get_basename(const char * path);
+
+/* whether a file name has the .flv extension, in any case */
+int batch_has_flv_extension(const char * name);
+
+/* extension of the output files of a command, according to its format */
+const char * batch_get_output_extension(const flvmeta_opts * options);
+
+/*
+    append a set aside output to another stream, after a line naming
+    the input file, unless it is empty
+*/
+int batch_copy_output(FILE * in, FILE * out, const char * input_file);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __BATCH_H__ */
@@ -0,0 +1,715 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif /* HAVE_PTHREAD */
+
+#include "amf.h"
+#include "hash.h"
+#include "util.h"
+
+/* identity of a file: device, inode, size, modification time in seconds and nanoseconds, and fingerprint */
+#define CACHE_FILE_KEY_SIZE 44
+
+/* key of a result: identity of the input file, and hash of the options */
+#define CACHE_KEY_SIZE (CACHE_FILE_KEY_SIZE + 8)
+
+/*
+    A record is made of the size of its body, the body, and the hash of the
+    body. The body holds the key, the result, the identity of the output
+    file of an update, and the check report.
+*/
+#define CACHE_RECORD_HEADER_SIZE    4
+#define CACHE_RECORD_BODY_SIZE      (CACHE_KEY_SIZE + 4 + CACHE_FILE_KEY_SIZE)
+#define CACHE_RECORD_CHECKSUM_SIZE  8
+
+/* bigger records are considered invalid */
+#define CACHE_MAX_RECORD_SIZE       0x4000000
+
+/* initial number of buckets of the index */
+#define CACHE_INITIAL_BUCKETS       256
+
+/* cached result */
+typedef struct __cache_entry {
+    byte key[CACHE_KEY_SIZE];
+    uint64 hash;
+    int result;
+    byte output_key[CACHE_FILE_KEY_SIZE];
+    file_offset_t report_offset; /* position of the check report in the log */
+    uint32 report_size;
+    struct __cache_entry * next;
+} cache_entry;
+
+struct __flvmeta_cache {
+    char * path;
+    FILE * file;
+    cache_entry ** buckets;
+    size_t buckets_number;
+    size_t entries_number;
+    size_t records_number;
+#ifdef HAVE_PTHREAD
+    pthread_mutex_t mutex;
+#endif /* HAVE_PTHREAD */
+};
+
+static void cache_put_uint32(byte * data, uint32 value) {
+    data[0] = (byte)(value >> 24);
+    data[1] = (byte)(value >> 16);
+    data[2] = (byte)(value >> 8);
+    data[3] = (byte)value;
+}
+
+static void cache_put_uint64(byte * data, uint64 value) {
+    cache_put_uint32(data, (uint32)(value >> 32));
+    cache_put_uint32(data + 4, (uint32)value);
+}
+
+static uint32 cache_get_uint32(const byte * data) {
+    return ((uint32)data[0] << 24) | ((uint32)data[1] << 16) | ((uint32)data[2] << 8) | data[3];
+}
+
+static uint64 cache_get_uint64(const byte * data) {
+    return ((uint64)cache_get_uint32(data) << 32) | cache_get_uint32(data + 4);
+}
+
+static void cache_lock(flvmeta_cache * cache) {
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&cache->mutex);
+#else /* HAVE_PTHREAD */
+    (void)cache;
+#endif /* HAVE_PTHREAD */
+}
+
+static void cache_unlock(flvmeta_cache * cache) {
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&cache->mutex);
+#else /* HAVE_PTHREAD */
+    (void)cache;
+#endif /* HAVE_PTHREAD */
+}
+
+/* add a range of a file to its fingerprint */
+static int cache_hash_range(FILE * file, file_offset_t start, size_t size, xxh64_state * hash) {
+    byte buffer[CACHE_FINGERPRINT_SIZE];
+
+    if (lfs_fseek(file, start, SEEK_SET) != 0 || fread(buffer, 1, size, file) < size) {
+        return ERROR_EOF;
+    }
+    xxh64_update(hash, buffer, size);
+    return OK;
+}
+
+/*
+    identity of a regular file, made of its metadata, and of a hash of its
+    first and last bytes, which changes when the file is rewritten in place
+*/
+static int cache_get_file_key(const char * path, byte * key) {
+#ifdef WIN32
+    struct _stati64 st;
+#else /* WIN32 */
+    struct stat st;
+#endif /* WIN32 */
+    xxh64_state hash;
+    file_offset_t size, tail_start;
+    size_t head_size;
+    uint32 mtime_nsec;
+    FILE * file;
+    int result;
+
+#ifdef WIN32
+    if (_stati64(path, &st) != 0 || (st.st_mode & _S_IFMT) != _S_IFREG) {
+        return ERROR_OPEN_READ;
+    }
+#else /* WIN32 */
+    if (stat(path, &st) != 0 || (st.st_mode & S_IFMT) != S_IFREG) {
+        return ERROR_OPEN_READ;
+    }
+#endif /* WIN32 */
+
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    mtime_nsec = (uint32)st.st_mtim.tv_nsec;
+#else /* HAVE_STRUCT_STAT_ST_MTIM */
+    mtime_nsec = 0;
+#endif /* HAVE_STRUCT_STAT_ST_MTIM */
+
+    size = (file_offset_t)st.st_size;
+    cache_put_uint64(key, (uint64)st.st_dev);
+    cache_put_uint64(key + 8, (uint64)st.st_ino);
+    cache_put_uint64(key + 16, (uint64)size);
+    cache_put_uint64(key + 24, (uint64)st.st_mtime);
+    cache_put_uint32(key + 32, mtime_nsec);
+
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        return ERROR_OPEN_READ;
+    }
+
+    head_size = (size < CACHE_FINGERPRINT_SIZE) ? (size_t)size : CACHE_FINGERPRINT_SIZE;
+    tail_start = (size - (file_offset_t)head_size > CACHE_FINGERPRINT_SIZE) ? size - CACHE_FINGERPRINT_SIZE : (file_offset_t)head_size;
+
+    xxh64_reset(&hash, 0);
+    result = cache_hash_range(file, 0, head_size, &hash);
+    if (result == OK) {
+        result = cache_hash_range(file, tail_start, (size_t)(size - tail_start), &hash);
+    }
+    fclose(file);
+
+    cache_put_uint64(key + 36, xxh64_digest(&hash));
+    return result;
+}
+
+/* AMF data writer adding the options metadata to their hash */
+static size_t cache_hash_write(const void * buffer, size_t size, void * user_data) {
+    xxh64_update((xxh64_state *)user_data, buffer, size);
+    return size;
+}
+
+static void cache_hash_int(xxh64_state * hash, int value) {
+    byte data[4];
+
+    cache_put_uint32(data, (uint32)value);
+    xxh64_update(hash, data, sizeof(data));
+}
+
+static void cache_hash_string(xxh64_state * hash, const char * str) {
+    if (str != NULL) {
+        cache_hash_int(hash, (int)strlen(str));
+        xxh64_update(hash, str, strlen(str));
+    }
+    else {
+        cache_hash_int(hash, -1);
+    }
+}
+
+/* hash of the version, the paths, and the options the result of a command depends on */
+static uint64 cache_get_options_hash(const flvmeta_opts * options) {
+    xxh64_state hash;
+    size_t i;
+
+    xxh64_reset(&hash, 0);
+    cache_hash_string(&hash, PACKAGE_STRING);
+    cache_hash_int(&hash, options->command);
+    cache_hash_string(&hash, options->input_file);
+
+    if (options->command == FLVMETA_CHECK_COMMAND) {
+        cache_hash_int(&hash, options->quiet);
+        cache_hash_int(&hash, options->check_level);
+        cache_hash_int(&hash, options->check_report_format);
+        cache_hash_int(&hash, options->check_quick);
+        cache_hash_int(&hash, options->check_structure);
+        cache_hash_int(&hash, options->check_nal_units);
+        cache_hash_int(&hash, options->check_fail_fast);
+        cache_hash_int(&hash, (int)options->check_disabled_rules_number);
+        for (i = 0; i < options->check_disabled_rules_number; ++i) {
+            cache_hash_int(&hash, options->check_disabled_rules[i]);
+        }
+    }
+    else {
+        cache_hash_string(&hash, options->output_file);
+        cache_hash_int(&hash, options->insert_onlastsecond);
+        cache_hash_int(&hash, options->reset_timestamps);
+        cache_hash_int(&hash, options->all_keyframes);
+        cache_hash_int(&hash, options->preserve_metadata);
+        cache_hash_int(&hash, options->error_handling);
+        cache_hash_int(&hash, options->metadata != NULL);
+        if (options->metadata != NULL) {
+            amf_data_write(options->metadata, cache_hash_write, &hash);
+        }
+    }
+
+    return xxh64_digest(&hash);
+}
+
+/* cached result of a key, or NULL */
+static cache_entry * cache_find(const flvmeta_cache * cache, const byte * key, uint64 hash) {
+    cache_entry * entry;
+
+    for (entry = cache->buckets[hash & (cache->buckets_number - 1)]; entry != NULL; entry = entry->next) {
+        if (entry->hash == hash && memcmp(entry->key, key, CACHE_KEY_SIZE) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/* double the number of buckets of the index */
+static int cache_grow(flvmeta_cache * cache) {
+    cache_entry ** buckets;
+    cache_entry * entry;
+    size_t buckets_number, i;
+
+    buckets_number = cache->buckets_number * 2;
+    buckets = (cache_entry **)calloc(buckets_number, sizeof(cache_entry *));
+    if (buckets == NULL) {
+        return ERROR_MEMORY;
+    }
+
+    for (i = 0; i < cache->buckets_number; ++i) {
+        while ((entry = cache->buckets[i]) != NULL) {
+            cache->buckets[i] = entry->next;
+            entry->next = buckets[entry->hash & (buckets_number - 1)];
+            buckets[entry->hash & (buckets_number - 1)] = entry;
+        }
+    }
+
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->buckets_number = buckets_number;
+    return OK;
+}
+
+/* index the result of a record, replacing the previous result of the same key */
+static int cache_set_entry(flvmeta_cache * cache, const byte * body, file_offset_t report_offset, uint32 report_size) {
+    cache_entry * entry;
+    uint64 hash;
+
+    hash = xxh64(body, CACHE_KEY_SIZE, 0);
+    entry = cache_find(cache, body, hash);
+    if (entry == NULL) {
+        if (cache->entries_number >= cache->buckets_number && cache_grow(cache) != OK) {
+            return ERROR_MEMORY;
+        }
+
+        entry = (cache_entry *)malloc(sizeof(cache_entry));
+        if (entry == NULL) {
+            return ERROR_MEMORY;
+        }
+        memcpy(entry->key, body, CACHE_KEY_SIZE);
+        entry->hash = hash;
+        entry->next = cache->buckets[hash & (cache->buckets_number - 1)];
+        cache->buckets[hash & (cache->buckets_number - 1)] = entry;
+        cache->entries_number++;
+    }
+
+    entry->result = (int)(sint32)cache_get_uint32(body + CACHE_KEY_SIZE);
+    memcpy(entry->output_key, body + CACHE_KEY_SIZE + 4, CACHE_FILE_KEY_SIZE);
+    entry->report_offset = report_offset;
+    entry->report_size = report_size;
+    return OK;
+}
+
+/* append a record to a log, returning the position of its report */
+static int cache_write_record(FILE * out, const byte * body, const byte * report, uint32 report_size, file_offset_t * report_offset) {
+    byte header[CACHE_RECORD_HEADER_SIZE];
+    byte checksum[CACHE_RECORD_CHECKSUM_SIZE];
+    xxh64_state hash;
+
+    cache_put_uint32(header, CACHE_RECORD_BODY_SIZE + report_size);
+    xxh64_reset(&hash, 0);
+    xxh64_update(&hash, body, CACHE_RECORD_BODY_SIZE);
+    if (report_size > 0) {
+        xxh64_update(&hash, report, report_size);
+    }
+    cache_put_uint64(checksum, xxh64_digest(&hash));
+
+    if (lfs_fseek(out, 0, SEEK_END) != 0) {
+        return ERROR_WRITE;
+    }
+    *report_offset = lfs_ftell(out) + CACHE_RECORD_HEADER_SIZE + CACHE_RECORD_BODY_SIZE;
+
+    if (fwrite(header, sizeof(header), 1, out) != 1
+    || fwrite(body, CACHE_RECORD_BODY_SIZE, 1, out) != 1
+    || (report_size > 0 && fwrite(report, report_size, 1, out) != 1)
+    || fwrite(checksum, sizeof(checksum), 1, out) != 1) {
+        return ERROR_WRITE;
+    }
+    return OK;
+}
+
+/* check report of a cached result, or NULL if it cannot be read */
+static byte * cache_read_report(flvmeta_cache * cache, const cache_entry * entry) {
+    byte * report;
+
+    report = (byte *)malloc(entry->report_size + 1);
+    if (report == NULL) {
+        return NULL;
+    }
+    if (entry->report_size > 0
+    && (lfs_fseek(cache->file, entry->report_offset, SEEK_SET) != 0
+        || fread(report, entry->report_size, 1, cache->file) != 1)) {
+        free(report);
+        return NULL;
+    }
+    return report;
+}
+
+/*
+    Index the records of the log, stopping at the first invalid one,
+    reported as corrupted. Returns ERROR_NO_FLV if the file is not a cache.
+*/
+static int cache_load(flvmeta_cache * cache, int * corrupted) {
+    char signature[sizeof(CACHE_SIGNATURE) - 1];
+    byte header[CACHE_RECORD_HEADER_SIZE];
+    byte * record, * buffer;
+    file_offset_t offset;
+    size_t size, read;
+    int result;
+
+    *corrupted = 0;
+    if (lfs_fseek(cache->file, 0, SEEK_SET) != 0) {
+        return ERROR_OPEN_READ;
+    }
+
+    /* a new cache starts with the signature */
+    read = fread(signature, 1, sizeof(signature), cache->file);
+    if (read == 0 && feof(cache->file)) {
+        if (lfs_fseek(cache->file, 0, SEEK_END) != 0
+        || fwrite(CACHE_SIGNATURE, sizeof(signature), 1, cache->file) != 1
+        || fflush(cache->file) != 0) {
+            return ERROR_WRITE;
+        }
+        return OK;
+    }
+    if (read < sizeof(signature) || memcmp(signature, CACHE_SIGNATURE, sizeof(signature)) != 0) {
+        return ERROR_NO_FLV;
+    }
+
+    record = NULL;
+    result = OK;
+    for (;;) {
+        offset = lfs_ftell(cache->file);
+        read = fread(header, 1, sizeof(header), cache->file);
+        if (read < sizeof(header)) {
+            *corrupted = (read > 0);
+            break;
+        }
+
+        size = cache_get_uint32(header);
+        if (size < CACHE_RECORD_BODY_SIZE || size > CACHE_MAX_RECORD_SIZE) {
+            *corrupted = 1;
+            break;
+        }
+
+        buffer = (byte *)realloc(record, size + CACHE_RECORD_CHECKSUM_SIZE);
+        if (buffer == NULL) {
+            result = ERROR_MEMORY;
+            break;
+        }
+        record = buffer;
+
+        if (fread(record, size + CACHE_RECORD_CHECKSUM_SIZE, 1, cache->file) != 1
+        || xxh64(record, size, 0) != cache_get_uint64(record + size)) {
+            *corrupted = 1;
+            break;
+        }
+
+        result = cache_set_entry(cache, record, offset + CACHE_RECORD_HEADER_SIZE + CACHE_RECORD_BODY_SIZE,
+            (uint32)(size - CACHE_RECORD_BODY_SIZE));
+        if (result != OK) {
+            break;
+        }
+        cache->records_number++;
+    }
+
+    free(record);
+    return result;
+}
+
+/*
+    Rewrite the log with the indexed results only,
+    dropping the replaced and invalid records.
+*/
+static int cache_compact(flvmeta_cache * cache) {
+    file_offset_t * offsets;
+    cache_entry * entry;
+    byte body[CACHE_RECORD_BODY_SIZE];
+    byte * report;
+    char * temp_path;
+    size_t path_length, i, n;
+    FILE * out;
+    int result;
+
+    path_length = strlen(cache->path);
+    temp_path = (char *)malloc(path_length + 5);
+    offsets = (file_offset_t *)malloc((cache->entries_number + 1) * sizeof(file_offset_t));
+    if (temp_path == NULL || offsets == NULL) {
+        free(temp_path);
+        free(offsets);
+        return ERROR_MEMORY;
+    }
+    memcpy(temp_path, cache->path, path_length);
+    memcpy(temp_path + path_length, ".tmp", 5);
+
+    out = fopen(temp_path, "wb");
+    result = (out != NULL && fwrite(CACHE_SIGNATURE, sizeof(CACHE_SIGNATURE) - 1, 1, out) == 1) ? OK : ERROR_WRITE;
+
+    /* the reports are copied from the previous log */
+    n = 0;
+    for (i = 0; i < cache->buckets_number && result == OK; ++i) {
+        for (entry = cache->buckets[i]; entry != NULL && result == OK; entry = entry->next) {
+            report = cache_read_report(cache, entry);
+            if (report == NULL) {
+                result = ERROR_OPEN_READ;
+                break;
+            }
+            memcpy(body, entry->key, CACHE_KEY_SIZE);
+            cache_put_uint32(body + CACHE_KEY_SIZE, (uint32)entry->result);
+            memcpy(body + CACHE_KEY_SIZE + 4, entry->output_key, CACHE_FILE_KEY_SIZE);
+            result = cache_write_record(out, body, report, entry->report_size, &offsets[n++]);
+            free(report);
+        }
+    }
+
+    if (out != NULL && fclose(out) != 0 && result == OK) {
+        result = ERROR_WRITE;
+    }
+
+    if (result == OK) {
+        fclose(cache->file);
+#ifdef WIN32
+        remove(cache->path);
+#endif /* WIN32 */
+        if (rename(temp_path, cache->path) != 0) {
+            result = ERROR_WRITE;
+        }
+        cache->file = fopen(cache->path, "a+b");
+    }
+    else if (out != NULL) {
+        remove(temp_path);
+    }
+
+    /* the reports are now in the new log */
+    if (result == OK) {
+        n = 0;
+        for (i = 0; i < cache->buckets_number; ++i) {
+            for (entry = cache->buckets[i]; entry != NULL; entry = entry->next) {
+                entry->report_offset = offsets[n++];
+            }
+        }
+        cache->records_number = cache->entries_number;
+    }
+
+    free(temp_path);
+    free(offsets);
+    return result;
+}
+
+flvmeta_cache * flvmeta_cache_open(const char * path) {
+    flvmeta_cache * cache;
+    size_t path_length;
+    int corrupted;
+
+    cache = (flvmeta_cache *)calloc(1, sizeof(flvmeta_cache));
+    if (cache == NULL) {
+        return NULL;
+    }
+#ifdef HAVE_PTHREAD
+    pthread_mutex_init(&cache->mutex, NULL);
+#endif /* HAVE_PTHREAD */
+
+    path_length = strlen(path);
+    cache->path = (char *)malloc(path_length + 1);
+    cache->buckets_number = CACHE_INITIAL_BUCKETS;
+    cache->buckets = (cache_entry **)calloc(cache->buckets_number, sizeof(cache_entry *));
+    if (cache->path == NULL || cache->buckets == NULL) {
+        flvmeta_cache_close(cache);
+        return NULL;
+    }
+    memcpy(cache->path, path, path_length + 1);
+
+    /* files that are not caches are left untouched */
+    cache->file = fopen(path, "a+b");
+    if (cache->file == NULL || cache_load(cache, &corrupted) != OK) {
+        flvmeta_cache_close(cache);
+        return NULL;
+    }
+
+    /* an interrupted write, or too many replaced results */
+    if (corrupted || (cache->records_number > CACHE_COMPACT_MIN_RECORDS && cache->records_number > 2 * cache->entries_number)) {
+        cache_compact(cache);
+    }
+    return cache;
+}
+
+void flvmeta_cache_close(flvmeta_cache * cache) {
+    cache_entry * entry;
+    size_t i;
+
+    if (cache->buckets != NULL) {
+        for (i = 0; i < cache->buckets_number; ++i) {
+            while ((entry = cache->buckets[i]) != NULL) {
+                cache->buckets[i] = entry->next;
+                free(entry);
+            }
+        }
+    }
+
+    if (cache->file != NULL) {
+        fclose(cache->file);
+    }
+    free(cache->buckets);
+    free(cache->path);
+#ifdef HAVE_PTHREAD
+    pthread_mutex_destroy(&cache->mutex);
+#endif /* HAVE_PTHREAD */
+    free(cache);
+}
+
+/* append a result to the log, and index it */
+static void cache_store(flvmeta_cache * cache, const byte * key, int result, const byte * output_key, const byte * report, size_t report_size) {
+    byte body[CACHE_RECORD_BODY_SIZE];
+    file_offset_t report_offset;
+
+    if (report_size > CACHE_MAX_RECORD_SIZE - CACHE_RECORD_BODY_SIZE) {
+        return;
+    }
+
+    memcpy(body, key, CACHE_KEY_SIZE);
+    cache_put_uint32(body + CACHE_KEY_SIZE, (uint32)result);
+    if (output_key != NULL) {
+        memcpy(body + CACHE_KEY_SIZE + 4, output_key, CACHE_FILE_KEY_SIZE);
+    }
+    else {
+        memset(body + CACHE_KEY_SIZE + 4, 0, CACHE_FILE_KEY_SIZE);
+    }
+
+    cache_lock(cache);
+    if (cache->file != NULL
+    && cache_write_record(cache->file, body, report, (uint32)report_size, &report_offset) == OK
+    && fflush(cache->file) == 0
+    && cache_set_entry(cache, body, report_offset, (uint32)report_size) == OK) {
+        cache->records_number++;
+    }
+    cache_unlock(cache);
+}
+
+/* print the cached report of an unchanged file, or check it and cache its report */
+static int cache_run_check(flvmeta_cache * cache, const flvmeta_opts * options, flvmeta_cache_command_proc command, byte * key) {
+    byte file_key[CACHE_FILE_KEY_SIZE];
+    flvmeta_opts check_options;
+    flvmeta_buffer buffer;
+    const cache_entry * entry;
+    byte * report;
+    size_t report_size;
+    int result;
+
+    cache_lock(cache);
+    entry = (cache->file != NULL) ? cache_find(cache, key, xxh64(key, CACHE_KEY_SIZE, 0)) : NULL;
+    report = (entry != NULL) ? cache_read_report(cache, entry) : NULL;
+    report_size = (report != NULL) ? entry->report_size : 0;
+    result = (report != NULL) ? entry->result : OK;
+    cache_unlock(cache);
+
+    if (report != NULL) {
+        if (options->verbose) {
+            flvmeta_message(options, "%s is unchanged, using the cached check report\n", options->input_file);
+        }
+        if (report_size > 0 && fwrite(report, report_size, 1, options->out) != 1) {
+            result = ERROR_WRITE;
+        }
+        free(report);
+        return result;
+    }
+
+    /* the report is set aside to be cached */
+    if (!flvmeta_buffer_open(&buffer)) {
+        return command(options);
+    }
+    memcpy(&check_options, options, sizeof(flvmeta_opts));
+    check_options.out = buffer.stream;
+    result = command(&check_options);
+
+    report = (byte *)flvmeta_buffer_release(&buffer, &report_size);
+    if (report == NULL) {
+        return ERROR_MEMORY;
+    }
+    if (report_size > 0 && fwrite(report, report_size, 1, options->out) != 1) {
+        result = ERROR_WRITE;
+    }
+
+    /* only the results of files left unchanged by the check are cached */
+    if ((result == OK || result == ERROR_INVALID_FLV_FILE)
+    && cache_get_file_key(options->input_file, file_key) == OK
+    && memcmp(file_key, key, CACHE_FILE_KEY_SIZE) == 0) {
+        cache_store(cache, key, result, NULL, report, report_size);
+    }
+
+    free(report);
+    return result;
+}
+
+/* skip the update of an unchanged file whose output is unchanged, or update it and cache its output */
+static int cache_run_update(flvmeta_cache * cache, const flvmeta_opts * options, flvmeta_cache_command_proc command, byte * key) {
+    byte file_key[CACHE_FILE_KEY_SIZE];
+    byte output_key[CACHE_FILE_KEY_SIZE];
+    const cache_entry * entry;
+    int cached, result;
+
+    cache_lock(cache);
+    entry = (cache->file != NULL) ? cache_find(cache, key, xxh64(key, CACHE_KEY_SIZE, 0)) : NULL;
+    cached = (entry != NULL);
+    if (cached) {
+        memcpy(output_key, entry->output_key, CACHE_FILE_KEY_SIZE);
+    }
+    cache_unlock(cache);
+
+    if (cached && cache_get_file_key(options->output_file, file_key) == OK
+    && memcmp(file_key, output_key, CACHE_FILE_KEY_SIZE) == 0) {
+        if (options->verbose) {
+            flvmeta_message(options, "%s is unchanged, skipping the update\n", options->input_file);
+        }
+        return OK;
+    }
+
+    result = command(options);
+    if (result != OK || cache_get_file_key(options->output_file, output_key) != OK) {
+        return result;
+    }
+
+    /* a file updated in place is identified by its new contents */
+    if (flvmeta_same_file(options->input_file, options->output_file)) {
+        memcpy(key, output_key, CACHE_FILE_KEY_SIZE);
+    }
+    else if (cache_get_file_key(options->input_file, file_key) != OK
+    || memcmp(file_key, key, CACHE_FILE_KEY_SIZE) != 0) {
+        return result;
+    }
+
+    cache_store(cache, key, result, output_key, NULL, 0);
+    return result;
+}
+
+int flvmeta_cache_run(flvmeta_cache * cache, const flvmeta_opts * options, flvmeta_cache_command_proc command) {
+    byte key[CACHE_KEY_SIZE];
+
+    /* the statistics, and the metadata dumped after updates, are not cached */
+    if (options->input_file == NULL || options->stats
+    || (options->command != FLVMETA_CHECK_COMMAND && options->command != FLVMETA_UPDATE_COMMAND)
+    || (options->command == FLVMETA_UPDATE_COMMAND && (options->output_file == NULL || options->dump_metadata))
+    || cache_get_file_key(options->input_file, key) != OK) {
+        return command(options);
+    }
+    cache_put_uint64(key + CACHE_FILE_KEY_SIZE, cache_get_options_hash(options));
+
+    if (options->command == FLVMETA_CHECK_COMMAND) {
+        return cache_run_check(cache, options, command, key);
+    }
+    return cache_run_update(cache, options, command, key);
+}
@@ -0,0 +1,77 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include "flvmeta.h"
+
+/**
+    Cache of the check and update results of unchanged files.
+    The results are appended to a single log file, and indexed in memory
+    when the cache is opened. A file is identified by its device, inode,
+    size, and modification time, along with a hash of its first and last
+    bytes, and the options the result depends on.
+    The check report of an unchanged file is printed again from the cache,
+    and an unchanged file whose updated output is still in place is not
+    updated again.
+*/
+
+/* signature and version of the cache files */
+#define CACHE_SIGNATURE "FLVMETA CACHE 1\n"
+
+/* size of the beginning and of the end of a file whose hash identifies it */
+#define CACHE_FINGERPRINT_SIZE 4096
+
+/* the log is rewritten without its replaced records past this number of records */
+#define CACHE_COMPACT_MIN_RECORDS 1024
+
+/* command run on a file whose result is not cached */
+typedef int (* flvmeta_cache_command_proc)(const flvmeta_opts * options);
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+    Open a cache file, creating it if needed, and index its results.
+    Invalid or truncated records are discarded.
+    Returns NULL if the file cannot be opened or the memory allocated.
+*/
+flvmeta_cache * flvmeta_cache_open(const char * path);
+
+/* close a cache file and release its index */
+void flvmeta_cache_close(flvmeta_cache * cache);
+
+/*
+    Run a check or update command on the input file of the options,
+    unless the result of the same command on the same file is cached,
+    then cache its result. Other commands are run uncached.
+    The cache can be shared by several threads.
+    Returns the result of the command, cached or not.
+*/
+int flvmeta_cache_run(flvmeta_cache * cache, const flvmeta_opts * options, flvmeta_cache_command_proc command);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __CACHE_H__ */
@@ -20,11 +20,15 @@
     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 */
 #include "check.h"
+#include "aac.h"
+#include "avc.h"
 #include "dump.h"
 #include "info.h"
 #include "json.h"
+#include "stats.h"
 #include "util.h"
 
+#include <ctype.h>
 #include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -35,36 +39,262 @@
 
 #define MAX_ACCEPTABLE_TAG_BODY_LENGTH 1000000
 
+/* check rules, sorted by unique identifier */
+typedef struct __check_rule {
+    const char * code;
+    int cost;
+} check_rule;
+
+static const check_rule check_rules[] = {
+    { FATAL_HEADER_EOF,                    CHECK_COST_HEADER },
+    { FATAL_HEADER_NO_SIGNATURE,           CHECK_COST_HEADER },
+    { ERROR_HEADER_BAD_VERSION,            CHECK_COST_HEADER },
+    { ERROR_HEADER_NO_STREAMS,             CHECK_COST_HEADER },
+    { INFO_HEADER_NO_AUDIO,                CHECK_COST_HEADER },
+    { WARNING_HEADER_NO_VIDEO,             CHECK_COST_HEADER },
+    { ERROR_HEADER_BAD_RESERVED_FLAGS,     CHECK_COST_HEADER },
+    { ERROR_HEADER_BAD_OFFSET,             CHECK_COST_HEADER },
+    { FATAL_PREV_TAG_SIZE_EOF,             CHECK_COST_HEADER },
+    { ERROR_PREV_TAG_SIZE_BAD_FIRST,       CHECK_COST_HEADER },
+    { FATAL_GENERAL_NO_TAG,                CHECK_COST_HEADER },
+    { FATAL_TAG_EOF,                       CHECK_COST_TAG },
+    { ERROR_TAG_TYPE_UNKNOWN,              CHECK_COST_TAG },
+    { WARNING_HEADER_UNEXPECTED_VIDEO,     CHECK_COST_TAG },
+    { WARNING_HEADER_UNEXPECTED_AUDIO,     CHECK_COST_TAG },
+    { FATAL_TAG_BODY_LENGTH_OVERFLOW,      CHECK_COST_TAG },
+    { WARNING_TAG_BODY_LENGTH_LARGE,       CHECK_COST_TAG },
+    { WARNING_TAG_BODY_LENGTH_ZERO,        CHECK_COST_TAG },
+    { ERROR_TIMESTAMP_FIRST_NON_ZERO,      CHECK_COST_TAG },
+    { ERROR_TIMESTAMP_AUDIO_DECREASE,      CHECK_COST_TAG },
+    { ERROR_TIMESTAMP_VIDEO_DECREASE,      CHECK_COST_TAG },
+    { ERROR_TIMESTAMP_OVERFLOW,            CHECK_COST_TAG },
+    { ERROR_TIMESTAMP_DECREASE,            CHECK_COST_TAG },
+    { WARNING_TIMESTAMP_DESYNC,            CHECK_COST_TAG },
+    { ERROR_TAG_STREAM_ID_NON_ZERO,        CHECK_COST_TAG },
+    { WARNING_AUDIO_FORMAT_CHANGED,        CHECK_COST_BODY },
+    { WARNING_AUDIO_CODEC_UNKNOWN,         CHECK_COST_BODY },
+    { WARNING_AUDIO_CODEC_RESERVED,        CHECK_COST_BODY },
+    { WARNING_AUDIO_CODEC_AAC_BAD,         CHECK_COST_BODY },
+    { WARNING_AUDIO_CODEC_NELLYMOSER_BAD,  CHECK_COST_BODY },
+    { WARNING_AUDIO_CODEC_AAC_MONO,        CHECK_COST_BODY },
+    { WARNING_AUDIO_CODEC_LINEAR_PCM,      CHECK_COST_BODY },
+    { WARNING_VIDEO_FORMAT_CHANGED,        CHECK_COST_BODY },
+    { ERROR_VIDEO_FRAME_TYPE_UNKNOWN,      CHECK_COST_BODY },
+    { WARNING_VIDEO_NO_FIRST_KEYFRAME,     CHECK_COST_BODY },
+    { ERROR_VIDEO_CODEC_UNKNOWN,           CHECK_COST_BODY },
+    { WARNING_VIDEO_CODEC_JPEG,            CHECK_COST_BODY },
+    { WARNING_METADATA_EMPTY,              CHECK_COST_METADATA },
+    { ERROR_METADATA_NAME_INVALID,         CHECK_COST_METADATA },
+    { ERROR_METADATA_DATA_INVALID,         CHECK_COST_METADATA },
+    { ERROR_METADATA_NAME_INVALID_TYPE,    CHECK_COST_METADATA },
+    { WARNING_METADATA_NAME_EMPTY,         CHECK_COST_METADATA },
+    { WARNING_METADATA_DATA_REMAINING,     CHECK_COST_METADATA },
+    { WARNING_METADATA_DATA_MISSING,       CHECK_COST_METADATA },
+    { WARNING_METADATA_LAST_SECOND_DUP,    CHECK_COST_METADATA },
+    { ERROR_METADATA_DATA_INVALID_TYPE,    CHECK_COST_METADATA },
+    { WARNING_METADATA_BAD_TAG,            CHECK_COST_METADATA },
+    { WARNING_METADATA_BAD_TIMESTAMP,      CHECK_COST_METADATA },
+    { WARNING_METADATA_DUPLICATE,          CHECK_COST_METADATA },
+    { INFO_METADATA_NAME_UNKNOWN,          CHECK_COST_METADATA },
+    { ERROR_PREV_TAG_SIZE_BAD,             CHECK_COST_TAG },
+    { WARNING_HEADER_VIDEO_NOT_FOUND,      CHECK_COST_TAG },
+    { WARNING_HEADER_AUDIO_NOT_FOUND,      CHECK_COST_TAG },
+    { WARNING_TIMESTAMP_VIDEO_ENDS_FIRST,  CHECK_COST_TAG },
+    { WARNING_TIMESTAMP_AUDIO_ENDS_FIRST,  CHECK_COST_TAG },
+    { WARNING_VIDEO_NO_KEYFRAME,           CHECK_COST_BODY },
+    { WARNING_VIDEO_ONLY_KEYFRAMES,        CHECK_COST_BODY },
+    { WARNING_VIDEO_ONLY_KF_LAST_SEC,      CHECK_COST_METADATA },
+    { WARNING_METADATA_LAST_SECOND_BAD,    CHECK_COST_METADATA },
+    { WARNING_METADATA_NOT_PRESENT,        CHECK_COST_METADATA },
+    { FATAL_INFO_COMPUTATION_ERROR,        CHECK_COST_METADATA },
+    { WARNING_AMF_DATA_INVALID_VALUE,      CHECK_COST_METADATA },
+    { WARNING_AMF_DATA_INVALID_TYPE,       CHECK_COST_METADATA },
+    { WARNING_AMF_DATA_VIDEO_NEEDED,       CHECK_COST_METADATA },
+    { WARNING_AMF_DATA_AUDIO_NEEDED,       CHECK_COST_METADATA },
+    { WARNING_AMF_DATA_AUDIO_VIDEO_NEEDED, CHECK_COST_METADATA },
+    { WARNING_KEYFRAMES_TIMES_MISSING,     CHECK_COST_METADATA },
+    { WARNING_KEYFRAMES_FILEPOS_MISSING,   CHECK_COST_METADATA },
+    { WARNING_KEYFRAMES_TIMES_TYPE_BAD,    CHECK_COST_METADATA },
+    { WARNING_KEYFRAMES_FILEPOS_TYPE_BAD,  CHECK_COST_METADATA },
+    { WARNING_KEYFRAMES_ARRAY_LENGTH_BAD,  CHECK_COST_METADATA },
+    { WARNING_KEYFRAMES_TIME_TYPE_BAD,     CHECK_COST_METADATA },
+    { WARNING_KEYFRAMES_POS_TYPE_BAD,      CHECK_COST_METADATA },
+    { WARNING_KEYFRAMES_TIME_BAD,          CHECK_COST_METADATA },
+    { WARNING_KEYFRAMES_POS_BAD,           CHECK_COST_METADATA },
+    { WARNING_KEYFRAMES_TIME_DUPLICATE,    CHECK_COST_METADATA },
+    { ERROR_VIDEO_WIDTH_MISSING,           CHECK_COST_METADATA },
+    { ERROR_VIDEO_HEIGHT_MISSING,          CHECK_COST_METADATA },
+    { WARNING_VIDEO_SIZE_ERROR,            CHECK_COST_METADATA },
+    { INFO_VIDEO_CODEC,                    CHECK_COST_BODY },
+    { INFO_AUDIO_FORMAT,                   CHECK_COST_BODY },
+    { INFO_TIMESTAMP_USE_EXTENDED,         CHECK_COST_TAG },
+    { INFO_GENERAL_LARGE_FILE,             CHECK_COST_HEADER },
+    { FATAL_CONSECUTIVE_UNKNOWN_TAGS,      CHECK_COST_TAG },
+    { ERROR_EXTENDED_VIDEO_CODEC_UNKNOWN,  CHECK_COST_BODY },
+    { ERROR_GENERAL_TRUNCATED,             CHECK_COST_TAG },
+    { INFO_TIMESTAMP_LAST,                 CHECK_COST_TAG },
+    { ERROR_AVC_NO_SEQUENCE_HEADER,        CHECK_COST_FRAME },
+    { ERROR_AVC_NAL_UNIT_LENGTH_BAD,       CHECK_COST_FRAME },
+    { WARNING_AVC_IDR_NOT_KEYFRAME,        CHECK_COST_FRAME },
+    { WARNING_AVC_PARAMETER_SET_CHANGED,   CHECK_COST_FRAME },
+    { ERROR_AAC_SEQUENCE_HEADER_INVALID,   CHECK_COST_BODY },
+    { WARNING_AAC_CHANNELS_MISMATCH,       CHECK_COST_BODY },
+    { WARNING_AAC_CONFIG_CHANGED,          CHECK_COST_BODY },
+    { ERROR_AAC_NO_SEQUENCE_HEADER,        CHECK_COST_BODY },
+    { ERROR_AAC_RAW_FRAME_ADTS,            CHECK_COST_BODY },
+    { WARNING_AAC_RAW_FRAME_ELEMENT_BAD,   CHECK_COST_BODY },
+    { WARNING_KEYFRAMES_ENTRY_MISSING,     CHECK_COST_METADATA },
+    { WARNING_KEYFRAMES_ENTRY_EXTRA,       CHECK_COST_METADATA },
+    { WARNING_KEYFRAMES_POS_SHIFTED,       CHECK_COST_METADATA },
+    { INFO_KEYFRAMES_ALIGNMENT,            CHECK_COST_METADATA },
+};
+
+#define CHECK_RULES_NUMBER (sizeof(check_rules) / sizeof(check_rule))
+
+/* rule identifier, from the last three digits of its code */
+#define check_code_get_id(code) (((code)[3] - '0') * 100 + ((code)[4] - '0') * 10 + ((code)[5] - '0'))
+
 typedef struct {
     json_emitter je;
+    const flvmeta_opts * opts;
+    uint32 errors;
+    uint32 warnings;
+    int stop; /* a finding requested the check to stop */
+    int run_body; /* tag bodies must be read */
+    int run_metadata; /* script data must be decoded and compared with the file */
+    int run_frames; /* video frames must be read entirely */
+    byte enabled[CHECK_RULES_NUMBER + 1]; /* indexed by rule identifier */
+    check_result * result; /* findings are collected here instead of being printed if not NULL */
+    int status; /* ERROR_MEMORY if the check ran out of memory */
+    flvmeta_stats * stats; /* performance counters, NULL if not requested */
 } check_context;
 
+/* get the level of a message code */
+static int check_code_get_level(const char * code) {
+    switch (code[0]) {
+        case 'F': return FLVMETA_CHECK_LEVEL_FATAL;
+        case 'E': return FLVMETA_CHECK_LEVEL_ERROR;
+        case 'W': return FLVMETA_CHECK_LEVEL_WARNING;
+        default: return FLVMETA_CHECK_LEVEL_INFO;
+    }
+}
+
+/* get the code of a rule from its identifier */
+const char * check_get_rule_code(int id) {
+    return (id >= 1 && id <= (int)CHECK_RULES_NUMBER) ? check_rules[id - 1].code : NULL;
+}
+
+/* get the identifier of a rule from its code or its number */
+int check_get_rule_id(const char * code) {
+    size_t len, i;
+    int id;
+
+    len = strlen(code);
+    if (len == 0 || len > 6) {
+        return -1;
+    }
+
+    /* complete code such as W81074 */
+    if (len == 6 && !isdigit((unsigned char)code[0])) {
+        for (i = 1; i < len; ++i) {
+            if (!isdigit((unsigned char)code[i])) {
+                return -1;
+            }
+        }
+        id = check_code_get_id(code);
+        if (id < 1 || id > (int)CHECK_RULES_NUMBER || strcmp(check_rules[id - 1].code, code)) {
+            return -1;
+        }
+        return id;
+    }
+
+    /* rule number */
+    id = 0;
+    for (i = 0; i < len; ++i) {
+        if (!isdigit((unsigned char)code[i])) {
+            return -1;
+        }
+        id = id * 10 + (code[i] - '0');
+    }
+    return (id >= 1 && id <= (int)CHECK_RULES_NUMBER) ? id : -1;
+}
+
+/*
+    enable the rules reported at the requested level and not disabled,
+    then determine which parts of the file must be read: fatal findings
+    only report that the check cannot go on, so they never require the
+    tag bodies or the script data to be read on their own
+*/
+static void check_context_init(check_context * ctxt, const flvmeta_opts * opts, check_result * result) {
+    size_t i;
+
+    ctxt->opts = opts;
+    ctxt->result = result;
+    ctxt->status = OK;
+    ctxt->stats = NULL;
+    ctxt->errors = 0;
+    ctxt->warnings = 0;
+    ctxt->stop = 0;
+    ctxt->run_body = 0;
+    ctxt->run_metadata = 0;
+    ctxt->run_frames = 0;
+
+    ctxt->enabled[0] = 0;
+    for (i = 0; i < CHECK_RULES_NUMBER; ++i) {
+        ctxt->enabled[i + 1] = (check_code_get_level(check_rules[i].code) >= opts->check_level)
+            && (check_rules[i].cost != CHECK_COST_FRAME || opts->check_nal_units);
+    }
+    for (i = 0; i < opts->check_disabled_rules_number; ++i) {
+        ctxt->enabled[opts->check_disabled_rules[i]] = 0;
+    }
+
+    for (i = 0; i < CHECK_RULES_NUMBER; ++i) {
+        if (ctxt->enabled[i + 1] && check_code_get_level(check_rules[i].code) != FLVMETA_CHECK_LEVEL_FATAL) {
+            if (check_rules[i].cost == CHECK_COST_BODY) {
+                ctxt->run_body = 1;
+            }
+            else if (check_rules[i].cost == CHECK_COST_METADATA) {
+                ctxt->run_metadata = 1;
+            }
+            else if (check_rules[i].cost == CHECK_COST_FRAME) {
+                ctxt->run_frames = 1;
+            }
+        }
+    }
+
+    /* file information is computed from the tag bodies */
+    if (ctxt->run_metadata || ctxt->run_frames) {
+        ctxt->run_body = 1;
+    }
+}
+
 /* start the report */
 static void report_start(const flvmeta_opts * opts, check_context * ctxt) {
     time_t now;
-    struct tm * t;
+    struct tm tm;
     char datestr[128];
 
     if (opts->quiet)
         return;
 
     now = time(NULL);
-    tzset();
-    t = localtime(&now);
-    strftime(datestr, sizeof(datestr), "%Y-%m-%dT%H:%M:%S", t);
+    if (flvmeta_localtime(&now, &tm) == NULL
+    || strftime(datestr, sizeof(datestr), "%Y-%m-%dT%H:%M:%S", &tm) == 0) {
+        strcpy(datestr, "0000-00-00T00:00:00");
+    }
 
     if (opts->check_report_format == FLVMETA_FORMAT_XML) {
-        puts("<?xml version=\"1.0\" encoding=\"utf-8\"?>");
-        puts("<report xmlns=\"http://schemas.flvmeta.org/report/1.0/\">");
-        puts("  <metadata>");
-        printf("    <filename>%s</filename>\n", opts->input_file);
-        printf("    <creation-date>%s</creation-date>\n", datestr);
-        printf("    <generator>%s</generator>\n", PACKAGE_STRING);
-        puts("  </metadata>");
-        puts("  <messages>");
+        fputs("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n", opts->out);
+        fputs("<report xmlns=\"http://schemas.flvmeta.org/report/1.0/\">\n", opts->out);
+        fputs("  <metadata>\n", opts->out);
+        fprintf(opts->out, "    <filename>%s</filename>\n", opts->input_file);
+        fprintf(opts->out, "    <creation-date>%s</creation-date>\n", datestr);
+        fprintf(opts->out, "    <generator>%s</generator>\n", PACKAGE_STRING);
+        fputs("  </metadata>\n", opts->out);
+        fputs("  <messages>\n", opts->out);
     }
     else if (opts->check_report_format == FLVMETA_FORMAT_JSON) {
-        json_emit_init(&ctxt->je);
+        json_emit_init_file(&ctxt->je, opts->out);
         json_emit_object_start(&ctxt->je);
 
         json_emit_object_key_z(&ctxt->je, "filename");
@@ -81,140 +311,1171 @@ static void report_start(const flvmeta_opts * opts, check_context * ctxt) {
     }
 }
 
+/* report the performance counters */
+static void report_stats(const flvmeta_opts * opts, check_context * ctxt) {
+    const flvmeta_stats * stats;
+    int i;
+
+    stats = ctxt->stats;
+    if (opts->check_report_format == FLVMETA_FORMAT_XML) {
+        fputs("  <performance>\n", opts->out);
+        for (i = 0; i < FLVMETA_PHASES_NUMBER; ++i) {
+            fprintf(opts->out, "    <phase name=\"%s\" time=\"%.6f\"/>\n", flvmeta_stats_get_phase_name(i), stats->phase_times[i]);
+        }
+        fprintf(opts->out, "    <bytes-read>%" PRI_LL "u</bytes-read>\n", (unsigned long long)stats->bytes_read);
+        fprintf(opts->out, "    <read-calls>%" PRI_LL "u</read-calls>\n", (unsigned long long)stats->reads);
+        fprintf(opts->out, "    <seek-calls>%" PRI_LL "u</seek-calls>\n", (unsigned long long)stats->seeks);
+        fprintf(opts->out, "    <amf-nodes>%" PRI_LL "u</amf-nodes>\n", (unsigned long long)stats->amf_nodes);
+        fprintf(opts->out, "    <peak-rss>%ld</peak-rss>\n", stats->peak_rss);
+        fputs("  </performance>\n", opts->out);
+    }
+    else if (opts->check_report_format == FLVMETA_FORMAT_JSON) {
+        json_emit_object_key_z(&ctxt->je, "performance");
+        json_emit_object_start(&ctxt->je);
+
+        json_emit_object_key_z(&ctxt->je, "phases");
+        json_emit_object_start(&ctxt->je);
+        for (i = 0; i < FLVMETA_PHASES_NUMBER; ++i) {
+            json_emit_object_key_z(&ctxt->je, flvmeta_stats_get_phase_name(i));
+            json_emit_number(&ctxt->je, stats->phase_times[i]);
+        }
+        json_emit_object_end(&ctxt->je);
+
+        json_emit_object_key_z(&ctxt->je, "bytes_read");
+        json_emit_file_offset(&ctxt->je, (file_offset_t)stats->bytes_read);
+
+        json_emit_object_key_z(&ctxt->je, "read_calls");
+        json_emit_file_offset(&ctxt->je, (file_offset_t)stats->reads);
+
+        json_emit_object_key_z(&ctxt->je, "seek_calls");
+        json_emit_file_offset(&ctxt->je, (file_offset_t)stats->seeks);
+
+        json_emit_object_key_z(&ctxt->je, "amf_nodes");
+        json_emit_file_offset(&ctxt->je, (file_offset_t)stats->amf_nodes);
+
+        json_emit_object_key_z(&ctxt->je, "peak_rss");
+        json_emit_file_offset(&ctxt->je, (file_offset_t)stats->peak_rss);
+
+        json_emit_object_end(&ctxt->je);
+    }
+    else {
+        flvmeta_stats_print(stats, opts->out);
+    }
+}
+
 /* end the report */
-static void report_end(const flvmeta_opts * opts, check_context * ctxt, uint32 errors, uint32 warnings) {
+static void report_end(const flvmeta_opts * opts, check_context * ctxt) {
     if (opts->quiet)
         return;
 
     if (opts->check_report_format == FLVMETA_FORMAT_XML) {
-        puts("  </messages>");
-        puts("</report>");
+        fputs("  </messages>\n", opts->out);
+        if (ctxt->stats != NULL) {
+            report_stats(opts, ctxt);
+        }
+        fputs("</report>\n", opts->out);
     }
     else if (opts->check_report_format == FLVMETA_FORMAT_JSON) {
         json_emit_array_end(&ctxt->je);
 
-        json_emit_object_key_z(&ctxt->je, "errors");
-        json_emit_integer(&ctxt->je, errors);
+        json_emit_object_key_z(&ctxt->je, "errors");
+        json_emit_integer(&ctxt->je, ctxt->errors);
+
+        json_emit_object_key_z(&ctxt->je, "warnings");
+        json_emit_integer(&ctxt->je, ctxt->warnings);
+
+        if (ctxt->stats != NULL) {
+            report_stats(opts, ctxt);
+        }
+
+        json_emit_object_end(&ctxt->je);
+
+        fprintf(opts->out, "\n");
+    }
+    else {
+        fprintf(opts->out, "%u error(s), %u warning(s)\n", ctxt->errors, ctxt->warnings);
+        if (ctxt->stats != NULL) {
+            report_stats(opts, ctxt);
+        }
+    }
+}
+
+/* report an error to the output stream according to the current format */
+static void report_print_message(
+    int level,
+    const char * code,
+    file_offset_t offset,
+    const char * message,
+    const flvmeta_opts * opts,
+    check_context * ctxt
+) {
+    if (opts->quiet)
+        return;
+
+    if (level >= opts->check_level) {
+        char * levelstr;
+
+        switch (level) {
+            case FLVMETA_CHECK_LEVEL_INFO: levelstr = "info"; break;
+            case FLVMETA_CHECK_LEVEL_WARNING: levelstr = "warning"; break;
+            case FLVMETA_CHECK_LEVEL_ERROR: levelstr = "error"; break;
+            case FLVMETA_CHECK_LEVEL_FATAL: levelstr = "fatal"; break;
+            default: levelstr = "unknown";
+        }
+
+        if (opts->check_report_format == FLVMETA_FORMAT_XML) {
+            /* XML report entry */
+            fprintf(opts->out, "    <message level=\"%s\" code=\"%s\"", levelstr, code);
+            fprintf(opts->out, " offset=\"%" FILE_OFFSET_PRINTF_FORMAT  "u\">", FILE_OFFSET_PRINTF_TYPE(offset));
+            fprintf(opts->out, "%s</message>\n", message);
+        }
+        else if (opts->check_report_format == FLVMETA_FORMAT_JSON) {
+            /* JSON report entry */
+            json_emit_object_start(&ctxt->je);
+
+            json_emit_object_key_z(&ctxt->je, "level");
+            json_emit_string_z(&ctxt->je, levelstr);
+
+            json_emit_object_key_z(&ctxt->je, "code");
+            json_emit_string_z(&ctxt->je, code);
+
+            json_emit_object_key_z(&ctxt->je, "offset");
+            json_emit_file_offset(&ctxt->je, offset);
+
+            json_emit_object_key_z(&ctxt->je, "message");
+            json_emit_string_z(&ctxt->je, message);
+
+            json_emit_object_end(&ctxt->je);
+        }
+        else {
+            /* raw report entry */
+            /*printf("%s:", opts->input_file);*/
+            fprintf(opts->out, "0x%.8" FILE_OFFSET_PRINTF_FORMAT "x: ", FILE_OFFSET_PRINTF_TYPE(offset));
+            fprintf(opts->out, "%s %s: %s\n", levelstr, code, message);
+        }
+    }
+}
+
+/* timestamp distance */
+#define timestamp_distance(t1, t2) ((t1)>(t2)?(t1)-(t2):(t2)-(t1))
+
+/* the check has run out of memory */
+static void check_out_of_memory(check_context * ctxt) {
+    ctxt->status = ERROR_MEMORY;
+    ctxt->stop = 1;
+}
+
+/* add a finding to the collected results */
+static void check_add_finding(check_context * ctxt, int level, const char * code, file_offset_t offset, const char * message) {
+    check_result * result;
+    check_finding * finding;
+
+    result = ctxt->result;
+    if (result->findings_number == result->findings_capacity) {
+        size_t capacity;
+        check_finding * findings;
+
+        capacity = (result->findings_capacity > 0) ? result->findings_capacity * 2 : 16;
+        findings = (check_finding *)realloc(result->findings, capacity * sizeof(check_finding));
+        if (findings == NULL) {
+            check_out_of_memory(ctxt);
+            return;
+        }
+        result->findings = findings;
+        result->findings_capacity = capacity;
+    }
+
+    finding = &result->findings[result->findings_number];
+    finding->message = (char *)malloc(strlen(message) + 1);
+    if (finding->message == NULL) {
+        check_out_of_memory(ctxt);
+        return;
+    }
+    strcpy(finding->message, message);
+    strcpy(finding->code, code);
+    finding->id = check_code_get_id(code);
+    finding->level = level;
+    finding->offset = offset;
+    ++result->findings_number;
+}
+
+/* report a finding of an enabled rule */
+static void check_report(check_context * ctxt, const char * code, file_offset_t offset, const char * message) {
+    int level;
+
+    if (!ctxt->enabled[check_code_get_id(code)]) {
+        return;
+    }
+
+    level = check_code_get_level(code);
+    if (level == FLVMETA_CHECK_LEVEL_WARNING) {
+        ++ctxt->warnings;
+    }
+    else if (level >= FLVMETA_CHECK_LEVEL_ERROR) {
+        ++ctxt->errors;
+        if (ctxt->opts->check_fail_fast) {
+            ctxt->stop = 1;
+        }
+    }
+
+    if (ctxt->result != NULL) {
+        check_add_finding(ctxt, level, code, offset, message);
+    }
+    else {
+        report_print_message(level, code, offset, message, ctxt->opts, ctxt);
+    }
+}
+
+/* convenience macros */
+#define print_info(code, offset, message)       check_report(ctxt, code, offset, message)
+#define print_warning(code, offset, message)    check_report(ctxt, code, offset, message)
+#define print_error(code, offset, message)      check_report(ctxt, code, offset, message)
+#define print_fatal(code, offset, message)      check_report(ctxt, code, offset, message)
+
+/* switch the performance counters to another phase, returning the previous one */
+#define check_phase(phase) flvmeta_stats_enter(ctxt->stats, (phase))
+
+/* get string representing given AMF type */
+static const char * get_amf_type_string(byte type) {
+    switch (type) {
+        case AMF_TYPE_NUMBER: return "Number";
+        case AMF_TYPE_BOOLEAN: return "Boolean";
+        case AMF_TYPE_STRING: return "String";
+        case AMF_TYPE_NULL: return "Null";
+        case AMF_TYPE_UNDEFINED: return "Undefined";
+        /*case AMF_TYPE_REFERENCE:*/
+        case AMF_TYPE_OBJECT: return "Object";
+        case AMF_TYPE_ASSOCIATIVE_ARRAY: return "Associative array";
+        case AMF_TYPE_ARRAY: return "Array";
+        case AMF_TYPE_DATE: return "Date";
+        /*case AMF_TYPE_SIMPLEOBJECT:*/
+        case AMF_TYPE_XML: return "XML";
+        case AMF_TYPE_CLASS: return "Class";
+        default: return "Unknown type";
+    }
+}
+
+/* structural checks, shared by all check modes */
+
+/* state of the structural checks along the tags */
+typedef struct __check_tags_state {
+    uint32 tag_number;
+    uint32 last_timestamp;
+    uint32 last_video_timestamp;
+    uint32 last_audio_timestamp;
+    int have_audio;
+    int have_video;
+    int have_desync;
+    int consecutive_unknown_tags;
+} check_tags_state;
+
+static void check_tags_state_init(check_tags_state * state) {
+    state->tag_number = 0;
+    state->last_timestamp = state->last_video_timestamp = state->last_audio_timestamp = 0;
+    state->have_audio = state->have_video = 0;
+    state->have_desync = 0;
+    state->consecutive_unknown_tags = 0;
+}
+
+/* check the file header fields */
+static void check_header(check_context * ctxt, const flv_header * header) {
+    char message[256];
+
+    /* version */
+    if (header->version != FLV_VERSION) {
+        sprintf(message, "header version should be 1, %u found instead", header->version);
+        check_report(ctxt, ERROR_HEADER_BAD_VERSION, 3, message);
+    }
+
+    /* video and audio flags */
+    if (!flv_header_has_audio(*header) && !flv_header_has_video(*header)) {
+        check_report(ctxt, ERROR_HEADER_NO_STREAMS, 4, "header signals the file does not contain video tags or audio tags");
+    }
+    else if (!flv_header_has_audio(*header)) {
+        check_report(ctxt, INFO_HEADER_NO_AUDIO, 4, "header signals the file does not contain audio tags");
+    }
+    else if (!flv_header_has_video(*header)) {
+        check_report(ctxt, WARNING_HEADER_NO_VIDEO, 4, "header signals the file does not contain video tags");
+    }
+
+    /* reserved flags */
+    if (header->flags & 0xFA) {
+        check_report(ctxt, ERROR_HEADER_BAD_RESERVED_FLAGS, 4, "header reserved flags are not zero");
+    }
+
+    /* offset */
+    if (flv_header_get_offset(*header) != 9) {
+        sprintf(message, "header offset should be 9, %u found instead", flv_header_get_offset(*header));
+        check_report(ctxt, ERROR_HEADER_BAD_OFFSET, 5, message);
+    }
+}
+
+/*
+    check a tag header located at the given offset, followed by the given
+    number of bytes in the file, returning 0 if the check cannot go on
+*/
+static int check_tag_header(
+    check_context * ctxt,
+    check_tags_state * state,
+    const flv_header * header,
+    const flv_tag * tag,
+    file_offset_t offset,
+    file_offset_t remaining
+) {
+    char message[256];
+    uint32 body_length, timestamp, stream_id;
+    int decr_timestamp_signaled;
+
+    ++state->tag_number;
+
+    body_length = flv_tag_get_body_length(*tag);
+    timestamp = flv_tag_get_timestamp(*tag);
+    stream_id = flv_tag_get_stream_id(*tag);
+
+    /* check tag type */
+    if (tag->type != FLV_TAG_TYPE_AUDIO
+        && tag->type != FLV_TAG_TYPE_VIDEO
+        && tag->type != FLV_TAG_TYPE_META
+    ) {
+        sprintf(message, "unknown tag type %" PRI_BYTE "d", tag->type);
+        check_report(ctxt, ERROR_TAG_TYPE_UNKNOWN, offset, message);
+        ++state->consecutive_unknown_tags;
+
+        if (state->consecutive_unknown_tags >= 2) {
+            check_report(ctxt, FATAL_CONSECUTIVE_UNKNOWN_TAGS, offset, "consecutive tags with unknown type found, aborting");
+            return 0;
+        }
+    }
+    else {
+        state->consecutive_unknown_tags = 0;
+    }
+
+    /* check consistency with global header */
+    if (!state->have_video && tag->type == FLV_TAG_TYPE_VIDEO) {
+        if (!flv_header_has_video(*header)) {
+            check_report(ctxt, WARNING_HEADER_UNEXPECTED_VIDEO, offset, "video tag found despite header signaling the file contains no video");
+        }
+        state->have_video = 1;
+    }
+    if (!state->have_audio && tag->type == FLV_TAG_TYPE_AUDIO) {
+        if (!flv_header_has_audio(*header)) {
+            check_report(ctxt, WARNING_HEADER_UNEXPECTED_AUDIO, offset, "audio tag found despite header signaling the file contains no audio");
+        }
+        state->have_audio = 1;
+    }
+
+    /* check body length */
+    if (body_length > remaining) {
+        sprintf(message, "tag body length (%u bytes) exceeds file size", body_length);
+        check_report(ctxt, FATAL_TAG_BODY_LENGTH_OVERFLOW, offset + 1, message);
+        return 0;
+    }
+    else if (body_length > MAX_ACCEPTABLE_TAG_BODY_LENGTH) {
+        sprintf(message, "tag body length (%u bytes) is abnormally large", body_length);
+        check_report(ctxt, WARNING_TAG_BODY_LENGTH_LARGE, offset + 1, message);
+    }
+    else if (body_length == 0) {
+        check_report(ctxt, WARNING_TAG_BODY_LENGTH_ZERO, offset + 1, "tag body length is zero");
+    }
+
+    /** check timestamp **/
+    decr_timestamp_signaled = 0;
+
+    /* check whether first timestamp is zero */
+    if (state->tag_number == 1 && timestamp != 0) {
+        sprintf(message, "first timestamp should be zero, %u found instead", timestamp);
+        check_report(ctxt, ERROR_TIMESTAMP_FIRST_NON_ZERO, offset + 4, message);
+    }
+
+    /* check whether timestamps decrease in a given stream */
+    if (tag->type == FLV_TAG_TYPE_AUDIO) {
+        if (state->last_audio_timestamp > timestamp) {
+            sprintf(message, "audio tag timestamps are decreasing from %u to %u", state->last_audio_timestamp, timestamp);
+            check_report(ctxt, ERROR_TIMESTAMP_AUDIO_DECREASE, offset + 4, message);
+        }
+        state->last_audio_timestamp = timestamp;
+        decr_timestamp_signaled = 1;
+    }
+    if (tag->type == FLV_TAG_TYPE_VIDEO) {
+        if (state->last_video_timestamp > timestamp) {
+            sprintf(message, "video tag timestamps are decreasing from %u to %u", state->last_video_timestamp, timestamp);
+            check_report(ctxt, ERROR_TIMESTAMP_VIDEO_DECREASE, offset + 4, message);
+        }
+        state->last_video_timestamp = timestamp;
+        decr_timestamp_signaled = 1;
+    }
+
+    /* check for overflow error */
+    if (state->last_timestamp > timestamp && state->last_timestamp - timestamp > 0xF00000) {
+        check_report(ctxt, ERROR_TIMESTAMP_OVERFLOW, offset + 4, "extended bits not used after timestamp overflow");
+    }
+
+    /* check whether timestamps decrease globally */
+    else if (!decr_timestamp_signaled && state->last_timestamp > timestamp && state->last_timestamp - timestamp >= 1000) {
+        sprintf(message, "timestamps are decreasing from %u to %u", state->last_timestamp, timestamp);
+        check_report(ctxt, ERROR_TIMESTAMP_DECREASE, offset + 4, message);
+    }
+
+    state->last_timestamp = timestamp;
+
+    /* check for desyncs between audio and video: one second or more is suspicious */
+    if (state->have_video && state->have_audio && !state->have_desync
+        && timestamp_distance(state->last_video_timestamp, state->last_audio_timestamp) >= 1000
+    ) {
+        sprintf(message, "audio and video streams are desynchronized by %d ms",
+            timestamp_distance(state->last_video_timestamp, state->last_audio_timestamp));
+        check_report(ctxt, WARNING_TIMESTAMP_DESYNC, offset + 4, message);
+        state->have_desync = 1; /* do not repeat */
+    }
+
+    /** stream id must be zero **/
+    if (stream_id != 0) {
+        sprintf(message, "tag stream id must be zero, %u found instead", stream_id);
+        check_report(ctxt, ERROR_TAG_STREAM_ID_NON_ZERO, offset + 8, message);
+    }
+
+    return 1;
+}
+
+/* check the previous tag size located at the given offset, following a tag */
+static void check_prev_tag_size(check_context * ctxt, file_offset_t offset, uint32 body_length, uint32 prev_tag_size) {
+    char message[256];
+
+    if (prev_tag_size != FLV_TAG_SIZE + body_length) {
+        sprintf(message, "previous tag size should be %u, %u found instead", FLV_TAG_SIZE + body_length, prev_tag_size);
+        check_report(ctxt, ERROR_PREV_TAG_SIZE_BAD, offset, message);
+    }
+}
+
+/* check the consistency of the tags with the global header and between streams */
+static void check_tags_end(check_context * ctxt, const check_tags_state * state, const flv_header * header, file_offset_t filesize) {
+    char message[256];
+
+    /* check consistency with global header */
+    if (!state->have_video && flv_header_has_video(*header)) {
+        check_report(ctxt, WARNING_HEADER_VIDEO_NOT_FOUND, 4, "no video tag found despite header signaling the file contains video");
+    }
+    if (!state->have_audio && flv_header_has_audio(*header)) {
+        check_report(ctxt, WARNING_HEADER_AUDIO_NOT_FOUND, 4, "no audio tag found despite header signaling the file contains audio");
+    }
+
+    /* check last timestamps */
+    if (state->have_video && state->have_audio
+        && timestamp_distance(state->last_audio_timestamp, state->last_video_timestamp) >= 1000
+    ) {
+        if (state->last_audio_timestamp > state->last_video_timestamp) {
+            sprintf(message, "video stops %u ms before audio", state->last_audio_timestamp - state->last_video_timestamp);
+            check_report(ctxt, WARNING_TIMESTAMP_VIDEO_ENDS_FIRST, filesize, message);
+        }
+        else {
+            sprintf(message, "audio stops %u ms before video", state->last_video_timestamp - state->last_audio_timestamp);
+            check_report(ctxt, WARNING_TIMESTAMP_AUDIO_ENDS_FIRST, filesize, message);
+        }
+    }
+}
+
+/* check the file properties reported as information */
+static void check_file_end(check_context * ctxt, uint32 last_timestamp, file_offset_t filesize) {
+    /* does the file use extended timestamps ? */
+    if (last_timestamp > 0x00FFFFFF) {
+        check_report(ctxt, INFO_TIMESTAMP_USE_EXTENDED, 0, "extended timestamps used in the file");
+    }
+
+    /* is the file larger than 4GB ? */
+    if (filesize > 0xFFFFFFFFULL) {
+        check_report(ctxt, INFO_GENERAL_LARGE_FILE, 0, "file is larger than 4 GB");
+    }
+}
+
+/* AVC frames checks */
+
+/* state of the AVC frames checks */
+typedef struct __check_avc_state {
+    byte * config; /* last AVCDecoderConfigurationRecord */
+    size_t config_size;
+    size_t length_size; /* size of the NAL unit lengths, 0 if unknown */
+    int no_config_signaled;
+    byte * frame; /* video data of the current tag */
+    size_t frame_capacity;
+} check_avc_state;
+
+static void check_avc_state_init(check_avc_state * state) {
+    state->config = NULL;
+    state->config_size = 0;
+    state->length_size = 0;
+    state->no_config_signaled = 0;
+    state->frame = NULL;
+    state->frame_capacity = 0;
+}
+
+static void check_avc_state_free(check_avc_state * state) {
+    free(state->config);
+    free(state->frame);
+}
+
+/*
+    check the NAL units of an AVC video tag, the stream being located
+    after the video tag header: the video data is read at once and the
+    NAL units are walked in memory
+*/
+static void check_avc_frame(check_context * ctxt, check_avc_state * state, flv_stream * flv_in, int frame_type, file_offset_t offset) {
+    char message[256];
+    file_offset_t data_offset;
+    const byte * data, * nal;
+    size_t size, data_size, pos, nal_size;
+    int result, idr_signaled, changed_signaled;
+
+    /* packet type and composition time */
+    size = flv_in->current_tag_body_length;
+    if (size < sizeof(flv_avc_packet_type) + sizeof(uint24)) {
+        return;
+    }
+
+    if (size > state->frame_capacity) {
+        byte * frame = (byte *)realloc(state->frame, size);
+        if (frame == NULL) {
+            check_out_of_memory(ctxt);
+            return;
+        }
+        state->frame = frame;
+        state->frame_capacity = size;
+    }
+
+    data_offset = flv_get_offset(flv_in) + sizeof(flv_avc_packet_type) + sizeof(uint24);
+    if (flv_peek_tag_body(flv_in, state->frame, size) < size) {
+        return;
+    }
+    data = state->frame + sizeof(flv_avc_packet_type) + sizeof(uint24);
+    data_size = size - sizeof(flv_avc_packet_type) - sizeof(uint24);
+
+    if (state->frame[0] == FLV_AVC_PACKET_TYPE_SEQUENCE_HEADER) {
+        /* keep the parameter sets to detect unannounced changes */
+        byte * config = (byte *)realloc(state->config, data_size + 1);
+        if (config == NULL) {
+            check_out_of_memory(ctxt);
+            return;
+        }
+        memcpy(config, data, data_size);
+        state->config = config;
+        state->config_size = data_size;
+        state->length_size = avc_get_nal_length_size(config, data_size);
+        state->no_config_signaled = 0;
+    }
+    else if (state->frame[0] == FLV_AVC_PACKET_TYPE_NALU) {
+        if (state->length_size == 0) {
+            if (!state->no_config_signaled) {
+                check_report(ctxt, ERROR_AVC_NO_SEQUENCE_HEADER, offset, "AVC NAL units found without a valid sequence header");
+                state->no_config_signaled = 1;
+            }
+            return;
+        }
+
+        idr_signaled = changed_signaled = 0;
+        pos = 0;
+        while ((result = avc_get_next_nal_unit(data, data_size, state->length_size, &pos, &nal, &nal_size)) > 0) {
+            if (nal_size == 0) {
+                continue;
+            }
+
+            switch (avc_nal_unit_type(nal)) {
+                case AVC_NAL_UNIT_TYPE_IDR:
+                    if (frame_type != FLV_VIDEO_TAG_FRAME_TYPE_KEYFRAME && !idr_signaled) {
+                        check_report(ctxt, WARNING_AVC_IDR_NOT_KEYFRAME, offset, "IDR NAL unit found in a video frame not flagged as a keyframe");
+                        idr_signaled = 1;
+                    }
+                    break;
+                case AVC_NAL_UNIT_TYPE_SPS:
+                case AVC_NAL_UNIT_TYPE_PPS:
+                    if (!changed_signaled && !avc_has_parameter_set(state->config, state->config_size, nal, nal_size)) {
+                        sprintf(message, "%s NAL unit differs from the sequence header, which has not been updated",
+                            (avc_nal_unit_type(nal) == AVC_NAL_UNIT_TYPE_SPS) ? "SPS" : "PPS");
+                        check_report(ctxt, WARNING_AVC_PARAMETER_SET_CHANGED, data_offset + pos - nal_size, message);
+                        changed_signaled = 1;
+                    }
+                    break;
+            }
+        }
+
+        if (result < 0) {
+            sprintf(message, "NAL unit lengths do not match the tag body, %lu bytes cannot be read as a NAL unit",
+                (unsigned long)(data_size - pos));
+            check_report(ctxt, ERROR_AVC_NAL_UNIT_LENGTH_BAD, data_offset + pos, message);
+        }
+    }
+}
+
+/* AAC audio checks */
+
+/* number of bytes of AAC audio data read by the checks */
+#define CHECK_AAC_DATA_SIZE 16
+
+/* state of the AAC audio checks */
+typedef struct __check_aac_state {
+    aac_config config; /* configuration of the last sequence header */
+    int have_config;
+    int no_config_signaled;
+    int adts_signaled;
+    int element_signaled;
+} check_aac_state;
+
+static void check_aac_state_init(check_aac_state * state) {
+    state->have_config = 0;
+    state->no_config_signaled = 0;
+    state->adts_signaled = 0;
+    state->element_signaled = 0;
+}
+
+/*
+    check the sequence header or the first bytes of a raw frame of an AAC
+    audio tag, the stream being located after the audio tag header
+*/
+static void check_aac_frame(check_context * ctxt, check_aac_state * state, flv_stream * flv_in, flv_audio_tag at) {
+    char message[256];
+    byte data[CHECK_AAC_DATA_SIZE];
+    file_offset_t data_offset;
+    size_t size;
+    aac_config config;
+
+    data_offset = flv_get_offset(flv_in);
+    size = flv_peek_tag_body(flv_in, data, sizeof(data));
+    if (size < sizeof(flv_aac_packet_type)) {
+        return;
+    }
+
+    if (data[0] == FLV_AAC_PACKET_TYPE_SEQUENCE_HEADER) {
+        if (!aac_read_audio_specific_config(data + 1, size - 1, &config)) {
+            check_report(ctxt, ERROR_AAC_SEQUENCE_HEADER_INVALID, data_offset + 1, "invalid AAC sequence header");
+            return;
+        }
+
+        /*
+            several channels flagged as mono, the stereo flag being
+            mandatory for AAC whatever the number of channels
+        */
+        if (config.channel_configuration >= 2 && flv_audio_tag_sound_type(at) == FLV_AUDIO_TAG_SOUND_TYPE_MONO) {
+            sprintf(message, "AAC sequence header declares %u channel(s) while the audio tag is flagged as %s",
+                config.channel_configuration, dump_string_get_sound_type(at));
+            check_report(ctxt, WARNING_AAC_CHANNELS_MISMATCH, data_offset + 1, message);
+        }
+
+        /* configuration changes */
+        if (state->have_config && !aac_config_equals(&state->config, &config)) {
+            sprintf(message, "AAC configuration changed from object type %u, %u Hz, %u channel(s) to object type %u, %u Hz, %u channel(s)",
+                state->config.object_type, state->config.sampling_frequency, state->config.channel_configuration,
+                config.object_type, config.sampling_frequency, config.channel_configuration);
+            check_report(ctxt, WARNING_AAC_CONFIG_CHANGED, data_offset + 1, message);
+        }
+
+        state->config = config;
+        state->have_config = 1;
+    }
+    else if (data[0] == FLV_AAC_PACKET_TYPE_RAW) {
+        if (!state->have_config) {
+            if (!state->no_config_signaled) {
+                check_report(ctxt, ERROR_AAC_NO_SEQUENCE_HEADER, data_offset, "raw AAC frames found without a valid sequence header");
+                state->no_config_signaled = 1;
+            }
+            return;
+        }
+
+        /* raw frames must not be encapsulated in ADTS */
+        if (aac_read_adts_header(data + 1, size - 1, &config)) {
+            if (!state->adts_signaled) {
+                check_report(ctxt, ERROR_AAC_RAW_FRAME_ADTS, data_offset + 1, "raw AAC frame starts with an ADTS header");
+                state->adts_signaled = 1;
+            }
+            return;
+        }
+
+        /* the first element of a mono or stereo frame is a single channel or a channel pair */
+        if (size > 1 && !state->element_signaled
+        && state->config.object_type >= AAC_OBJECT_TYPE_MAIN && state->config.object_type <= AAC_OBJECT_TYPE_LTP) {
+            uint32 element = data[1] >> 5;
+
+            if ((element == AAC_ELEMENT_CPE && state->config.channel_configuration == 1)
+            || (element == AAC_ELEMENT_SCE && state->config.channel_configuration == 2)) {
+                sprintf(message, "raw AAC frame starts with a %s element, which does not match the %u channel(s) of the sequence header",
+                    (element == AAC_ELEMENT_CPE) ? "channel pair" : "single channel", state->config.channel_configuration);
+                check_report(ctxt, WARNING_AAC_RAW_FRAME_ELEMENT_BAD, data_offset + 1, message);
+                state->element_signaled = 1;
+            }
+        }
+    }
+}
+
+/* keyframes index checks */
+
+/* largest difference between paired keyframe times, in seconds */
+#define CHECK_KEYFRAMES_TIME_TOLERANCE  0.001
+
+/*
+    align the stored keyframes index with the computed one in a single
+    merge pass, both being sorted by time: entries whose times match
+    within one millisecond are paired, and the others are reported as
+    missing from or extra in the stored index, along with the shift of
+    the paired positions, so files needing only new positions can be told
+    apart from files needing a new index
+*/
+static void check_keyframes_align(
+    check_context * ctxt,
+    amf_data * times,
+    amf_data * filepositions,
+    amf_data * file_times,
+    amf_data * file_filepositions,
+    file_offset_t offset
+) {
+    char message[256];
+    amf_node * t_node, * f_node, * ft_node, * ff_node;
+    uint32 matched, missing, extra, shifted;
+    number64 time, position, f_time, f_position, shift, last_file_time;
+    int uniform_shift, have_last_time, use_stored;
+    byte ft_type, ff_type;
+
+    matched = missing = extra = shifted = 0;
+    shift = 0;
+    uniform_shift = 1;
+    last_file_time = 0;
+    have_last_time = 0;
+
+    t_node = amf_array_first(times);
+    f_node = amf_array_first(filepositions);
+    ft_node = amf_array_first(file_times);
+    ff_node = amf_array_first(file_filepositions);
+
+    while ((t_node != NULL && f_node != NULL) || (ft_node != NULL && ff_node != NULL)) {
+        use_stored = 0;
+
+        if (ft_node != NULL && ff_node != NULL) {
+            /* stored entries of invalid types cannot be aligned */
+            ft_type = amf_data_get_type(amf_array_get(ft_node));
+            ff_type = amf_data_get_type(amf_array_get(ff_node));
+            if (ft_type != AMF_TYPE_NUMBER || ff_type != AMF_TYPE_NUMBER) {
+                if (ft_type != AMF_TYPE_NUMBER) {
+                    sprintf(message, "invalid type for time: expected %s, got %s",
+                        get_amf_type_string(AMF_TYPE_NUMBER),
+                        get_amf_type_string(ft_type));
+                    print_warning(WARNING_KEYFRAMES_TIME_TYPE_BAD, offset, message);
+                }
+                if (ff_type != AMF_TYPE_NUMBER) {
+                    sprintf(message, "invalid type for file position: expected %s, got %s",
+                        get_amf_type_string(AMF_TYPE_NUMBER),
+                        get_amf_type_string(ff_type));
+                    print_warning(WARNING_KEYFRAMES_POS_TYPE_BAD, offset, message);
+                }
+                ft_node = amf_array_next(ft_node);
+                ff_node = amf_array_next(ff_node);
+                continue;
+            }
+
+            f_time = amf_number_get_value(amf_array_get(ft_node));
+            f_position = amf_number_get_value(amf_array_get(ff_node));
+            use_stored = 1;
+        }
+
+        if (t_node != NULL && f_node != NULL) {
+            time = amf_number_get_value(amf_array_get(t_node));
+            position = amf_number_get_value(amf_array_get(f_node));
+
+            if (use_stored && fabs(time - f_time) < CHECK_KEYFRAMES_TIME_TOLERANCE) {
+                /* paired entries */
+                ++matched;
+                if (fabs(position - f_position) >= 1.0) {
+                    if (shifted > 0 && f_position - position != shift) {
+                        uniform_shift = 0;
+                    }
+                    shift = f_position - position;
+                    ++shifted;
+
+                    sprintf(message, "keyframe at %.12g shifted by %+.12g bytes: expected position %.12g, got %.12g",
+                        time, shift, position, f_position);
+                    print_warning(WARNING_KEYFRAMES_POS_SHIFTED, offset, message);
+                }
+                t_node = amf_array_next(t_node);
+                f_node = amf_array_next(f_node);
+            }
+            else if (use_stored && f_time < time) {
+                /* stored entry without a computed counterpart */
+                ++extra;
+                sprintf(message, "extra keyframe at %.12g, position %.12g", f_time, f_position);
+                print_warning(WARNING_KEYFRAMES_ENTRY_EXTRA, offset, message);
+            }
+            else {
+                /* computed entry without a stored counterpart */
+                ++missing;
+                sprintf(message, "missing keyframe at %.12g, position %.12g", time, position);
+                print_warning(WARNING_KEYFRAMES_ENTRY_MISSING, offset, message);
+                t_node = amf_array_next(t_node);
+                f_node = amf_array_next(f_node);
+                continue;
+            }
+        }
+        else {
+            ++extra;
+            sprintf(message, "extra keyframe at %.12g, position %.12g", f_time, f_position);
+            print_warning(WARNING_KEYFRAMES_ENTRY_EXTRA, offset, message);
+        }
+
+        /* the stored entry has been consumed */
+        if (have_last_time && last_file_time == f_time) {
+            sprintf(message, "Duplicate keyframe time: %.12g", f_time);
+            print_warning(WARNING_KEYFRAMES_TIME_DUPLICATE, offset, message);
+        }
+        have_last_time = 1;
+        last_file_time = f_time;
+
+        ft_node = amf_array_next(ft_node);
+        ff_node = amf_array_next(ff_node);
+    }
+
+    if (shifted > 0 && uniform_shift) {
+        sprintf(message, "keyframes index alignment: %u matched, %u missing, %u extra, %u shifted by %+.12g bytes",
+            matched, missing, extra, shifted, shift);
+    }
+    else {
+        sprintf(message, "keyframes index alignment: %u matched, %u missing, %u extra, %u shifted",
+            matched, missing, extra, shifted);
+    }
+    print_info(INFO_KEYFRAMES_ALIGNMENT, offset, message);
+}
+
+/* quick check */
+
+/* size of the tail of the file searched for the last complete tag */
+#define CHECK_QUICK_TAIL_SIZE   65536
+
+/* number of final tags verified through the previous tag sizes */
+#define CHECK_QUICK_TAGS_NUMBER 16
+
+/* read bytes at the given offset */
+static int check_read_at(flv_stream * flv_in, file_offset_t offset, void * buffer, size_t size) {
+    return flv_stream_seek(flv_in, offset, SEEK_SET) == 0
+        && flv_stream_read(flv_in, buffer, size, 1) == 1;
+}
+
+/* decode a big endian 32 bits integer */
+#define check_get_uint32_be(b) ((uint32)(((uint32)(b)[0] << 24) | ((uint32)(b)[1] << 16) | ((uint32)(b)[2] << 8) | (uint32)(b)[3]))
+
+/* whether a tag header looks valid */
+static int check_is_valid_tag(const flv_tag * tag) {
+    return (tag->type == FLV_TAG_TYPE_AUDIO || tag->type == FLV_TAG_TYPE_VIDEO || tag->type == FLV_TAG_TYPE_META)
+        && flv_tag_get_stream_id(*tag) == 0;
+}
+
+/* decode a tag header, returning whether it looks valid */
+static int check_decode_tag(const byte * b, flv_tag * tag) {
+    tag->type = b[0];
+    memcpy(&tag->body_length, b + 1, 3);
+    memcpy(&tag->timestamp, b + 4, 3);
+    tag->timestamp_extended = b[7];
+    memcpy(&tag->stream_id, b + 8, 3);
+
+    return check_is_valid_tag(tag);
+}
+
+/*
+    find the last complete tag in the tail of the file, i.e. a valid tag
+    header followed by its body and a matching previous tag size,
+    returning its offset within the tail or -1 if none can be found
+*/
+static long check_find_last_tag(const byte * tail, size_t tail_size, flv_tag * tag) {
+    size_t pos, end;
+
+    if (tail_size < FLV_TAG_SIZE + sizeof(uint32_be)) {
+        return -1;
+    }
+
+    pos = tail_size - FLV_TAG_SIZE - sizeof(uint32_be) + 1;
+    while (pos-- > 0) {
+        if (check_decode_tag(tail + pos, tag)) {
+            end = pos + FLV_TAG_SIZE + flv_tag_get_body_length(*tag);
+            if (end + sizeof(uint32_be) <= tail_size
+            && check_get_uint32_be(tail + end) == FLV_TAG_SIZE + flv_tag_get_body_length(*tag)) {
+                return (long)pos;
+            }
+        }
+    }
+    return -1;
+}
+
+/*
+    check the end of the file only: walk backwards from the end of file
+    through the previous tag sizes to verify the last tags are complete,
+    or find the last complete tag if the file is truncated
+*/
+static int check_stream_quick(check_context * ctxt, flv_stream * flv_in, file_offset_t filesize) {
+    flv_header header;
+    int result;
+    char message[256];
+    file_offset_t data_offset, last_tag_offset;
+    uint32 last_timestamp;
+    int tags_number, have_last_tag;
+    flv_tag tag;
+
+    last_timestamp = 0;
+    last_tag_offset = 0;
+    have_last_tag = 0;
+
+    check_phase(FLVMETA_PHASE_HEADER);
+
+    /* check signature */
+    result = flv_read_header(flv_in, &header);
+    if (result == FLV_ERROR_EOF) {
+        print_fatal(FATAL_HEADER_EOF, 0, "unexpected end of file in header");
+        goto end;
+    }
+    else if (result == FLV_ERROR_NO_FLV) {
+        print_fatal(FATAL_HEADER_NO_SIGNATURE, 0, "FLV signature not found in header");
+        goto end;
+    }
+
+    data_offset = flv_header_get_offset(header) + sizeof(uint32_be);
+    if (filesize <= data_offset) {
+        print_fatal(FATAL_GENERAL_NO_TAG, data_offset, "file does not contain tags");
+        goto end;
+    }
+
+    /* walk backwards through the last tags */
+    check_phase(FLVMETA_PHASE_TAGS);
+    tags_number = 0;
+    result = flv_seek_end(flv_in);
+    while (result == FLV_OK && tags_number < CHECK_QUICK_TAGS_NUMBER) {
+        result = flv_read_prev_tag(flv_in, &tag);
+        if (result == FLV_OK && !check_is_valid_tag(&tag)) {
+            result = FLV_ERROR_INVALID_PREV_TAG_SIZE;
+        }
+        if (result != FLV_OK) {
+            break;
+        }
+
+        if (tags_number == 0) {
+            last_timestamp = flv_tag_get_timestamp(tag);
+            last_tag_offset = flv_get_current_tag_offset(flv_in);
+            have_last_tag = 1;
+        }
+        ++tags_number;
+    }
+
+    if (tags_number == 0) {
+        /* the file does not end with a complete tag */
+        file_offset_t tail_offset;
+        size_t tail_size;
+        byte * tail;
+        long pos;
+
+        tail_offset = (filesize - data_offset > CHECK_QUICK_TAIL_SIZE) ? filesize - CHECK_QUICK_TAIL_SIZE : data_offset;
+        tail_size = (size_t)(filesize - tail_offset);
+        tail = (byte *)malloc(tail_size);
+        if (tail == NULL) {
+            return ERROR_MEMORY;
+        }
+
+        pos = -1;
+        if (check_read_at(flv_in, tail_offset, tail, tail_size)) {
+            pos = check_find_last_tag(tail, tail_size, &tag);
+        }
+
+        if (pos < 0) {
+            sprintf(message, "file is truncated, no complete tag found in the last %lu bytes", (unsigned long)tail_size);
+            print_error(ERROR_GENERAL_TRUNCATED, filesize, message);
+        }
+        else {
+            flv_tag next_tag;
+            size_t next = (size_t)pos + FLV_TAG_SIZE + flv_tag_get_body_length(tag) + sizeof(uint32_be);
+            size_t remaining = tail_size - next;
+
+            last_timestamp = flv_tag_get_timestamp(tag);
+            last_tag_offset = tail_offset + (size_t)pos;
+            have_last_tag = 1;
+
+            /* estimate the missing size if the incomplete tag header is readable */
+            if (remaining >= FLV_TAG_SIZE && check_decode_tag(tail + next, &next_tag)) {
+                sprintf(message, "file is truncated, tag is incomplete with %lu bytes missing",
+                    (unsigned long)(FLV_TAG_SIZE + flv_tag_get_body_length(next_tag) + sizeof(uint32_be) - remaining));
+            }
+            else {
+                sprintf(message, "file does not end with a complete tag, %lu bytes found after the last one", (unsigned long)remaining);
+            }
+            print_error(ERROR_GENERAL_TRUNCATED, tail_offset + next, message);
+        }
+
+        free(tail);
+    }
+    else if (result == FLV_ERROR_INVALID_PREV_TAG_SIZE) {
+        /* the chain of previous tag sizes is broken before the last tags */
+        print_error(ERROR_PREV_TAG_SIZE_BAD, flv_get_current_tag_offset(flv_in) - sizeof(uint32_be), "previous tag size does not match a valid tag");
+    }
+
+    if (have_last_tag) {
+        sprintf(message, "last timestamp is %u ms", last_timestamp);
+        print_info(INFO_TIMESTAMP_LAST, last_tag_offset, message);
+    }
+
+end:
+    return OK;
+}
+
+/* structural check */
+
+/* size of the blocks read from the file */
+#define CHECK_STRUCTURE_BLOCK_SIZE  1048576
+
+/* reader of large file blocks */
+typedef struct __check_block_reader {
+    flv_stream * stream;
+    byte * buffer;
+    file_offset_t offset; /* file offset of the buffer contents */
+    size_t size; /* number of bytes in the buffer */
+} check_block_reader;
+
+/*
+    get size bytes located at the given offset from the buffer, reading the
+    next block of the file if needed, or NULL if the end of file is reached
+*/
+static const byte * check_block_get(check_block_reader * reader, file_offset_t offset, size_t size) {
+    file_offset_t end;
+    size_t kept;
+
+    end = reader->offset + reader->size;
+    if (offset >= reader->offset && offset + (file_offset_t)size <= end) {
+        return reader->buffer + (size_t)(offset - reader->offset);
+    }
+
+    /* keep the bytes already read, or skip the bytes not needed */
+    kept = 0;
+    if (offset >= reader->offset && offset < end) {
+        kept = (size_t)(end - offset);
+        memmove(reader->buffer, reader->buffer + (size_t)(offset - reader->offset), kept);
+    }
+    else if (offset != end && flv_stream_seek(reader->stream, offset, SEEK_SET) != 0) {
+        return NULL;
+    }
+
+    reader->offset = offset;
+    reader->size = kept + flv_stream_read(reader->stream, reader->buffer + kept, 1, CHECK_STRUCTURE_BLOCK_SIZE - kept);
+
+    return (size <= reader->size) ? reader->buffer : NULL;
+}
+
+/*
+    check the file structure only: header, tag headers, and previous tag
+    sizes, hopping from one tag header to the next in large blocks read
+    from the file without decoding the tag bodies
+*/
+static int check_stream_structure(check_context * ctxt, flv_stream * flv_in, file_offset_t filesize) {
+    check_block_reader reader;
+    flv_header header;
+    check_tags_state tags_state;
+    char message[256];
+    file_offset_t offset;
+    const byte * b;
+    uint32 prev_tag_size;
+
+    reader.buffer = (byte *)malloc(CHECK_STRUCTURE_BLOCK_SIZE);
+    if (reader.buffer == NULL) {
+        return ERROR_MEMORY;
+    }
+    reader.stream = flv_in;
+    reader.offset = 0;
+    reader.size = 0;
+
+    check_tags_state_init(&tags_state);
 
-        json_emit_object_key_z(&ctxt->je, "warnings");
-        json_emit_integer(&ctxt->je, warnings);
+    check_phase(FLVMETA_PHASE_HEADER);
 
-        json_emit_object_end(&ctxt->je);
+    /* check signature */
+    b = check_block_get(&reader, 0, FLV_HEADER_SIZE);
+    if (b == NULL) {
+        print_fatal(FATAL_HEADER_EOF, 0, "unexpected end of file in header");
+        goto end;
+    }
+    else if (b[0] != 'F' || b[1] != 'L' || b[2] != 'V') {
+        print_fatal(FATAL_HEADER_NO_SIGNATURE, 0, "FLV signature not found in header");
+        goto end;
+    }
+    memcpy(header.signature, b, sizeof(header.signature));
+    header.version = b[3];
+    header.flags = b[4];
+    memcpy(&header.offset, b + 5, sizeof(header.offset));
+
+    check_header(ctxt, &header);
 
-        printf("\n");
+    /* check first previous tag size */
+    b = check_block_get(&reader, FLV_HEADER_SIZE, sizeof(uint32_be));
+    if (b == NULL) {
+        print_fatal(FATAL_PREV_TAG_SIZE_EOF, 9, "unexpected end of file in previous tag size");
+        goto end;
     }
-    else {
-        printf("%u error(s), %u warning(s)\n", errors, warnings);
+    prev_tag_size = check_get_uint32_be(b);
+    if (prev_tag_size != 0) {
+        sprintf(message, "first previous tag size should be 0, %u found instead", prev_tag_size);
+        print_error(ERROR_PREV_TAG_SIZE_BAD_FIRST, 9, message);
     }
-}
 
-/* report an error to stdout according to the current format */
-static void report_print_message(
-    int level,
-    const char * code,
-    file_offset_t offset,
-    const char * message,
-    const flvmeta_opts * opts,
-    check_context * ctxt
-) {
-    if (opts->quiet)
-        return;
+    offset = FLV_HEADER_SIZE + sizeof(uint32_be);
 
-    if (level >= opts->check_level) {
-        char * levelstr;
+    /* we reached the end of file: no tags in file */
+    if (offset == filesize) {
+        print_fatal(FATAL_GENERAL_NO_TAG, 13, "file does not contain tags");
+        goto end;
+    }
 
-        switch (level) {
-            case FLVMETA_CHECK_LEVEL_INFO: levelstr = "info"; break;
-            case FLVMETA_CHECK_LEVEL_WARNING: levelstr = "warning"; break;
-            case FLVMETA_CHECK_LEVEL_ERROR: levelstr = "error"; break;
-            case FLVMETA_CHECK_LEVEL_FATAL: levelstr = "fatal"; break;
-            default: levelstr = "unknown";
-        }
+    /* hop from one tag header to the next */
+    check_phase(FLVMETA_PHASE_TAGS);
+    while (offset < filesize) {
+        flv_tag tag;
+        uint32 body_length;
 
-        if (opts->check_report_format == FLVMETA_FORMAT_XML) {
-            /* XML report entry */
-            printf("    <message level=\"%s\" code=\"%s\"", levelstr, code);
-            printf(" offset=\"%" FILE_OFFSET_PRINTF_FORMAT  "u\">", FILE_OFFSET_PRINTF_TYPE(offset));
-            printf("%s</message>\n", message);
+        if (ctxt->stop) {
+            goto end;
         }
-        else if (opts->check_report_format == FLVMETA_FORMAT_JSON) {
-            /* JSON report entry */
-            json_emit_object_start(&ctxt->je);
 
-            json_emit_object_key_z(&ctxt->je, "level");
-            json_emit_string_z(&ctxt->je, levelstr);
-
-            json_emit_object_key_z(&ctxt->je, "code");
-            json_emit_string_z(&ctxt->je, code);
+        b = check_block_get(&reader, offset, FLV_TAG_SIZE);
+        if (b == NULL) {
+            print_fatal(FATAL_TAG_EOF, filesize, "unexpected end of file in tag");
+            goto end;
+        }
+        check_decode_tag(b, &tag);
 
-            json_emit_object_key_z(&ctxt->je, "offset");
-            json_emit_file_offset(&ctxt->je, offset);
+        if (!check_tag_header(ctxt, &tags_state, &header, &tag, offset, filesize - offset - FLV_TAG_SIZE)) {
+            goto end;
+        }
 
-            json_emit_object_key_z(&ctxt->je, "message");
-            json_emit_string_z(&ctxt->je, message);
+        body_length = flv_tag_get_body_length(tag);
+        offset += FLV_TAG_SIZE + body_length;
 
-            json_emit_object_end(&ctxt->je);
-        }
-        else {
-            /* raw report entry */
-            /*printf("%s:", opts->input_file);*/
-            printf("0x%.8" FILE_OFFSET_PRINTF_FORMAT "x: ", FILE_OFFSET_PRINTF_TYPE(offset));
-            printf("%s %s: %s\n", levelstr, code, message);
+        b = check_block_get(&reader, offset, sizeof(uint32_be));
+        if (b == NULL) {
+            print_fatal(FATAL_PREV_TAG_SIZE_EOF, filesize, "unexpected end of file in previous tag size");
+            goto end;
         }
+        offset += sizeof(uint32_be);
+
+        check_prev_tag_size(ctxt, offset, body_length, check_get_uint32_be(b));
     }
-}
 
-/* timestamp distance */
-#define timestamp_distance(t1, t2) ((t1)>(t2)?(t1)-(t2):(t2)-(t1))
+    if (ctxt->stop) {
+        goto end;
+    }
 
-/* convenience macros */
-#define print_info(code, offset, message) \
-    report_print_message(FLVMETA_CHECK_LEVEL_INFO, code, offset, message, opts, &ctxt)
-#define print_warning(code, offset, message) \
-    if (opts->check_level <= FLVMETA_CHECK_LEVEL_WARNING) ++warnings; \
-    report_print_message(FLVMETA_CHECK_LEVEL_WARNING, code, offset, message, opts, &ctxt)
-#define print_error(code, offset, message) \
-    if (opts->check_level <= FLVMETA_CHECK_LEVEL_ERROR) ++errors; \
-    report_print_message(FLVMETA_CHECK_LEVEL_ERROR, code, offset, message, opts, &ctxt)
-#define print_fatal(code, offset, message) \
-    if (opts->check_level <= FLVMETA_CHECK_LEVEL_FATAL) ++errors; \
-    report_print_message(FLVMETA_CHECK_LEVEL_FATAL, code, offset, message, opts, &ctxt)
+    check_tags_end(ctxt, &tags_state, &header, filesize);
+    check_file_end(ctxt, tags_state.last_timestamp, filesize);
 
-/* get string representing given AMF type */
-static const char * get_amf_type_string(byte type) {
-    switch (type) {
-        case AMF_TYPE_NUMBER: return "Number";
-        case AMF_TYPE_BOOLEAN: return "Boolean";
-        case AMF_TYPE_STRING: return "String";
-        case AMF_TYPE_NULL: return "Null";
-        case AMF_TYPE_UNDEFINED: return "Undefined";
-        /*case AMF_TYPE_REFERENCE:*/
-        case AMF_TYPE_OBJECT: return "Object";
-        case AMF_TYPE_ASSOCIATIVE_ARRAY: return "Associative array";
-        case AMF_TYPE_ARRAY: return "Array";
-        case AMF_TYPE_DATE: return "Date";
-        /*case AMF_TYPE_SIMPLEOBJECT:*/
-        case AMF_TYPE_XML: return "XML";
-        case AMF_TYPE_CLASS: return "Class";
-        default: return "Unknown type";
-    }
+end:
+    free(reader.buffer);
+    return OK;
 }
 
-/* check FLV file validity */
-int check_flv_file(const flvmeta_opts * opts) {
-    flv_stream * flv_in;
+/* check all the file contents */
+static int check_stream_full(check_context * ctxt, flv_stream * flv_in, file_offset_t filesize) {
     flv_header header;
-    check_context ctxt;
-    uint32 errors, warnings;
     int result;
     char message[256];
-    uint32 prev_tag_size, tag_number;
-    uint32 last_timestamp, last_video_timestamp, last_audio_timestamp;
-    file_offset_t filesize;
-    int have_audio, have_video;
+    uint32 prev_tag_size;
+    check_tags_state tags_state;
     flvmeta_opts opts_loc;
     flv_info info;
-    int have_desync;
+    flv_info_state info_state;
+    int info_result;
     int have_on_metadata;
     file_offset_t on_metadata_offset;
     amf_data * on_metadata, * on_metadata_name;
@@ -226,17 +1487,17 @@ int check_flv_file(const flvmeta_opts * opts) {
     int have_prev_video_tag;
     flv_video_tag prev_video_tag;
 
-    int consecutive_unknown_tags;
-
     int video_frames_number, keyframes_number;
 
+    check_aac_state aac_state;
+    check_avc_state avc_state;
+
     prev_audio_tag = 0;
     prev_video_tag.video_tag = 0;
 
-    have_audio = have_video = 0;
-    tag_number = 0;
-    last_timestamp = last_video_timestamp = last_audio_timestamp = 0;
-    have_desync = 0;
+    check_tags_state_init(&tags_state);
+    check_aac_state_init(&aac_state);
+    check_avc_state_init(&avc_state);
     have_prev_audio_tag = have_prev_video_tag = 0;
     video_frames_number = keyframes_number = 0;
     have_on_metadata = 0;
@@ -244,25 +1505,23 @@ int check_flv_file(const flvmeta_opts * opts) {
     on_metadata = on_metadata_name = NULL;
     have_on_last_second = 0;
     on_last_second_timestamp = 0;
-    consecutive_unknown_tags = 0;
-
-    /* file stats */
-    if (flvmeta_filesize(opts->input_file, &filesize) == 0) {
-        return ERROR_OPEN_READ;
-    }
-
-    /* open file for reading */
-    flv_in = flv_open(opts->input_file);
-    if (flv_in == NULL) {
-        return ERROR_OPEN_READ;
-    }
 
-    errors = warnings = 0;
+    /* file information is collected along with the checks,
+       with a sensible set of unobstrusive options */
+    opts_loc.verbose = 0;
+    opts_loc.reset_timestamps = 0;
+    opts_loc.preserve_metadata = 0;
+    opts_loc.all_keyframes = 0;
+    opts_loc.error_handling = FLVMETA_IGNORE_ERRORS;
+    opts_loc.insert_onlastsecond = 0;
 
-    report_start(opts, &ctxt);
+    flv_info_init(&info_state, &info);
+    info_result = OK;
 
     /** check header **/
 
+    check_phase(FLVMETA_PHASE_HEADER);
+
     /* check signature */
     result = flv_read_header(flv_in, &header);
     if (result == FLV_ERROR_EOF) {
@@ -273,34 +1532,9 @@ int check_flv_file(const flvmeta_opts * opts) {
         print_fatal(FATAL_HEADER_NO_SIGNATURE, 0, "FLV signature not found in header");
         goto end;
     }
+    info.header = header;
 
-    /* version */
-    if (header.version != FLV_VERSION) {
-        sprintf(message, "header version should be 1, %u found instead", header.version);
-        print_error(ERROR_HEADER_BAD_VERSION, 3, message);
-    }
-
-    /* video and audio flags */
-    if (!flv_header_has_audio(header) && !flv_header_has_video(header)) {
-        print_error(ERROR_HEADER_NO_STREAMS, 4, "header signals the file does not contain video tags or audio tags");
-    }
-    else if (!flv_header_has_audio(header)) {
-        print_info(INFO_HEADER_NO_AUDIO, 4, "header signals the file does not contain audio tags");
-    }
-    else if (!flv_header_has_video(header)) {
-        print_warning(WARNING_HEADER_NO_VIDEO, 4, "header signals the file does not contain video tags");
-    }
-
-    /* reserved flags */
-    if (header.flags & 0xFA) {
-        print_error(ERROR_HEADER_BAD_RESERVED_FLAGS, 4, "header reserved flags are not zero");
-    }
-
-    /* offset */
-    if (flv_header_get_offset(header) != 9) {
-        sprintf(message, "header offset should be 9, %u found instead", flv_header_get_offset(header));
-        print_error(ERROR_HEADER_BAD_OFFSET, 5, message);
-    }
+    check_header(ctxt, &header);
 
     /** check first previous tag size **/
 
@@ -321,11 +1555,16 @@ int check_flv_file(const flvmeta_opts * opts) {
     }
 
     /** read tags **/
+    check_phase(FLVMETA_PHASE_TAGS);
     while (flv_get_offset(flv_in) < filesize) {
         flv_tag tag;
         file_offset_t offset;
-        uint32 body_length, timestamp, stream_id;
-        int decr_timestamp_signaled;
+        uint32 body_length, timestamp;
+
+        /* a finding requested the check to stop */
+        if (ctxt->stop) {
+            goto end;
+        }
 
         result = flv_read_tag(flv_in, &tag);
         if (result != FLV_OK) {
@@ -333,118 +1572,28 @@ int check_flv_file(const flvmeta_opts * opts) {
             goto end;
         }
 
-        ++tag_number;
-
         offset = flv_get_current_tag_offset(flv_in);
         body_length = flv_tag_get_body_length(tag);
         timestamp = flv_tag_get_timestamp(tag);
-        stream_id = flv_tag_get_stream_id(tag);
-
-        /* check tag type */
-        if (tag.type != FLV_TAG_TYPE_AUDIO
-            && tag.type != FLV_TAG_TYPE_VIDEO
-            && tag.type != FLV_TAG_TYPE_META
-        ) {
-            sprintf(message, "unknown tag type %" PRI_BYTE "d", tag.type);
-            print_error(ERROR_TAG_TYPE_UNKNOWN, offset, message);
-            ++consecutive_unknown_tags;
-
-            if (consecutive_unknown_tags >= 2) {
-                print_fatal(FATAL_CONSECUTIVE_UNKNOWN_TAGS, offset, "consecutive tags with unknown type found, aborting");
-                goto end;
-            }
-        }
-        else {
-            consecutive_unknown_tags = 0;
-        }
-
-        /* check consistency with global header */
-        if (!have_video && tag.type == FLV_TAG_TYPE_VIDEO) {
-            if (!flv_header_has_video(header)) {
-                print_warning(WARNING_HEADER_UNEXPECTED_VIDEO, offset, "video tag found despite header signaling the file contains no video");
-            }
-            have_video = 1;
-        }
-        if (!have_audio && tag.type == FLV_TAG_TYPE_AUDIO) {
-            if (!flv_header_has_audio(header)) {
-                print_warning(WARNING_HEADER_UNEXPECTED_AUDIO, offset, "audio tag found despite header signaling the file contains no audio");
-            }
-            have_audio = 1;
-        }
 
-        /* check body length */
-        if (body_length > (filesize - flv_get_offset(flv_in))) {
-            sprintf(message, "tag body length (%u bytes) exceeds file size", body_length);
-            print_fatal(FATAL_TAG_BODY_LENGTH_OVERFLOW, offset + 1, message);
+        if (!check_tag_header(ctxt, &tags_state, &header, &tag, offset, filesize - flv_get_offset(flv_in))) {
             goto end;
         }
-        else if (body_length > MAX_ACCEPTABLE_TAG_BODY_LENGTH) {
-            sprintf(message, "tag body length (%u bytes) is abnormally large", body_length);
-            print_warning(WARNING_TAG_BODY_LENGTH_LARGE, offset + 1, message);
-        }
-        else if (body_length == 0) {
-            print_warning(WARNING_TAG_BODY_LENGTH_ZERO, offset + 1, "tag body length is zero");
-        }
 
-        /** check timestamp **/
-        decr_timestamp_signaled = 0;
-
-        /* check whether first timestamp is zero */
-        if (tag_number == 1 && timestamp != 0) {
-            sprintf(message, "first timestamp should be zero, %u found instead", timestamp);
-            print_error(ERROR_TIMESTAMP_FIRST_NON_ZERO, offset + 4, message);
-        }
-
-        /* check whether timestamps decrease in a given stream */
-        if (tag.type == FLV_TAG_TYPE_AUDIO) {
-            if (last_audio_timestamp > timestamp) {
-                sprintf(message, "audio tag timestamps are decreasing from %u to %u", last_audio_timestamp, timestamp);
-                print_error(ERROR_TIMESTAMP_AUDIO_DECREASE, offset + 4, message);
-            }
-            last_audio_timestamp = timestamp;
-            decr_timestamp_signaled = 1;
-        }
-        if (tag.type == FLV_TAG_TYPE_VIDEO) {
-            if (last_video_timestamp > timestamp) {
-                sprintf(message, "video tag timestamps are decreasing from %u to %u", last_video_timestamp, timestamp);
-                print_error(ERROR_TIMESTAMP_VIDEO_DECREASE, offset + 4, message);
+        if (ctxt->run_metadata) {
+            check_phase(FLVMETA_PHASE_INFO);
+            flv_info_start_tag(&info_state, &info, &tag, &opts_loc);
+            if (tags_state.consecutive_unknown_tags > 0) {
+                flv_info_add_unknown_tag(&info);
             }
-            last_video_timestamp = timestamp;
-            decr_timestamp_signaled = 1;
-        }
-
-        /* check for overflow error */
-        if (last_timestamp > timestamp && last_timestamp - timestamp > 0xF00000) {
-            print_error(ERROR_TIMESTAMP_OVERFLOW, offset + 4, "extended bits not used after timestamp overflow");
-        }
-
-        /* check whether timestamps decrease globally */
-        else if (!decr_timestamp_signaled && last_timestamp > timestamp && last_timestamp - timestamp >= 1000) {
-            sprintf(message, "timestamps are decreasing from %u to %u", last_timestamp, timestamp);
-            print_error(ERROR_TIMESTAMP_DECREASE, offset + 4, message);
-        }
-
-        last_timestamp = timestamp;
-
-        /* check for desyncs between audio and video: one second or more is suspicious */
-        if (have_video && have_audio && !have_desync && timestamp_distance(last_video_timestamp, last_audio_timestamp) >= 1000) {
-            sprintf(message, "audio and video streams are desynchronized by %d ms",
-                timestamp_distance(last_video_timestamp, last_audio_timestamp));
-            print_warning(WARNING_TIMESTAMP_DESYNC, offset + 4, message);
-            have_desync = 1; /* do not repeat */
+            check_phase(FLVMETA_PHASE_TAGS);
         }
 
-        /** stream id must be zero **/
-        if (stream_id != 0) {
-            sprintf(message, "tag stream id must be zero, %u found instead", stream_id);
-            print_error(ERROR_TAG_STREAM_ID_NON_ZERO, offset + 8, message);
-        }
-
-        /* check tag body contents only if not empty */
+        /* check tag body contents only if not empty, and only if enabled rules need them */
         if (body_length > 0) {
 
             /** check audio info **/
-            if (tag.type == FLV_TAG_TYPE_AUDIO) {
+            if (tag.type == FLV_TAG_TYPE_AUDIO && ctxt->run_body) {
                 flv_audio_tag at;
                 uint8_bitmask audio_format;
 
@@ -500,11 +1649,22 @@ int check_flv_file(const flvmeta_opts * opts) {
                     print_warning(WARNING_AUDIO_CODEC_LINEAR_PCM, offset + 11, "audio data in Linear PCM, platform endian format should not be used because of non-portability");
                 }
 
+                /* check AAC sequence headers and raw frames */
+                if (audio_format == FLV_AUDIO_TAG_SOUND_FORMAT_AAC) {
+                    check_aac_frame(ctxt, &aac_state, flv_in, at);
+                }
+
+                if (ctxt->run_metadata) {
+                    check_phase(FLVMETA_PHASE_INFO);
+                    flv_info_add_audio_tag(&info_state, &info, &at, body_length);
+                    check_phase(FLVMETA_PHASE_TAGS);
+                }
+
                 prev_audio_tag = at;
                 have_prev_audio_tag = 1;
             }
             /** check video info **/
-            else if (tag.type == FLV_TAG_TYPE_VIDEO) {
+            else if (tag.type == FLV_TAG_TYPE_VIDEO && ctxt->run_body) {
                 flv_video_tag vt;
                 uint8_bitmask video_frame_type;
                 uint32_be video_codec;
@@ -565,17 +1725,33 @@ int check_flv_file(const flvmeta_opts * opts) {
                     print_warning(WARNING_VIDEO_CODEC_JPEG, offset + 11, "JPEG codec not currently used");
                 }
 
+                /* check the NAL units of AVC frames */
+                if (ctxt->run_frames && video_codec == FLV_VIDEO_TAG_CODEC_AVC) {
+                    check_avc_frame(ctxt, &avc_state, flv_in, video_frame_type, offset);
+                }
+
+                if (ctxt->run_metadata && info_result == OK) {
+                    check_phase(FLVMETA_PHASE_INFO);
+                    info_result = flv_info_add_video_tag(&info_state, &info, flv_in, &vt, body_length, offset, &opts_loc);
+                    check_phase(FLVMETA_PHASE_TAGS);
+                }
+
                 prev_video_tag = vt;
                 have_prev_video_tag = 1;
             }
             /** check script data info **/
-            else if (tag.type == FLV_TAG_TYPE_META) {
+            else if (tag.type == FLV_TAG_TYPE_META && ctxt->run_metadata) {
                 amf_data * name;
                 amf_data * data;
 
                 name = NULL;
                 data = NULL;
+                check_phase(FLVMETA_PHASE_METADATA);
                 result = flv_read_metadata(flv_in, &name, &data);
+                check_phase(FLVMETA_PHASE_TAGS);
+                if (ctxt->stats != NULL) {
+                    ctxt->stats->amf_nodes += amf_data_count_nodes(name) + amf_data_count_nodes(data);
+                }
 
                 if (result == FLV_ERROR_EOF) {
                     print_fatal(FATAL_TAG_EOF, offset + 11, "unexpected end of file in tag");
@@ -639,7 +1815,7 @@ int check_flv_file(const flvmeta_opts * opts) {
                             }
 
                             /* onMetaData must be the first tag at 0 timestamp */
-                            if (tag_number != 1) {
+                            if (tags_state.tag_number != 1) {
                                 print_warning(WARNING_METADATA_BAD_TAG, offset, "onMetadata event found after the first tag");
                             }
                             if (timestamp != 0) {
@@ -665,10 +1841,27 @@ int check_flv_file(const flvmeta_opts * opts) {
                     }
                 }
 
+                check_phase(FLVMETA_PHASE_INFO);
+                flv_info_add_metadata_tag(&info, name, data, body_length, offset, &opts_loc);
+                check_phase(FLVMETA_PHASE_TAGS);
+
                 amf_data_free(name);
                 amf_data_free(data);
             }
         }
+        else if (ctxt->run_metadata) {
+            check_phase(FLVMETA_PHASE_INFO);
+            if (tag.type == FLV_TAG_TYPE_AUDIO) {
+                flv_info_add_audio_tag(&info_state, &info, NULL, body_length);
+            }
+            else if (tag.type == FLV_TAG_TYPE_VIDEO && info_result == OK) {
+                info_result = flv_info_add_video_tag(&info_state, &info, flv_in, NULL, body_length, offset, &opts_loc);
+            }
+            else if (tag.type == FLV_TAG_TYPE_META) {
+                flv_info_add_metadata_tag(&info, NULL, NULL, body_length, offset, &opts_loc);
+            }
+            check_phase(FLVMETA_PHASE_TAGS);
+        }
 
         /* check body length against previous tag size */
         result = flv_read_prev_tag_size(flv_in, &prev_tag_size);
@@ -677,50 +1870,35 @@ int check_flv_file(const flvmeta_opts * opts) {
             goto end;
         }
 
-        if (prev_tag_size != FLV_TAG_SIZE + body_length) {
-            sprintf(message, "previous tag size should be %u, %u found instead", FLV_TAG_SIZE + body_length, prev_tag_size);
-            print_error(ERROR_PREV_TAG_SIZE_BAD, flv_get_offset(flv_in), message);
-        }
+        check_prev_tag_size(ctxt, flv_get_offset(flv_in), body_length, prev_tag_size);
     }
 
     /** final checks */
 
-    /* check consistency with global header */
-    if (!have_video && flv_header_has_video(header)) {
-        print_warning(WARNING_HEADER_VIDEO_NOT_FOUND, 4, "no video tag found despite header signaling the file contains video");
-    }
-    if (!have_audio && flv_header_has_audio(header)) {
-        print_warning(WARNING_HEADER_AUDIO_NOT_FOUND, 4, "no audio tag found despite header signaling the file contains audio");
+    if (ctxt->stop) {
+        goto end;
     }
 
-    /* check last timestamps */
-    if (have_video && have_audio && timestamp_distance(last_audio_timestamp, last_video_timestamp) >= 1000) {
-        if (last_audio_timestamp > last_video_timestamp) {
-            sprintf(message, "video stops %u ms before audio", last_audio_timestamp - last_video_timestamp);
-            print_warning(WARNING_TIMESTAMP_VIDEO_ENDS_FIRST, filesize, message);
-        }
-        else {
-            sprintf(message, "audio stops %u ms before video", last_video_timestamp - last_audio_timestamp);
-            print_warning(WARNING_TIMESTAMP_AUDIO_ENDS_FIRST, filesize, message);
-        }
-    }
+    check_phase(FLVMETA_PHASE_COMPARISON);
+
+    check_tags_end(ctxt, &tags_state, &header, filesize);
 
     /* check video keyframes */
-    if (have_video && keyframes_number == 0) {
+    if (tags_state.have_video && keyframes_number == 0) {
         print_warning(WARNING_VIDEO_NO_KEYFRAME, filesize, "no keyframe detected, file is probably broken or incomplete");
     }
-    if (have_video && keyframes_number == video_frames_number) {
+    if (tags_state.have_video && keyframes_number == video_frames_number) {
         print_warning(WARNING_VIDEO_ONLY_KEYFRAMES, filesize, "only keyframes detected, probably inefficient compression scheme used");
     }
 
     /* only keyframes + onLastSecond bug */
-    if (have_video && have_on_last_second && keyframes_number == video_frames_number) {
+    if (tags_state.have_video && have_on_last_second && keyframes_number == video_frames_number) {
         print_warning(WARNING_VIDEO_ONLY_KF_LAST_SEC, filesize, "only keyframes detected and onLastSecond event present, file is probably not playable");
     }
 
     /* check onLastSecond timestamp */
-    if (have_on_last_second && (last_timestamp - on_last_second_timestamp) >= 2000) {
-        sprintf(message, "onLastSecond event located %u ms before the last tag", last_timestamp - on_last_second_timestamp);
+    if (have_on_last_second && (tags_state.last_timestamp - on_last_second_timestamp) >= 2000) {
+        sprintf(message, "onLastSecond event located %u ms before the last tag", tags_state.last_timestamp - on_last_second_timestamp);
         print_warning(WARNING_METADATA_LAST_SECOND_BAD, filesize, message);
     }
 
@@ -735,25 +1913,14 @@ int check_flv_file(const flvmeta_opts * opts) {
         have_width = 0;
         have_height = 0;
 
-        /* compute metadata, with a sensible set of unobstrusive options */
-        opts_loc.verbose = 0;
-        opts_loc.reset_timestamps = 0;
-        opts_loc.preserve_metadata = 0;
-        opts_loc.all_keyframes = 0;
-        opts_loc.error_handling = FLVMETA_IGNORE_ERRORS;
-        opts_loc.insert_onlastsecond = 0;
-
-        flv_reset(flv_in);
-        if (get_flv_info(flv_in, &info, &opts_loc) != OK) {
+        /* file information has been collected while reading the tags */
+        if (info_result != OK) {
             print_fatal(FATAL_INFO_COMPUTATION_ERROR, 0, "unable to compute file information");
             goto end;
         }
 
-        /* delete useless info data */
-        amf_data_free(info.original_on_metadata);
-
-        /* more metadata checks */
-        for (n = amf_associative_array_first(on_metadata); n != NULL; n = amf_associative_array_next(n)) {
+        /* more metadata checks, until a finding requests the check to stop */
+        for (n = amf_associative_array_first(on_metadata); n != NULL && !ctxt->stop; n = amf_associative_array_next(n)) {
             byte * name;
             amf_data * data;
             byte type;
@@ -1337,6 +2504,12 @@ int check_flv_file(const flvmeta_opts * opts) {
                                 amf_array_size(info.filepositions) != amf_array_size(file_filepositions) ||
                                 amf_array_size(file_filepositions) != amf_array_size(file_times)) {
                                 print_warning(WARNING_KEYFRAMES_ARRAY_LENGTH_BAD, on_metadata_offset, "invalid keyframes arrays length");
+
+                                /* align the entries when the stored arrays can be paired */
+                                if (amf_array_size(file_filepositions) == amf_array_size(file_times)) {
+                                    check_keyframes_align(ctxt, info.times, info.filepositions,
+                                        file_times, file_filepositions, on_metadata_offset);
+                                }
                             }
                             else {
                                 number64 last_file_time;
@@ -1418,17 +2591,16 @@ int check_flv_file(const flvmeta_opts * opts) {
             }
         }
 
-        /* we need to release the info.keyframes pointer, because
-           as opposed to update.c, these amf data do not get added
-           into another object, therefore keep memory ownership */
-        amf_data_free(info.keyframes);
+        if (ctxt->stop) {
+            goto end;
+        }
 
         /* missing width or height can cause size problem in various players */
         if (info.have_video) {
             if (!have_width) {
                 print_error(ERROR_VIDEO_WIDTH_MISSING, on_metadata_offset, "width information not found in metadata, problems might occur in some players");
             }
-            if (!have_height) {
+            if (!have_height && !ctxt->stop) {
                 print_error(ERROR_VIDEO_HEIGHT_MISSING, on_metadata_offset, "height information not found in metadata, problems might occur in some players");
             }
         }
@@ -1441,14 +2613,14 @@ int check_flv_file(const flvmeta_opts * opts) {
 
     /* global info */
 
-    if (info.have_video) {
+    if (have_prev_video_tag) {
         /* video codec */
         sprintf(message, "video codec is %s", dump_string_get_video_codec(prev_video_tag));
         print_info(INFO_VIDEO_CODEC, 0, message);
 
     }
 
-    if (info.have_audio) {
+    if (have_prev_audio_tag) {
         /* audio info */
         sprintf(message, "audio format is %s (%s, %s-bit, %s kHz)",
             dump_string_get_sound_format(prev_audio_tag),
@@ -1459,22 +2631,130 @@ int check_flv_file(const flvmeta_opts * opts) {
         print_info(INFO_AUDIO_FORMAT, 0, message);
     }
 
-    /* does the file use extended timestamps ? */
-    if (last_timestamp > 0x00FFFFFF) {
-        print_info(INFO_TIMESTAMP_USE_EXTENDED, 0, "extended timestamps used in the file");
+    check_file_end(ctxt, tags_state.last_timestamp, filesize);
+
+end:
+    amf_data_free(on_metadata);
+    amf_data_free(on_metadata_name);
+
+    /* the computed keyframes index */
+    if (ctxt->stats != NULL) {
+        ctxt->stats->amf_nodes += amf_data_count_nodes(info.keyframes);
     }
 
-    /* is the file larger than 4GB ? */
-    if (filesize > 0xFFFFFFFFULL) {
-        print_info(INFO_GENERAL_LARGE_FILE, 0, "file is larger than 4 GB");
+    /* we need to release the info.keyframes pointer, because
+       as opposed to update.c, these amf data do not get added
+       into another object, therefore keep memory ownership */
+    amf_data_free(info.keyframes);
+    check_avc_state_free(&avc_state);
+
+    return OK;
+}
+
+/*
+    check a stream according to the check mode, using the structural check
+    when no enabled rule needs the tag bodies, since it evaluates the same
+    header and tag rules without reading the file tag by tag
+*/
+static int check_stream(check_context * ctxt, flv_stream * flv_in, file_offset_t filesize) {
+    if (ctxt->opts->check_quick) {
+        return check_stream_quick(ctxt, flv_in, filesize);
+    }
+    else if (ctxt->opts->check_structure || !ctxt->run_body) {
+        return check_stream_structure(ctxt, flv_in, filesize);
+    }
+    else {
+        return check_stream_full(ctxt, flv_in, filesize);
     }
+}
 
-end:
-    report_end(opts, &ctxt, errors, warnings);
+/* check FLV file validity */
+int check_flv_file(const flvmeta_opts * opts) {
+    flv_stream * flv_in;
+    check_context ctxt;
+    flvmeta_stats stats;
+    file_offset_t filesize;
+    int result;
+
+    /* file stats */
+    if (flvmeta_filesize(opts->input_file, &filesize) == 0) {
+        return ERROR_OPEN_READ;
+    }
+
+    /* open file for reading */
+    flv_in = flv_open(opts->input_file);
+    if (flv_in == NULL) {
+        return ERROR_OPEN_READ;
+    }
+
+    check_context_init(&ctxt, opts, NULL);
+    if (opts->stats) {
+        flvmeta_stats_init(&stats);
+        ctxt.stats = &stats;
+    }
+
+    report_start(opts, &ctxt);
+    result = check_stream(&ctxt, flv_in, filesize);
+    if (result == OK) {
+        result = ctxt.status;
+    }
+    flvmeta_stats_end(ctxt.stats, flv_in);
+    report_end(opts, &ctxt);
 
-    amf_data_free(on_metadata);
-    amf_data_free(on_metadata_name);
     flv_close(flv_in);
 
-    return (errors > 0) ? ERROR_INVALID_FLV_FILE : OK;
+    if (result != OK) {
+        return result;
+    }
+    return (ctxt.errors > 0) ? ERROR_INVALID_FLV_FILE : OK;
+}
+
+/* check a freshly opened stream, collecting the findings */
+int check_flv_stream(flv_stream * flv_in, const flvmeta_opts * opts, check_result * result) {
+    check_context ctxt;
+    file_offset_t filesize;
+    int status;
+
+    result->findings = NULL;
+    result->findings_number = 0;
+    result->findings_capacity = 0;
+    result->errors = 0;
+    result->warnings = 0;
+
+    /* stream size */
+    if (lfs_fseek(flv_in->flvin, 0, SEEK_END) != 0) {
+        return ERROR_OPEN_READ;
+    }
+    filesize = lfs_ftell(flv_in->flvin);
+    if (lfs_fseek(flv_in->flvin, 0, SEEK_SET) != 0) {
+        return ERROR_OPEN_READ;
+    }
+
+    check_context_init(&ctxt, opts, result);
+
+    status = check_stream(&ctxt, flv_in, filesize);
+    if (status == OK) {
+        status = ctxt.status;
+    }
+
+    result->errors = ctxt.errors;
+    result->warnings = ctxt.warnings;
+
+    if (status != OK) {
+        return status;
+    }
+    return (ctxt.errors > 0) ? ERROR_INVALID_FLV_FILE : OK;
+}
+
+/* release the findings of a check */
+void check_result_free(check_result * result) {
+    size_t i;
+
+    for (i = 0; i < result->findings_number; ++i) {
+        free(result->findings[i].message);
+    }
+    free(result->findings);
+    result->findings = NULL;
+    result->findings_number = 0;
+    result->findings_capacity = 0;
 }
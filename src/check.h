@@ -132,6 +132,47 @@
 #define INFO_GENERAL_LARGE_FILE             LEVEL_INFO      TOPIC_GENERAL_FORMAT    "083"
 #define FATAL_CONSECUTIVE_UNKNOWN_TAGS      LEVEL_FATAL     TOPIC_TAG_TYPES         "084"
 #define ERROR_EXTENDED_VIDEO_CODEC_UNKNOWN  LEVEL_ERROR     TOPIC_VIDEO_CODECS      "085"
+#define ERROR_GENERAL_TRUNCATED             LEVEL_ERROR     TOPIC_GENERAL_FORMAT    "086"
+#define INFO_TIMESTAMP_LAST                 LEVEL_INFO      TOPIC_TIMESTAMPS        "087"
+#define ERROR_AVC_NO_SEQUENCE_HEADER        LEVEL_ERROR     TOPIC_VIDEO_CODECS      "088"
+#define ERROR_AVC_NAL_UNIT_LENGTH_BAD       LEVEL_ERROR     TOPIC_VIDEO_CODECS      "089"
+#define WARNING_AVC_IDR_NOT_KEYFRAME        LEVEL_WARNING   TOPIC_VIDEO_CODECS      "090"
+#define WARNING_AVC_PARAMETER_SET_CHANGED   LEVEL_WARNING   TOPIC_VIDEO_CODECS      "091"
+#define ERROR_AAC_SEQUENCE_HEADER_INVALID   LEVEL_ERROR     TOPIC_AUDIO_CODECS      "092"
+#define WARNING_AAC_CHANNELS_MISMATCH       LEVEL_WARNING   TOPIC_AUDIO_CODECS      "093"
+#define WARNING_AAC_CONFIG_CHANGED          LEVEL_WARNING   TOPIC_AUDIO_CODECS      "094"
+#define ERROR_AAC_NO_SEQUENCE_HEADER        LEVEL_ERROR     TOPIC_AUDIO_CODECS      "095"
+#define ERROR_AAC_RAW_FRAME_ADTS            LEVEL_ERROR     TOPIC_AUDIO_CODECS      "096"
+#define WARNING_AAC_RAW_FRAME_ELEMENT_BAD   LEVEL_WARNING   TOPIC_AUDIO_CODECS      "097"
+#define WARNING_KEYFRAMES_ENTRY_MISSING     LEVEL_WARNING   TOPIC_KEYFRAMES         "098"
+#define WARNING_KEYFRAMES_ENTRY_EXTRA       LEVEL_WARNING   TOPIC_KEYFRAMES         "099"
+#define WARNING_KEYFRAMES_POS_SHIFTED       LEVEL_WARNING   TOPIC_KEYFRAMES         "100"
+#define INFO_KEYFRAMES_ALIGNMENT            LEVEL_INFO      TOPIC_KEYFRAMES         "101"
+
+/* rule cost classes, from the cheapest to the most expensive */
+#define CHECK_COST_HEADER   0 /* file header and first previous tag size */
+#define CHECK_COST_TAG      1 /* tag headers and previous tag sizes */
+#define CHECK_COST_BODY     2 /* audio and video tag bodies */
+#define CHECK_COST_METADATA 3 /* script data, compared with the file contents */
+#define CHECK_COST_FRAME    4 /* whole video frames, only when requested */
+
+/* check finding */
+typedef struct __check_finding {
+    int level; /* FLVMETA_CHECK_LEVEL_* */
+    int id; /* rule identifier */
+    char code[7]; /* message code, e.g. W81074 */
+    file_offset_t offset;
+    char * message;
+} check_finding;
+
+/* findings of a check, with summary counters */
+typedef struct __check_result {
+    check_finding * findings;
+    size_t findings_number;
+    size_t findings_capacity;
+    uint32 errors;
+    uint32 warnings;
+} check_result;
 
 #ifdef __cplusplus
 extern "C" {
@@ -140,6 +181,22 @@ extern "C" {
 /* check FLV file validity */
 int check_flv_file(const flvmeta_opts * opts);
 
+/*
+    check a freshly opened FLV stream without printing anything, collecting
+    the findings at the level given in the options into result, which must
+    be released with check_result_free
+*/
+int check_flv_stream(flv_stream * flv_in, const flvmeta_opts * opts, check_result * result);
+
+/* release the findings of a check */
+void check_result_free(check_result * result);
+
+/* get the identifier of a check rule from its code or its number, -1 if unknown */
+int check_get_rule_id(const char * code);
+
+/* get the code of a check rule from its identifier, NULL if unknown */
+const char * check_get_rule_code(int id);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
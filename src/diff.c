@@ -0,0 +1,331 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "diff.h"
+#include "dump.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+    Tags are compared by type, body size, and body hash, ignoring their
+    timestamps and offsets. When tags differ, the tags of both files are
+    resynchronized on the nearest following run of matching tags within a
+    window, preferring runs which keep the current timestamp shift, so
+    that repeated identical frames do not cause spurious matches.
+*/
+#define DIFF_WINDOW_SIZE    256
+#define DIFF_RUN_LENGTH     8
+
+/* tag information read from a file */
+typedef struct __diff_tag {
+    file_offset_t offset;
+    uint64 hash;
+    uint32 timestamp;
+    uint32 body_length;
+    uint8 type;
+    uint8 truncated; /* the body ends with the file, hashed as far as available */
+} diff_tag;
+
+typedef struct __diff_file {
+    flv_header header;
+    diff_tag * tags;
+    size_t tags_number;
+    size_t tags_capacity;
+} diff_file;
+
+typedef struct __diff_stats {
+    size_t identical;
+    size_t changed;
+    size_t removed;
+    size_t inserted;
+    size_t shifts;
+} diff_stats;
+
+/* whether a tag matches the optional filter expression */
+static int diff_filter_match(flv_stream * stream, flv_tag * tag, const flvmeta_filter * filter) {
+    flvmeta_filter_tag ft;
+    byte body[FLVMETA_FILTER_PEEK_SIZE];
+
+    if (filter == NULL) {
+        return 1;
+    }
+
+    flvmeta_filter_tag_init(&ft, tag, flv_get_current_tag_offset(stream));
+    if (flvmeta_filter_needs_body(filter)) {
+        flvmeta_filter_tag_set_body(&ft, body, flv_peek_tag_body(stream, body, sizeof(body)));
+    }
+    return flvmeta_filter_match(filter, &ft);
+}
+
+/* read the tags of a file matching the filter, hashing their bodies */
+static int diff_read_file(const char * file, diff_file * df, const flvmeta_filter * filter) {
+    flv_stream * stream;
+    flv_tag tag;
+    diff_tag * dt;
+    int retval;
+
+    stream = flv_open(file);
+    if (stream == NULL) {
+        return ERROR_OPEN_READ;
+    }
+
+    retval = flv_read_header(stream, &df->header);
+    if (retval != FLV_OK) {
+        flv_close(stream);
+        return (retval == FLV_ERROR_NO_FLV) ? ERROR_NO_FLV : ERROR_EOF;
+    }
+
+    while (flv_read_tag(stream, &tag) == FLV_OK) {
+        if (!diff_filter_match(stream, &tag, filter)) {
+            continue;
+        }
+
+        if (df->tags_number == df->tags_capacity) {
+            size_t capacity = (df->tags_capacity > 0) ? df->tags_capacity * 2 : 1024;
+            dt = (diff_tag *)realloc(df->tags, capacity * sizeof(diff_tag));
+            if (dt == NULL) {
+                flv_close(stream);
+                return ERROR_MEMORY;
+            }
+            df->tags = dt;
+            df->tags_capacity = capacity;
+        }
+
+        dt = &df->tags[df->tags_number];
+        dt->offset = flv_get_current_tag_offset(stream);
+        dt->timestamp = flv_tag_get_timestamp(tag);
+        dt->body_length = flv_tag_get_body_length(tag);
+        dt->type = tag.type;
+
+        /* a truncated last tag is kept to be reported as a difference */
+        dt->truncated = (flv_hash_tag_body(stream, &dt->hash) != FLV_OK);
+        ++df->tags_number;
+        if (dt->truncated) {
+            break;
+        }
+    }
+
+    flv_close(stream);
+    return OK;
+}
+
+static int diff_tag_equals(const diff_tag * t1, const diff_tag * t2) {
+    return t1->type == t2->type
+        && t1->body_length == t2->body_length
+        && t1->hash == t2->hash
+        && t1->truncated == t2->truncated;
+}
+
+/* check whether the tags at the given indexes start a run of matching tags */
+static int diff_is_run(const diff_file * df1, size_t i, const diff_file * df2, size_t j, long shift, int check_shift) {
+    size_t k;
+
+    if (i >= df1->tags_number || j >= df2->tags_number) {
+        return 0;
+    }
+
+    if (check_shift && (long)df2->tags[j].timestamp - (long)df1->tags[i].timestamp != shift) {
+        return 0;
+    }
+
+    for (k = 0; k < DIFF_RUN_LENGTH && i + k < df1->tags_number && j + k < df2->tags_number; ++k) {
+        if (!diff_tag_equals(&df1->tags[i + k], &df2->tags[j + k])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+    find the nearest resynchronization point after differing tags,
+    returning the number of tags to skip in each file, or zero if none
+*/
+static int diff_resync(const diff_file * df1, size_t i, const diff_file * df2, size_t j,
+    long shift, size_t * skip1, size_t * skip2)
+{
+    size_t k;
+    int check_shift;
+
+    for (check_shift = 1; check_shift >= 0; --check_shift) {
+        for (k = 1; k < DIFF_WINDOW_SIZE; ++k) {
+            /* removed tags */
+            if (diff_is_run(df1, i + k, df2, j, shift, check_shift)) {
+                *skip1 = k;
+                *skip2 = 0;
+                return 1;
+            }
+            /* inserted tags */
+            if (diff_is_run(df1, i, df2, j + k, shift, check_shift)) {
+                *skip1 = 0;
+                *skip2 = k;
+                return 1;
+            }
+            /* changed tags */
+            if (diff_is_run(df1, i + k, df2, j + k, shift, check_shift)) {
+                *skip1 = k;
+                *skip2 = k;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static const char * diff_get_tag_type(const diff_tag * dt) {
+    flv_tag tag;
+    tag.type = dt->type;
+    return dump_string_get_tag_type(&tag);
+}
+
+static const char * diff_get_truncated(const diff_tag * dt) {
+    return dt->truncated ? " (truncated)" : "";
+}
+
+static void diff_print_tag(FILE * out, const char * change, const diff_tag * dt, size_t index) {
+    fprintf(out, "%s tag #%lu: %s, timestamp %u, %u bytes%s, offset %" FILE_OFFSET_PRINTF_FORMAT "u\n",
+        change, (unsigned long)(index + 1), diff_get_tag_type(dt), dt->timestamp, dt->body_length,
+        diff_get_truncated(dt), FILE_OFFSET_PRINTF_TYPE(dt->offset));
+}
+
+/* compare two tag sequences, printing the differences */
+static void diff_compare(const diff_file * df1, const diff_file * df2, diff_stats * stats, int quiet, FILE * out) {
+    size_t i, j, d1, d2, k;
+    long shift, current_shift;
+
+    i = j = 0;
+    current_shift = 0;
+    while (i < df1->tags_number || j < df2->tags_number) {
+        const diff_tag * t1 = (i < df1->tags_number) ? &df1->tags[i] : NULL;
+        const diff_tag * t2 = (j < df2->tags_number) ? &df2->tags[j] : NULL;
+
+        /* identical tags, possibly with a timestamp shift */
+        if (t1 != NULL && t2 != NULL && diff_tag_equals(t1, t2)) {
+            shift = (long)t2->timestamp - (long)t1->timestamp;
+            if (shift != current_shift) {
+                if (!quiet) {
+                    fprintf(out, "shifted tags from #%lu and #%lu: timestamps %+ld ms\n",
+                        (unsigned long)(i + 1), (unsigned long)(j + 1), shift);
+                }
+                current_shift = shift;
+                ++stats->shifts;
+            }
+            ++stats->identical;
+            ++i;
+            ++j;
+            continue;
+        }
+
+        /* trailing tags */
+        if (t2 == NULL) {
+            if (!quiet) {
+                diff_print_tag(out, "removed", t1, i);
+            }
+            ++stats->removed;
+            ++i;
+            continue;
+        }
+        if (t1 == NULL) {
+            if (!quiet) {
+                diff_print_tag(out, "inserted", t2, j);
+            }
+            ++stats->inserted;
+            ++j;
+            continue;
+        }
+
+        /* skip differing tags up to the nearest resynchronization point */
+        if (!diff_resync(df1, i, df2, j, current_shift, &d1, &d2)) {
+            d1 = d2 = 1;
+        }
+
+        for (k = 0; k < d1 && k < d2; ++k, ++i, ++j) {
+            if (!quiet) {
+                fprintf(out, "changed tag #%lu -> #%lu: %s -> %s, timestamp %u -> %u, %u%s -> %u%s bytes\n",
+                    (unsigned long)(i + 1), (unsigned long)(j + 1),
+                    diff_get_tag_type(&df1->tags[i]), diff_get_tag_type(&df2->tags[j]),
+                    df1->tags[i].timestamp, df2->tags[j].timestamp,
+                    df1->tags[i].body_length, diff_get_truncated(&df1->tags[i]),
+                    df2->tags[j].body_length, diff_get_truncated(&df2->tags[j]));
+            }
+            ++stats->changed;
+        }
+        for (; k < d1; ++k, ++i) {
+            if (!quiet) {
+                diff_print_tag(out, "removed", &df1->tags[i], i);
+            }
+            ++stats->removed;
+        }
+        for (; k < d2; ++k, ++j) {
+            if (!quiet) {
+                diff_print_tag(out, "inserted", &df2->tags[j], j);
+            }
+            ++stats->inserted;
+        }
+    }
+}
+
+/* compare two FLV files */
+int diff_flv_files(const flvmeta_opts * options) {
+    diff_file df1, df2;
+    diff_stats stats;
+    int retval;
+
+    memset(&df1, 0, sizeof(diff_file));
+    memset(&df2, 0, sizeof(diff_file));
+    memset(&stats, 0, sizeof(diff_stats));
+
+    retval = diff_read_file(options->input_file, &df1, options->filter);
+    if (retval == OK) {
+        retval = diff_read_file(options->output_file, &df2, options->filter);
+        if (retval == ERROR_OPEN_READ) {
+            retval = ERROR_OPEN_READ_DIFF;
+        }
+    }
+
+    if (retval == OK) {
+        if (!options->quiet) {
+            fprintf(options->out, "--- %s\n+++ %s\n", options->input_file, options->output_file);
+            if (df1.header.version != df2.header.version || df1.header.flags != df2.header.flags) {
+                fprintf(options->out, "changed header: version %u -> %u, flags 0x%02X -> 0x%02X\n",
+                    df1.header.version, df2.header.version, df1.header.flags, df2.header.flags);
+            }
+        }
+
+        diff_compare(&df1, &df2, &stats, options->quiet, options->out);
+
+        if (!options->quiet) {
+            fprintf(options->out, "%lu identical, %lu changed, %lu removed, %lu inserted tags, %lu timestamp shifts\n",
+                (unsigned long)stats.identical, (unsigned long)stats.changed, (unsigned long)stats.removed,
+                (unsigned long)stats.inserted, (unsigned long)stats.shifts);
+        }
+
+        if (stats.changed > 0 || stats.removed > 0 || stats.inserted > 0 || stats.shifts > 0
+        || df1.header.version != df2.header.version || df1.header.flags != df2.header.flags) {
+            retval = FLVMETA_FILES_DIFFER;
+        }
+    }
+
+    free(df1.tags);
+    free(df2.tags);
+    return retval;
+}
@@ -19,12 +19,13 @@
     along with FLVMeta; if not, write to the Free Software
     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 */
-#include "flvmeta.h"
+#include "dump.h"
 #include "dump_json.h"
 #include "dump_raw.h"
 #include "dump_xml.h"
 #include "dump_yaml.h"
 
+#include <stdio.h>
 #include <string.h>
 
 const char * dump_string_get_tag_type(flv_tag * tag) {
@@ -37,7 +38,11 @@ const char * dump_string_get_tag_type(flv_tag * tag) {
 }
 
 const char * dump_string_get_video_codec(flv_video_tag tag) {
-    switch(flv_video_tag_codec_id(&tag)) {
+    return dump_string_get_video_codec_id(flv_video_tag_codec_id(&tag));
+}
+
+const char * dump_string_get_video_codec_id(uint32 codec_id) {
+    switch (codec_id) {
         case FLV_VIDEO_FOURCC_HEVC: return "HEVC";
         case FLV_VIDEO_FOURCC_AV1: return "AV1";
         case FLV_VIDEO_FOURCC_VP9: return "VP9";
@@ -128,7 +133,11 @@ const char * dump_string_get_sound_rate(flv_audio_tag tag) {
 }
 
 const char * dump_string_get_sound_format(flv_audio_tag tag) {
-    switch (flv_audio_tag_sound_format(tag)) {
+    return dump_string_get_sound_format_id(flv_audio_tag_sound_format(tag));
+}
+
+const char * dump_string_get_sound_format_id(uint8 sound_format) {
+    switch (sound_format) {
         case FLV_AUDIO_TAG_SOUND_FORMAT_LINEAR_PCM: return "Linear PCM, platform endian";
         case FLV_AUDIO_TAG_SOUND_FORMAT_ADPCM: return "ADPCM";
         case FLV_AUDIO_TAG_SOUND_FORMAT_MP3: return "MP3";
@@ -155,33 +164,545 @@ const char * dump_string_get_aac_packet_type(flv_aac_packet_type type) {
     }
 }
 
+/* format a tag body hash into a buffer of DUMP_HASH_STRING_SIZE bytes */
+const char * dump_string_get_hash(uint64 hash, char * buffer) {
+    sprintf(buffer, "%08lx%08lx", (unsigned long)(hash >> 32), (unsigned long)(hash & 0xFFFFFFFF));
+    return buffer;
+}
+
+/*
+    return the index of the first requested event matching name whose limit
+    has not been reached yet, or -1 if there is none
+*/
+static int dump_find_event(const flvmeta_opts * options, const char * name, const uint32 * events_count) {
+    size_t i;
+
+    for (i = 0; i < options->metadata_events_number; ++i) {
+        const flvmeta_event * event = &options->metadata_events[i];
+        if (!strcmp(name, event->name) && (event->limit == 0 || events_count[i] < event->limit)) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+/* full dump tag filtering */
+
+#define DUMP_TAG_PENDING    0
+#define DUMP_TAG_ACCEPTED   1
+#define DUMP_TAG_REJECTED   2
+
+typedef struct __dump_filter {
+    const flvmeta_opts * options;
+    flv_parser * target;
+    int tag_state;
+    uint32 * events_count;
+} dump_filter;
+
+static int dump_filter_is_active(const flvmeta_opts * options) {
+    return options->dump_tag_types != FLVMETA_DUMP_TAG_TYPE_ALL
+        || options->dump_keyframes_only
+        || options->dump_start_time > 0
+        || options->dump_end_time != FLVMETA_DUMP_NO_END_TIME
+        || options->dump_start_offset > 0
+        || options->dump_end_offset != FLVMETA_DUMP_NO_END_OFFSET
+        || options->metadata_events_number > 0
+        || options->filter != NULL;
+}
+
+/* evaluate a filter expression on the current tag */
+static int dump_filter_match(flv_tag * tag, file_offset_t offset, flv_stream * stream, const flvmeta_filter * filter) {
+    flvmeta_filter_tag ft;
+    byte body[FLVMETA_FILTER_PEEK_SIZE];
+
+    flvmeta_filter_tag_init(&ft, tag, offset);
+    if (flvmeta_filter_needs_body(filter)) {
+        flvmeta_filter_tag_set_body(&ft, body, flv_peek_tag_body(stream, body, sizeof(body)));
+    }
+    return flvmeta_filter_match(filter, &ft);
+}
+
+/* forward the pending tag to the target parser */
+static int dump_filter_accept(flv_tag * tag, dump_filter * filter, flv_parser * parser) {
+    filter->tag_state = DUMP_TAG_ACCEPTED;
+    filter->target->stream = parser->stream;
+    if (filter->target->on_tag != NULL) {
+        return filter->target->on_tag(tag, filter->target);
+    }
+    return OK;
+}
+
+/* get a named member from an AMF object or associative array */
+static amf_data * dump_filter_object_get(amf_data * data, const char * name) {
+    byte type = amf_data_get_type(data);
+    if (type == AMF_TYPE_OBJECT || type == AMF_TYPE_ASSOCIATIVE_ARRAY) {
+        return amf_object_get(data, name);
+    }
+    return NULL;
+}
+
+/*
+    position the stream on the last indexed keyframe preceding the start
+    of the requested range, using the keyframes object from onMetaData,
+    or on the first tag if no usable index can be found
+*/
+static int dump_filter_seek_start(flv_stream * stream, const flv_header * header, const flvmeta_opts * options) {
+    flv_tag tag;
+    amf_data * name, * data, * keyframes, * times, * filepositions;
+    amf_node * t_node, * f_node;
+    file_offset_t first_tag_offset, seek_offset;
+    number64 seek_time;
+    int have_seek;
+
+    first_tag_offset = flv_header_get_offset(*header) + sizeof(uint32_be);
+    seek_offset = first_tag_offset;
+    seek_time = 0;
+    have_seek = 0;
+
+    if (flv_read_tag(stream, &tag) == FLV_OK && tag.type == FLV_TAG_TYPE_META) {
+        name = data = NULL;
+        if (flv_read_metadata(stream, &name, &data) == FLV_OK
+        && amf_data_get_type(name) == AMF_TYPE_STRING
+        && !strcmp((char *)amf_string_get_bytes(name), "onMetaData")) {
+            keyframes = dump_filter_object_get(data, "keyframes");
+            times = dump_filter_object_get(keyframes, "times");
+            filepositions = dump_filter_object_get(keyframes, "filepositions");
+
+            if (amf_data_get_type(times) == AMF_TYPE_ARRAY
+            && amf_data_get_type(filepositions) == AMF_TYPE_ARRAY) {
+                t_node = amf_array_first(times);
+                f_node = amf_array_first(filepositions);
+
+                /* find the last keyframe preceding either range start */
+                while (t_node != NULL && f_node != NULL) {
+                    number64 time, position;
+
+                    time = amf_number_get_value(amf_array_get(t_node)) * 1000;
+                    position = amf_number_get_value(amf_array_get(f_node));
+
+                    if (time >= (number64)options->dump_start_time
+                    && position > (number64)options->dump_start_offset) {
+                        break;
+                    }
+
+                    if (position >= (number64)first_tag_offset) {
+                        seek_offset = (file_offset_t)position;
+                        seek_time = time;
+                        have_seek = 1;
+                    }
+
+                    t_node = amf_array_next(t_node);
+                    f_node = amf_array_next(f_node);
+                }
+            }
+        }
+        amf_data_free(name);
+        amf_data_free(data);
+    }
+
+    /* make sure the index points to the expected keyframe */
+    if (have_seek) {
+        if (flv_seek_tag(stream, seek_offset) != FLV_OK
+        || flv_read_tag(stream, &tag) != FLV_OK
+        || tag.type != FLV_TAG_TYPE_VIDEO
+        || (number64)flv_tag_get_timestamp(tag) > seek_time + 1
+        || (number64)flv_tag_get_timestamp(tag) + 1 < seek_time) {
+            seek_offset = first_tag_offset;
+        }
+    }
+
+    return flv_seek_tag(stream, seek_offset);
+}
+
+static int dump_filter_on_header(flv_header * header, flv_parser * parser) {
+    dump_filter * filter = (dump_filter *)parser->user_data;
+    int retval;
+
+    filter->target->stream = parser->stream;
+    if (filter->target->on_header != NULL) {
+        retval = filter->target->on_header(header, filter->target);
+        if (retval != OK) {
+            return retval;
+        }
+    }
+
+    if (filter->options->dump_start_time > 0 || filter->options->dump_start_offset > 0) {
+        return dump_filter_seek_start(parser->stream, header, filter->options);
+    }
+    return OK;
+}
+
+static int dump_filter_on_tag(flv_tag * tag, flv_parser * parser) {
+    dump_filter * filter = (dump_filter *)parser->user_data;
+    const flvmeta_opts * options = filter->options;
+    file_offset_t offset = flv_get_current_tag_offset(parser->stream);
+    uint32 timestamp = flv_tag_get_timestamp(*tag);
+    int type_flag;
+    int retval;
+
+    filter->target->tag_body_hash = parser->tag_body_hash;
+
+    /* past the end of the requested range: close the dump and stop parsing */
+    if (timestamp > options->dump_end_time
+    || (options->dump_end_offset != FLVMETA_DUMP_NO_END_OFFSET && offset > options->dump_end_offset)) {
+        filter->target->stream = parser->stream;
+        if (filter->target->on_stream_end != NULL) {
+            retval = filter->target->on_stream_end(filter->target);
+            if (retval != OK) {
+                return retval;
+            }
+        }
+        return FLVMETA_DUMP_STOP_OK;
+    }
+
+    switch (tag->type) {
+        case FLV_TAG_TYPE_AUDIO: type_flag = FLVMETA_DUMP_TAG_TYPE_AUDIO; break;
+        case FLV_TAG_TYPE_VIDEO: type_flag = FLVMETA_DUMP_TAG_TYPE_VIDEO; break;
+        case FLV_TAG_TYPE_META: type_flag = FLVMETA_DUMP_TAG_TYPE_META; break;
+        default: type_flag = FLVMETA_DUMP_TAG_TYPE_OTHER; break;
+    }
+
+    if (timestamp < options->dump_start_time
+    || offset < options->dump_start_offset
+    || !(options->dump_tag_types & type_flag)) {
+        filter->tag_state = DUMP_TAG_REJECTED;
+    }
+    else if (options->filter != NULL && !dump_filter_match(tag, offset, parser->stream, options->filter)) {
+        filter->tag_state = DUMP_TAG_REJECTED;
+    }
+    else {
+        /* the decision may depend on the tag body, so it is deferred */
+        filter->tag_state = DUMP_TAG_PENDING;
+    }
+    return OK;
+}
+
+static int dump_filter_on_audio_tag(flv_tag * tag, flv_audio_tag audio_tag, flv_parser * parser) {
+    dump_filter * filter = (dump_filter *)parser->user_data;
+    int retval;
+
+    if (filter->tag_state == DUMP_TAG_PENDING) {
+        retval = dump_filter_accept(tag, filter, parser);
+        if (retval != OK) {
+            return retval;
+        }
+        if (filter->target->on_audio_tag != NULL) {
+            return filter->target->on_audio_tag(tag, audio_tag, filter->target);
+        }
+    }
+    return OK;
+}
+
+static int dump_filter_on_video_tag(flv_tag * tag, flv_video_tag video_tag, flv_parser * parser) {
+    dump_filter * filter = (dump_filter *)parser->user_data;
+    int retval;
+
+    if (filter->tag_state == DUMP_TAG_PENDING) {
+        if (filter->options->dump_keyframes_only
+        && flv_video_tag_frame_type(&video_tag) != FLV_VIDEO_TAG_FRAME_TYPE_KEYFRAME) {
+            filter->tag_state = DUMP_TAG_REJECTED;
+            return OK;
+        }
+
+        retval = dump_filter_accept(tag, filter, parser);
+        if (retval != OK) {
+            return retval;
+        }
+        if (filter->target->on_video_tag != NULL) {
+            return filter->target->on_video_tag(tag, video_tag, filter->target);
+        }
+    }
+    return OK;
+}
+
+static int dump_filter_on_metadata_tag(flv_tag * tag, char * name, amf_data * data, flv_parser * parser) {
+    dump_filter * filter = (dump_filter *)parser->user_data;
+    int retval;
+
+    if (filter->tag_state == DUMP_TAG_PENDING) {
+        if (filter->options->metadata_events_number > 0) {
+            int index = dump_find_event(filter->options, name, filter->events_count);
+            if (index < 0) {
+                filter->tag_state = DUMP_TAG_REJECTED;
+                return OK;
+            }
+            filter->events_count[index]++;
+        }
+
+        retval = dump_filter_accept(tag, filter, parser);
+        if (retval != OK) {
+            return retval;
+        }
+        if (filter->target->on_metadata_tag != NULL) {
+            return filter->target->on_metadata_tag(tag, name, data, filter->target);
+        }
+    }
+    return OK;
+}
+
+static int dump_filter_on_unknown_tag(flv_tag * tag, flv_parser * parser) {
+    dump_filter * filter = (dump_filter *)parser->user_data;
+    int retval;
+
+    if (filter->tag_state == DUMP_TAG_PENDING) {
+        retval = dump_filter_accept(tag, filter, parser);
+        if (retval != OK) {
+            return retval;
+        }
+        if (filter->target->on_unknown_tag != NULL) {
+            return filter->target->on_unknown_tag(tag, filter->target);
+        }
+    }
+    return OK;
+}
+
+static int dump_filter_on_prev_tag_size(uint32 size, flv_parser * parser) {
+    dump_filter * filter = (dump_filter *)parser->user_data;
+    flv_tag * tag = &parser->stream->current_tag;
+    int retval;
+
+    /* empty tags and invalid metadata never reach the body callbacks */
+    if (filter->tag_state == DUMP_TAG_PENDING) {
+        if ((filter->options->dump_keyframes_only && tag->type == FLV_TAG_TYPE_VIDEO)
+        || (filter->options->metadata_events_number > 0 && tag->type == FLV_TAG_TYPE_META)) {
+            filter->tag_state = DUMP_TAG_REJECTED;
+        }
+        else {
+            retval = dump_filter_accept(tag, filter, parser);
+            if (retval != OK) {
+                return retval;
+            }
+        }
+    }
+
+    if (filter->tag_state == DUMP_TAG_ACCEPTED && filter->target->on_prev_tag_size != NULL) {
+        filter->target->stream = parser->stream;
+        return filter->target->on_prev_tag_size(size, filter->target);
+    }
+    return OK;
+}
+
+static int dump_filter_on_stream_end(flv_parser * parser) {
+    dump_filter * filter = (dump_filter *)parser->user_data;
+
+    if (filter->target->on_stream_end != NULL) {
+        filter->target->stream = parser->stream;
+        return filter->target->on_stream_end(filter->target);
+    }
+    return OK;
+}
+
+/* parse a FLV file for a full dump, applying the tag filters from the options */
+int dump_parse_file(flv_parser * parser, const flvmeta_opts * options) {
+    flv_parser filter_parser;
+    dump_filter filter;
+    int retval;
+
+    parser->hash_tag_bodies = options->dump_hash;
+
+    if (!dump_filter_is_active(options)) {
+        return flv_parse(options->input_file, parser);
+    }
+
+    filter.options = options;
+    filter.target = parser;
+    filter.tag_state = DUMP_TAG_REJECTED;
+    filter.events_count = NULL;
+    if (options->metadata_events_number > 0) {
+        filter.events_count = (uint32 *)calloc(options->metadata_events_number, sizeof(uint32));
+        if (filter.events_count == NULL) {
+            return ERROR_MEMORY;
+        }
+    }
+
+    memset(&filter_parser, 0, sizeof(flv_parser));
+    filter_parser.user_data = &filter;
+    filter_parser.hash_tag_bodies = options->dump_hash;
+    filter_parser.on_header = dump_filter_on_header;
+    filter_parser.on_tag = dump_filter_on_tag;
+    filter_parser.on_audio_tag = dump_filter_on_audio_tag;
+    filter_parser.on_video_tag = dump_filter_on_video_tag;
+    filter_parser.on_metadata_tag = dump_filter_on_metadata_tag;
+    filter_parser.on_unknown_tag = dump_filter_on_unknown_tag;
+    filter_parser.on_prev_tag_size = dump_filter_on_prev_tag_size;
+    filter_parser.on_stream_end = dump_filter_on_stream_end;
+
+    retval = flv_parse(options->input_file, &filter_parser);
+    if (retval == FLVMETA_DUMP_STOP_OK) {
+        retval = OK;
+    }
+
+    free(filter.events_count);
+    return retval;
+}
+
+/* metadata dump state */
+typedef struct __dump_metadata_state {
+    const flvmeta_opts * options;
+    uint32 * events_count;
+    size_t events_pending; /* number of limited events not yet satisfied */
+    int have_unlimited_event;
+    int have_header;
+    amf_data * document; /* payloads keyed by event name, NULL when dumped one by one */
+    amf_data ** payloads; /* payload list of each requested event, shared by equal names */
+} dump_metadata_state;
+
+/*
+    prepare the single document holding the payloads of each requested
+    event, listed in the order of the requested events
+*/
+static int dump_metadata_document_init(dump_metadata_state * state) {
+    const flvmeta_opts * options = state->options;
+    size_t i, j;
+
+    state->document = amf_associative_array_new();
+    state->payloads = (amf_data **)calloc(options->metadata_events_number, sizeof(amf_data *));
+    if (state->document == NULL || state->payloads == NULL) {
+        return ERROR_MEMORY;
+    }
+
+    for (i = 0; i < options->metadata_events_number; ++i) {
+        for (j = 0; j < i; ++j) {
+            if (!strcmp(options->metadata_events[i].name, options->metadata_events[j].name)) {
+                state->payloads[i] = state->payloads[j];
+                break;
+            }
+        }
+
+        if (state->payloads[i] == NULL) {
+            amf_data * list = amf_array_new();
+            if (amf_associative_array_add(state->document, options->metadata_events[i].name, list) == NULL) {
+                amf_data_free(list);
+                return ERROR_MEMORY;
+            }
+            state->payloads[i] = list;
+        }
+    }
+    return OK;
+}
+
+static int dump_on_metadata_header(flv_header * header, flv_parser * parser) {
+    dump_metadata_state * state = (dump_metadata_state *)parser->user_data;
+
+    (void)header;
+    state->have_header = 1;
+    return OK;
+}
+
+static int dump_on_metadata_tag_only(flv_tag * tag, char * name, amf_data * data, flv_parser * parser) {
+    dump_metadata_state * state = (dump_metadata_state *)parser->user_data;
+    const flvmeta_event * event;
+    int index, retval;
+
+    index = dump_find_event(state->options, name, state->events_count);
+    if (index < 0) {
+        return OK;
+    }
+
+    if (state->options->filter != NULL) {
+        flvmeta_filter_tag ft;
+        size_t length = strlen(name);
+
+        flvmeta_filter_tag_init(&ft, tag, flv_get_current_tag_offset(parser->stream));
+        if (length < sizeof(ft.event)) {
+            memcpy(ft.event, name, length + 1);
+            ft.known |= 1 << FLVMETA_FILTER_FIELD_EVENT;
+        }
+        if (!flvmeta_filter_match(state->options->filter, &ft)) {
+            return OK;
+        }
+    }
+
+    if (state->document != NULL) {
+        /* the parser releases the payload after the callback */
+        amf_data * payload = amf_data_clone(data);
+        if (payload == NULL || amf_array_push(state->payloads[index], payload) == NULL) {
+            amf_data_free(payload);
+            return ERROR_MEMORY;
+        }
+    }
+    else {
+        retval = dump_amf_data(data, state->options);
+        if (retval != OK) {
+            return retval;
+        }
+    }
+
+    /* stop as soon as every requested event has reached its limit */
+    event = &state->options->metadata_events[index];
+    if (event->limit > 0 && ++state->events_count[index] == event->limit) {
+        --state->events_pending;
+        if (state->events_pending == 0 && !state->have_unlimited_event) {
+            return FLVMETA_DUMP_STOP_OK;
+        }
+    }
+    return OK;
+}
+
 /* dump metadata from a FLV file */
 int dump_metadata(const flvmeta_opts * options) {
-    int retval;
+    int retval, dump_retval;
+    size_t i;
     flv_parser parser;
-    memset(&parser, 0, sizeof(flv_parser));
-    parser.user_data = (void*)options;
+    dump_metadata_state state;
+    flvmeta_opts default_options;
+    flvmeta_event default_event;
 
-    switch (options->dump_format) {
-        case FLVMETA_FORMAT_JSON:
-            dump_json_setup_metadata_dump(&parser);
-            break;
-        case FLVMETA_FORMAT_RAW:
-            dump_raw_setup_metadata_dump(&parser);
-            break;
-        case FLVMETA_FORMAT_XML:
-            dump_xml_setup_metadata_dump(&parser);
-            break;
-        case FLVMETA_FORMAT_YAML:
-            dump_yaml_setup_metadata_dump(&parser);
-            break;
+    /* dump only the first onMetaData event by default */
+    if (options->metadata_events_number == 0) {
+        default_event.name = "onMetaData";
+        default_event.limit = 1;
+        memcpy(&default_options, options, sizeof(flvmeta_opts));
+        default_options.metadata_events = &default_event;
+        default_options.metadata_events_number = 1;
+        options = &default_options;
     }
 
-    retval = flv_parse(options->input_file, &parser);
-    if (retval == FLVMETA_DUMP_STOP_OK) {
-        retval = FLV_OK;
+    memset(&state, 0, sizeof(dump_metadata_state));
+    state.options = options;
+    state.events_count = (uint32 *)calloc(options->metadata_events_number, sizeof(uint32));
+    if (state.events_count == NULL) {
+        return ERROR_MEMORY;
+    }
+
+    for (i = 0; i < options->metadata_events_number; ++i) {
+        if (options->metadata_events[i].limit > 0) {
+            ++state.events_pending;
+        }
+        else {
+            state.have_unlimited_event = 1;
+        }
+    }
+
+    /* a single payload is dumped as is, several ones as a single document */
+    retval = OK;
+    if (options->metadata_events_number > 1 || options->metadata_events[0].limit != 1) {
+        retval = dump_metadata_document_init(&state);
+    }
+
+    if (retval == OK) {
+        memset(&parser, 0, sizeof(flv_parser));
+        parser.user_data = &state;
+        parser.on_header = dump_on_metadata_header;
+        parser.on_metadata_tag = dump_on_metadata_tag_only;
+
+        retval = flv_parse(options->input_file, &parser);
+        if (retval == FLVMETA_DUMP_STOP_OK) {
+            retval = FLV_OK;
+        }
+
+        /* the events found before a parsing error are dumped as well */
+        if (state.document != NULL && state.have_header && retval != ERROR_MEMORY) {
+            dump_retval = dump_amf_data(state.document, options);
+            if (retval == OK) {
+                retval = dump_retval;
+            }
+        }
     }
 
+    amf_data_free(state.document);
+    free(state.payloads);
+    free(state.events_count);
     return retval;
 }
 
@@ -208,13 +729,13 @@ int dump_flv_file(const flvmeta_opts * options) {
 int dump_amf_data(const amf_data * data, const flvmeta_opts * options) {
     switch (options->dump_format) {
         case FLVMETA_FORMAT_JSON:
-            return dump_json_amf_data(data);
+            return dump_json_amf_data(data, options->out);
         case FLVMETA_FORMAT_RAW:
-            return dump_raw_amf_data(data);
+            return dump_raw_amf_data(data, options->out);
         case FLVMETA_FORMAT_XML:
-            return dump_xml_amf_data(data);
+            return dump_xml_amf_data(data, options->out);
         case FLVMETA_FORMAT_YAML:
-            return dump_yaml_amf_data(data);
+            return dump_yaml_amf_data(data, options->out);
         default:
             return OK;
     }
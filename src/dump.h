@@ -24,6 +24,9 @@
 
 #include "flvmeta.h"
 
+/* size of a tag body hash string, including the terminating null character */
+#define DUMP_HASH_STRING_SIZE 17
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -31,6 +34,7 @@ extern "C" {
 /* common FLV strings */
 const char * dump_string_get_tag_type(flv_tag * tag);
 const char * dump_string_get_video_codec(flv_video_tag tag);
+const char * dump_string_get_video_codec_id(uint32 codec_id);
 const char * dump_string_get_video_frame_type(flv_video_tag tag);
 const char * dump_string_get_avc_packet_type(flv_avc_packet_type type);
 const char * dump_string_get_ext_packet_type(flv_video_tag tag);
@@ -38,7 +42,12 @@ const char * dump_string_get_sound_type(flv_audio_tag tag);
 const char * dump_string_get_sound_size(flv_audio_tag tag);
 const char * dump_string_get_sound_rate(flv_audio_tag tag);
 const char * dump_string_get_sound_format(flv_audio_tag tag);
+const char * dump_string_get_sound_format_id(uint8 sound_format);
 const char * dump_string_get_aac_packet_type(flv_aac_packet_type type);
+const char * dump_string_get_hash(uint64 hash, char * buffer);
+
+/* parse a FLV file for a full dump, applying the tag filters from the options */
+int dump_parse_file(flv_parser * parser, const flvmeta_opts * options);
 
 /* dump metadata from a FLV file */
 int dump_metadata(const flvmeta_opts * options);
@@ -22,8 +22,11 @@
 #include "dump.h"
 #include "dump_json.h"
 #include "json.h"
+#include "pool.h"
+#include "util.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 /* JSON metadata dumping */
@@ -92,11 +95,295 @@ static void json_amf_data_dump(const amf_data * data, json_emitter * je) {
     }
 }
 
+/*
+    JSON FLV file full dump
+
+    Tags are decoded by the parser callbacks into records, which are then
+    formatted either immediately, or by batches on a pool of worker threads,
+    the formatted batches being written to the output in file order.
+*/
+
+/* number of tags formatted by a worker at once */
+#define JSON_DUMP_BATCH_SIZE 1024
+
+/* number of batches queued or being formatted per worker thread */
+#define JSON_DUMP_BATCHES_PER_THREAD 2
+
+/* tag information decoded by the parser */
+typedef struct __json_tag_record {
+    flv_tag tag;
+    file_offset_t offset;
+    byte have_body_hash;
+    uint64 body_hash;
+    byte have_audio_tag;
+    flv_audio_tag audio_tag;
+    byte have_video_tag;
+    flv_video_tag video_tag;
+    byte have_packet_type;
+    byte packet_type;
+    byte have_composition_time;
+    uint32 composition_time;
+    char * metadata_name;
+    amf_data * metadata;
+    byte complete;
+} json_tag_record;
+
+/* batch of tags formatted by a worker thread */
+typedef struct __json_dump_batch {
+    flvmeta_task task;
+    json_tag_record records[JSON_DUMP_BATCH_SIZE];
+    size_t records_number;
+    byte print_comma;
+    flvmeta_buffer output;
+} json_dump_batch;
+
+/* full dump state */
+typedef struct __json_dump {
+    json_emitter je;
+    json_tag_record single_record;
+    json_tag_record * record;
+    byte record_formatted;
+    /* parallel formatting */
+    flvmeta_pool * pool;
+    json_dump_batch * batches;
+    size_t batches_number;
+    size_t first_batch;
+    size_t pending_batches;
+    byte have_tags;
+    int result;
+} json_dump;
+
+static void json_record_init(json_tag_record * record, flv_tag * tag, file_offset_t offset) {
+    memset(record, 0, sizeof(json_tag_record));
+    memcpy(&record->tag, tag, sizeof(flv_tag));
+    record->offset = offset;
+}
+
+static void json_record_free(json_tag_record * record) {
+    free(record->metadata_name);
+    amf_data_free(record->metadata);
+    record->metadata_name = NULL;
+    record->metadata = NULL;
+}
+
+/* format a tag record, stopping where its decoding stopped if incomplete */
+static void json_format_tag(json_emitter * je, const json_tag_record * record) {
+    json_emit_object_start(je);
+    json_emit_object_key_z(je, "type");
+    json_emit_string_z(je, dump_string_get_tag_type((flv_tag *)&record->tag));
+    json_emit_object_key_z(je, "timestamp");
+    json_emit_integer(je, flv_tag_get_timestamp(record->tag));
+    json_emit_object_key_z(je, "dataSize");
+    json_emit_integer(je, flv_tag_get_body_length(record->tag));
+    json_emit_object_key_z(je, "offset");
+    json_emit_file_offset(je, record->offset);
+
+    if (record->have_body_hash) {
+        char hash[DUMP_HASH_STRING_SIZE];
+        json_emit_object_key_z(je, "bodyHash");
+        json_emit_string_z(je, dump_string_get_hash(record->body_hash, hash));
+    }
+
+    if (record->have_audio_tag) {
+        flv_audio_tag at = record->audio_tag;
+
+        json_emit_object_key_z(je, "audioData");
+        json_emit_object_start(je);
+        json_emit_object_key_z(je, "type");
+        json_emit_string_z(je, dump_string_get_sound_type(at));
+        json_emit_object_key_z(je, "size");
+        json_emit_string_z(je, dump_string_get_sound_size(at));
+        json_emit_object_key_z(je, "rate");
+        json_emit_string_z(je, dump_string_get_sound_rate(at));
+        json_emit_object_key_z(je, "format");
+        json_emit_string_z(je, dump_string_get_sound_format(at));
+
+        /* if AAC, detect packet type */
+        if (flv_audio_tag_sound_format(at) == FLV_AUDIO_TAG_SOUND_FORMAT_AAC) {
+            if (!record->have_packet_type) {
+                return;
+            }
+
+            json_emit_object_key_z(je, "AACData");
+
+            json_emit_object_start(je);
+            json_emit_object_key_z(je, "packetType");
+            json_emit_string_z(je, dump_string_get_aac_packet_type(record->packet_type));
+            json_emit_object_end(je);
+        }
+
+        json_emit_object_end(je);
+    }
+    else if (record->have_video_tag) {
+        flv_video_tag vt = record->video_tag;
+
+        json_emit_object_key_z(je, "videoData");
+        json_emit_object_start(je);
+        json_emit_object_key_z(je, "codecID");
+        json_emit_string_z(je, dump_string_get_video_codec(vt));
+        json_emit_object_key_z(je, "frameType");
+        json_emit_string_z(je, dump_string_get_video_frame_type(vt));
+
+        if (flv_video_tag_is_ext_header(&vt)) {
+            json_emit_object_key_z(je, "packetType");
+            json_emit_string_z(je, dump_string_get_ext_packet_type(vt));
+        } else {
+            /* if AVC, detect frame type and composition time */
+            if (flv_video_tag_codec_id(&vt) == FLV_VIDEO_TAG_CODEC_AVC) {
+                if (!record->have_packet_type) {
+                    return;
+                }
+
+                json_emit_object_key_z(je, "AVCData");
+
+                json_emit_object_start(je);
+                json_emit_object_key_z(je, "packetType");
+                json_emit_string_z(je, dump_string_get_avc_packet_type(record->packet_type));
+
+                /* composition time */
+                if (record->packet_type == FLV_AVC_PACKET_TYPE_NALU) {
+                    if (!record->have_composition_time) {
+                        return;
+                    }
+
+                    json_emit_object_key_z(je, "compositionTimeOffset");
+                    json_emit_integer(je, record->composition_time);
+                }
+
+                json_emit_object_end(je);
+            }
+        }
+        json_emit_object_end(je);
+    }
+    else if (record->metadata_name != NULL) {
+        json_emit_object_key_z(je, "scriptDataObject");
+        json_emit_object_start(je);
+        json_emit_object_key_z(je, "name");
+        json_emit_string_z(je, record->metadata_name);
+        json_emit_object_key_z(je, "metadata");
+        json_amf_data_dump(record->metadata, je);
+        json_emit_object_end(je);
+    }
+
+    if (record->complete) {
+        json_emit_object_end(je);
+    }
+}
+
+/* worker task formatting a batch of tags */
+static void json_format_batch(void * data) {
+    json_dump_batch * batch = (json_dump_batch *)data;
+    json_emitter je;
+    size_t i;
+
+    json_emit_init_file(&je, batch->output.stream);
+    je.print_comma = batch->print_comma;
+
+    for (i = 0; i < batch->records_number; ++i) {
+        json_format_tag(&je, &batch->records[i]);
+        json_record_free(&batch->records[i]);
+    }
+}
+
+/* write the oldest pending batch once formatted */
+static void json_dump_write_batch(json_dump * dump) {
+    json_dump_batch * batch = &dump->batches[dump->first_batch];
+
+    flvmeta_pool_wait(dump->pool, &batch->task);
+    if (!flvmeta_buffer_write(&batch->output, dump->je.out) && dump->result == OK) {
+        dump->result = ERROR_WRITE;
+    }
+
+    batch->records_number = 0;
+    dump->first_batch = (dump->first_batch + 1) % dump->batches_number;
+    dump->pending_batches--;
+}
+
+/* current batch being filled by the parser */
+static json_dump_batch * json_dump_current_batch(json_dump * dump) {
+    return &dump->batches[(dump->first_batch + dump->pending_batches) % dump->batches_number];
+}
+
+/* hand the current batch over to the pool, if not empty */
+static int json_dump_submit_batch(json_dump * dump) {
+    json_dump_batch * batch = json_dump_current_batch(dump);
+    size_t i;
+
+    if (batch->records_number == 0) {
+        return OK;
+    }
+
+    if (!flvmeta_buffer_open(&batch->output)) {
+        /* the records will not be formatted */
+        for (i = 0; i < batch->records_number; ++i) {
+            json_record_free(&batch->records[i]);
+        }
+        batch->records_number = 0;
+        return ERROR_MEMORY;
+    }
+
+    batch->print_comma = dump->have_tags;
+    dump->have_tags = 1;
+    dump->pending_batches++;
+    flvmeta_pool_submit(dump->pool, &batch->task, json_format_batch, batch);
+
+    /* wait for the oldest batch if all batches are in use */
+    if (dump->pending_batches == dump->batches_number) {
+        json_dump_write_batch(dump);
+    }
+    return dump->result;
+}
+
+/* format and write all decoded tags */
+static int json_dump_flush(json_dump * dump) {
+    int retval;
+
+    if (dump->pool != NULL) {
+        retval = json_dump_submit_batch(dump);
+        while (dump->pending_batches > 0) {
+            json_dump_write_batch(dump);
+        }
+        if (retval != OK) {
+            return retval;
+        }
+    }
+    else if (dump->record != NULL) {
+        if (!dump->record_formatted) {
+            json_format_tag(&dump->je, dump->record);
+        }
+        else if (dump->record->complete) {
+            json_emit_object_end(&dump->je);
+        }
+        json_record_free(dump->record);
+    }
+    dump->record = NULL;
+    dump->record_formatted = 0;
+    return dump->result;
+}
+
+/* the current record has been completely decoded */
+static int json_dump_end_record(json_dump * dump) {
+    json_dump_batch * batch;
+
+    dump->record->complete = 1;
+
+    if (dump->pool == NULL) {
+        return json_dump_flush(dump);
+    }
+
+    dump->record = NULL;
+    batch = json_dump_current_batch(dump);
+    if (batch->records_number == JSON_DUMP_BATCH_SIZE) {
+        return json_dump_submit_batch(dump);
+    }
+    return OK;
+}
+
 /* JSON FLV file full dump callbacks */
 
 static int json_on_header(flv_header * header, flv_parser * parser) {
     json_emitter * je;
-    je = (json_emitter*)parser->user_data;
+    je = &((json_dump *)parser->user_data)->je;
 
     json_emit_object_start(je);
     json_emit_object_key_z(je, "magic");
@@ -114,86 +401,63 @@ static int json_on_header(flv_header * header, flv_parser * parser) {
 }
 
 static int json_on_tag(flv_tag * tag, flv_parser * parser) {
-    json_emitter * je;
-    je = (json_emitter*)parser->user_data;
+    json_dump * dump;
+    json_dump_batch * batch;
+    dump = (json_dump *)parser->user_data;
 
-    json_emit_object_start(je);
-    json_emit_object_key_z(je, "type");
-    json_emit_string_z(je, dump_string_get_tag_type(tag));
-    json_emit_object_key_z(je, "timestamp");
-    json_emit_integer(je, flv_tag_get_timestamp(*tag));
-    json_emit_object_key_z(je, "dataSize");
-    json_emit_integer(je, flv_tag_get_body_length(*tag));
-    json_emit_object_key_z(je, "offset");
-    json_emit_file_offset(je, parser->stream->current_tag_offset);
+    if (dump->pool != NULL) {
+        batch = json_dump_current_batch(dump);
+        dump->record = &batch->records[batch->records_number++];
+    }
+    else {
+        dump->record = &dump->single_record;
+    }
+    json_record_init(dump->record, tag, parser->stream->current_tag_offset);
+    dump->record->have_body_hash = (byte)parser->hash_tag_bodies;
+    dump->record->body_hash = parser->tag_body_hash;
 
     return OK;
 }
 
 static int json_on_video_tag(flv_tag * tag, flv_video_tag vt, flv_parser * parser) {
-    json_emitter * je;
-    je = (json_emitter*)parser->user_data;
-
-    json_emit_object_key_z(je, "videoData");
-    json_emit_object_start(je);
-    json_emit_object_key_z(je, "codecID");
-    json_emit_string_z(je, dump_string_get_video_codec(vt));
-    json_emit_object_key_z(je, "frameType");
-    json_emit_string_z(je, dump_string_get_video_frame_type(vt));
-
-    if (flv_video_tag_is_ext_header(&vt)) {
-        json_emit_object_key_z(je, "packetType");
-        json_emit_string_z(je, dump_string_get_ext_packet_type(vt));
-    } else {
-        /* if AVC, detect frame type and composition time */
-        if (flv_video_tag_codec_id(&vt) == FLV_VIDEO_TAG_CODEC_AVC) {
-            flv_avc_packet_type type;
-
-            /* packet type */
-            if (flv_read_tag_body(parser->stream, &type, sizeof(flv_avc_packet_type)) < sizeof(flv_avc_packet_type)) {
-                return ERROR_INVALID_TAG;
-            }
+    json_tag_record * record;
+    record = ((json_dump *)parser->user_data)->record;
 
-            json_emit_object_key_z(je, "AVCData");
+    record->have_video_tag = 1;
+    record->video_tag = vt;
 
-            json_emit_object_start(je);
-            json_emit_object_key_z(je, "packetType");
-            json_emit_string_z(je, dump_string_get_avc_packet_type(type));
+    if (!flv_video_tag_is_ext_header(&vt)
+    && flv_video_tag_codec_id(&vt) == FLV_VIDEO_TAG_CODEC_AVC) {
+        flv_avc_packet_type type;
 
-            /* composition time */
-            if (type == FLV_AVC_PACKET_TYPE_NALU) {
-                uint24_be composition_time;
+        /* packet type */
+        if (flv_read_tag_body(parser->stream, &type, sizeof(flv_avc_packet_type)) < sizeof(flv_avc_packet_type)) {
+            return ERROR_INVALID_TAG;
+        }
+        record->have_packet_type = 1;
+        record->packet_type = type;
 
-                if (flv_read_tag_body(parser->stream, &composition_time, sizeof(uint24_be)) < sizeof(uint24_be)) {
-                    return ERROR_INVALID_TAG;
-                }
+        /* composition time */
+        if (type == FLV_AVC_PACKET_TYPE_NALU) {
+            uint24_be composition_time;
 
-                json_emit_object_key_z(je, "compositionTimeOffset");
-                json_emit_integer(je, uint24_be_to_uint32(composition_time));
+            if (flv_read_tag_body(parser->stream, &composition_time, sizeof(uint24_be)) < sizeof(uint24_be)) {
+                return ERROR_INVALID_TAG;
             }
-
-            json_emit_object_end(je);
+            record->have_composition_time = 1;
+            record->composition_time = uint24_be_to_uint32(composition_time);
         }
     }
-    json_emit_object_end(je);
 
     return OK;
 }
 
 static int json_on_audio_tag(flv_tag * tag, flv_audio_tag at, flv_parser * parser) {
-    json_emitter * je;
-    je = (json_emitter*)parser->user_data;
+    json_tag_record * record;
+    record = ((json_dump *)parser->user_data)->record;
 
-    json_emit_object_key_z(je, "audioData");
-    json_emit_object_start(je);
-    json_emit_object_key_z(je, "type");
-    json_emit_string_z(je, dump_string_get_sound_type(at));
-    json_emit_object_key_z(je, "size");
-    json_emit_string_z(je, dump_string_get_sound_size(at));
-    json_emit_object_key_z(je, "rate");
-    json_emit_string_z(je, dump_string_get_sound_rate(at));
-    json_emit_object_key_z(je, "format");
-    json_emit_string_z(je, dump_string_get_sound_format(at));
+    record->have_audio_tag = 1;
+    record->audio_tag = at;
 
     /* if AAC, detect packet type */
     if (flv_audio_tag_sound_format(at) == FLV_AUDIO_TAG_SOUND_FORMAT_AAC) {
@@ -203,84 +467,65 @@ static int json_on_audio_tag(flv_tag * tag, flv_audio_tag at, flv_parser * parse
         if (flv_read_tag_body(parser->stream, &type, sizeof(flv_aac_packet_type)) < sizeof(flv_aac_packet_type)) {
             return ERROR_INVALID_TAG;
         }
-
-        json_emit_object_key_z(je, "AACData");
-
-        json_emit_object_start(je);
-        json_emit_object_key_z(je, "packetType");
-
-        json_emit_string_z(je, dump_string_get_aac_packet_type(type));
-
-        json_emit_object_end(je);
+        record->have_packet_type = 1;
+        record->packet_type = type;
     }
 
-    json_emit_object_end(je);
-
     return OK;
 }
 
 static int json_on_metadata_tag(flv_tag * tag, char * name, amf_data * data, flv_parser * parser) {
-    json_emitter * je;
-    je = (json_emitter*)parser->user_data;
+    json_dump * dump;
+    json_tag_record * record;
+    dump = (json_dump *)parser->user_data;
+    record = dump->record;
+
+    /* formatting is either immediate, or done once the parser has released its data */
+    if (dump->pool == NULL) {
+        record->metadata_name = name;
+        record->metadata = data;
+        json_format_tag(&dump->je, record);
+        record->metadata_name = NULL;
+        record->metadata = NULL;
+        dump->record_formatted = 1;
+        return OK;
+    }
 
-    json_emit_object_key_z(je, "scriptDataObject");
-    json_emit_object_start(je);
-    json_emit_object_key_z(je, "name");
-    json_emit_string_z(je, name);
-    json_emit_object_key_z(je, "metadata");
-    json_amf_data_dump(data, je);
-    json_emit_object_end(je);
+    record->metadata_name = strdup(name);
+    record->metadata = amf_data_clone(data);
+    if (record->metadata_name == NULL || (data != NULL && record->metadata == NULL)) {
+        return ERROR_MEMORY;
+    }
 
     return OK;
 }
 
 static int json_on_prev_tag_size(uint32 size, flv_parser * parser) {
-    json_emitter * je;
-    je = (json_emitter*)parser->user_data;
-
-    json_emit_object_end(je);
+    json_dump * dump;
+    dump = (json_dump *)parser->user_data;
 
-    return OK;
+    return json_dump_end_record(dump);
 }
 
 static int json_on_stream_end(flv_parser * parser) {
-    json_emitter * je;
-    je = (json_emitter*)parser->user_data;
-
-    json_emit_array_end(je);
-    json_emit_object_end(je);
-
-    return OK;
-}
-
-/* JSON FLV file metadata dump callback */
-static int json_on_metadata_tag_only(flv_tag * tag, char * name, amf_data * data, flv_parser * parser) {
-    flvmeta_opts * options = (flvmeta_opts*) parser->user_data;
+    json_dump * dump;
+    int retval;
+    dump = (json_dump *)parser->user_data;
 
-    if (options->metadata_event == NULL) {
-        if (!strcmp(name, "onMetaData")) {
-            dump_json_amf_data(data);
-            return FLVMETA_DUMP_STOP_OK;
-        }
+    retval = json_dump_flush(dump);
+    if (retval != OK) {
+        return retval;
     }
-    else {
-        if (!strcmp(name, options->metadata_event)) {
-            dump_json_amf_data(data);
-        }
-    }
-    return OK;
-}
 
-/* setup dumping */
+    json_emit_array_end(&dump->je);
+    json_emit_object_end(&dump->je);
 
-void dump_json_setup_metadata_dump(flv_parser * parser) {
-    if (parser != NULL) {
-        parser->on_metadata_tag = json_on_metadata_tag_only;
-    }
+    return OK;
 }
 
 int dump_json_file(flv_parser * parser, const flvmeta_opts * options) {
-    json_emitter je;
+    json_dump dump;
+    int retval, flush_retval;
 
     parser->on_header = json_on_header;
     parser->on_tag = json_on_tag;
@@ -290,20 +535,50 @@ int dump_json_file(flv_parser * parser, const flvmeta_opts * options) {
     parser->on_prev_tag_size = json_on_prev_tag_size;
     parser->on_stream_end = json_on_stream_end;
 
-    json_emit_init(&je);
-    parser->user_data = &je;
+    memset(&dump, 0, sizeof(json_dump));
+    json_emit_init_file(&dump.je, options->out);
+    dump.result = OK;
+    parser->user_data = &dump;
+
+    /* format tags on worker threads */
+    if (options->jobs != 1) {
+        dump.pool = flvmeta_pool_new(options->jobs);
+        if (dump.pool == NULL) {
+            return ERROR_MEMORY;
+        }
+
+        dump.batches_number = (size_t)flvmeta_pool_get_threads(dump.pool) * JSON_DUMP_BATCHES_PER_THREAD;
+        dump.batches = (json_dump_batch *)calloc(dump.batches_number, sizeof(json_dump_batch));
+        if (dump.batches == NULL) {
+            flvmeta_pool_free(dump.pool);
+            return ERROR_MEMORY;
+        }
+    }
+
+    retval = dump_parse_file(parser, options);
+
+    /* write what has been decoded if parsing stopped early */
+    flush_retval = json_dump_flush(&dump);
+    if (retval == OK) {
+        retval = flush_retval;
+    }
+
+    if (dump.pool != NULL) {
+        flvmeta_pool_free(dump.pool);
+        free(dump.batches);
+    }
 
-    return flv_parse(options->input_file, parser);
+    return retval;
 }
 
-int dump_json_amf_data(const amf_data * data) {
+int dump_json_amf_data(const amf_data * data, FILE * out) {
     json_emitter je;
-    json_emit_init(&je);
+    json_emit_init_file(&je, out);
 
     /* dump AMF into JSON */
     json_amf_data_dump(data, &je);
 
-    printf("\n");
+    fputc('\n', out);
 
     return OK;
 }
@@ -29,9 +29,8 @@ extern "C" {
 #endif /* __cplusplus */
 
 /* JSON dumping functions */
-void dump_json_setup_metadata_dump(flv_parser * parser);
 int dump_json_file(flv_parser * parser, const flvmeta_opts * options);
-int dump_json_amf_data(const amf_data * data);
+int dump_json_amf_data(const amf_data * data, FILE * out);
 
 #ifdef __cplusplus
 }
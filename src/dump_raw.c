@@ -25,49 +25,54 @@
 #include <stdio.h>
 #include <string.h>
 
+/* raw FLV file full dump state */
+typedef struct __raw_dump_state {
+    FILE * out;
+    uint32 tags; /* current tag number */
+} raw_dump_state;
+
 /* raw FLV file full dump callbacks */
 
 static int raw_on_header(flv_header * header, flv_parser * parser) {
-    int * n;
-
-    n = (int*) malloc(sizeof(uint32));
-    if (n == NULL) {
-        return ERROR_MEMORY;
-    }
-
-    parser->user_data = n;
-    *n = 0;
+    FILE * out = ((raw_dump_state *)parser->user_data)->out;
 
-    printf("Magic: %.3s\n", header->signature);
-    printf("Version: %" PRI_BYTE "u\n", header->version);
-    printf("Has audio: %s\n", flv_header_has_audio(*header) ? "yes" : "no");
-    printf("Has video: %s\n", flv_header_has_video(*header) ? "yes" : "no");
-    printf("Offset: %u\n", swap_uint32(header->offset));
+    fprintf(out, "Magic: %.3s\n", header->signature);
+    fprintf(out, "Version: %" PRI_BYTE "u\n", header->version);
+    fprintf(out, "Has audio: %s\n", flv_header_has_audio(*header) ? "yes" : "no");
+    fprintf(out, "Has video: %s\n", flv_header_has_video(*header) ? "yes" : "no");
+    fprintf(out, "Offset: %u\n", swap_uint32(header->offset));
     return OK;
 }
 
 static int raw_on_tag(flv_tag * tag, flv_parser * parser) {
-    int * n;
+    raw_dump_state * state = (raw_dump_state *)parser->user_data;
+    FILE * out = state->out;
 
     /* increment current tag number */
-    n = ((int*)parser->user_data);
-    ++(*n);
+    ++state->tags;
 
-    printf("--- Tag #%u at 0x%" FILE_OFFSET_PRINTF_FORMAT "X", *n, FILE_OFFSET_PRINTF_TYPE(parser->stream->current_tag_offset));
-    printf(" (%" FILE_OFFSET_PRINTF_FORMAT "u) ---\n", FILE_OFFSET_PRINTF_TYPE(parser->stream->current_tag_offset));
-    printf("Tag type: %s\n", dump_string_get_tag_type(tag));
-    printf("Body length: %u\n", flv_tag_get_body_length(*tag));
-    printf("Timestamp: %u\n", flv_tag_get_timestamp(*tag));
+    fprintf(out, "--- Tag #%u at 0x%" FILE_OFFSET_PRINTF_FORMAT "X", state->tags, FILE_OFFSET_PRINTF_TYPE(parser->stream->current_tag_offset));
+    fprintf(out, " (%" FILE_OFFSET_PRINTF_FORMAT "u) ---\n", FILE_OFFSET_PRINTF_TYPE(parser->stream->current_tag_offset));
+    fprintf(out, "Tag type: %s\n", dump_string_get_tag_type(tag));
+    fprintf(out, "Body length: %u\n", flv_tag_get_body_length(*tag));
+    fprintf(out, "Timestamp: %u\n", flv_tag_get_timestamp(*tag));
+
+    if (parser->hash_tag_bodies) {
+        char hash[DUMP_HASH_STRING_SIZE];
+        fprintf(out, "Body hash: %s\n", dump_string_get_hash(parser->tag_body_hash, hash));
+    }
 
     return OK;
 }
 
 static int raw_on_video_tag(flv_tag * tag, flv_video_tag vt, flv_parser * parser) {
-    printf("* Video codec: %s\n", dump_string_get_video_codec(vt));
-    printf("* Video frame type: %s\n", dump_string_get_video_frame_type(vt));
+    FILE * out = ((raw_dump_state *)parser->user_data)->out;
+
+    fprintf(out, "* Video codec: %s\n", dump_string_get_video_codec(vt));
+    fprintf(out, "* Video frame type: %s\n", dump_string_get_video_frame_type(vt));
 
     if (flv_video_tag_is_ext_header(&vt)) {
-        printf("* Packet type: %s\n", dump_string_get_ext_packet_type(vt));
+        fprintf(out, "* Packet type: %s\n", dump_string_get_ext_packet_type(vt));
     }
     else {
         /* if AVC, detect frame type and composition time */
@@ -79,7 +84,7 @@ static int raw_on_video_tag(flv_tag * tag, flv_video_tag vt, flv_parser * parser
                 return ERROR_INVALID_TAG;
             }
 
-            printf("* AVC packet type: %s\n", dump_string_get_avc_packet_type(type));
+            fprintf(out, "* AVC packet type: %s\n", dump_string_get_avc_packet_type(type));
 
             /* composition time */
             if (type == FLV_AVC_PACKET_TYPE_NALU) {
@@ -89,7 +94,7 @@ static int raw_on_video_tag(flv_tag * tag, flv_video_tag vt, flv_parser * parser
                     return ERROR_INVALID_TAG;
                 }
 
-                printf("* Composition time offset: %i\n", uint24_be_to_uint32(composition_time));
+                fprintf(out, "* Composition time offset: %i\n", uint24_be_to_uint32(composition_time));
             }
         }
     }
@@ -98,10 +103,12 @@ static int raw_on_video_tag(flv_tag * tag, flv_video_tag vt, flv_parser * parser
 }
 
 static int raw_on_audio_tag(flv_tag * tag, flv_audio_tag at, flv_parser * parser) {
-    printf("* Sound type: %s\n", dump_string_get_sound_type(at));
-    printf("* Sound size: %s\n", dump_string_get_sound_size(at));
-    printf("* Sound rate: %s\n", dump_string_get_sound_rate(at));
-    printf("* Sound format: %s\n", dump_string_get_sound_format(at));
+    FILE * out = ((raw_dump_state *)parser->user_data)->out;
+
+    fprintf(out, "* Sound type: %s\n", dump_string_get_sound_type(at));
+    fprintf(out, "* Sound size: %s\n", dump_string_get_sound_size(at));
+    fprintf(out, "* Sound rate: %s\n", dump_string_get_sound_rate(at));
+    fprintf(out, "* Sound format: %s\n", dump_string_get_sound_format(at));
 
     /* if AAC, detect packet type */
     if (flv_audio_tag_sound_format(at) == FLV_AUDIO_TAG_SOUND_FORMAT_AAC) {
@@ -112,70 +119,50 @@ static int raw_on_audio_tag(flv_tag * tag, flv_audio_tag at, flv_parser * parser
             return ERROR_INVALID_TAG;
         }
 
-        printf("* AAC packet type: %s\n", dump_string_get_aac_packet_type(type));
+        fprintf(out, "* AAC packet type: %s\n", dump_string_get_aac_packet_type(type));
     }
 
     return OK;
 }
 
 static int raw_on_metadata_tag(flv_tag * tag, char * name, amf_data * data, flv_parser * parser) {
-    printf("* Metadata event name: %s\n", name);
-    printf("* Metadata contents: ");
-    amf_data_dump(stdout, data, 0);
-    printf("\n");
-    return OK;
-}
+    FILE * out = ((raw_dump_state *)parser->user_data)->out;
 
-static int raw_on_prev_tag_size(uint32 size, flv_parser * parser) {
-    printf("Previous tag size: %u\n", size);
+    fprintf(out, "* Metadata event name: %s\n", name);
+    fprintf(out, "* Metadata contents: ");
+    amf_data_dump(out, data, 0);
+    fprintf(out, "\n");
     return OK;
 }
 
-static int raw_on_stream_end(flv_parser * parser) {
-    free(parser->user_data);
-    return OK;
-}
-
-/* raw FLV file metadata dump callback */
-static int raw_on_metadata_tag_only(flv_tag * tag, char * name, amf_data * data, flv_parser * parser) {
-    flvmeta_opts * options = (flvmeta_opts*) parser->user_data;
+static int raw_on_prev_tag_size(uint32 size, flv_parser * parser) {
+    FILE * out = ((raw_dump_state *)parser->user_data)->out;
 
-    if (options->metadata_event == NULL) {
-        if (!strcmp(name, "onMetaData")) {
-            dump_raw_amf_data(data);
-            return FLVMETA_DUMP_STOP_OK;
-        }
-    }
-    else {
-        if (!strcmp(name, options->metadata_event)) {
-            dump_raw_amf_data(data);
-        }
-    }
+    fprintf(out, "Previous tag size: %u\n", size);
     return OK;
 }
 
 /* setup dumping */
 
-void dump_raw_setup_metadata_dump(flv_parser * parser) {
-    if (parser != NULL) {
-        parser->on_metadata_tag = raw_on_metadata_tag_only;
-    }
-}
-
 int dump_raw_file(flv_parser * parser, const flvmeta_opts * options) {
+    raw_dump_state state;
+
+    state.out = options->out;
+    state.tags = 0;
+
+    parser->user_data = &state;
     parser->on_header = raw_on_header;
     parser->on_tag = raw_on_tag;
     parser->on_audio_tag = raw_on_audio_tag;
     parser->on_video_tag = raw_on_video_tag;
     parser->on_metadata_tag = raw_on_metadata_tag;
     parser->on_prev_tag_size = raw_on_prev_tag_size;
-    parser->on_stream_end = raw_on_stream_end;
 
-    return flv_parse(options->input_file, parser);
+    return dump_parse_file(parser, options);
 }
 
-int dump_raw_amf_data(const amf_data * data) {
-    amf_data_dump(stdout, data, 0);
-    printf("\n");
+int dump_raw_amf_data(const amf_data * data, FILE * out) {
+    amf_data_dump(out, data, 0);
+    fprintf(out, "\n");
     return OK;
 }
@@ -29,9 +29,8 @@ extern "C" {
 #endif /* __cplusplus */
 
 /* raw dumping functions */
-void dump_raw_setup_metadata_dump(flv_parser * parser);
 int dump_raw_file(flv_parser * parser, const flvmeta_opts * options);
-int dump_raw_amf_data(const amf_data * data);
+int dump_raw_amf_data(const amf_data * data, FILE * out);
 
 #ifdef __cplusplus
 }
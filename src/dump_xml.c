@@ -37,7 +37,7 @@ static int has_xml_markers(const char * str, int len) {
 }
 
 /* XML metadata dumping */
-static void xml_amf_data_dump(const amf_data * data, int qualified, int indent_level) {
+static void xml_amf_data_dump(const amf_data * data, int qualified, int indent_level, FILE * out) {
     if (data != NULL) {
         amf_node * node;
         char datestr[128];
@@ -58,93 +58,93 @@ static void xml_amf_data_dump(const amf_data * data, int qualified, int indent_l
         }
 
         /* print indentation spaces */
-        printf("%*s", indent_level * 2, "");
+        fprintf(out, "%*s", indent_level * 2, "");
 
         switch (data->type) {
             case AMF_TYPE_NUMBER:
-                printf("<%snumber%s value=\"%.12g\"/>\n", ns, ns_decl, data->number_data);
+                fprintf(out, "<%snumber%s value=\"%.12g\"/>\n", ns, ns_decl, data->number_data);
                 break;
             case AMF_TYPE_BOOLEAN:
-                printf("<%sboolean%s value=\"%s\"/>\n", ns, ns_decl, (data->boolean_data) ? "true" : "false");
+                fprintf(out, "<%sboolean%s value=\"%s\"/>\n", ns, ns_decl, (data->boolean_data) ? "true" : "false");
                 break;
             case AMF_TYPE_STRING:
                 if (amf_string_get_size(data) > 0) {
-                    printf("<%sstring%s>", ns, ns_decl);
+                    fprintf(out, "<%sstring%s>", ns, ns_decl);
                     /* check whether the string contains xml characters, if so, CDATA it */
                     markers = has_xml_markers((char*)amf_string_get_bytes(data), amf_string_get_size(data));
                     if (markers) {
-                        printf("<![CDATA[");
+                        fprintf(out, "<![CDATA[");
                     }
                     /* do not print more than the actual length of string */
-                    printf("%.*s", (int)amf_string_get_size(data), amf_string_get_bytes(data));
+                    fprintf(out, "%.*s", (int)amf_string_get_size(data), amf_string_get_bytes(data));
                     if (markers) {
-                        printf("]]>");
+                        fprintf(out, "]]>");
                     }
-                    printf("</%sstring>\n", ns);
+                    fprintf(out, "</%sstring>\n", ns);
                 }
                 else {
                     /* simplify empty xml element into a more compact form */
-                    printf("<%sstring%s/>\n", ns, ns_decl);
+                    fprintf(out, "<%sstring%s/>\n", ns, ns_decl);
                 }
                 break;
             case AMF_TYPE_OBJECT:
                 if (amf_object_size(data) > 0) {
-                    printf("<%sobject%s>\n", ns, ns_decl);
+                    fprintf(out, "<%sobject%s>\n", ns, ns_decl);
                     node = amf_object_first(data);
                     while (node != NULL) {
-                        printf("%*s<%sentry name=\"%s\">\n", (indent_level + 1) * 2, "", ns, amf_string_get_bytes(amf_object_get_name(node)));
-                        xml_amf_data_dump(amf_object_get_data(node), qualified, indent_level + 2);
+                        fprintf(out, "%*s<%sentry name=\"%s\">\n", (indent_level + 1) * 2, "", ns, amf_string_get_bytes(amf_object_get_name(node)));
+                        xml_amf_data_dump(amf_object_get_data(node), qualified, indent_level + 2, out);
                         node = amf_object_next(node);
-                        printf("%*s</%sentry>\n", (indent_level + 1) * 2, "", ns);
+                        fprintf(out, "%*s</%sentry>\n", (indent_level + 1) * 2, "", ns);
                     }
-                    printf("%*s</%sobject>\n", indent_level * 2, "", ns);
+                    fprintf(out, "%*s</%sobject>\n", indent_level * 2, "", ns);
                 }
                 else {
                     /* simplify empty xml element into a more compact form */
-                    printf("<%sobject%s/>\n", ns, ns_decl);
+                    fprintf(out, "<%sobject%s/>\n", ns, ns_decl);
                 }
                 break;
             case AMF_TYPE_NULL:
-                printf("<%snull%s/>\n", ns, ns_decl);
+                fprintf(out, "<%snull%s/>\n", ns, ns_decl);
                 break;
             case AMF_TYPE_UNDEFINED:
-                printf("<%sundefined%s/>\n", ns, ns_decl);
+                fprintf(out, "<%sundefined%s/>\n", ns, ns_decl);
                 break;
             case AMF_TYPE_ASSOCIATIVE_ARRAY:
                 if (amf_associative_array_size(data) > 0) {
-                    printf("<%sassociativeArray%s>\n", ns, ns_decl);
+                    fprintf(out, "<%sassociativeArray%s>\n", ns, ns_decl);
                     node = amf_associative_array_first(data);
                     while (node != NULL) {
-                        printf("%*s<%sentry name=\"%s\">\n", (indent_level + 1) * 2, "", ns, amf_string_get_bytes(amf_associative_array_get_name(node)));
-                        xml_amf_data_dump(amf_associative_array_get_data(node), qualified, indent_level + 2);
+                        fprintf(out, "%*s<%sentry name=\"%s\">\n", (indent_level + 1) * 2, "", ns, amf_string_get_bytes(amf_associative_array_get_name(node)));
+                        xml_amf_data_dump(amf_associative_array_get_data(node), qualified, indent_level + 2, out);
                         node = amf_associative_array_next(node);
-                        printf("%*s</%sentry>\n", (indent_level + 1) * 2, "", ns);
+                        fprintf(out, "%*s</%sentry>\n", (indent_level + 1) * 2, "", ns);
                     }
-                    printf("%*s</%sassociativeArray>\n", indent_level * 2, "", ns);
+                    fprintf(out, "%*s</%sassociativeArray>\n", indent_level * 2, "", ns);
                 }
                 else {
                     /* simplify empty xml element into a more compact form */
-                    printf("<%sassociativeArray%s/>\n", ns, ns_decl);
+                    fprintf(out, "<%sassociativeArray%s/>\n", ns, ns_decl);
                 }
                 break;
             case AMF_TYPE_ARRAY:
                 if (amf_array_size(data) > 0) {
-                    printf("<%sarray%s>\n", ns, ns_decl);
+                    fprintf(out, "<%sarray%s>\n", ns, ns_decl);
                     node = amf_array_first(data);
                     while (node != NULL) {
-                        xml_amf_data_dump(amf_array_get(node), qualified, indent_level + 1);
+                        xml_amf_data_dump(amf_array_get(node), qualified, indent_level + 1, out);
                         node = amf_array_next(node);
                     }
-                    printf("%*s</%sarray>\n", indent_level * 2, "", ns);
+                    fprintf(out, "%*s</%sarray>\n", indent_level * 2, "", ns);
                 }
                 else {
                     /* simplify empty xml element into a more compact form */
-                    printf("<%sarray%s/>\n", ns, ns_decl);
+                    fprintf(out, "<%sarray%s/>\n", ns, ns_decl);
                 }
                 break;
             case AMF_TYPE_DATE:
                 amf_date_to_iso8601(data, datestr, sizeof(datestr));
-                printf("<%sdate%s value=\"%s\"/>\n", ns, ns_decl, datestr);
+                fprintf(out, "<%sdate%s value=\"%s\"/>\n", ns, ns_decl, datestr);
                 break;
             case AMF_TYPE_XML: break;
             case AMF_TYPE_CLASS: break;
@@ -156,8 +156,10 @@ static void xml_amf_data_dump(const amf_data * data, int qualified, int indent_l
 /* XML FLV file full dump callbacks */
 
 static int xml_on_header(flv_header * header, flv_parser * parser) {
-    puts("<?xml version=\"1.0\" encoding=\"utf-8\" standalone=\"yes\"?>");
-    printf("<flv xmlns=\"http://schemas.flvmeta.org/FLV/1.0/\" xmlns:amf=\"http://schemas.flvmeta.org/AMF0/1.0/\" hasVideo=\"%s\" hasAudio=\"%s\" version=\"%" PRI_BYTE "u\">\n",
+    FILE * out = (FILE *)parser->user_data;
+
+    fputs("<?xml version=\"1.0\" encoding=\"utf-8\" standalone=\"yes\"?>\n", out);
+    fprintf(out, "<flv xmlns=\"http://schemas.flvmeta.org/FLV/1.0/\" xmlns:amf=\"http://schemas.flvmeta.org/AMF0/1.0/\" hasVideo=\"%s\" hasAudio=\"%s\" version=\"%" PRI_BYTE "u\">\n",
         flv_header_has_video(*header) ? "true" : "false",
         flv_header_has_audio(*header) ? "true" : "false",
         header->version);
@@ -165,36 +167,44 @@ static int xml_on_header(flv_header * header, flv_parser * parser) {
 }
 
 static int xml_on_tag(flv_tag * tag, flv_parser * parser) {
-    printf("  <tag type=\"%s\" timestamp=\"%i\" dataSize=\"%i\"",
+    FILE * out = (FILE *)parser->user_data;
+
+    fprintf(out, "  <tag type=\"%s\" timestamp=\"%i\" dataSize=\"%i\"",
         dump_string_get_tag_type(tag),
         flv_tag_get_timestamp(*tag),
         flv_tag_get_body_length(*tag));
-    printf(" offset=\"%" FILE_OFFSET_PRINTF_FORMAT "u\">\n",
+    if (parser->hash_tag_bodies) {
+        char hash[DUMP_HASH_STRING_SIZE];
+        fprintf(out, " bodyHash=\"%s\"", dump_string_get_hash(parser->tag_body_hash, hash));
+    }
+    fprintf(out, " offset=\"%" FILE_OFFSET_PRINTF_FORMAT "u\">\n",
         FILE_OFFSET_PRINTF_TYPE(parser->stream->current_tag_offset));
 
     return OK;
 }
 
 static int xml_on_video_tag(flv_tag * tag, flv_video_tag vt, flv_parser * parser) {
-    printf("    <videoData codecID=\"%s\"", dump_string_get_video_codec(vt));
-    printf(" frameType=\"%s\"", dump_string_get_video_frame_type(vt));
+    FILE * out = (FILE *)parser->user_data;
+
+    fprintf(out, "    <videoData codecID=\"%s\"", dump_string_get_video_codec(vt));
+    fprintf(out, " frameType=\"%s\"", dump_string_get_video_frame_type(vt));
 
     if (flv_video_tag_is_ext_header(&vt)) {
-        printf(" packetType=\"%s\"", dump_string_get_ext_packet_type(vt));
-        printf("/>\n");
+        fprintf(out, " packetType=\"%s\"", dump_string_get_ext_packet_type(vt));
+        fprintf(out, "/>\n");
     } else {
         /* if AVC, detect frame type and composition time */
         if (flv_video_tag_codec_id(&vt) == FLV_VIDEO_TAG_CODEC_AVC) {
             flv_avc_packet_type type;
 
-            printf(">\n");
+            fprintf(out, ">\n");
 
             /* packet type */
             if (flv_read_tag_body(parser->stream, &type, sizeof(flv_avc_packet_type)) < sizeof(flv_avc_packet_type)) {
                 return ERROR_INVALID_TAG;
             }
 
-            printf("        <AVCData packetType=\"%s\"", dump_string_get_avc_packet_type(type));
+            fprintf(out, "        <AVCData packetType=\"%s\"", dump_string_get_avc_packet_type(type));
 
             /* composition time */
             if (type == FLV_AVC_PACKET_TYPE_NALU) {
@@ -204,90 +214,75 @@ static int xml_on_video_tag(flv_tag * tag, flv_video_tag vt, flv_parser * parser
                     return ERROR_INVALID_TAG;
                 }
 
-                printf(" compositionTimeOffset=\"%i\"", uint24_be_to_uint32(composition_time));
+                fprintf(out, " compositionTimeOffset=\"%i\"", uint24_be_to_uint32(composition_time));
             }
 
-            printf("/>\n");
-            printf("    </videoData>\n");
+            fprintf(out, "/>\n");
+            fprintf(out, "    </videoData>\n");
         }
         else {
-            printf("/>\n");
+            fprintf(out, "/>\n");
         }
     }
     return OK;
 }
 
 static int xml_on_audio_tag(flv_tag * tag, flv_audio_tag at, flv_parser * parser) {
-    printf("    <audioData type=\"%s\"", dump_string_get_sound_type(at));
-    printf(" size=\"%s\"", dump_string_get_sound_size(at));
-    printf(" rate=\"%s\"", dump_string_get_sound_rate(at));
-    printf(" format=\"%s\"", dump_string_get_sound_format(at));
+    FILE * out = (FILE *)parser->user_data;
+
+    fprintf(out, "    <audioData type=\"%s\"", dump_string_get_sound_type(at));
+    fprintf(out, " size=\"%s\"", dump_string_get_sound_size(at));
+    fprintf(out, " rate=\"%s\"", dump_string_get_sound_rate(at));
+    fprintf(out, " format=\"%s\"", dump_string_get_sound_format(at));
 
     /* if AAC, detect packet type */
     if (flv_audio_tag_sound_format(at) == FLV_AUDIO_TAG_SOUND_FORMAT_AAC) {
         flv_aac_packet_type type;
 
-        printf(">\n");
+        fprintf(out, ">\n");
 
         /* packet type */
         if (flv_read_tag_body(parser->stream, &type, sizeof(flv_aac_packet_type)) < sizeof(flv_aac_packet_type)) {
             return ERROR_INVALID_TAG;
         }
 
-        printf("        <AACData packetType=\"%s\"/>\n", dump_string_get_aac_packet_type(type));
-        printf("    </audioData>\n");
+        fprintf(out, "        <AACData packetType=\"%s\"/>\n", dump_string_get_aac_packet_type(type));
+        fprintf(out, "    </audioData>\n");
     }
     else {
-        printf("/>\n");
+        fprintf(out, "/>\n");
     }
 
     return OK;
 }
 
 static int xml_on_metadata_tag(flv_tag * tag, char * name, amf_data * data, flv_parser * parser) {
-    printf("    <scriptDataObject name=\"%s\">\n", name);
+    FILE * out = (FILE *)parser->user_data;
+
+    fprintf(out, "    <scriptDataObject name=\"%s\">\n", name);
     /* dump AMF data as XML, we start from level 3, meaning 6 indentations characters */
-    xml_amf_data_dump(data, 1, 3);
-    puts("    </scriptDataObject>");
+    xml_amf_data_dump(data, 1, 3, out);
+    fputs("    </scriptDataObject>\n", out);
     return OK;
 }
 
 static int xml_on_prev_tag_size(uint32 size, flv_parser * parser) {
-    puts("  </tag>");
-    return OK;
-}
+    FILE * out = (FILE *)parser->user_data;
 
-static int xml_on_stream_end(flv_parser * parser) {
-    puts("</flv>");
+    fputs("  </tag>\n", out);
     return OK;
 }
 
-/* XML FLV file metadata dump callbacks */
-static int xml_on_metadata_tag_only(flv_tag * tag, char * name, amf_data * data, flv_parser * parser) {
-    flvmeta_opts * options = (flvmeta_opts*) parser->user_data;
+static int xml_on_stream_end(flv_parser * parser) {
+    FILE * out = (FILE *)parser->user_data;
 
-    if (options->metadata_event == NULL) {
-        if (!strcmp(name, "onMetaData")) {
-            dump_xml_amf_data(data);
-            return FLVMETA_DUMP_STOP_OK;
-        }
-    }
-    else {
-        if (!strcmp(name, options->metadata_event)) {
-            dump_xml_amf_data(data);
-        }
-    }
+    fputs("</flv>\n", out);
     return OK;
 }
 
 /* dumping functions */
-void dump_xml_setup_metadata_dump(flv_parser * parser) {
-    if (parser != NULL) {
-        parser->on_metadata_tag = xml_on_metadata_tag_only;
-    }
-}
-
 int dump_xml_file(flv_parser * parser, const flvmeta_opts * options) {
+    parser->user_data = options->out;
     parser->on_header = xml_on_header;
     parser->on_tag = xml_on_tag;
     parser->on_audio_tag = xml_on_audio_tag;
@@ -296,11 +291,11 @@ int dump_xml_file(flv_parser * parser, const flvmeta_opts * options) {
     parser->on_prev_tag_size = xml_on_prev_tag_size;
     parser->on_stream_end = xml_on_stream_end;
 
-    return flv_parse(options->input_file, parser);
+    return dump_parse_file(parser, options);
 }
 
-int dump_xml_amf_data(const amf_data * data) {
-    puts("<?xml version=\"1.0\" encoding=\"utf-8\" standalone=\"yes\"?>");
-    xml_amf_data_dump(data, 0, 0);
+int dump_xml_amf_data(const amf_data * data, FILE * out) {
+    fputs("<?xml version=\"1.0\" encoding=\"utf-8\" standalone=\"yes\"?>\n", out);
+    xml_amf_data_dump(data, 0, 0, out);
     return OK;
 }
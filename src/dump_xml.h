@@ -29,9 +29,8 @@ extern "C" {
 #endif /* __cplusplus */
 
 /* XML dumping functions */
-void dump_xml_setup_metadata_dump(flv_parser * parser);
 int dump_xml_file(flv_parser * parser, const flvmeta_opts * options);
-int dump_xml_amf_data(const amf_data * data);
+int dump_xml_amf_data(const amf_data * data, FILE * out);
 
 #ifdef __cplusplus
 }
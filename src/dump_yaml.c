@@ -208,6 +208,16 @@ static int yaml_on_tag(flv_tag * tag, flv_parser * parser) {
     yaml_scalar_event_initialize(&event, NULL, NULL, (yaml_char_t*)buffer, (int)strlen(buffer), 1, 1, YAML_ANY_SCALAR_STYLE);
     yaml_emitter_emit(emitter, &event);
 
+    /* body hash */
+    if (parser->hash_tag_bodies) {
+        yaml_scalar_event_initialize(&event, NULL, NULL, (yaml_char_t*)"bodyHash", 8, 1, 1, YAML_ANY_SCALAR_STYLE);
+        yaml_emitter_emit(emitter, &event);
+
+        dump_string_get_hash(parser->tag_body_hash, buffer);
+        yaml_scalar_event_initialize(&event, NULL, NULL, (yaml_char_t*)buffer, (int)strlen(buffer), 1, 1, YAML_DOUBLE_QUOTED_SCALAR_STYLE);
+        yaml_emitter_emit(emitter, &event);
+    }
+
     return OK;
 }
 
@@ -418,31 +428,7 @@ static int yaml_on_stream_end(flv_parser * parser) {
     return OK;
 }
 
-/* YAML FLV file metadata dump callbacks */
-static int yaml_on_metadata_tag_only(flv_tag * tag, char * name, amf_data * data, flv_parser * parser) {
-    flvmeta_opts * options = (flvmeta_opts*) parser->user_data;
-
-    if (options->metadata_event == NULL) {
-        if (!strcmp(name, "onMetaData")) {
-            dump_yaml_amf_data(data);
-            return FLVMETA_DUMP_STOP_OK;
-        }
-    }
-    else {
-        if (!strcmp(name, options->metadata_event)) {
-            dump_yaml_amf_data(data);
-        }
-    }
-    return OK;
-}
-
 /* dumping functions */
-void dump_yaml_setup_metadata_dump(flv_parser * parser) {
-    if (parser != NULL) {
-        parser->on_metadata_tag = yaml_on_metadata_tag_only;
-    }
-}
-
 int dump_yaml_file(flv_parser * parser, const flvmeta_opts * options) {
     yaml_emitter_t emitter;
     yaml_event_t event;
@@ -457,7 +443,7 @@ int dump_yaml_file(flv_parser * parser, const flvmeta_opts * options) {
     parser->on_stream_end = yaml_on_stream_end;
 
     yaml_emitter_initialize(&emitter);
-    yaml_emitter_set_output_file(&emitter, stdout);
+    yaml_emitter_set_output_file(&emitter, options->out);
     yaml_emitter_open(&emitter);
 
     yaml_document_start_event_initialize(&event, NULL, NULL, NULL, 0);
@@ -465,7 +451,7 @@ int dump_yaml_file(flv_parser * parser, const flvmeta_opts * options) {
 
     parser->user_data = &emitter;
 
-    ret = flv_parse(options->input_file, parser);
+    ret = dump_parse_file(parser, options);
 
     yaml_document_end_event_initialize(&event, 1);
     yaml_emitter_emit(&emitter, &event);
@@ -477,12 +463,12 @@ int dump_yaml_file(flv_parser * parser, const flvmeta_opts * options) {
     return ret;
 }
 
-int dump_yaml_amf_data(const amf_data * data) {
+int dump_yaml_amf_data(const amf_data * data, FILE * out) {
     yaml_emitter_t emitter;
     yaml_event_t event;
 
     yaml_emitter_initialize(&emitter);
-    yaml_emitter_set_output_file(&emitter, stdout);
+    yaml_emitter_set_output_file(&emitter, out);
     yaml_emitter_open(&emitter);
 
     yaml_document_start_event_initialize(&event, NULL, NULL, NULL, 0);
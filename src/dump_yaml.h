@@ -29,9 +29,8 @@ extern "C" {
 #endif /* __cplusplus */
 
 /* YAML dumping functions */
-void dump_yaml_setup_metadata_dump(flv_parser * parser);
 int dump_yaml_file(flv_parser * parser, const flvmeta_opts * options);
-int dump_yaml_amf_data(const amf_data * data);
+int dump_yaml_amf_data(const amf_data * data, FILE * out);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,585 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "amf.h"
+#include "filter.h"
+
+/* maximum nesting of the evaluation stack */
+#define FILTER_MAX_DEPTH 64
+
+/* opcodes */
+#define FILTER_OP_COMPARE   0
+#define FILTER_OP_TEST      1
+#define FILTER_OP_NOT       2
+#define FILTER_OP_AND       3
+#define FILTER_OP_OR        4
+
+/* tokens */
+#define FILTER_TOKEN_END        0
+#define FILTER_TOKEN_IDENTIFIER 1
+#define FILTER_TOKEN_NUMBER     2
+#define FILTER_TOKEN_STRING     3
+#define FILTER_TOKEN_EQ         4
+#define FILTER_TOKEN_NE         5
+#define FILTER_TOKEN_LT         6
+#define FILTER_TOKEN_LE         7
+#define FILTER_TOKEN_GT         8
+#define FILTER_TOKEN_GE         9
+#define FILTER_TOKEN_AND        10
+#define FILTER_TOKEN_OR         11
+#define FILTER_TOKEN_NOT        12
+#define FILTER_TOKEN_LPAREN     13
+#define FILTER_TOKEN_RPAREN     14
+#define FILTER_TOKEN_ERROR      15
+
+/* audio codecs are distinguished from video codecs by this offset */
+#define FILTER_AUDIO_CODEC(format) (0x100 + (format))
+
+/* field bitmask of the fields decoded from the tag body */
+#define FILTER_BODY_FIELDS ( \
+    (1 << FLVMETA_FILTER_FIELD_CODEC) \
+    | (1 << FLVMETA_FILTER_FIELD_FRAME) \
+    | (1 << FLVMETA_FILTER_FIELD_KEYFRAME) \
+    | (1 << FLVMETA_FILTER_FIELD_PACKET) \
+    | (1 << FLVMETA_FILTER_FIELD_EVENT))
+
+typedef struct __filter_instruction {
+    int opcode;
+    int field;
+    int comparison; /* comparison token */
+    uint64 value;
+    char * string;
+} filter_instruction;
+
+struct __flvmeta_filter {
+    filter_instruction * code;
+    size_t code_size;
+    size_t code_capacity;
+    int fields; /* bitmask of the fields used */
+};
+
+/* field names */
+typedef struct __filter_field_name {
+    const char * name;
+    int field;
+} filter_field_name;
+
+static const filter_field_name filter_fields[] = {
+    { "type",       FLVMETA_FILTER_FIELD_TYPE },
+    { "ts",         FLVMETA_FILTER_FIELD_TIMESTAMP },
+    { "timestamp",  FLVMETA_FILTER_FIELD_TIMESTAMP },
+    { "size",       FLVMETA_FILTER_FIELD_SIZE },
+    { "offset",     FLVMETA_FILTER_FIELD_OFFSET },
+    { "codec",      FLVMETA_FILTER_FIELD_CODEC },
+    { "frame",      FLVMETA_FILTER_FIELD_FRAME },
+    { "keyframe",   FLVMETA_FILTER_FIELD_KEYFRAME },
+    { "packet",     FLVMETA_FILTER_FIELD_PACKET },
+    { "event",      FLVMETA_FILTER_FIELD_EVENT },
+    { NULL, 0 }
+};
+
+/* symbolic field values */
+typedef struct __filter_constant {
+    int field;
+    const char * name;
+    uint64 value;
+} filter_constant;
+
+static const filter_constant filter_constants[] = {
+    { FLVMETA_FILTER_FIELD_TYPE,    "audio",        FLV_TAG_TYPE_AUDIO },
+    { FLVMETA_FILTER_FIELD_TYPE,    "video",        FLV_TAG_TYPE_VIDEO },
+    { FLVMETA_FILTER_FIELD_TYPE,    "script",       FLV_TAG_TYPE_META },
+    { FLVMETA_FILTER_FIELD_TYPE,    "scriptData",   FLV_TAG_TYPE_META },
+    { FLVMETA_FILTER_FIELD_CODEC,   "JPEG",         FLV_VIDEO_TAG_CODEC_JPEG },
+    { FLVMETA_FILTER_FIELD_CODEC,   "H263",         FLV_VIDEO_TAG_CODEC_SORENSEN_H263 },
+    { FLVMETA_FILTER_FIELD_CODEC,   "SCREEN",       FLV_VIDEO_TAG_CODEC_SCREEN_VIDEO },
+    { FLVMETA_FILTER_FIELD_CODEC,   "VP6",          FLV_VIDEO_TAG_CODEC_ON2_VP6 },
+    { FLVMETA_FILTER_FIELD_CODEC,   "VP6A",         FLV_VIDEO_TAG_CODEC_ON2_VP6_ALPHA },
+    { FLVMETA_FILTER_FIELD_CODEC,   "SCREEN2",      FLV_VIDEO_TAG_CODEC_SCREEN_VIDEO_V2 },
+    { FLVMETA_FILTER_FIELD_CODEC,   "AVC",          FLV_VIDEO_TAG_CODEC_AVC },
+    { FLVMETA_FILTER_FIELD_CODEC,   "HEVC",         FLV_VIDEO_FOURCC_HEVC },
+    { FLVMETA_FILTER_FIELD_CODEC,   "AV1",          FLV_VIDEO_FOURCC_AV1 },
+    { FLVMETA_FILTER_FIELD_CODEC,   "VP9",          FLV_VIDEO_FOURCC_VP9 },
+    { FLVMETA_FILTER_FIELD_CODEC,   "PCM",          FILTER_AUDIO_CODEC(FLV_AUDIO_TAG_SOUND_FORMAT_LINEAR_PCM) },
+    { FLVMETA_FILTER_FIELD_CODEC,   "ADPCM",        FILTER_AUDIO_CODEC(FLV_AUDIO_TAG_SOUND_FORMAT_ADPCM) },
+    { FLVMETA_FILTER_FIELD_CODEC,   "MP3",          FILTER_AUDIO_CODEC(FLV_AUDIO_TAG_SOUND_FORMAT_MP3) },
+    { FLVMETA_FILTER_FIELD_CODEC,   "PCMLE",        FILTER_AUDIO_CODEC(FLV_AUDIO_TAG_SOUND_FORMAT_LINEAR_PCM_LE) },
+    { FLVMETA_FILTER_FIELD_CODEC,   "NELLYMOSER16", FILTER_AUDIO_CODEC(FLV_AUDIO_TAG_SOUND_FORMAT_NELLYMOSER_16_MONO) },
+    { FLVMETA_FILTER_FIELD_CODEC,   "NELLYMOSER8",  FILTER_AUDIO_CODEC(FLV_AUDIO_TAG_SOUND_FORMAT_NELLYMOSER_8_MONO) },
+    { FLVMETA_FILTER_FIELD_CODEC,   "NELLYMOSER",   FILTER_AUDIO_CODEC(FLV_AUDIO_TAG_SOUND_FORMAT_NELLYMOSER) },
+    { FLVMETA_FILTER_FIELD_CODEC,   "G711A",        FILTER_AUDIO_CODEC(FLV_AUDIO_TAG_SOUND_FORMAT_G711_A) },
+    { FLVMETA_FILTER_FIELD_CODEC,   "G711U",        FILTER_AUDIO_CODEC(FLV_AUDIO_TAG_SOUND_FORMAT_G711_MU) },
+    { FLVMETA_FILTER_FIELD_CODEC,   "AAC",          FILTER_AUDIO_CODEC(FLV_AUDIO_TAG_SOUND_FORMAT_AAC) },
+    { FLVMETA_FILTER_FIELD_CODEC,   "SPEEX",        FILTER_AUDIO_CODEC(FLV_AUDIO_TAG_SOUND_FORMAT_SPEEX) },
+    { FLVMETA_FILTER_FIELD_CODEC,   "MP38K",        FILTER_AUDIO_CODEC(FLV_AUDIO_TAG_SOUND_FORMAT_MP3_8) },
+    { FLVMETA_FILTER_FIELD_CODEC,   "DEVICE",       FILTER_AUDIO_CODEC(FLV_AUDIO_TAG_SOUND_FORMAT_DEVICE_SPECIFIC) },
+    { FLVMETA_FILTER_FIELD_FRAME,   "keyframe",     FLV_VIDEO_TAG_FRAME_TYPE_KEYFRAME },
+    { FLVMETA_FILTER_FIELD_FRAME,   "inter",        FLV_VIDEO_TAG_FRAME_TYPE_INTERFRAME },
+    { FLVMETA_FILTER_FIELD_FRAME,   "disposable",   FLV_VIDEO_TAG_FRAME_TYPE_DISPOSABLE_INTERFRAME },
+    { FLVMETA_FILTER_FIELD_FRAME,   "generated",    FLV_VIDEO_TAG_FRAME_TYPE_GENERATED_KEYFRAME },
+    { FLVMETA_FILTER_FIELD_FRAME,   "command",      FLV_VIDEO_TAG_FRAME_TYPE_COMMAND_FRAME },
+    { FLVMETA_FILTER_FIELD_PACKET,  "seqhdr",       FLV_AVC_PACKET_TYPE_SEQUENCE_HEADER },
+    { FLVMETA_FILTER_FIELD_PACKET,  "frame",        FLV_AVC_PACKET_TYPE_NALU },
+    { FLVMETA_FILTER_FIELD_PACKET,  "nalu",         FLV_AVC_PACKET_TYPE_NALU },
+    { FLVMETA_FILTER_FIELD_PACKET,  "raw",          FLV_AAC_PACKET_TYPE_RAW },
+    { FLVMETA_FILTER_FIELD_PACKET,  "eos",          FLV_AVC_PACKET_TYPE_SEQUENCE_END },
+    { FLVMETA_FILTER_FIELD_PACKET,  "metadata",     FLV_VIDEO_TAG_PACKET_TYPE_METADATA },
+    { 0, NULL, 0 }
+};
+
+/* expression compiler state */
+typedef struct __filter_compiler {
+    const char * expression;
+    const char * position;
+    int token;
+    const char * token_start;
+    size_t token_length;
+    uint64 number;
+    int depth;
+    flvmeta_filter * filter;
+} filter_compiler;
+
+static int filter_strncasecmp(const char * s1, const char * s2, size_t n) {
+    size_t i;
+    for (i = 0; i < n; ++i) {
+        int c1 = tolower((unsigned char)s1[i]);
+        int c2 = tolower((unsigned char)s2[i]);
+        if (c1 != c2 || c1 == 0) {
+            return c1 - c2;
+        }
+    }
+    return 0;
+}
+
+/* whether the current token is the given name, ignoring case */
+static int filter_token_is(const filter_compiler * fc, const char * name) {
+    return strlen(name) == fc->token_length && !filter_strncasecmp(fc->token_start, name, fc->token_length);
+}
+
+static void filter_next_token(filter_compiler * fc) {
+    const char * p = fc->position;
+
+    while (isspace((unsigned char)*p)) {
+        ++p;
+    }
+
+    fc->token_start = p;
+    if (*p == 0) {
+        fc->token = FILTER_TOKEN_END;
+    }
+    else if (isalpha((unsigned char)*p) || *p == '_') {
+        while (isalnum((unsigned char)*p) || *p == '_') {
+            ++p;
+        }
+        fc->token = FILTER_TOKEN_IDENTIFIER;
+    }
+    else if (isdigit((unsigned char)*p)) {
+        fc->number = 0;
+        fc->token = FILTER_TOKEN_NUMBER;
+        while (isdigit((unsigned char)*p)) {
+            if (fc->number > ((uint64)-1 - 9) / 10) {
+                fc->token = FILTER_TOKEN_ERROR;
+            }
+            fc->number = fc->number * 10 + (uint64)(*p - '0');
+            ++p;
+        }
+    }
+    else if (*p == '"' || *p == '\'') {
+        const char * end = strchr(p + 1, *p);
+        if (end == NULL) {
+            fc->token = FILTER_TOKEN_ERROR;
+        }
+        else {
+            fc->token = FILTER_TOKEN_STRING;
+            p = end + 1;
+        }
+    }
+    else if (p[0] == '=' && p[1] == '=') { fc->token = FILTER_TOKEN_EQ; p += 2; }
+    else if (p[0] == '!' && p[1] == '=') { fc->token = FILTER_TOKEN_NE; p += 2; }
+    else if (p[0] == '<' && p[1] == '=') { fc->token = FILTER_TOKEN_LE; p += 2; }
+    else if (p[0] == '>' && p[1] == '=') { fc->token = FILTER_TOKEN_GE; p += 2; }
+    else if (p[0] == '&' && p[1] == '&') { fc->token = FILTER_TOKEN_AND; p += 2; }
+    else if (p[0] == '|' && p[1] == '|') { fc->token = FILTER_TOKEN_OR; p += 2; }
+    else if (*p == '<') { fc->token = FILTER_TOKEN_LT; ++p; }
+    else if (*p == '>') { fc->token = FILTER_TOKEN_GT; ++p; }
+    else if (*p == '!') { fc->token = FILTER_TOKEN_NOT; ++p; }
+    else if (*p == '(') { fc->token = FILTER_TOKEN_LPAREN; ++p; }
+    else if (*p == ')') { fc->token = FILTER_TOKEN_RPAREN; ++p; }
+    else {
+        fc->token = FILTER_TOKEN_ERROR;
+    }
+
+    if (fc->token == FILTER_TOKEN_ERROR) {
+        fc->position = fc->token_start;
+        fc->token_length = 0;
+    }
+    else {
+        fc->position = p;
+        fc->token_length = (size_t)(p - fc->token_start);
+    }
+}
+
+/* append an instruction to the program */
+static filter_instruction * filter_emit(filter_compiler * fc, int opcode) {
+    flvmeta_filter * filter = fc->filter;
+    filter_instruction * instruction;
+
+    if (filter->code_size == filter->code_capacity) {
+        size_t capacity = (filter->code_capacity > 0) ? filter->code_capacity * 2 : 16;
+        instruction = (filter_instruction *)realloc(filter->code, capacity * sizeof(filter_instruction));
+        if (instruction == NULL) {
+            return NULL;
+        }
+        filter->code = instruction;
+        filter->code_capacity = capacity;
+    }
+
+    instruction = &filter->code[filter->code_size++];
+    memset(instruction, 0, sizeof(filter_instruction));
+    instruction->opcode = opcode;
+
+    /* keep track of the evaluation stack depth */
+    if (opcode == FILTER_OP_COMPARE || opcode == FILTER_OP_TEST) {
+        if (++fc->depth > FILTER_MAX_DEPTH) {
+            filter->code_size--;
+            return NULL;
+        }
+    }
+    else if (opcode == FILTER_OP_AND || opcode == FILTER_OP_OR) {
+        --fc->depth;
+    }
+
+    return instruction;
+}
+
+static int filter_compile_or(filter_compiler * fc);
+
+/* comparison of a field with a value */
+static int filter_compile_comparison(filter_compiler * fc, int field) {
+    filter_instruction * instruction;
+    const filter_constant * constant;
+    int comparison;
+
+    comparison = fc->token;
+    filter_next_token(fc);
+
+    instruction = filter_emit(fc, FILTER_OP_COMPARE);
+    if (instruction == NULL) {
+        return 0;
+    }
+    instruction->field = field;
+    instruction->comparison = comparison;
+
+    /* event names are compared as strings */
+    if (field == FLVMETA_FILTER_FIELD_EVENT) {
+        const char * start = fc->token_start;
+        size_t length = fc->token_length;
+
+        if (comparison != FILTER_TOKEN_EQ && comparison != FILTER_TOKEN_NE) {
+            return 0;
+        }
+        if (fc->token == FILTER_TOKEN_STRING) {
+            ++start;
+            length -= 2;
+        }
+        else if (fc->token != FILTER_TOKEN_IDENTIFIER) {
+            return 0;
+        }
+
+        instruction->string = (char *)malloc(length + 1);
+        if (instruction->string == NULL) {
+            return 0;
+        }
+        memcpy(instruction->string, start, length);
+        instruction->string[length] = 0;
+        filter_next_token(fc);
+        return 1;
+    }
+
+    if (fc->token == FILTER_TOKEN_NUMBER) {
+        instruction->value = fc->number;
+        filter_next_token(fc);
+        return 1;
+    }
+
+    if (fc->token == FILTER_TOKEN_IDENTIFIER) {
+        for (constant = filter_constants; constant->name != NULL; ++constant) {
+            if (constant->field == field && filter_token_is(fc, constant->name)) {
+                instruction->value = constant->value;
+                filter_next_token(fc);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int filter_compile_unary(filter_compiler * fc) {
+    const filter_field_name * field;
+
+    if (fc->token == FILTER_TOKEN_NOT) {
+        filter_next_token(fc);
+        return filter_compile_unary(fc) && filter_emit(fc, FILTER_OP_NOT) != NULL;
+    }
+
+    if (fc->token == FILTER_TOKEN_LPAREN) {
+        filter_next_token(fc);
+        if (!filter_compile_or(fc) || fc->token != FILTER_TOKEN_RPAREN) {
+            return 0;
+        }
+        filter_next_token(fc);
+        return 1;
+    }
+
+    if (fc->token != FILTER_TOKEN_IDENTIFIER) {
+        return 0;
+    }
+
+    for (field = filter_fields; field->name != NULL; ++field) {
+        if (filter_token_is(fc, field->name)) {
+            break;
+        }
+    }
+    if (field->name == NULL) {
+        return 0;
+    }
+
+    fc->filter->fields |= 1 << field->field;
+    filter_next_token(fc);
+
+    switch (fc->token) {
+        case FILTER_TOKEN_EQ:
+        case FILTER_TOKEN_NE:
+        case FILTER_TOKEN_LT:
+        case FILTER_TOKEN_LE:
+        case FILTER_TOKEN_GT:
+        case FILTER_TOKEN_GE:
+            return filter_compile_comparison(fc, field->field);
+        default:
+            {
+                /* a field alone is true when it applies to the tag and is not zero */
+                filter_instruction * instruction = filter_emit(fc, FILTER_OP_TEST);
+                if (instruction == NULL) {
+                    return 0;
+                }
+                instruction->field = field->field;
+                return 1;
+            }
+    }
+}
+
+static int filter_compile_and(filter_compiler * fc) {
+    if (!filter_compile_unary(fc)) {
+        return 0;
+    }
+    while (fc->token == FILTER_TOKEN_AND) {
+        filter_next_token(fc);
+        if (!filter_compile_unary(fc) || filter_emit(fc, FILTER_OP_AND) == NULL) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int filter_compile_or(filter_compiler * fc) {
+    if (!filter_compile_and(fc)) {
+        return 0;
+    }
+    while (fc->token == FILTER_TOKEN_OR) {
+        filter_next_token(fc);
+        if (!filter_compile_and(fc) || filter_emit(fc, FILTER_OP_OR) == NULL) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+flvmeta_filter * flvmeta_filter_compile(const char * expression, size_t * error_position) {
+    filter_compiler fc;
+
+    fc.filter = (flvmeta_filter *)calloc(1, sizeof(flvmeta_filter));
+    if (fc.filter == NULL) {
+        *error_position = 0;
+        return NULL;
+    }
+
+    fc.expression = expression;
+    fc.position = expression;
+    fc.depth = 0;
+    filter_next_token(&fc);
+
+    if (!filter_compile_or(&fc) || fc.token != FILTER_TOKEN_END) {
+        *error_position = (size_t)(fc.token_start - expression);
+        flvmeta_filter_free(fc.filter);
+        return NULL;
+    }
+
+    return fc.filter;
+}
+
+int flvmeta_filter_needs_body(const flvmeta_filter * filter) {
+    return (filter->fields & FILTER_BODY_FIELDS) != 0;
+}
+
+static int filter_compare(const filter_instruction * instruction, const flvmeta_filter_tag * tag) {
+    uint64 value;
+
+    /* fields not applying to the tag are only different from anything */
+    if (!(tag->known & (1 << instruction->field))) {
+        return instruction->comparison == FILTER_TOKEN_NE;
+    }
+
+    if (instruction->field == FLVMETA_FILTER_FIELD_EVENT) {
+        int equal = !strcmp(tag->event, instruction->string);
+        return (instruction->comparison == FILTER_TOKEN_EQ) ? equal : !equal;
+    }
+
+    value = tag->values[instruction->field];
+    switch (instruction->comparison) {
+        case FILTER_TOKEN_EQ: return value == instruction->value;
+        case FILTER_TOKEN_NE: return value != instruction->value;
+        case FILTER_TOKEN_LT: return value < instruction->value;
+        case FILTER_TOKEN_LE: return value <= instruction->value;
+        case FILTER_TOKEN_GT: return value > instruction->value;
+        case FILTER_TOKEN_GE: return value >= instruction->value;
+        default: return 0;
+    }
+}
+
+int flvmeta_filter_match(const flvmeta_filter * filter, const flvmeta_filter_tag * tag) {
+    byte stack[FILTER_MAX_DEPTH];
+    const filter_instruction * instruction;
+    size_t i;
+    int top;
+
+    top = -1;
+    for (i = 0; i < filter->code_size; ++i) {
+        instruction = &filter->code[i];
+        switch (instruction->opcode) {
+            case FILTER_OP_COMPARE:
+                stack[++top] = (byte)filter_compare(instruction, tag);
+                break;
+            case FILTER_OP_TEST:
+                if (instruction->field == FLVMETA_FILTER_FIELD_EVENT) {
+                    stack[++top] = (byte)((tag->known & (1 << instruction->field)) && tag->event[0] != 0);
+                }
+                else {
+                    stack[++top] = (byte)((tag->known & (1 << instruction->field)) && tag->values[instruction->field] != 0);
+                }
+                break;
+            case FILTER_OP_NOT:
+                stack[top] = (byte)!stack[top];
+                break;
+            case FILTER_OP_AND:
+                --top;
+                stack[top] = (byte)(stack[top] && stack[top + 1]);
+                break;
+            case FILTER_OP_OR:
+                --top;
+                stack[top] = (byte)(stack[top] || stack[top + 1]);
+                break;
+        }
+    }
+    return stack[0];
+}
+
+void flvmeta_filter_free(flvmeta_filter * filter) {
+    size_t i;
+
+    if (filter != NULL) {
+        for (i = 0; i < filter->code_size; ++i) {
+            free(filter->code[i].string);
+        }
+        free(filter->code);
+        free(filter);
+    }
+}
+
+/* tag fields */
+
+static void filter_tag_set(flvmeta_filter_tag * ft, int field, uint64 value) {
+    ft->values[field] = value;
+    ft->known |= 1 << field;
+}
+
+void flvmeta_filter_tag_init(flvmeta_filter_tag * ft, const flv_tag * tag, file_offset_t offset) {
+    ft->known = 0;
+    ft->event[0] = 0;
+    filter_tag_set(ft, FLVMETA_FILTER_FIELD_TYPE, tag->type);
+    filter_tag_set(ft, FLVMETA_FILTER_FIELD_TIMESTAMP, flv_tag_get_timestamp(*tag));
+    filter_tag_set(ft, FLVMETA_FILTER_FIELD_SIZE, flv_tag_get_body_length(*tag));
+    filter_tag_set(ft, FLVMETA_FILTER_FIELD_OFFSET, (uint64)offset);
+}
+
+void flvmeta_filter_tag_set_body(flvmeta_filter_tag * ft, const byte * body, size_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    if (ft->values[FLVMETA_FILTER_FIELD_TYPE] == FLV_TAG_TYPE_AUDIO) {
+        int format = flv_audio_tag_sound_format(body[0]);
+
+        filter_tag_set(ft, FLVMETA_FILTER_FIELD_CODEC, FILTER_AUDIO_CODEC(format));
+        if (format == FLV_AUDIO_TAG_SOUND_FORMAT_AAC && size > 1) {
+            filter_tag_set(ft, FLVMETA_FILTER_FIELD_PACKET, body[1]);
+        }
+    }
+    else if (ft->values[FLVMETA_FILTER_FIELD_TYPE] == FLV_TAG_TYPE_VIDEO) {
+        int frame_type = (body[0] & 0x70) >> 4;
+
+        filter_tag_set(ft, FLVMETA_FILTER_FIELD_FRAME, frame_type);
+        filter_tag_set(ft, FLVMETA_FILTER_FIELD_KEYFRAME, frame_type == FLV_VIDEO_TAG_FRAME_TYPE_KEYFRAME);
+
+        /* extended header: packet type and FourCC */
+        if (body[0] & 0x80) {
+            int packet_type = body[0] & 0x0F;
+
+            if (packet_type == FLV_VIDEO_TAG_PACKET_TYPE_CODED_FRAMES_X) {
+                packet_type = FLV_VIDEO_TAG_PACKET_TYPE_CODED_FRAMES;
+            }
+            filter_tag_set(ft, FLVMETA_FILTER_FIELD_PACKET, packet_type);
+            if (size >= 1 + FLV_VIDEO_FOURCC_SIZE) {
+                filter_tag_set(ft, FLVMETA_FILTER_FIELD_CODEC, FOURCC(body[1], body[2], body[3], body[4]));
+            }
+        }
+        else {
+            filter_tag_set(ft, FLVMETA_FILTER_FIELD_CODEC, body[0] & 0x0F);
+            if ((body[0] & 0x0F) == FLV_VIDEO_TAG_CODEC_AVC && size > 1) {
+                filter_tag_set(ft, FLVMETA_FILTER_FIELD_PACKET, body[1]);
+            }
+        }
+    }
+    else if (ft->values[FLVMETA_FILTER_FIELD_TYPE] == FLV_TAG_TYPE_META) {
+        /* event name as an AMF string */
+        if (size >= 3 && body[0] == AMF_TYPE_STRING) {
+            size_t length = ((size_t)body[1] << 8) | body[2];
+            if (length < sizeof(ft->event) && 3 + length <= size) {
+                memcpy(ft->event, body + 3, length);
+                ft->event[length] = 0;
+                ft->known |= 1 << FLVMETA_FILTER_FIELD_EVENT;
+            }
+        }
+    }
+}
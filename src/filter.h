@@ -0,0 +1,88 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#ifndef __FILTER_H__
+#define __FILTER_H__
+
+#include "flv.h"
+
+/**
+    Tag filter expressions.
+
+    An expression such as "type==video && keyframe && ts>=60000" is compiled
+    once into a postfix program, which is then evaluated against the fields
+    of each tag, decoded from the tag header and the first bytes of its body.
+
+    Fields: type, ts (or timestamp), size, offset, codec, frame, keyframe,
+    packet, and event (script data event name).
+    Operators: == != < <= > >= && || ! and parentheses.
+*/
+
+/* number of body bytes needed to decode every field */
+#define FLVMETA_FILTER_PEEK_SIZE 64
+
+/* filter fields */
+#define FLVMETA_FILTER_FIELD_TYPE       0
+#define FLVMETA_FILTER_FIELD_TIMESTAMP  1
+#define FLVMETA_FILTER_FIELD_SIZE       2
+#define FLVMETA_FILTER_FIELD_OFFSET     3
+#define FLVMETA_FILTER_FIELD_CODEC      4
+#define FLVMETA_FILTER_FIELD_FRAME      5
+#define FLVMETA_FILTER_FIELD_KEYFRAME   6
+#define FLVMETA_FILTER_FIELD_PACKET     7
+#define FLVMETA_FILTER_FIELD_EVENT      8
+#define FLVMETA_FILTER_FIELDS_NUMBER    9
+
+/* tag fields as seen by filters */
+typedef struct __flvmeta_filter_tag {
+    uint64 values[FLVMETA_FILTER_FIELDS_NUMBER];
+    int known; /* bitmask of the fields applying to the tag */
+    char event[FLVMETA_FILTER_PEEK_SIZE];
+} flvmeta_filter_tag;
+
+typedef struct __flvmeta_filter flvmeta_filter;
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* compile an expression, returning NULL and the position of the error on failure */
+flvmeta_filter * flvmeta_filter_compile(const char * expression, size_t * error_position);
+
+/* whether the filter uses fields decoded from the tag body */
+int flvmeta_filter_needs_body(const flvmeta_filter * filter);
+
+/* evaluate the filter on a tag */
+int flvmeta_filter_match(const flvmeta_filter * filter, const flvmeta_filter_tag * tag);
+
+void flvmeta_filter_free(flvmeta_filter * filter);
+
+/* initialize the tag fields from its header */
+void flvmeta_filter_tag_init(flvmeta_filter_tag * ft, const flv_tag * tag, file_offset_t offset);
+
+/* decode the tag fields from the first bytes of its body */
+void flvmeta_filter_tag_set_body(flvmeta_filter_tag * ft, const byte * body, size_t size);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __FILTER_H__ */
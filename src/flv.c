@@ -20,9 +20,13 @@
     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 */
 #include "flv.h"
+#include "hash.h"
 
 #include <string.h>
 
+/* size of the buffer used to hash tag bodies */
+#define FLV_HASH_BUFFER_SIZE 16384
+
 void flv_tag_set_timestamp(flv_tag * tag, uint32 timestamp) {
     tag->timestamp = uint32_to_uint24_be(timestamp);
     tag->timestamp_extended = (uint8)((timestamp & 0xFF000000) >> 24);
@@ -48,6 +52,28 @@ uint32_be flv_video_tag_codec_id(flv_video_tag * tag) {
 }
 
 /* FLV stream functions */
+
+/* read from the stream file, updating the I/O counters */
+size_t flv_stream_read(flv_stream * stream, void * buffer, size_t size, size_t count) {
+    size_t items_number;
+
+    items_number = fread(buffer, size, count, stream->flvin);
+    stream->bytes_read += items_number * size;
+    ++(stream->reads);
+    return items_number;
+}
+
+/* seek into the stream file, updating the I/O counters */
+int flv_stream_seek(flv_stream * stream, file_offset_t offset, int whence) {
+    ++(stream->seeks);
+    return lfs_fseek(stream->flvin, offset, whence);
+}
+
+/* callback function to read AMF data from the stream */
+static size_t flv_stream_amf_read(void * out_buffer, size_t size, void * user_data) {
+    return flv_stream_read((flv_stream *)user_data, out_buffer, sizeof(byte), size);
+}
+
 flv_stream * flv_open(const char * file) {
     flv_stream * stream = (flv_stream *) malloc(sizeof(flv_stream));
     if (stream == NULL) {
@@ -61,7 +87,11 @@ flv_stream * flv_open(const char * file) {
     stream->current_tag_body_length = 0;
     stream->current_tag_body_overflow = 0;
     stream->current_tag_offset = 0;
+    stream->data_offset = FLV_HEADER_SIZE;
     stream->state = FLV_STREAM_STATE_START;
+    stream->bytes_read = 0;
+    stream->reads = 0;
+    stream->seeks = 0;
     return stream;
 }
 
@@ -73,10 +103,10 @@ int flv_read_header(flv_stream * stream, flv_header * header) {
         return FLV_ERROR_EOF;
     }
 
-    if (fread(&header->signature, sizeof(header->signature), 1, stream->flvin) == 0
-    || fread(&header->version, sizeof(header->version), 1, stream->flvin) == 0
-    || fread(&header->flags, sizeof(header->flags), 1, stream->flvin) == 0
-    || fread(&header->offset, sizeof(header->offset), 1, stream->flvin) == 0) {
+    if (flv_stream_read(stream, &header->signature, sizeof(header->signature), 1) == 0
+    || flv_stream_read(stream, &header->version, sizeof(header->version), 1) == 0
+    || flv_stream_read(stream, &header->flags, sizeof(header->flags), 1) == 0
+    || flv_stream_read(stream, &header->offset, sizeof(header->offset), 1) == 0) {
         return FLV_ERROR_EOF;
     }
 
@@ -86,6 +116,11 @@ int flv_read_header(flv_stream * stream, flv_header * header) {
         return FLV_ERROR_NO_FLV;
     }
 
+    /* the tags may start after extra header data */
+    if (flv_header_get_offset(*header) > FLV_HEADER_SIZE) {
+        stream->data_offset = flv_header_get_offset(*header);
+    }
+
     stream->state = FLV_STREAM_STATE_PREV_TAG_SIZE;
     return FLV_OK;
 }
@@ -100,12 +135,12 @@ int flv_read_prev_tag_size(flv_stream * stream, uint32 * prev_tag_size) {
 
     /* skip remaining tag body bytes */
     if (stream->state == FLV_STREAM_STATE_TAG_BODY) {
-        lfs_fseek(stream->flvin, stream->current_tag_offset + FLV_TAG_SIZE + uint24_be_to_uint32(stream->current_tag.body_length), SEEK_SET);
+        flv_stream_seek(stream, stream->current_tag_offset + FLV_TAG_SIZE + uint24_be_to_uint32(stream->current_tag.body_length), SEEK_SET);
         stream->state = FLV_STREAM_STATE_PREV_TAG_SIZE;
     }
 
     if (stream->state == FLV_STREAM_STATE_PREV_TAG_SIZE) {
-        if (fread(&val, sizeof(uint32_be), 1, stream->flvin) == 0) {
+        if (flv_stream_read(stream, &val, sizeof(uint32_be), 1) == 0) {
             return FLV_ERROR_EOF;
         }
         else {
@@ -119,6 +154,23 @@ int flv_read_prev_tag_size(flv_stream * stream, uint32 * prev_tag_size) {
     }
 }
 
+/* read a tag header at the current position, then position the stream at its body */
+static int flv_read_tag_header(flv_stream * stream, flv_tag * tag) {
+    if (flv_stream_read(stream, &tag->type, sizeof(tag->type), 1) == 0
+    || flv_stream_read(stream, &tag->body_length, sizeof(tag->body_length), 1) == 0
+    || flv_stream_read(stream, &tag->timestamp, sizeof(tag->timestamp), 1) == 0
+    || flv_stream_read(stream, &tag->timestamp_extended, sizeof(tag->timestamp_extended), 1) == 0
+    || flv_stream_read(stream, &tag->stream_id, sizeof(tag->stream_id), 1) == 0) {
+        return FLV_ERROR_EOF;
+    }
+
+    memcpy(&stream->current_tag, tag, sizeof(flv_tag));
+    stream->current_tag_body_length = uint24_be_to_uint32(tag->body_length);
+    stream->current_tag_body_overflow = 0;
+    stream->state = FLV_STREAM_STATE_TAG_BODY;
+    return FLV_OK;
+}
+
 int flv_read_tag(flv_stream * stream, flv_tag * tag) {
     if (stream == NULL
     || stream->flvin == NULL
@@ -128,45 +180,99 @@ int flv_read_tag(flv_stream * stream, flv_tag * tag) {
 
     /* skip header */
     if (stream->state == FLV_STREAM_STATE_START) {
-        lfs_fseek(stream->flvin, FLV_HEADER_SIZE, SEEK_CUR);
+        flv_stream_seek(stream, FLV_HEADER_SIZE, SEEK_CUR);
         stream->state = FLV_STREAM_STATE_PREV_TAG_SIZE;
     }
 
     /* skip current tag body */
     if (stream->state == FLV_STREAM_STATE_TAG_BODY) {
-        lfs_fseek(stream->flvin, stream->current_tag_offset + FLV_TAG_SIZE + uint24_be_to_uint32(stream->current_tag.body_length), SEEK_SET);
+        flv_stream_seek(stream, stream->current_tag_offset + FLV_TAG_SIZE + uint24_be_to_uint32(stream->current_tag.body_length), SEEK_SET);
         stream->state = FLV_STREAM_STATE_PREV_TAG_SIZE;
     }
 
     /* skip previous tag size */
     if (stream->state == FLV_STREAM_STATE_PREV_TAG_SIZE) {
-        lfs_fseek(stream->flvin, sizeof(uint32_be), SEEK_CUR);
+        flv_stream_seek(stream, sizeof(uint32_be), SEEK_CUR);
         stream->state = FLV_STREAM_STATE_TAG;
     }
 
     if (stream->state == FLV_STREAM_STATE_TAG) {
         stream->current_tag_offset = lfs_ftell(stream->flvin);
-
-        if (fread(&tag->type, sizeof(tag->type), 1, stream->flvin) == 0
-        || fread(&tag->body_length, sizeof(tag->body_length), 1, stream->flvin) == 0
-        || fread(&tag->timestamp, sizeof(tag->timestamp), 1, stream->flvin) == 0
-        || fread(&tag->timestamp_extended, sizeof(tag->timestamp_extended), 1, stream->flvin) == 0
-        || fread(&tag->stream_id, sizeof(tag->stream_id), 1, stream->flvin) == 0) {
-            return FLV_ERROR_EOF;
-        }
-        else {
-            memcpy(&stream->current_tag, tag, sizeof(flv_tag));
-            stream->current_tag_body_length = uint24_be_to_uint32(tag->body_length);
-            stream->current_tag_body_overflow = 0;
-            stream->state = FLV_STREAM_STATE_TAG_BODY;
-            return FLV_OK;
-        }
+        return flv_read_tag_header(stream, tag);
     }
     else {
         return FLV_ERROR_EOF;
     }
 }
 
+/* position the stream at the end of the file to read its tags backwards */
+int flv_seek_end(flv_stream * stream) {
+    if (stream == NULL || stream->flvin == NULL) {
+        return FLV_ERROR_EOF;
+    }
+
+    if (flv_stream_seek(stream, 0, SEEK_END) != 0) {
+        return FLV_ERROR_EOF;
+    }
+
+    stream->current_tag_offset = lfs_ftell(stream->flvin);
+    stream->current_tag_body_length = 0;
+    stream->current_tag_body_overflow = 0;
+    stream->state = FLV_STREAM_STATE_TAG;
+    return FLV_OK;
+}
+
+/*
+    read the tag preceding the current tag, or the last tag of the file
+    after flv_seek_end(), located using the previous tag size stored just
+    before the current tag, then position the stream at its body; the
+    first tag is found using the header offset once the header is read
+*/
+int flv_read_prev_tag(flv_stream * stream, flv_tag * tag) {
+    uint32_be val;
+    uint32 prev_tag_size;
+    file_offset_t end, offset;
+
+    if (stream == NULL
+    || stream->flvin == NULL
+    || stream->state == FLV_STREAM_STATE_START) {
+        return FLV_ERROR_EOF;
+    }
+
+    /* reached the first tag */
+    end = stream->current_tag_offset;
+    if (end <= stream->data_offset + sizeof(uint32_be)) {
+        return FLV_ERROR_EOF;
+    }
+
+    if (flv_stream_seek(stream, end - sizeof(uint32_be), SEEK_SET) != 0
+    || flv_stream_read(stream, &val, sizeof(uint32_be), 1) == 0) {
+        return FLV_ERROR_EOF;
+    }
+
+    prev_tag_size = swap_uint32(val);
+    if (prev_tag_size < FLV_TAG_SIZE
+    || prev_tag_size > end - sizeof(uint32_be) - stream->data_offset - sizeof(uint32_be)) {
+        return FLV_ERROR_INVALID_PREV_TAG_SIZE;
+    }
+
+    offset = end - sizeof(uint32_be) - prev_tag_size;
+    if (flv_stream_seek(stream, offset, SEEK_SET) != 0) {
+        return FLV_ERROR_EOF;
+    }
+
+    stream->current_tag_offset = offset;
+    if (flv_read_tag_header(stream, tag) != FLV_OK) {
+        return FLV_ERROR_EOF;
+    }
+
+    /* the previous tag size must match the tag */
+    if (FLV_TAG_SIZE + flv_tag_get_body_length(*tag) != prev_tag_size) {
+        return FLV_ERROR_INVALID_PREV_TAG_SIZE;
+    }
+    return FLV_OK;
+}
+
 int flv_read_audio_tag(flv_stream * stream, flv_audio_tag * tag) {
     if (stream == NULL
     || stream->flvin == NULL
@@ -179,7 +285,7 @@ int flv_read_audio_tag(flv_stream * stream, flv_audio_tag * tag) {
         return FLV_ERROR_EMPTY_TAG;
     }
 
-    if (fread(tag, sizeof(flv_audio_tag), 1, stream->flvin) == 0) {
+    if (flv_stream_read(stream, tag, sizeof(flv_audio_tag), 1) == 0) {
         return FLV_ERROR_EOF;
     }
 
@@ -194,7 +300,7 @@ int flv_read_audio_tag(flv_stream * stream, flv_audio_tag * tag) {
     if (stream->current_tag_body_length == 0) {
         stream->state = FLV_STREAM_STATE_PREV_TAG_SIZE;
         if (stream->current_tag_body_overflow > 0) {
-            lfs_fseek(stream->flvin, -(file_offset_t)stream->current_tag_body_overflow, SEEK_CUR);
+            flv_stream_seek(stream, -(file_offset_t)stream->current_tag_body_overflow, SEEK_CUR);
         }
     }
 
@@ -223,7 +329,7 @@ int flv_read_video_tag(flv_stream * stream, flv_video_tag * tag) {
             return FLV_ERROR_EMPTY_TAG;
         }
 
-        if (fread(tag, sizeof(byte), 1, stream->flvin) == 0) {
+        if (flv_stream_read(stream, tag, sizeof(byte), 1) == 0) {
             return FLV_ERROR_EOF;
         }
 
@@ -238,7 +344,7 @@ int flv_read_video_tag(flv_stream * stream, flv_video_tag * tag) {
         if (stream->current_tag_body_length == 0) {
             stream->state = FLV_STREAM_STATE_PREV_TAG_SIZE;
             if (stream->current_tag_body_overflow > 0) {
-                lfs_fseek(stream->flvin, -(file_offset_t)stream->current_tag_body_overflow, SEEK_CUR);
+                flv_stream_seek(stream, -(file_offset_t)stream->current_tag_body_overflow, SEEK_CUR);
             }
         }
 
@@ -271,7 +377,7 @@ int flv_read_metadata(flv_stream * stream, amf_data ** name, amf_data ** data) {
     }
 
     /* read metadata name */
-    d = amf_data_file_read(stream->flvin);
+    d = amf_data_read(flv_stream_amf_read, stream);
     *name = d;
     error_code = amf_data_get_error_code(d);
     if (error_code == AMF_ERROR_EOF) {
@@ -292,14 +398,14 @@ int flv_read_metadata(flv_stream * stream, amf_data ** name, amf_data ** data) {
 
         stream->state = FLV_STREAM_STATE_PREV_TAG_SIZE;
         if (stream->current_tag_body_overflow > 0) {
-            lfs_fseek(stream->flvin, -(file_offset_t)stream->current_tag_body_overflow, SEEK_CUR);
+            flv_stream_seek(stream, -(file_offset_t)stream->current_tag_body_overflow, SEEK_CUR);
         }
 
         return FLV_ERROR_INVALID_METADATA;
     }
 
     /* read metadata contents */
-    d = amf_data_file_read(stream->flvin);
+    d = amf_data_read(flv_stream_amf_read, stream);
     *data = d;
     error_code = amf_data_get_error_code(d);
     if (error_code == AMF_ERROR_EOF) {
@@ -321,7 +427,7 @@ int flv_read_metadata(flv_stream * stream, amf_data ** name, amf_data ** data) {
     if (stream->current_tag_body_length == 0) {
         stream->state = FLV_STREAM_STATE_PREV_TAG_SIZE;
         if (stream->current_tag_body_overflow > 0) {
-            lfs_fseek(stream->flvin, -(file_offset_t)stream->current_tag_body_overflow, SEEK_CUR);
+            flv_stream_seek(stream, -(file_offset_t)stream->current_tag_body_overflow, SEEK_CUR);
         }
     }
 
@@ -339,7 +445,7 @@ size_t flv_read_tag_body(flv_stream * stream, void * buffer, size_t buffer_size)
     }
 
     bytes_number = (buffer_size > stream->current_tag_body_length) ? stream->current_tag_body_length : buffer_size;
-    bytes_number = fread(buffer, sizeof(byte), bytes_number, stream->flvin);
+    bytes_number = flv_stream_read(stream, buffer, sizeof(byte), bytes_number);
 
     stream->current_tag_body_length -= (uint32)bytes_number;
 
@@ -350,6 +456,51 @@ size_t flv_read_tag_body(flv_stream * stream, void * buffer, size_t buffer_size)
     return bytes_number;
 }
 
+/* hash the remaining tag body, leaving the stream at the next previous tag size */
+int flv_hash_tag_body(flv_stream * stream, uint64 * hash) {
+    byte buffer[FLV_HASH_BUFFER_SIZE];
+    xxh64_state state;
+    size_t bytes_number;
+
+    if (stream == NULL || stream->state != FLV_STREAM_STATE_TAG_BODY) {
+        return FLV_ERROR_EOF;
+    }
+
+    xxh64_reset(&state, 0);
+    do {
+        bytes_number = flv_read_tag_body(stream, buffer, sizeof(buffer));
+        xxh64_update(&state, buffer, bytes_number);
+    } while (bytes_number > 0);
+
+    *hash = xxh64_digest(&state);
+    return (stream->current_tag_body_length > 0) ? FLV_ERROR_EOF : FLV_OK;
+}
+
+/* read the first bytes of the current tag body without consuming them */
+size_t flv_peek_tag_body(flv_stream * stream, void * buffer, size_t buffer_size) {
+    file_offset_t body_offset;
+    uint32 body_length;
+    uint8 state;
+    size_t bytes_number;
+
+    if (stream == NULL || stream->state != FLV_STREAM_STATE_TAG_BODY) {
+        return 0;
+    }
+
+    body_offset = lfs_ftell(stream->flvin);
+    body_length = stream->current_tag_body_length;
+    state = stream->state;
+
+    bytes_number = flv_read_tag_body(stream, buffer, buffer_size);
+
+    if (flv_stream_seek(stream, body_offset, SEEK_SET) != 0) {
+        return 0;
+    }
+    stream->current_tag_body_length = body_length;
+    stream->state = state;
+    return bytes_number;
+}
+
 file_offset_t flv_get_current_tag_offset(flv_stream * stream) {
     return (stream != NULL) ? stream->current_tag_offset : 0;
 }
@@ -358,6 +509,23 @@ file_offset_t flv_get_offset(flv_stream * stream) {
     return (stream != NULL) ? lfs_ftell(stream->flvin) : 0;
 }
 
+/* position the stream at the start of the tag located at the given offset */
+int flv_seek_tag(flv_stream * stream, file_offset_t offset) {
+    if (stream == NULL || stream->flvin == NULL) {
+        return FLV_ERROR_EOF;
+    }
+
+    if (flv_stream_seek(stream, offset, SEEK_SET) != 0) {
+        return FLV_ERROR_EOF;
+    }
+
+    stream->current_tag_body_length = 0;
+    stream->current_tag_body_overflow = 0;
+    stream->current_tag_offset = offset;
+    stream->state = FLV_STREAM_STATE_TAG;
+    return FLV_OK;
+}
+
 void flv_reset(flv_stream * stream) {
     /* go back to beginning of file */
     if (stream != NULL && stream->flvin != NULL) {
@@ -365,7 +533,7 @@ void flv_reset(flv_stream * stream) {
         stream->current_tag_offset = 0;
         stream->state = FLV_STREAM_STATE_START;
 
-        lfs_fseek(stream->flvin, 0, SEEK_SET);
+        flv_stream_seek(stream, 0, SEEK_SET);
     }
 }
 
@@ -461,135 +629,257 @@ size_t flv_write_tag(FILE * out, const flv_tag * tag) {
     return 1;
 }
 
-/* FLV event based parser */
-int flv_parse(const char * file, flv_parser * parser) {
-    flv_header header;
-    flv_tag tag;
-    flv_audio_tag at;
-    flv_video_tag vt;
-    amf_data * name, * data;
-    char * name_str;
-    uint32 prev_tag_size;
-    int retval;
+/* FLV pull based tag iterator */
 
-    if (parser == NULL) {
+/* release the script payload decoded for the current tag */
+static void flv_iter_free_metadata(flv_iter * iter) {
+    amf_data_free(iter->metadata_name);
+    amf_data_free(iter->metadata_data);
+    iter->metadata_name = NULL;
+    iter->metadata_data = NULL;
+    iter->metadata_read = 0;
+    iter->metadata_result = FLV_OK;
+}
+
+int flv_iter_init(flv_iter * iter, flv_stream * stream) {
+    if (iter == NULL) {
         return FLV_ERROR_EOF;
     }
 
-    parser->stream = flv_open(file);
-    if (parser->stream == NULL) {
-        return FLV_ERROR_OPEN_READ;
+    memset(iter, 0, sizeof(flv_iter));
+    iter->stream = stream;
+    iter->decode_media_headers = 1;
+    return flv_read_header(stream, &iter->header);
+}
+
+int flv_iter_next(flv_iter * iter, flv_tag_view * view) {
+    byte body[sizeof(flv_audio_tag) + sizeof(byte) + FLV_VIDEO_FOURCC_SIZE];
+    size_t body_size;
+    int retval;
+
+    if (iter == NULL || view == NULL) {
+        return FLV_ERROR_EOF;
     }
 
-    retval = flv_read_header(parser->stream, &header);
+    flv_iter_free_metadata(iter);
+
+    /* an unfinished tag is skipped along with its previous tag size */
+    retval = flv_read_tag(iter->stream, &view->tag);
     if (retval != FLV_OK) {
-        flv_close(parser->stream);
         return retval;
     }
 
+    view->offset = flv_get_current_tag_offset(iter->stream);
+    view->timestamp = flv_tag_get_timestamp(view->tag);
+    view->body_length = flv_tag_get_body_length(view->tag);
+    view->has_media_header = 0;
+    view->audio_tag = 0;
+    memset(&view->video_tag, 0, sizeof(flv_video_tag));
+
+    /* decode the media headers without consuming the body */
+    if (!iter->decode_media_headers) {
+        return FLV_OK;
+    }
+    if (view->tag.type == FLV_TAG_TYPE_AUDIO) {
+        body_size = flv_peek_tag_body(iter->stream, body, sizeof(flv_audio_tag));
+        if (body_size == sizeof(flv_audio_tag)) {
+            view->audio_tag = body[0];
+            view->has_media_header = 1;
+        }
+    }
+    else if (view->tag.type == FLV_TAG_TYPE_VIDEO) {
+        body_size = flv_peek_tag_body(iter->stream, body, sizeof(byte) + FLV_VIDEO_FOURCC_SIZE);
+        if (body_size >= sizeof(byte)) {
+            view->video_tag.video_tag = body[0];
+            if (!flv_video_tag_is_ext_header(&view->video_tag)) {
+                view->has_media_header = 1;
+            }
+            else if (body_size == sizeof(byte) + FLV_VIDEO_FOURCC_SIZE) {
+                memcpy(&view->video_tag.fourcc, body + sizeof(byte), FLV_VIDEO_FOURCC_SIZE);
+                view->has_media_header = 1;
+            }
+        }
+    }
+
+    return FLV_OK;
+}
+
+int flv_iter_get_metadata(flv_iter * iter, amf_data ** name, amf_data ** data) {
+    if (iter == NULL || iter->stream == NULL) {
+        return FLV_ERROR_EOF;
+    }
+
+    if (!iter->metadata_read) {
+        if (iter->stream->current_tag.type != FLV_TAG_TYPE_META) {
+            iter->metadata_result = FLV_ERROR_INVALID_METADATA;
+        }
+        else {
+            iter->metadata_result = flv_read_metadata(iter->stream, &iter->metadata_name, &iter->metadata_data);
+        }
+        iter->metadata_read = 1;
+    }
+
+    if (name != NULL) {
+        *name = iter->metadata_name;
+    }
+    if (data != NULL) {
+        *data = iter->metadata_data;
+    }
+    return iter->metadata_result;
+}
+
+int flv_iter_finish_tag(flv_iter * iter, uint32 * prev_tag_size) {
+    if (iter == NULL) {
+        return FLV_ERROR_EOF;
+    }
+    return flv_read_prev_tag_size(iter->stream, prev_tag_size);
+}
+
+void flv_iter_free(flv_iter * iter) {
+    if (iter != NULL) {
+        flv_iter_free_metadata(iter);
+    }
+}
+
+/* FLV event based parser */
+
+/* hash the current tag body, then go back to its start for the callbacks */
+static int flv_parse_hash_tag_body(flv_parser * parser) {
+    flv_stream * stream = parser->stream;
+    file_offset_t body_offset = lfs_ftell(stream->flvin);
+    uint32 body_length = stream->current_tag_body_length;
+    uint8 state = stream->state;
+
+    /* truncated bodies are reported when read by the callbacks */
+    flv_hash_tag_body(stream, &parser->tag_body_hash);
+
+    if (flv_stream_seek(stream, body_offset, SEEK_SET) != 0) {
+        return FLV_ERROR_EOF;
+    }
+    stream->current_tag_body_length = body_length;
+    stream->state = state;
+    return FLV_OK;
+}
+
+/* run the parser callbacks over the tags of an iterator */
+static int flv_parse_tags(flv_iter * iter, flv_parser * parser) {
+    flv_tag_view view;
+    flv_audio_tag at;
+    flv_video_tag vt;
+    amf_data * name, * data;
+    uint32 prev_tag_size;
+    int retval;
+
     if (parser->on_header != NULL) {
-        retval = parser->on_header(&header, parser);
+        retval = parser->on_header(&iter->header, parser);
         if (retval != FLV_OK) {
-            flv_close(parser->stream);
             return retval;
         }
     }
 
-    while (flv_read_tag(parser->stream, &tag) == FLV_OK) {
+    while (flv_iter_next(iter, &view) == FLV_OK) {
+        if (parser->hash_tag_bodies) {
+            retval = flv_parse_hash_tag_body(parser);
+            if (retval != FLV_OK) {
+                return retval;
+            }
+        }
+
         if (parser->on_tag != NULL) {
-            retval = parser->on_tag(&tag, parser);
+            retval = parser->on_tag(&view.tag, parser);
             if (retval != FLV_OK) {
-                flv_close(parser->stream);
                 return retval;
             }
         }
 
-        if (tag.type == FLV_TAG_TYPE_AUDIO) {
+        /* media callbacks expect the stream past the media header */
+        if (view.tag.type == FLV_TAG_TYPE_AUDIO) {
             retval = flv_read_audio_tag(parser->stream, &at);
             if (retval == FLV_ERROR_EOF) {
-                flv_close(parser->stream);
                 return retval;
             }
             if (retval != FLV_ERROR_EMPTY_TAG && parser->on_audio_tag != NULL) {
-                retval = parser->on_audio_tag(&tag, at, parser);
+                retval = parser->on_audio_tag(&view.tag, at, parser);
                 if (retval != FLV_OK) {
-                    flv_close(parser->stream);
                     return retval;
                 }
             }
         }
-        else if (tag.type == FLV_TAG_TYPE_VIDEO) {
+        else if (view.tag.type == FLV_TAG_TYPE_VIDEO) {
             retval = flv_read_video_tag(parser->stream, &vt);
             if (retval == FLV_ERROR_EOF) {
-                flv_close(parser->stream);
                 return retval;
             }
             if (retval != FLV_ERROR_EMPTY_TAG && parser->on_video_tag != NULL) {
-                retval = parser->on_video_tag(&tag, vt, parser);
+                retval = parser->on_video_tag(&view.tag, vt, parser);
                 if (retval != FLV_OK) {
-                    flv_close(parser->stream);
                     return retval;
                 }
             }
         }
-        else if (tag.type == FLV_TAG_TYPE_META) {
-            name = data = NULL;
-            retval = flv_read_metadata(parser->stream, &name, &data);
+        else if (view.tag.type == FLV_TAG_TYPE_META) {
+            retval = flv_iter_get_metadata(iter, &name, &data);
             if (retval == FLV_ERROR_EOF) {
-                amf_data_free(name);
-                amf_data_free(data);
-                flv_close(parser->stream);
                 return retval;
             }
 
             if (retval == FLV_OK
             && parser->on_metadata_tag != NULL
             && amf_data_get_type(name) == AMF_TYPE_STRING) {
-                name_str = (char *)amf_string_get_bytes(name);
-
-                retval = parser->on_metadata_tag(&tag, name_str, data, parser);
+                retval = parser->on_metadata_tag(&view.tag, (char *)amf_string_get_bytes(name), data, parser);
                 if (retval != FLV_OK) {
-                    amf_data_free(name);
-                    amf_data_free(data);
-                    flv_close(parser->stream);
                     return retval;
                 }
             }
-
-            amf_data_free(name);
-            amf_data_free(data);
         }
         else {
             if (parser->on_unknown_tag != NULL) {
-                retval = parser->on_unknown_tag(&tag, parser);
+                retval = parser->on_unknown_tag(&view.tag, parser);
                 if (retval != FLV_OK) {
-                    flv_close(parser->stream);
                     return retval;
                 }
             }
         }
-        retval = flv_read_prev_tag_size(parser->stream, &prev_tag_size);
+
+        retval = flv_iter_finish_tag(iter, &prev_tag_size);
         if (retval != FLV_OK) {
-            flv_close(parser->stream);
             return retval;
         }
         if (parser->on_prev_tag_size != NULL) {
             retval = parser->on_prev_tag_size(prev_tag_size, parser);
             if (retval != FLV_OK) {
-                flv_close(parser->stream);
                 return retval;
             }
         }
     }
 
     if (parser->on_stream_end != NULL) {
-        retval = parser->on_stream_end(parser);
-        if (retval != FLV_OK) {
-            flv_close(parser->stream);
-            return retval;
-        }
+        return parser->on_stream_end(parser);
     }
+    return FLV_OK;
+}
+
+int flv_parse(const char * file, flv_parser * parser) {
+    flv_iter iter;
+    int retval;
 
+    if (parser == NULL) {
+        return FLV_ERROR_EOF;
+    }
+
+    parser->stream = flv_open(file);
+    if (parser->stream == NULL) {
+        return FLV_ERROR_OPEN_READ;
+    }
+
+    retval = flv_iter_init(&iter, parser->stream);
+    if (retval == FLV_OK) {
+        /* the media callbacks read the headers themselves */
+        iter.decode_media_headers = 0;
+        retval = flv_parse_tags(&iter, parser);
+    }
+
+    flv_iter_free(&iter);
     flv_close(parser->stream);
-    return FLV_OK;
+    return retval;
 }
@@ -39,6 +39,7 @@
 #define FLV_ERROR_EMPTY_TAG             5
 #define FLV_ERROR_INVALID_METADATA_NAME 6
 #define FLV_ERROR_INVALID_METADATA      7
+#define FLV_ERROR_INVALID_PREV_TAG_SIZE 8
 
 /* flv file format structure and definitions */
 
@@ -195,19 +196,31 @@ typedef struct __flv_stream {
     file_offset_t current_tag_offset;
     uint32 current_tag_body_length;
     uint32 current_tag_body_overflow;
+    file_offset_t data_offset; /* end of the header, from its offset field */
+    /* I/O counters */
+    uint64 bytes_read;
+    uint64 reads;
+    uint64 seeks;
 } flv_stream;
 
 /* FLV stream functions */
+size_t flv_stream_read(flv_stream * stream, void * buffer, size_t size, size_t count);
+int flv_stream_seek(flv_stream * stream, file_offset_t offset, int whence);
 flv_stream * flv_open(const char * file);
 int flv_read_header(flv_stream * stream, flv_header * header);
 int flv_read_prev_tag_size(flv_stream * stream, uint32 * prev_tag_size);
 int flv_read_tag(flv_stream * stream, flv_tag * tag);
+int flv_seek_end(flv_stream * stream);
+int flv_read_prev_tag(flv_stream * stream, flv_tag * tag);
 int flv_read_audio_tag(flv_stream * stream, flv_audio_tag * tag);
 int flv_read_video_tag(flv_stream * stream, flv_video_tag * tag);
 int flv_read_metadata(flv_stream * stream, amf_data ** name, amf_data ** data);
 size_t flv_read_tag_body(flv_stream * stream, void * buffer, size_t buffer_size);
+int flv_hash_tag_body(flv_stream * stream, uint64 * hash);
+size_t flv_peek_tag_body(flv_stream * stream, void * buffer, size_t buffer_size);
 file_offset_t flv_get_current_tag_offset(flv_stream * stream);
 file_offset_t flv_get_offset(flv_stream * stream);
+int flv_seek_tag(flv_stream * stream, file_offset_t offset);
 void flv_reset(flv_stream * stream);
 void flv_close(flv_stream * stream);
 
@@ -220,10 +233,43 @@ size_t flv_copy_prev_tag_size(void * to, uint32 prev_tag_size, size_t buffer_siz
 size_t flv_write_header(FILE * out, const flv_header * header);
 size_t flv_write_tag(FILE * out, const flv_tag * tag);
 
+/* FLV pull based tag iterator */
+typedef struct __flv_tag_view {
+    flv_tag tag;
+    file_offset_t offset; /* offset of the tag in the stream */
+    uint32 timestamp;
+    uint32 body_length;
+    int has_media_header; /* audio_tag or video_tag was decoded from the body */
+    flv_audio_tag audio_tag;
+    flv_video_tag video_tag;
+} flv_tag_view;
+
+typedef struct __flv_iter {
+    flv_stream * stream;
+    flv_header header;
+    int decode_media_headers; /* peek the audio and video headers into the views */
+    int metadata_read; /* the script payload of the current tag is decoded */
+    int metadata_result;
+    amf_data * metadata_name;
+    amf_data * metadata_data;
+} flv_iter;
+
+/* read the stream header, the stream remains owned by the caller */
+int flv_iter_init(flv_iter * iter, flv_stream * stream);
+/* move to the next tag, leaving its body unread, FLV_ERROR_EOF past the last one */
+int flv_iter_next(flv_iter * iter, flv_tag_view * view);
+/* decode the script payload of the current tag on first call, owned by the iterator */
+int flv_iter_get_metadata(flv_iter * iter, amf_data ** name, amf_data ** data);
+/* skip the rest of the current tag and read its previous tag size */
+int flv_iter_finish_tag(flv_iter * iter, uint32 * prev_tag_size);
+void flv_iter_free(flv_iter * iter);
+
 /* FLV event based parser */
 typedef struct __flv_parser {
     flv_stream * stream;
     void * user_data;
+    int hash_tag_bodies; /* compute tag_body_hash before the tag callbacks */
+    uint64 tag_body_hash; /* XXH64 hash of the current tag body */
     int (* on_header)(flv_header * header, struct __flv_parser * parser);
     int (* on_tag)(flv_tag * tag, struct __flv_parser * parser);
     int (* on_metadata_tag)(flv_tag * tag, char * name, amf_data * data, struct __flv_parser * parser);
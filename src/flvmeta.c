@@ -19,32 +19,85 @@
     along with FLVMeta; if not, write to the Free Software
     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 */
+#include <errno.h>
 #include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "flvmeta.h"
+#include "batch.h"
+#include "cache.h"
 #include "check.h"
+#include "diff.h"
 #include "dump.h"
+#include "inventory.h"
+#include "server.h"
 #include "update.h"
+#include "util.h"
+#include "watch.h"
 
 /*
     Command-line options
 */
+
+/* long options without a short equivalent */
+#define TAG_TYPE_OPTION_ID          256
+#define KEYFRAMES_ONLY_OPTION_ID    257
+#define START_TIME_OPTION_ID        258
+#define END_TIME_OPTION_ID          259
+#define START_OFFSET_OPTION_ID      260
+#define END_OFFSET_OPTION_ID        261
+#define JOBS_OPTION_ID              262
+#define DIFF_COMMAND_ID             263
+#define HASH_OPTION_ID              264
+#define FILTER_OPTION_ID            265
+#define QUICK_OPTION_ID             266
+#define DISABLE_RULE_OPTION_ID      267
+#define FAIL_FAST_OPTION_ID         268
+#define STRUCTURE_OPTION_ID         269
+#define NAL_UNITS_OPTION_ID         270
+#define STATS_OPTION_ID             271
+#define BATCH_OPTION_ID             272
+#define FILES_FROM_OPTION_ID        273
+#define OUTPUT_DIR_OPTION_ID        274
+#define MAX_MEMORY_OPTION_ID        275
+#define SERVE_COMMAND_ID            276
+#define WATCH_OPTION_ID             277
+#define WATCH_DELAY_OPTION_ID       278
+#define STATE_FILE_OPTION_ID        279
+#define CACHE_OPTION_ID             280
+#define INVENTORY_COMMAND_ID        281
+
 static struct option long_options[] = {
     { "dump",               no_argument,        NULL, 'D'},
     { "full-dump",          no_argument,        NULL, 'F'},
     { "check",              no_argument,        NULL, 'C'},
     { "update",             no_argument,        NULL, 'U'},
+    { "diff",               no_argument,        NULL, DIFF_COMMAND_ID},
+    { "serve",              required_argument,  NULL, SERVE_COMMAND_ID},
+    { "inventory",          no_argument,        NULL, INVENTORY_COMMAND_ID},
     { "dump-format",        required_argument,  NULL, 'd'},
     { "json",               no_argument,        NULL, 'j'},
     { "raw",                no_argument,        NULL, 'r'},
     { "xml",                no_argument,        NULL, 'x'},
     { "yaml",               no_argument,        NULL, 'y'},
     { "event",              required_argument,  NULL, 'e'},
+    { "hash",               no_argument,        NULL, HASH_OPTION_ID},
+    { "tag-type",           required_argument,  NULL, TAG_TYPE_OPTION_ID},
+    { "keyframes-only",     no_argument,        NULL, KEYFRAMES_ONLY_OPTION_ID},
+    { "start-time",         required_argument,  NULL, START_TIME_OPTION_ID},
+    { "end-time",           required_argument,  NULL, END_TIME_OPTION_ID},
+    { "start-offset",       required_argument,  NULL, START_OFFSET_OPTION_ID},
+    { "end-offset",         required_argument,  NULL, END_OFFSET_OPTION_ID},
+    { "filter",             required_argument,  NULL, FILTER_OPTION_ID},
     { "level",              required_argument,  NULL, 'l'},
     { "quiet",              no_argument,        NULL, 'q'},
+    { "quick",              no_argument,        NULL, QUICK_OPTION_ID},
+    { "structure",          no_argument,        NULL, STRUCTURE_OPTION_ID},
+    { "nal-units",          no_argument,        NULL, NAL_UNITS_OPTION_ID},
+    { "disable-rule",       required_argument,  NULL, DISABLE_RULE_OPTION_ID},
+    { "fail-fast",          no_argument,        NULL, FAIL_FAST_OPTION_ID},
     { "print-metadata",     no_argument,        NULL, 'm'},
     { "add",                required_argument,  NULL, 'a'},
     { "no-lastsecond",      no_argument,        NULL, 's'},
@@ -53,7 +106,17 @@ static struct option long_options[] = {
     { "ignore",             no_argument,        NULL, 'i'},
     { "reset-timestamps",   no_argument,        NULL, 't'},
     { "all-keyframes",      no_argument,        NULL, 'k'},
+    { "max-memory",         required_argument,  NULL, MAX_MEMORY_OPTION_ID},
+    { "state-file",         required_argument,  NULL, STATE_FILE_OPTION_ID},
     { "verbose",            no_argument,        NULL, 'v'},
+    { "stats",              no_argument,        NULL, STATS_OPTION_ID},
+    { "jobs",               required_argument,  NULL, JOBS_OPTION_ID},
+    { "cache",              required_argument,  NULL, CACHE_OPTION_ID},
+    { "batch",              no_argument,        NULL, BATCH_OPTION_ID},
+    { "files-from",         required_argument,  NULL, FILES_FROM_OPTION_ID},
+    { "output-dir",         required_argument,  NULL, OUTPUT_DIR_OPTION_ID},
+    { "watch",              required_argument,  NULL, WATCH_OPTION_ID},
+    { "watch-delay",        required_argument,  NULL, WATCH_DELAY_OPTION_ID},
     { "version",            no_argument,        NULL, 'V'},
     { "help",               no_argument,        NULL, 'h'},
     { 0, 0, 0, 0 }
@@ -93,11 +156,19 @@ static void version(void) {
 
 static void usage(const char * name) {
     fprintf(stderr, "Usage: %s [COMMAND] [OPTIONS] INPUT_FILE [OUTPUT_FILE]\n", name);
+    fprintf(stderr, "       %s [COMMAND] [OPTIONS] --batch INPUT_FILE...\n", name);
+    fprintf(stderr, "       %s [COMMAND] [OPTIONS] --watch DIR --output-dir DIR\n", name);
+    fprintf(stderr, "       %s [OPTIONS] --serve SOCKET\n", name);
+    fprintf(stderr, "       %s [OPTIONS] --inventory INPUT_FILE...\n", name);
     fprintf(stderr, "Try `%s --help' for more information.\n", name);
 }
 
 static void help(const char * name) {
     printf("Usage: %s [COMMAND] [OPTIONS] INPUT_FILE [OUTPUT_FILE]\n", name);
+    printf("       %s [COMMAND] [OPTIONS] --batch INPUT_FILE...\n", name);
+    printf("       %s [COMMAND] [OPTIONS] --watch DIR --output-dir DIR\n", name);
+    printf("       %s [OPTIONS] --serve SOCKET\n", name);
+    printf("       %s [OPTIONS] --inventory INPUT_FILE...\n", name);
     printf("\nIf OUTPUT_FILE is omitted for commands expecting it, INPUT_FILE will be overwritten instead.\n"
            "\nCommands:\n"
            "  -D, --dump                dump onMetaData tag (default without output file)\n"
@@ -106,6 +177,14 @@ static void help(const char * name) {
            "                            the file is valid, or 10 if it contains errors\n"
            "  -U, --update              update computed onMetaData tag from INPUT_FILE\n"
            "                            into OUTPUT_FILE (default with output file)\n"
+           "      --diff                compare the tags of INPUT_FILE and OUTPUT_FILE,\n"
+           "                            returning 0 if they are identical, or 11 if not\n"
+           "      --serve=SOCKET        answer check, info, update, and dump-metadata\n"
+           "                            requests on the Unix domain socket SOCKET\n"
+           "      --inventory           summarize the codecs, resolutions, duration, and\n"
+           "                            bitrates of every INPUT_FILE and of the .flv files\n"
+           "                            found in directories, and list the files failing\n"
+           "                            the quick check, as text or JSON (-j)\n"
            /*    "  -A, --extract-audio       extract raw audio data into OUTPUT_FILE\n"*/
            /*    "  -E, --extract-video       extract raw video data into OUTPUT_FILE\n"*/
            "\nDump options:\n"
@@ -115,13 +194,34 @@ static void help(const char * name) {
            "  -r, --raw                 equivalent to --dump-format=raw\n"
            "  -x, --xml                 equivalent to --dump-format=xml\n"
            "  -y, --yaml                equivalent to --dump-format=yaml\n"
-           "  -e, --event=EVENT         specify the event to be dumped instead of 'onMetadata'\n"
+           "  -e, --event=EVENT[:N]     specify an event to be dumped instead of 'onMetadata',\n"
+           "                            at most N times if specified, or a script data event\n"
+           "                            to include in a full dump; can be given several times\n"
+           "      --hash                include a hash of each tag body in full dumps\n"
+           "\nFull dump filters:\n"
+           "      --tag-type=TYPES      dump only tags of the given comma-separated TYPES\n"
+           "                            among 'audio', 'video', and 'script'\n"
+           "      --keyframes-only      dump only video keyframes\n"
+           "      --start-time=TIME     dump only tags from timestamp TIME in milliseconds\n"
+           "      --end-time=TIME       stop dumping after timestamp TIME in milliseconds\n"
+           "      --start-offset=OFFSET dump only tags starting at byte OFFSET or later\n"
+           "      --end-offset=OFFSET   stop dumping after byte OFFSET\n"
+           "      --filter=EXPR         dump only tags matching the filter expression EXPR,\n"
+           "                            e.g. 'type==video && keyframe && ts>=60000'\n"
            "\nCheck options:\n"
            "  -l, --level=LEVEL         print only messages where level is at least LEVEL\n"
            "                            LEVEL is 'info', 'warning' (default), 'error', or 'fatal'\n"
            "  -q, --quiet               do not print messages, only return the status code\n"
            "  -x, --xml                 generate an XML report\n"
            "  -j, --json                generate a JSON report\n"
+           "      --quick               only check that the last tags are complete, reading\n"
+           "                            the end of the file\n"
+           "      --structure           only check the header, tag headers, previous tag\n"
+           "                            sizes, and timestamps, without reading tag bodies\n"
+           "      --nal-units           also check the NAL units of AVC video frames\n"
+           "      --disable-rule=IDS    do not run the check rules of the comma-separated\n"
+           "                            IDS, given as codes or numbers, e.g. 'W81074,60'\n"
+           "      --fail-fast           stop checking at the first error\n"
            "\nUpdate options:\n"
            "  -m, --print-metadata      print metadata to stdout after update using\n"
            "                            the specified format\n"
@@ -133,18 +233,254 @@ static void help(const char * name) {
            "                            (the default is to stop with an error)\n"
            "  -t, --reset-timestamps    reset timestamps so OUTPUT_FILE starts at zero\n"
            "  -k, --all-keyframes       index all keyframe tags, including duplicate timestamps\n"
+           "      --max-memory=SIZE     keep the memory used per file under SIZE bytes,\n"
+           "                            optionally followed by K, M, or G, copying tags in\n"
+           "                            chunks if needed, or fail if SIZE is too small\n"
+           "      --state-file=FILE     save the analysis of a growing INPUT_FILE to FILE,\n"
+           "                            and resume it from FILE on the next update, only\n"
+           "                            reading the tags appended since\n"
            "\nCommon options:\n"
            "  -v, --verbose             display informative messages\n"
+           "      --stats               report per-phase times and I/O counters in check\n"
+           "                            reports and after updates\n"
+           "      --jobs=N              use N threads to format full dumps, or to process\n"
+           "                            files in batch mode, or one per processor if N is 0\n"
+           "                            (default is 1, or 0 for the inventory)\n"
+           "      --cache=FILE          keep the check and update results in FILE, and\n"
+           "                            skip the files unchanged since they were cached\n"
+           "\nBatch options:\n"
+           "      --batch               run the command on every INPUT_FILE, and on the\n"
+           "                            .flv files found in directories given instead\n"
+           "      --files-from=LIST     run the command on the files listed in LIST, one\n"
+           "                            per line, or the standard input if LIST is '-'\n"
+           "      --output-dir=DIR      write each report, dump, or updated file to DIR\n"
+           "                            instead of the combined output, or in place\n"
+           "\nWatch options:\n"
+           "      --watch=DIR           run the command (default is update) on the .flv\n"
+           "                            files written to DIR, until interrupted, writing\n"
+           "                            each result to the --output-dir directory\n"
+           "      --watch-delay=MS      wait until a file has not been written for MS\n"
+           "                            milliseconds before processing it (default is %d)\n"
            "\nMiscellaneous:\n"
            "  -V, --version             print version information and exit\n"
-           "  -h, --help                display this information and exit\n");
+           "  -h, --help                display this information and exit\n", WATCH_DEFAULT_DELAY);
     printf("\nPlease report bugs to <%s>\n", PACKAGE_BUGREPORT);
 }
 
+/* parse a non-negative decimal integer */
+static int parse_number(const char * str, uint64 * value) {
+    char * end;
+
+    if (str == NULL || *str < '0' || *str > '9') {
+        return 0;
+    }
+
+    errno = 0;
+    *value = (uint64)strtoull(str, &end, 10);
+    return (errno == 0 && *end == '\0');
+}
+
+/* parse a size in bytes, optionally followed by a K, M, or G binary multiplier */
+static int parse_size(const char * str, uint64 * value) {
+    char number[32];
+    size_t length;
+    int shift;
+
+    length = strlen(str);
+    shift = 0;
+    if (length > 0) {
+        switch (str[length - 1]) {
+            case 'k': case 'K': shift = 10; break;
+            case 'm': case 'M': shift = 20; break;
+            case 'g': case 'G': shift = 30; break;
+        }
+    }
+    if (shift > 0) {
+        --length;
+    }
+    if (length == 0 || length >= sizeof(number)) {
+        return 0;
+    }
+
+    memcpy(number, str, length);
+    number[length] = '\0';
+    if (!parse_number(number, value) || *value > (((uint64)-1) >> shift)) {
+        return 0;
+    }
+    *value <<= shift;
+    return 1;
+}
+
+/* parse a comma-separated list of events with optional limits, as NAME[:LIMIT] */
+static int parse_events(char * str, flvmeta_opts * options) {
+    char * end, * limit;
+    flvmeta_event * events;
+    uint64 value;
+
+    do {
+        end = strchr(str, ',');
+        if (end != NULL) {
+            *end = '\0';
+        }
+
+        value = 0;
+        limit = strchr(str, ':');
+        if (limit != NULL) {
+            *limit = '\0';
+            if (!parse_number(limit + 1, &value) || value == 0 || value > 0xFFFFFFFFU) {
+                return 0;
+            }
+        }
+
+        if (*str == '\0') {
+            return 0;
+        }
+
+        events = (flvmeta_event *)realloc(options->metadata_events,
+            (options->metadata_events_number + 1) * sizeof(flvmeta_event));
+        if (events == NULL) {
+            return 0;
+        }
+        events[options->metadata_events_number].name = str;
+        events[options->metadata_events_number].limit = (uint32)value;
+        options->metadata_events = events;
+        options->metadata_events_number++;
+
+        str = end + 1;
+    } while (end != NULL);
+
+    return 1;
+}
+
+/* parse a comma-separated list of check rules to disable, as codes or numbers */
+static int parse_disabled_rules(char * str, flvmeta_opts * options) {
+    char * end;
+    int * rules;
+    int id;
+
+    do {
+        end = strchr(str, ',');
+        if (end != NULL) {
+            *end = '\0';
+        }
+
+        id = check_get_rule_id(str);
+        if (id < 0) {
+            return 0;
+        }
+
+        rules = (int *)realloc(options->check_disabled_rules,
+            (options->check_disabled_rules_number + 1) * sizeof(int));
+        if (rules == NULL) {
+            return 0;
+        }
+        rules[options->check_disabled_rules_number] = id;
+        options->check_disabled_rules = rules;
+        options->check_disabled_rules_number++;
+
+        str = end + 1;
+    } while (end != NULL);
+
+    return 1;
+}
+
+/* parse a comma-separated list of tag types */
+static int parse_tag_types(const char * str, int * types) {
+    const char * end;
+    size_t len;
+
+    *types = 0;
+    do {
+        end = strchr(str, ',');
+        len = (end != NULL) ? (size_t)(end - str) : strlen(str);
+
+        if (len == 5 && !strncmp(str, "audio", len)) {
+            *types |= FLVMETA_DUMP_TAG_TYPE_AUDIO;
+        }
+        else if (len == 5 && !strncmp(str, "video", len)) {
+            *types |= FLVMETA_DUMP_TAG_TYPE_VIDEO;
+        }
+        else if (len == 6 && !strncmp(str, "script", len)) {
+            *types |= FLVMETA_DUMP_TAG_TYPE_META;
+        }
+        else {
+            return 0;
+        }
+
+        str = end + 1;
+    } while (end != NULL);
+
+    return 1;
+}
+
+/* input files and directories of the batch mode */
+static int parse_batch_files(int argc, char ** argv, flvmeta_opts * options) {
+    if (options->command == FLVMETA_DIFF_COMMAND) {
+        fprintf(stderr, "%s: the diff command cannot be run in batch mode\n", argv[0]);
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (optind >= argc && options->batch_list == NULL) {
+        fprintf(stderr, "%s: no input file\n", argv[0]);
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    options->batch_files = argv + optind;
+    options->batch_files_number = (size_t)(argc - optind);
+
+    /* there is no output file to choose the update command */
+    if (options->command == FLVMETA_DEFAULT_COMMAND) {
+        options->command = FLVMETA_DUMP_COMMAND;
+    }
+    return OK;
+}
+
+/* watched and output directories of the watch mode */
+static int parse_watch_options(int argc, char ** argv, flvmeta_opts * options) {
+    if (options->command == FLVMETA_DIFF_COMMAND || options->command == FLVMETA_SERVE_COMMAND
+    || options->command == FLVMETA_INVENTORY_COMMAND) {
+        fprintf(stderr, "%s: the %s command cannot be run in watch mode\n", argv[0],
+            (options->command == FLVMETA_DIFF_COMMAND) ? "diff"
+            : (options->command == FLVMETA_SERVE_COMMAND) ? "serve" : "inventory");
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (options->batch || optind < argc) {
+        fprintf(stderr, "%s: the watch mode takes no input file\n", argv[0]);
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* results are moved to a distinct directory, where they are not seen as new files */
+    if (options->batch_output_dir == NULL) {
+        fprintf(stderr, "%s: the watch mode requires --output-dir\n", argv[0]);
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (!flvmeta_is_directory(options->batch_output_dir)) {
+        fprintf(stderr, "%s: %s is not a directory\n", argv[0], options->batch_output_dir);
+        return EXIT_FAILURE;
+    }
+    if (flvmeta_same_file(options->watch_dir, options->batch_output_dir)) {
+        fprintf(stderr, "%s: --output-dir must differ from the watched directory\n", argv[0]);
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (options->command == FLVMETA_DEFAULT_COMMAND) {
+        options->command = FLVMETA_UPDATE_COMMAND;
+    }
+    return OK;
+}
+
 static int parse_command_line(int argc, char ** argv, flvmeta_opts * options) {
-    int option, option_index;
+    int option, option_index, jobs_given;
 
     option_index = 0;
+    jobs_given = 0;
     do {
         option = getopt_long(argc, argv,
             DUMP_COMMAND
@@ -203,6 +539,28 @@ static int parse_command_line(int argc, char ** argv, flvmeta_opts * options) {
                 }
                 options->command = FLVMETA_UPDATE_COMMAND;
                 break;
+            case DIFF_COMMAND_ID:
+                if (options->command != FLVMETA_DEFAULT_COMMAND) {
+                    fprintf(stderr, "%s: only one command can be specified -- %s\n", argv[0], argv[optind]);
+                    return EXIT_FAILURE;
+                }
+                options->command = FLVMETA_DIFF_COMMAND;
+                break;
+            case SERVE_COMMAND_ID:
+                if (options->command != FLVMETA_DEFAULT_COMMAND) {
+                    fprintf(stderr, "%s: only one command can be specified -- %s\n", argv[0], argv[optind]);
+                    return EXIT_FAILURE;
+                }
+                options->command = FLVMETA_SERVE_COMMAND;
+                options->server_socket = optarg;
+                break;
+            case INVENTORY_COMMAND_ID:
+                if (options->command != FLVMETA_DEFAULT_COMMAND) {
+                    fprintf(stderr, "%s: only one command can be specified -- %s\n", argv[0], argv[optind]);
+                    return EXIT_FAILURE;
+                }
+                options->command = FLVMETA_INVENTORY_COMMAND;
+                break;
             /*
                 options
             */
@@ -227,6 +585,17 @@ static int parse_command_line(int argc, char ** argv, flvmeta_opts * options) {
                 }
                 break;
             case 'q': options->quiet = 1; break;
+            case QUICK_OPTION_ID: options->check_quick = 1; break;
+            case STRUCTURE_OPTION_ID: options->check_structure = 1; break;
+            case NAL_UNITS_OPTION_ID: options->check_nal_units = 1; break;
+            case DISABLE_RULE_OPTION_ID:
+                if (!parse_disabled_rules(optarg, options)) {
+                    fprintf(stderr, "%s: invalid check rule -- %s\n", argv[0], optarg);
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case FAIL_FAST_OPTION_ID: options->check_fail_fast = 1; break;
             /* dump options */
             case 'd':
                 if (!strcmp(optarg, "xml")) {
@@ -259,7 +628,67 @@ static int parse_command_line(int argc, char ** argv, flvmeta_opts * options) {
                 options->check_report_format = FLVMETA_FORMAT_XML;
                 break;
             case 'y': options->dump_format = FLVMETA_FORMAT_YAML;    break;
-            case 'e': options->metadata_event = optarg;              break;
+            case 'e':
+                if (!parse_events(optarg, options)) {
+                    fprintf(stderr, "%s: invalid event -- %s\n", argv[0], optarg);
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case HASH_OPTION_ID: options->dump_hash = 1; break;
+            case FILTER_OPTION_ID:
+                {
+                    size_t position;
+                    flvmeta_filter_free(options->filter);
+                    options->filter = flvmeta_filter_compile(optarg, &position);
+                    if (options->filter == NULL) {
+                        fprintf(stderr, "%s: invalid filter expression at position %lu -- %s\n",
+                            argv[0], (unsigned long)(position + 1), optarg);
+                        usage(argv[0]);
+                        return EXIT_FAILURE;
+                    }
+                } break;
+            /* full dump filters */
+            case TAG_TYPE_OPTION_ID:
+                if (!parse_tag_types(optarg, &options->dump_tag_types)) {
+                    fprintf(stderr, "%s: invalid tag type -- %s\n", argv[0], optarg);
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case KEYFRAMES_ONLY_OPTION_ID: options->dump_keyframes_only = 1; break;
+            case START_TIME_OPTION_ID:
+            case END_TIME_OPTION_ID:
+                {
+                    uint64 value;
+                    if (!parse_number(optarg, &value) || value >= FLVMETA_DUMP_NO_END_TIME) {
+                        fprintf(stderr, "%s: invalid timestamp -- %s\n", argv[0], optarg);
+                        usage(argv[0]);
+                        return EXIT_FAILURE;
+                    }
+                    if (option == START_TIME_OPTION_ID) {
+                        options->dump_start_time = (uint32)value;
+                    }
+                    else {
+                        options->dump_end_time = (uint32)value;
+                    }
+                } break;
+            case START_OFFSET_OPTION_ID:
+            case END_OFFSET_OPTION_ID:
+                {
+                    uint64 value;
+                    if (!parse_number(optarg, &value) || (file_offset_t)value < 0) {
+                        fprintf(stderr, "%s: invalid file offset -- %s\n", argv[0], optarg);
+                        usage(argv[0]);
+                        return EXIT_FAILURE;
+                    }
+                    if (option == START_OFFSET_OPTION_ID) {
+                        options->dump_start_offset = (file_offset_t)value;
+                    }
+                    else {
+                        options->dump_end_offset = (file_offset_t)value;
+                    }
+                } break;
             /* update options */
             case 'm': options->dump_metadata = 1;                    break;
             case 'a':
@@ -285,11 +714,51 @@ static int parse_command_line(int argc, char ** argv, flvmeta_opts * options) {
             case 'i': options->error_handling = FLVMETA_IGNORE_ERRORS;   break;
             case 't': options->reset_timestamps = 1;                     break;
             case 'k': options->all_keyframes = 1;                        break;
+            case STATE_FILE_OPTION_ID: options->state_file = optarg; break;
+            case MAX_MEMORY_OPTION_ID:
+                if (!parse_size(optarg, &options->max_memory) || options->max_memory == 0) {
+                    fprintf(stderr, "%s: invalid memory size -- %s\n", argv[0], optarg);
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
 
             /*
                 common options
             */
             case 'v': options->verbose = 1;  break;
+            case STATS_OPTION_ID: options->stats = 1; break;
+            case JOBS_OPTION_ID:
+                {
+                    uint64 value;
+                    if (!parse_number(optarg, &value) || value > FLVMETA_MAX_JOBS) {
+                        fprintf(stderr, "%s: invalid number of jobs -- %s\n", argv[0], optarg);
+                        usage(argv[0]);
+                        return EXIT_FAILURE;
+                    }
+                    options->jobs = (int)value;
+                    jobs_given = 1;
+                } break;
+            case CACHE_OPTION_ID: options->cache_file = optarg; break;
+            /* batch options */
+            case BATCH_OPTION_ID: options->batch = 1; break;
+            case FILES_FROM_OPTION_ID:
+                options->batch = 1;
+                options->batch_list = optarg;
+                break;
+            case OUTPUT_DIR_OPTION_ID: options->batch_output_dir = optarg; break;
+            /* watch options */
+            case WATCH_OPTION_ID: options->watch_dir = optarg; break;
+            case WATCH_DELAY_OPTION_ID:
+                {
+                    uint64 value;
+                    if (!parse_number(optarg, &value) || value > 0xFFFFFFFF) {
+                        fprintf(stderr, "%s: invalid watch delay -- %s\n", argv[0], optarg);
+                        usage(argv[0]);
+                        return EXIT_FAILURE;
+                    }
+                    options->watch_delay = (uint32)value;
+                } break;
             /*
                 Miscellaneous
             */
@@ -317,6 +786,52 @@ static int parse_command_line(int argc, char ** argv, flvmeta_opts * options) {
         }
     } while (option != EOF);
 
+    /* the analysis state belongs to a single input file */
+    if (options->state_file != NULL && (options->batch || options->watch_dir != NULL
+    || options->command == FLVMETA_SERVE_COMMAND || options->command == FLVMETA_INVENTORY_COMMAND)) {
+        fprintf(stderr, "%s: --state-file requires a single input file\n", argv[0]);
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* watch mode: the input files are the ones written to the watched directory */
+    if (options->watch_dir != NULL) {
+        return parse_watch_options(argc, argv, options);
+    }
+
+    /* the server mode takes its input files from the requests */
+    if (options->command == FLVMETA_SERVE_COMMAND) {
+        if (options->batch || optind < argc) {
+            fprintf(stderr, "%s: the server mode takes no input file\n", argv[0]);
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        return OK;
+    }
+
+    /* the inventory summarizes every input file or directory, on every processor by default */
+    if (options->command == FLVMETA_INVENTORY_COMMAND) {
+        if (options->batch_output_dir != NULL) {
+            fprintf(stderr, "%s: the inventory has no output directory\n", argv[0]);
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        if (!jobs_given) {
+            options->jobs = 0;
+        }
+        return parse_batch_files(argc, argv, options);
+    }
+
+    /* batch mode: every argument is an input file or directory */
+    if (options->batch) {
+        return parse_batch_files(argc, argv, options);
+    }
+    if (options->batch_output_dir != NULL) {
+        fprintf(stderr, "%s: --output-dir requires batch mode\n", argv[0]);
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
     /* input filename */
     if (optind > 0 && optind < argc) {
         options->input_file = argv[optind];
@@ -332,6 +847,13 @@ static int parse_command_line(int argc, char ** argv, flvmeta_opts * options) {
         options->output_file = argv[optind];
     }
 
+    /* the diff command compares two files */
+    if (options->command == FLVMETA_DIFF_COMMAND && options->output_file == NULL) {
+        fprintf(stderr, "%s: no file to compare\n", argv[0]);
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
     /* determine command if default */
     if (options->command == FLVMETA_DEFAULT_COMMAND && options->output_file != NULL) {
         options->command = FLVMETA_UPDATE_COMMAND;
@@ -348,60 +870,217 @@ static int parse_command_line(int argc, char ** argv, flvmeta_opts * options) {
     return OK;
 }
 
+/* print informative messages to the standard output */
+static void print_message(const char * message, void * user_data) {
+    fputs(message, stdout);
+}
+
+/* execute the command on a single file, without the cache */
+static int run_uncached_command(const flvmeta_opts * options) {
+    switch (options->command) {
+        case FLVMETA_DUMP_COMMAND: return dump_metadata(options);
+        case FLVMETA_FULL_DUMP_COMMAND: return dump_flv_file(options);
+        case FLVMETA_CHECK_COMMAND: return check_flv_file(options);
+        case FLVMETA_UPDATE_COMMAND: return update_metadata(options);
+        case FLVMETA_DIFF_COMMAND: return diff_flv_files(options);
+        default: return OK;
+    }
+}
+
+/* execute the command on a single file, unless its result is cached */
+static int run_command(const flvmeta_opts * options) {
+    if (options->cache != NULL) {
+        return flvmeta_cache_run(options->cache, options, run_uncached_command);
+    }
+    return run_uncached_command(options);
+}
+
+/* error report, returning the exit status */
+static int report_error(const char * name, const flvmeta_opts * options, int errcode) {
+    switch (errcode) {
+        case ERROR_OPEN_READ: fprintf(stderr, "%s: cannot open %s for reading\n", name, options->input_file); break;
+        case ERROR_NO_FLV: fprintf(stderr, "%s: %s is not a valid FLV file\n", name, options->input_file); break;
+        case ERROR_EOF: fprintf(stderr, "%s: unexpected end of file\n", name); break;
+        case ERROR_MEMORY: fprintf(stderr, "%s: memory allocation error\n", name); break;
+        case ERROR_EMPTY_TAG: fprintf(stderr, "%s: empty FLV tag\n", name); break;
+        case ERROR_OPEN_WRITE: fprintf(stderr, "%s: cannot open %s for writing\n", name, options->output_file); break;
+        case ERROR_INVALID_TAG: fprintf(stderr, "%s: invalid FLV tag\n", name); break;
+        case ERROR_WRITE: fprintf(stderr, "%s: unable to write to %s\n", name, options->output_file); break;
+        case ERROR_SOCKET: fprintf(stderr, "%s: cannot serve requests on %s\n", name, options->server_socket); break;
+        case ERROR_MEMORY_LIMIT: fprintf(stderr, "%s: %s cannot be updated within the memory limit\n", name, options->input_file); break;
+        case ERROR_OPEN_READ_DIFF:
+            fprintf(stderr, "%s: cannot open %s for reading\n", name, options->output_file);
+            errcode = ERROR_OPEN_READ;
+            break;
+    }
+    return errcode;
+}
+
+/* batch mode progress */
+typedef struct __batch_status {
+    const char * name;
+    int errcode; /* status of the first file in error */
+    unsigned long files;
+    unsigned long failures;
+} batch_status;
+
+/* report the result of a file processed in batch mode */
+static void report_batch_result(const flvmeta_opts * options, int result, void * user_data) {
+    batch_status * status = (batch_status *)user_data;
+
+    ++status->files;
+    if (result == OK) {
+        return;
+    }
+
+    /* errors without a file name are prefixed by the input file */
+    switch (result) {
+        case ERROR_EOF: fprintf(stderr, "%s: %s: unexpected end of file\n", status->name, options->input_file); break;
+        case ERROR_MEMORY: fprintf(stderr, "%s: %s: memory allocation error\n", status->name, options->input_file); break;
+        case ERROR_EMPTY_TAG: fprintf(stderr, "%s: %s: empty FLV tag\n", status->name, options->input_file); break;
+        case ERROR_INVALID_TAG: fprintf(stderr, "%s: %s: invalid FLV tag\n", status->name, options->input_file); break;
+        case ERROR_INVALID_FLV_FILE: fprintf(stderr, "%s: %s contains errors\n", status->name, options->input_file); break;
+        default: result = report_error(status->name, options, result);
+    }
+
+    ++status->failures;
+    if (status->errcode == OK) {
+        status->errcode = result;
+    }
+}
+
+/* run the command on every input file of the batch */
+static int run_batch(const char * name, const flvmeta_opts * options) {
+    batch_status status;
+    int errcode;
+
+    status.name = name;
+    status.errcode = OK;
+    status.files = 0;
+    status.failures = 0;
+
+    errcode = batch_run(options, run_command, report_batch_result, &status);
+    switch (errcode) {
+        case OK: break;
+        case ERROR_MEMORY: fprintf(stderr, "%s: memory allocation error\n", name); break;
+        default: fprintf(stderr, "%s: unable to write the output\n", name);
+    }
+
+    if (options->verbose) {
+        flvmeta_message(options, "%lu file(s) processed, %lu failed\n", status.files, status.failures);
+    }
+    return (errcode != OK) ? errcode : status.errcode;
+}
+
+/* run the command on the files written to the watched directory */
+static int run_watch(const char * name, const flvmeta_opts * options) {
+    batch_status status;
+    int errcode;
+
+    status.name = name;
+    status.errcode = OK;
+    status.files = 0;
+    status.failures = 0;
+
+    errcode = watch_run(options, run_command, report_batch_result, &status);
+    switch (errcode) {
+        case OK: break;
+        case ERROR_MEMORY: fprintf(stderr, "%s: memory allocation error\n", name); break;
+        case ERROR_WATCH: fprintf(stderr, "%s: cannot watch %s\n", name, options->watch_dir); break;
+        default: fprintf(stderr, "%s: cannot write to %s\n", name, options->batch_output_dir);
+    }
+
+    if (options->verbose) {
+        flvmeta_message(options, "%lu file(s) processed, %lu failed\n", status.files, status.failures);
+    }
+
+    /* failed files were reported as they were processed */
+    return errcode;
+}
+
+/* summarize the input files */
+static int run_inventory(const char * name, const flvmeta_opts * options) {
+    int errcode;
+
+    /* files that cannot be analyzed are listed in the summary */
+    errcode = inventory_run(options);
+    switch (errcode) {
+        case OK: break;
+        case ERROR_MEMORY: fprintf(stderr, "%s: memory allocation error\n", name); break;
+        default: fprintf(stderr, "%s: unable to write the output\n", name);
+    }
+    return errcode;
+}
+
 int main(int argc, char ** argv) {
     int errcode;
 
     /* flvmeta default options */
     static flvmeta_opts options;
-    options.command = FLVMETA_DEFAULT_COMMAND;
-    options.input_file = NULL;
-    options.output_file = NULL;
-    options.metadata = NULL;
-    options.check_level = FLVMETA_CHECK_LEVEL_WARNING;
-    options.quiet = 0;
-    options.check_report_format = FLVMETA_FORMAT_RAW;
-    options.dump_metadata = 0;
-    options.insert_onlastsecond = 1;
-    options.reset_timestamps = 0;
-    options.all_keyframes = 0;
-    options.preserve_metadata = 0;
-    options.error_handling = FLVMETA_EXIT_ON_ERROR;
-    options.dump_format = FLVMETA_FORMAT_XML;
-    options.verbose = 0;
-    options.metadata_event = NULL;
-
+    flvmeta_opts_init(&options);
+    options.message_proc = print_message;
 
     /* Command-line parsing */
     errcode = parse_command_line(argc, argv, &options);
 
     /* free metadata if necessary */
-    if ((errcode != OK || options.command != FLVMETA_UPDATE_COMMAND) && options.metadata != NULL) {
+    if ((errcode != OK || (options.command != FLVMETA_UPDATE_COMMAND && options.command != FLVMETA_SERVE_COMMAND))
+    && options.metadata != NULL) {
         amf_data_free(options.metadata);
+        options.metadata = NULL;
+    }
+
+    /* results of the commands on unchanged files */
+    if (errcode == OK && options.cache_file != NULL) {
+        if (options.command != FLVMETA_CHECK_COMMAND && options.command != FLVMETA_UPDATE_COMMAND) {
+            fprintf(stderr, "%s: --cache requires the check or update command\n", argv[0]);
+            usage(argv[0]);
+            errcode = EXIT_FAILURE;
+        }
+        else {
+            options.cache = flvmeta_cache_open(options.cache_file);
+            if (options.cache == NULL) {
+                fprintf(stderr, "%s: cannot open the cache %s\n", argv[0], options.cache_file);
+                errcode = ERROR_OPEN_READ;
+            }
+        }
     }
 
     if (errcode == OK) {
         /* execute command */
         switch (options.command) {
-            case FLVMETA_DUMP_COMMAND: errcode = dump_metadata(&options); break;
-            case FLVMETA_FULL_DUMP_COMMAND: errcode = dump_flv_file(&options); break;
-            case FLVMETA_CHECK_COMMAND: errcode = check_flv_file(&options); break;
-            case FLVMETA_UPDATE_COMMAND: errcode = update_metadata(&options); break;
             case FLVMETA_VERSION_COMMAND: version(); break;
             case FLVMETA_HELP_COMMAND: help(argv[0]); break;
+            case FLVMETA_SERVE_COMMAND:
+                errcode = report_error(argv[0], &options, server_run(options.server_socket, &options));
+                break;
+            case FLVMETA_INVENTORY_COMMAND:
+                errcode = run_inventory(argv[0], &options);
+                break;
+            default:
+                if (options.watch_dir != NULL) {
+                    errcode = run_watch(argv[0], &options);
+                }
+                else if (options.batch) {
+                    errcode = run_batch(argv[0], &options);
+                }
+                else {
+                    errcode = report_error(argv[0], &options, run_command(&options));
+                }
         }
+    }
 
-        /* error report */
-        switch (errcode) {
-            case ERROR_OPEN_READ: fprintf(stderr, "%s: cannot open %s for reading\n", argv[0], options.input_file); break;
-            case ERROR_NO_FLV: fprintf(stderr, "%s: %s is not a valid FLV file\n", argv[0], options.input_file); break;
-            case ERROR_EOF: fprintf(stderr, "%s: unexpected end of file\n", argv[0]); break;
-            case ERROR_MEMORY: fprintf(stderr, "%s: memory allocation error\n", argv[0]); break;
-            case ERROR_EMPTY_TAG: fprintf(stderr, "%s: empty FLV tag\n", argv[0]); break;
-            case ERROR_OPEN_WRITE: fprintf(stderr, "%s: cannot open %s for writing\n", argv[0], options.output_file); break;
-            case ERROR_INVALID_TAG: fprintf(stderr, "%s: invalid FLV tag\n", argv[0]); break;
-            case ERROR_WRITE: fprintf(stderr, "%s: unable to write to %s\n", argv[0], options.output_file); break;
-        }
+    /* batch, watch, and server updates use copies of the metadata */
+    if ((options.batch || options.watch_dir != NULL || options.command == FLVMETA_SERVE_COMMAND) && options.metadata != NULL) {
+        amf_data_free(options.metadata);
+    }
+
+    if (options.cache != NULL) {
+        flvmeta_cache_close(options.cache);
     }
+    free(options.metadata_events);
+    free(options.check_disabled_rules);
+    flvmeta_filter_free(options.filter);
 
     return errcode;
 }
@@ -27,6 +27,7 @@
 # include <config.h>
 #endif
 
+#include "filter.h"
 #include "flv.h"
 
 /* copyright string */
@@ -49,6 +50,24 @@
 /* stop file parsing without error */
 #define FLVMETA_DUMP_STOP_OK 10
 
+/* files reported as different by the diff command */
+#define FLVMETA_FILES_DIFFER 11
+
+/* second file of the diff command cannot be opened */
+#define ERROR_OPEN_READ_DIFF 12
+
+/* update whose estimated memory needs exceed the memory cap */
+#define ERROR_MEMORY_LIMIT  13
+
+/* server socket cannot be created */
+#define ERROR_SOCKET        14
+
+/* server request that cannot be understood */
+#define ERROR_INVALID_REQUEST 15
+
+/* watched directory cannot be read or watched */
+#define ERROR_WATCH         16
+
 /* commands */
 #define FLVMETA_DEFAULT_COMMAND     0
 #define FLVMETA_DUMP_COMMAND        1
@@ -57,6 +76,9 @@
 #define FLVMETA_UPDATE_COMMAND      4
 #define FLVMETA_VERSION_COMMAND     5
 #define FLVMETA_HELP_COMMAND        6
+#define FLVMETA_DIFF_COMMAND        7
+#define FLVMETA_SERVE_COMMAND       8
+#define FLVMETA_INVENTORY_COMMAND   9
 
 /* error handling */
 #define FLVMETA_EXIT_ON_ERROR       0
@@ -75,6 +97,32 @@
 #define FLVMETA_FORMAT_JSON         2
 #define FLVMETA_FORMAT_YAML         3
 
+/* full dump tag type filters */
+#define FLVMETA_DUMP_TAG_TYPE_AUDIO 0x01
+#define FLVMETA_DUMP_TAG_TYPE_VIDEO 0x02
+#define FLVMETA_DUMP_TAG_TYPE_META  0x04
+#define FLVMETA_DUMP_TAG_TYPE_OTHER 0x08 /* unknown tag types, never selected by name */
+#define FLVMETA_DUMP_TAG_TYPE_ALL   (FLVMETA_DUMP_TAG_TYPE_AUDIO | FLVMETA_DUMP_TAG_TYPE_VIDEO | FLVMETA_DUMP_TAG_TYPE_META | FLVMETA_DUMP_TAG_TYPE_OTHER)
+
+/* full dump range bounds */
+#define FLVMETA_DUMP_NO_END_TIME    ((uint32)0xFFFFFFFF)
+#define FLVMETA_DUMP_NO_END_OFFSET  ((file_offset_t)-1)
+
+/* maximum number of worker threads */
+#define FLVMETA_MAX_JOBS                256
+
+/* script data event selected for dumping */
+typedef struct __flvmeta_event {
+    const char * name;
+    uint32 limit; /* maximum number of events to dump, 0 if unlimited */
+} flvmeta_event;
+
+/* handler of the informative messages, given with their trailing newline */
+typedef void (* flvmeta_message_proc)(const char * message, void * user_data);
+
+/* results of the commands on unchanged files, defined in cache.h */
+typedef struct __flvmeta_cache flvmeta_cache;
+
 /* flvmeta options */
 typedef struct __flvmeta_opts {
     int command;
@@ -85,14 +133,60 @@ typedef struct __flvmeta_opts {
     int check_level;
     int quiet;
     int check_report_format;
+    int check_quick;
+    int check_structure;
+    int check_nal_units;
+    int check_fail_fast;
+    int * check_disabled_rules;
+    size_t check_disabled_rules_number;
     int insert_onlastsecond;
     int reset_timestamps;
     int all_keyframes;
     int preserve_metadata;
+    uint64 max_memory; /* memory cap of the update in bytes, 0 if unlimited */
+    char * state_file; /* saved analysis of a growing input file, resumed and updated, if any */
     int error_handling;
     int dump_format;
     int verbose;
-    char * metadata_event;
+    flvmeta_message_proc message_proc; /* verbose messages are discarded if NULL */
+    void * message_user_data;
+    FILE * out; /* destination of the reports and dumps */
+    int stats;
+    flvmeta_event * metadata_events;
+    size_t metadata_events_number;
+    int dump_tag_types;
+    int dump_keyframes_only;
+    uint32 dump_start_time;
+    uint32 dump_end_time;
+    file_offset_t dump_start_offset;
+    file_offset_t dump_end_offset;
+    int jobs;
+    int dump_hash;
+    flvmeta_filter * filter;
+    int batch;
+    char ** batch_files; /* input files and directories */
+    size_t batch_files_number;
+    char * batch_list; /* file listing input files, "-" for the standard input */
+    char * batch_output_dir; /* destination of the per-file outputs, if any */
+    char * server_socket; /* path of the socket of the server mode */
+    char * watch_dir; /* directory watched for new files */
+    uint32 watch_delay; /* milliseconds without writes before a watched file is processed */
+    char * cache_file; /* path of the cache of the check and update results, if any */
+    flvmeta_cache * cache; /* opened cache of the check and update results, if any */
 } flvmeta_opts;
 
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* set the default options, without any message handler */
+void flvmeta_opts_init(flvmeta_opts * opts);
+
+/* send a formatted informative message to the message handler, if any */
+void flvmeta_message(const flvmeta_opts * opts, const char * format, ...);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
 #endif /* __FLVMETA_H__ */
@@ -0,0 +1,169 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include <string.h>
+
+#include "hash.h"
+
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+#define xxh_rotl64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+/* read little-endian integers regardless of the host byte order */
+static uint64 xxh_read64(const byte * p) {
+    return (uint64)p[0]
+        | ((uint64)p[1] << 8)
+        | ((uint64)p[2] << 16)
+        | ((uint64)p[3] << 24)
+        | ((uint64)p[4] << 32)
+        | ((uint64)p[5] << 40)
+        | ((uint64)p[6] << 48)
+        | ((uint64)p[7] << 56);
+}
+
+static uint32 xxh_read32(const byte * p) {
+    return (uint32)p[0]
+        | ((uint32)p[1] << 8)
+        | ((uint32)p[2] << 16)
+        | ((uint32)p[3] << 24);
+}
+
+static uint64 xxh64_round(uint64 acc, uint64 input) {
+    acc += input * XXH_PRIME64_2;
+    acc = xxh_rotl64(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+static uint64 xxh64_merge_round(uint64 acc, uint64 val) {
+    acc ^= xxh64_round(0, val);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+/* consume a 32-byte stripe */
+static void xxh64_stripe(uint64 * v, const byte * p) {
+    v[0] = xxh64_round(v[0], xxh_read64(p));
+    v[1] = xxh64_round(v[1], xxh_read64(p + 8));
+    v[2] = xxh64_round(v[2], xxh_read64(p + 16));
+    v[3] = xxh64_round(v[3], xxh_read64(p + 24));
+}
+
+void xxh64_reset(xxh64_state * state, uint64 seed) {
+    state->total_length = 0;
+    state->v[0] = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+    state->v[1] = seed + XXH_PRIME64_2;
+    state->v[2] = seed;
+    state->v[3] = seed - XXH_PRIME64_1;
+    state->buffer_size = 0;
+    state->seed = seed;
+}
+
+void xxh64_update(xxh64_state * state, const void * data, size_t length) {
+    const byte * p = (const byte *)data;
+    const byte * end = p + length;
+
+    state->total_length += length;
+
+    /* not enough data for a full stripe */
+    if (state->buffer_size + length < 32) {
+        memcpy(state->buffer + state->buffer_size, p, length);
+        state->buffer_size += length;
+        return;
+    }
+
+    /* complete the pending stripe */
+    if (state->buffer_size > 0) {
+        size_t fill = 32 - state->buffer_size;
+        memcpy(state->buffer + state->buffer_size, p, fill);
+        xxh64_stripe(state->v, state->buffer);
+        p += fill;
+        state->buffer_size = 0;
+    }
+
+    while (p + 32 <= end) {
+        xxh64_stripe(state->v, p);
+        p += 32;
+    }
+
+    if (p < end) {
+        state->buffer_size = (size_t)(end - p);
+        memcpy(state->buffer, p, state->buffer_size);
+    }
+}
+
+uint64 xxh64_digest(const xxh64_state * state) {
+    const byte * p = state->buffer;
+    const byte * end = p + state->buffer_size;
+    uint64 h;
+
+    if (state->total_length >= 32) {
+        h = xxh_rotl64(state->v[0], 1) + xxh_rotl64(state->v[1], 7)
+            + xxh_rotl64(state->v[2], 12) + xxh_rotl64(state->v[3], 18);
+        h = xxh64_merge_round(h, state->v[0]);
+        h = xxh64_merge_round(h, state->v[1]);
+        h = xxh64_merge_round(h, state->v[2]);
+        h = xxh64_merge_round(h, state->v[3]);
+    }
+    else {
+        h = state->seed + XXH_PRIME64_5;
+    }
+
+    h += state->total_length;
+
+    /* remaining bytes */
+    while (p + 8 <= end) {
+        h ^= xxh64_round(0, xxh_read64(p));
+        h = xxh_rotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        p += 8;
+    }
+
+    if (p + 4 <= end) {
+        h ^= (uint64)xxh_read32(p) * XXH_PRIME64_1;
+        h = xxh_rotl64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+
+    while (p < end) {
+        h ^= (*p) * XXH_PRIME64_5;
+        h = xxh_rotl64(h, 11) * XXH_PRIME64_1;
+        ++p;
+    }
+
+    /* final avalanche */
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+uint64 xxh64(const void * data, size_t length, uint64 seed) {
+    xxh64_state state;
+
+    xxh64_reset(&state, seed);
+    xxh64_update(&state, data, length);
+    return xxh64_digest(&state);
+}
@@ -0,0 +1,61 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#ifndef __HASH_H__
+#define __HASH_H__
+
+#include <stddef.h>
+
+#include "types.h"
+
+/**
+    XXH64 non-cryptographic hash, used to fingerprint tag contents.
+    The output is identical to the reference xxHash implementation.
+*/
+typedef struct __xxh64_state {
+    uint64 total_length;
+    uint64 v[4];
+    byte buffer[32];
+    size_t buffer_size;
+    uint64 seed;
+} xxh64_state;
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* start a new hash computation */
+void xxh64_reset(xxh64_state * state, uint64 seed);
+
+/* hash the given data */
+void xxh64_update(xxh64_state * state, const void * data, size_t length);
+
+/* return the hash of all data given since the last reset */
+uint64 xxh64_digest(const xxh64_state * state);
+
+/* hash a buffer at once */
+uint64 xxh64(const void * data, size_t length, uint64 seed);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __HASH_H__ */
@@ -21,6 +21,8 @@
 */
 #include "info.h"
 #include "avc.h"
+#include "resume.h"
+#include "util.h"
 
 #include <string.h>
 
@@ -167,6 +169,241 @@ static int compute_video_size(flv_stream * flv_in, flv_info * info, uint32 body_
     }
 }
 
+/*
+    initialize the info structure and the state of its computation
+*/
+void flv_info_init(flv_info_state * state, flv_info * info) {
+    memset(state, 0, sizeof(flv_info_state));
+    memset(info, 0, sizeof(flv_info));
+
+    info->original_on_metadata = NULL;
+    info->keyframes = amf_object_new();
+    info->times = amf_array_new();
+    info->filepositions = amf_array_new();
+    amf_object_add(info->keyframes, "times", info->times);
+    amf_object_add(info->keyframes, "filepositions", info->filepositions);
+
+    /* first empty previous tag size */
+    info->total_prev_tags_size = sizeof(uint32_be);
+}
+
+/*
+    account for a tag header, returning its timestamp,
+    fixed for extended timestamps and optionally reset
+*/
+uint32 flv_info_start_tag(flv_info_state * state, flv_info * info, const flv_tag * tag, const flvmeta_opts * opts) {
+    uint32 body_length;
+    uint32 timestamp;
+
+    body_length = flv_tag_get_body_length(*tag);
+    timestamp = flv_tag_get_timestamp(*tag);
+
+    /* extended timestamp fixing */
+    if (tag->type == FLV_TAG_TYPE_META) {
+        if (timestamp < state->prev_timestamp_meta
+        && state->prev_timestamp_meta - timestamp > 0xF00000) {
+            ++state->timestamp_extended_meta;
+        }
+        state->prev_timestamp_meta = timestamp;
+        if (state->timestamp_extended_meta > 0) {
+            timestamp += state->timestamp_extended_meta << 24;
+        }
+    }
+    else if (tag->type == FLV_TAG_TYPE_AUDIO) {
+        if (timestamp < state->prev_timestamp_audio
+        && state->prev_timestamp_audio - timestamp > 0xF00000) {
+            ++state->timestamp_extended_audio;
+        }
+        state->prev_timestamp_audio = timestamp;
+        if (state->timestamp_extended_audio > 0) {
+            timestamp += state->timestamp_extended_audio << 24;
+        }
+    }
+    else if (tag->type == FLV_TAG_TYPE_VIDEO) {
+        if (timestamp < state->prev_timestamp_video
+        && state->prev_timestamp_video - timestamp > 0xF00000) {
+            ++state->timestamp_extended_video;
+        }
+        state->prev_timestamp_video = timestamp;
+        if (state->timestamp_extended_video > 0) {
+            timestamp += state->timestamp_extended_video << 24;
+        }
+    }
+
+    /* non-zero starting timestamp handling */
+    if (!state->have_first_timestamp && tag->type != FLV_TAG_TYPE_META) {
+        info->first_timestamp = timestamp;
+        state->have_first_timestamp = 1;
+    }
+    if (opts->reset_timestamps && timestamp > 0) {
+        timestamp -= info->first_timestamp;
+    }
+
+    /* update the info struct only if the tag is valid */
+    if (tag->type == FLV_TAG_TYPE_META
+    || tag->type == FLV_TAG_TYPE_AUDIO
+    || tag->type == FLV_TAG_TYPE_VIDEO) {
+        if (info->biggest_tag_body_size < body_length) {
+            info->biggest_tag_body_size = body_length;
+        }
+        info->last_timestamp = timestamp;
+    }
+
+    ++state->tag_number;
+    state->timestamp = timestamp;
+    return timestamp;
+}
+
+/*
+    account for a script data tag, whose name and data have been read,
+    or are NULL if the tag is empty
+*/
+void flv_info_add_metadata_tag(flv_info * info, amf_data * name, amf_data * data, uint32 body_length, file_offset_t offset, const flvmeta_opts * opts) {
+    /* check metadata name */
+    if (body_length > 0 && amf_data_get_type(name) == AMF_TYPE_STRING) {
+        char * str = (char *)amf_string_get_bytes(name);
+        size_t len = (size_t)amf_string_get_size(name);
+
+        /* get info only on the first onMetaData we read */
+        if (info->on_metadata_size == 0 && !strncmp(str, "onMetaData", len)) {
+            info->on_metadata_size = body_length + FLV_TAG_SIZE + sizeof(uint32_be);
+            info->on_metadata_offset = offset;
+
+            /* if we want to preserve existing metadata, then extract them */
+            if (opts->preserve_metadata == 1) {
+                /* we need an AMF associative array here, so we must
+                   discard errors and mis-typed data */
+                if (amf_data_get_error_code(data) != AMF_ERROR_OK
+                || amf_data_get_type(data) != AMF_TYPE_ASSOCIATIVE_ARRAY) {
+                    info->original_on_metadata = amf_associative_array_new();
+                }
+                else {
+                    info->original_on_metadata = amf_data_clone(data);
+                    /* the computed keyframes index always replaces the
+                       original one, which can be as big, so drop it early */
+                    amf_data_free(amf_associative_array_delete(info->original_on_metadata, "keyframes"));
+                }
+            }
+        }
+        else {
+            if (!strncmp(str, "onLastSecond", len)) {
+                info->have_on_last_second = 1;
+            }
+            info->meta_data_size += (body_length + FLV_TAG_SIZE);
+            info->total_prev_tags_size += sizeof(uint32_be);
+        }
+    }
+    /* just ignore metadata that don't have a proper name */
+    else {
+        info->meta_data_size += (body_length + FLV_TAG_SIZE);
+        info->total_prev_tags_size += sizeof(uint32_be);
+    }
+}
+
+/*
+    account for a video tag, whose header has been read, or is NULL if
+    the tag is empty, reading the first keyframes to get the video size
+*/
+int flv_info_add_video_tag(flv_info_state * state, flv_info * info, flv_stream * flv_in, flv_video_tag * vt, uint32 body_length, file_offset_t offset, const flvmeta_opts * opts) {
+    uint32 timestamp = state->timestamp;
+    int result;
+
+    if (vt != NULL) {
+        if (info->have_video != 1) {
+            info->have_video = 1;
+            info->video_codec = flv_video_tag_codec_id(vt);
+            info->video_first_timestamp = timestamp;
+        }
+
+        if (state->have_video_size != 1
+        && flv_video_tag_frame_type(vt) == FLV_VIDEO_TAG_FRAME_TYPE_KEYFRAME) {
+            /* read first video frame to get critical info */
+            result = compute_video_size(flv_in, info, body_length - sizeof(flv_video_tag));
+            if (result != FLV_OK) {
+                return result;
+            }
+
+            if (info->video_width > 0 && info->video_height > 0) {
+                state->have_video_size = 1;
+            }
+            /* if we cannot fetch that information from the first tag, we'll try
+               for each following video key frame */
+        }
+
+        /* add keyframe to list */
+        if (flv_video_tag_frame_type(vt) == FLV_VIDEO_TAG_FRAME_TYPE_KEYFRAME) {
+            /* do not add keyframe if the previous one has the same timestamp */
+            if (!info->have_keyframes
+            || (info->have_keyframes && info->last_keyframe_timestamp != timestamp)
+            || opts->all_keyframes) {
+                info->have_keyframes = 1;
+                info->last_keyframe_timestamp = timestamp;
+                amf_array_push(info->times, amf_number_new(timestamp / 1000.0));
+                amf_array_push(info->filepositions, amf_number_new((number64)offset));
+            }
+            /* is last frame a key frame ? if so, we can seek to end */
+            info->can_seek_to_end = 1;
+        }
+        else {
+            info->can_seek_to_end = 0;
+        }
+
+        info->real_video_data_size += (body_length - 1);
+    }
+
+    info->video_frames_number++;
+
+    /*
+        we assume all video frames have the same size as the first one
+    */
+    if (info->video_frame_duration == 0) {
+        info->video_frame_duration = timestamp - info->video_first_timestamp;
+    }
+
+    info->last_media_frame_type = FLV_TAG_TYPE_VIDEO;
+
+    info->video_data_size += (body_length + FLV_TAG_SIZE);
+    info->total_prev_tags_size += sizeof(uint32_be);
+    return FLV_OK;
+}
+
+/*
+    account for an audio tag, whose header has been read, or is NULL if
+    the tag is empty
+*/
+void flv_info_add_audio_tag(flv_info_state * state, flv_info * info, const flv_audio_tag * at, uint32 body_length) {
+    uint32 timestamp = state->timestamp;
+
+    if (at != NULL) {
+        if (info->have_audio != 1) {
+            info->have_audio = 1;
+            info->audio_codec = flv_audio_tag_sound_format(*at);
+            info->audio_rate = flv_audio_tag_sound_rate(*at);
+            info->audio_size = flv_audio_tag_sound_size(*at);
+            info->audio_stereo = flv_audio_tag_sound_type(*at);
+            info->audio_first_timestamp = timestamp;
+        }
+        /* we assume all audio frames have the same size as the first one */
+        if (info->audio_frame_duration == 0) {
+            info->audio_frame_duration = timestamp - info->audio_first_timestamp;
+        }
+
+        info->real_audio_data_size += (body_length - 1);
+    }
+
+    info->last_media_frame_type = FLV_TAG_TYPE_AUDIO;
+
+    info->audio_data_size += (body_length + FLV_TAG_SIZE);
+    info->total_prev_tags_size += sizeof(uint32_be);
+}
+
+/*
+    account for an ignored tag of unknown type
+*/
+void flv_info_add_unknown_tag(flv_info * info) {
+    info->total_prev_tags_size += sizeof(uint32_be);
+}
+
 /*
     read the flv file thoroughly to get all necessary information.
 
@@ -186,147 +423,63 @@ static int compute_video_size(flv_stream * flv_in, flv_info * info, uint32 body_
     - real audio data size, duration to compute audio data rate
     - video headers to find width and height. (depends on the encoding)
 */
-int get_flv_info(flv_stream * flv_in, flv_info * info, const flvmeta_opts * opts) {
-    uint32 prev_timestamp_video;
-    uint32 prev_timestamp_audio;
-    uint32 prev_timestamp_meta;
-    uint8 timestamp_extended_video;
-    uint8 timestamp_extended_audio;
-    uint8 timestamp_extended_meta;
-    uint8 have_video_size;
-    uint8 have_first_timestamp;
-    uint32 tag_number;
+int get_flv_info(flv_stream * flv_in, flv_info * info, const flvmeta_opts * opts, flvmeta_stats * stats) {
+    flv_info_state state;
+    flv_header header;
+    file_offset_t file_size, next_offset;
     int result;
     flv_tag ft;
 
-    info->have_video = 0;
-    info->have_audio = 0;
-    info->video_width = 0;
-    info->video_height = 0;
-    info->video_codec = 0;
-    info->video_frames_number = 0;
-    info->audio_codec = 0;
-    info->audio_size = 0;
-    info->audio_rate = 0;
-    info->audio_stereo = 0;
-    info->video_data_size = 0;
-    info->audio_data_size = 0;
-    info->meta_data_size = 0;
-    info->real_video_data_size = 0;
-    info->real_audio_data_size = 0;
-    info->video_first_timestamp = 0;
-    info->audio_first_timestamp = 0;
-    info->first_timestamp = 0;
-    info->can_seek_to_end = 0;
-    info->have_keyframes = 0;
-    info->last_keyframe_timestamp = 0;
-    info->on_metadata_size = 0;
-    info->on_metadata_offset = 0;
-    info->biggest_tag_body_size = 0;
-    info->last_timestamp = 0;
-    info->video_frame_duration = 0;
-    info->audio_frame_duration = 0;
-    info->total_prev_tags_size = 0;
-    info->have_on_last_second = 0;
-    info->last_media_frame_type = 0;
-    info->original_on_metadata = NULL;
-    info->keyframes = NULL;
-    info->times = NULL;
-    info->filepositions = NULL;
-
     if (opts->verbose) {
-        fprintf(stdout, "Parsing %s...\n", opts->input_file);
+        flvmeta_message(opts, "Parsing %s...\n", opts->input_file);
     }
 
     /*
         read FLV header
     */
 
-    if (flv_read_header(flv_in, &(info->header)) != FLV_OK) {
+    flvmeta_stats_enter(stats, FLVMETA_PHASE_HEADER);
+    if (flv_read_header(flv_in, &header) != FLV_OK) {
+        memset(info, 0, sizeof(flv_info));
         return ERROR_NO_FLV;
     }
 
-    info->keyframes = amf_object_new();
-    info->times = amf_array_new();
-    info->filepositions = amf_array_new();
-    amf_object_add(info->keyframes, "times", info->times);
-    amf_object_add(info->keyframes, "filepositions", info->filepositions);
-
-    /* first empty previous tag size */
-    info->total_prev_tags_size = sizeof(uint32_be);
-
-    /* first timestamp */
-    have_first_timestamp = 0;
+    flv_info_init(&state, info);
+    info->header = header;
 
-    /* extended timestamp initialization */
-    prev_timestamp_video = 0;
-    prev_timestamp_audio = 0;
-    prev_timestamp_meta = 0;
-    timestamp_extended_video = 0;
-    timestamp_extended_audio = 0;
-    timestamp_extended_meta = 0;
-    tag_number = 0;
-    have_video_size = 0;
+    /* resume the analysis of a growing file where the previous one stopped */
+    file_size = 0;
+    next_offset = FLV_HEADER_SIZE + sizeof(uint32_be);
+    if (opts->state_file != NULL) {
+        if (flvmeta_filesize(opts->input_file, &file_size) == 0) {
+            return ERROR_OPEN_READ;
+        }
+        if (resume_load(opts->state_file, flv_in, opts, &state, info, &next_offset) == OK) {
+            if (opts->verbose) {
+                flvmeta_message(opts, "Resuming the analysis at 0x%" FILE_OFFSET_PRINTF_FORMAT "X\n", FILE_OFFSET_PRINTF_TYPE(next_offset));
+            }
+        }
+        if (flv_seek_tag(flv_in, next_offset) != FLV_OK) {
+            return ERROR_EOF;
+        }
+    }
 
+    flvmeta_stats_enter(stats, FLVMETA_PHASE_TAGS);
     while (flv_read_tag(flv_in, &ft) == FLV_OK) {
         file_offset_t offset;
         uint32 body_length;
-        uint32 timestamp;
 
         offset = flv_get_current_tag_offset(flv_in);
         body_length = flv_tag_get_body_length(ft);
-        timestamp = flv_tag_get_timestamp(ft);
-
-        /* extended timestamp fixing */
-        if (ft.type == FLV_TAG_TYPE_META) {
-            if (timestamp < prev_timestamp_meta
-            && prev_timestamp_meta - timestamp > 0xF00000) {
-                ++timestamp_extended_meta;
-            }
-            prev_timestamp_meta = timestamp;
-            if (timestamp_extended_meta > 0) {
-                timestamp += timestamp_extended_meta << 24;
-            }
-        }
-        else if (ft.type == FLV_TAG_TYPE_AUDIO) {
-            if (timestamp < prev_timestamp_audio
-            && prev_timestamp_audio - timestamp > 0xF00000) {
-                ++timestamp_extended_audio;
-            }
-            prev_timestamp_audio = timestamp;
-            if (timestamp_extended_audio > 0) {
-                timestamp += timestamp_extended_audio << 24;
-            }
-        }
-        else if (ft.type == FLV_TAG_TYPE_VIDEO) {
-            if (timestamp < prev_timestamp_video
-            && prev_timestamp_video - timestamp > 0xF00000) {
-                ++timestamp_extended_video;
-            }
-            prev_timestamp_video = timestamp;
-            if (timestamp_extended_video > 0) {
-                timestamp += timestamp_extended_video << 24;
-            }
-        }
 
-        /* non-zero starting timestamp handling */
-        if (!have_first_timestamp && ft.type != FLV_TAG_TYPE_META) {
-            info->first_timestamp = timestamp;
-            have_first_timestamp = 1;
-        }
-        if (opts->reset_timestamps && timestamp > 0) {
-            timestamp -= info->first_timestamp;
+        /* the tag still being written to a growing file is left for the next analysis */
+        if (opts->state_file != NULL && offset + (file_offset_t)(FLV_TAG_SIZE + body_length + sizeof(uint32_be)) > file_size) {
+            break;
         }
 
-        /* update the info struct only if the tag is valid */
-        if (ft.type == FLV_TAG_TYPE_META
-        || ft.type == FLV_TAG_TYPE_AUDIO
-        || ft.type == FLV_TAG_TYPE_VIDEO) {
-            if (info->biggest_tag_body_size < body_length) {
-                info->biggest_tag_body_size = body_length;
-            }
-            info->last_timestamp = timestamp;
-        }
+        flvmeta_stats_enter(stats, FLVMETA_PHASE_INFO);
+        flv_info_start_tag(&state, info, &ft, opts);
+        flvmeta_stats_enter(stats, FLVMETA_PHASE_TAGS);
 
         if (ft.type == FLV_TAG_TYPE_META) {
             amf_data *tag_name, *data;
@@ -335,11 +488,16 @@ int get_flv_info(flv_stream * flv_in, flv_info * info, const flvmeta_opts * opts
 
             if (body_length == 0) {
                 if (opts->verbose) {
-                    fprintf(stdout, "Warning: empty metadata tag at 0x%" FILE_OFFSET_PRINTF_FORMAT "X\n", FILE_OFFSET_PRINTF_TYPE(offset));
+                    flvmeta_message(opts, "Warning: empty metadata tag at 0x%" FILE_OFFSET_PRINTF_FORMAT "X\n", FILE_OFFSET_PRINTF_TYPE(offset));
                 }
             }
             else {
+                flvmeta_stats_enter(stats, FLVMETA_PHASE_METADATA);
                 retval = flv_read_metadata(flv_in, &tag_name, &data);
+                flvmeta_stats_enter(stats, FLVMETA_PHASE_TAGS);
+                if (stats != NULL) {
+                    stats->amf_nodes += amf_data_count_nodes(tag_name) + amf_data_count_nodes(data);
+                }
                 if (retval == FLV_ERROR_EOF) {
                     amf_data_free(tag_name);
                     amf_data_free(data);
@@ -347,12 +505,12 @@ int get_flv_info(flv_stream * flv_in, flv_info * info, const flvmeta_opts * opts
                 }
                 else if (retval == FLV_ERROR_INVALID_METADATA_NAME) {
                     if (opts->verbose) {
-                        fprintf(stdout, "Warning: invalid metadata name at 0x%" FILE_OFFSET_PRINTF_FORMAT "X\n", FILE_OFFSET_PRINTF_TYPE(offset));
+                        flvmeta_message(opts, "Warning: invalid metadata name at 0x%" FILE_OFFSET_PRINTF_FORMAT "X\n", FILE_OFFSET_PRINTF_TYPE(offset));
                     }
                 }
                 else if (retval == FLV_ERROR_INVALID_METADATA) {
                     if (opts->verbose) {
-                        fprintf(stdout, "Warning: invalid metadata at 0x%" FILE_OFFSET_PRINTF_FORMAT "X\n", FILE_OFFSET_PRINTF_TYPE(offset));
+                        flvmeta_message(opts, "Warning: invalid metadata at 0x%" FILE_OFFSET_PRINTF_FORMAT "X\n", FILE_OFFSET_PRINTF_TYPE(offset));
                     }
                     if (opts->error_handling == FLVMETA_EXIT_ON_ERROR) {
                         amf_data_free(tag_name);
@@ -362,50 +520,11 @@ int get_flv_info(flv_stream * flv_in, flv_info * info, const flvmeta_opts * opts
                 }
             }
 
-            /* check metadata name */
-            if (body_length > 0 && amf_data_get_type(tag_name) == AMF_TYPE_STRING) {
-                char * name = (char *)amf_string_get_bytes(tag_name);
-                size_t len = (size_t)amf_string_get_size(tag_name);
-
-                /* get info only on the first onMetaData we read */
-                if (info->on_metadata_size == 0 && !strncmp(name, "onMetaData", len)) {
-                    info->on_metadata_size = body_length + FLV_TAG_SIZE + sizeof(uint32_be);
-                    info->on_metadata_offset = offset;
-
-                    /* if we want to preserve existing metadata, then extract them */
-                    if (opts->preserve_metadata == 1) {
-                        /* we need an AMF associative array here, so we must
-                           discard errors and mis-typed data */
-                        if (amf_data_get_error_code(data) != AMF_ERROR_OK
-                        || amf_data_get_type(data) != AMF_TYPE_ASSOCIATIVE_ARRAY) {
-                            amf_data_free(data);
-                            data = amf_associative_array_new();
-                        }
-
-                        info->original_on_metadata = data;
-                    }
-                    else {
-                        amf_data_free(data);
-                    }
-                }
-                else {
-                    if (!strncmp(name, "onLastSecond", len)) {
-                        info->have_on_last_second = 1;
-                    }
-                    info->meta_data_size += (body_length + FLV_TAG_SIZE);
-                    info->total_prev_tags_size += sizeof(uint32_be);
-                    if (data != NULL) {
-                        amf_data_free(data);
-                    }
-                }
-            }
-            /* just ignore metadata that don't have a proper name */
-            else {
-                info->meta_data_size += (body_length + FLV_TAG_SIZE);
-                info->total_prev_tags_size += sizeof(uint32_be);
-                amf_data_free(data);
-            }
+            flvmeta_stats_enter(stats, FLVMETA_PHASE_INFO);
+            flv_info_add_metadata_tag(info, tag_name, data, body_length, offset, opts);
+            flvmeta_stats_enter(stats, FLVMETA_PHASE_TAGS);
             amf_data_free(tag_name);
+            amf_data_free(data);
         }
         else if (ft.type == FLV_TAG_TYPE_VIDEO) {
             flv_video_tag vt;
@@ -413,69 +532,23 @@ int get_flv_info(flv_stream * flv_in, flv_info * info, const flvmeta_opts * opts
             /* do not take video frame into account if body length is zero and we ignore errors */
             if (body_length == 0) {
                 if (opts->verbose) {
-                    fprintf(stdout, "Warning: empty video tag at 0x%" FILE_OFFSET_PRINTF_FORMAT "X\n", FILE_OFFSET_PRINTF_TYPE(offset));
+                    flvmeta_message(opts, "Warning: empty video tag at 0x%" FILE_OFFSET_PRINTF_FORMAT "X\n", FILE_OFFSET_PRINTF_TYPE(offset));
                 }
+                flvmeta_stats_enter(stats, FLVMETA_PHASE_INFO);
+                result = flv_info_add_video_tag(&state, info, flv_in, NULL, body_length, offset, opts);
+                flvmeta_stats_enter(stats, FLVMETA_PHASE_TAGS);
             }
             else {
                 if (flv_read_video_tag(flv_in, &vt) != FLV_OK) {
                     return ERROR_EOF;
                 }
-
-                if (info->have_video != 1) {
-                    info->have_video = 1;
-                    info->video_codec = flv_video_tag_codec_id(&vt);
-                    info->video_first_timestamp = timestamp;
-                }
-
-                if (have_video_size != 1
-                && flv_video_tag_frame_type(&vt) == FLV_VIDEO_TAG_FRAME_TYPE_KEYFRAME) {
-                    /* read first video frame to get critical info */
-                    result = compute_video_size(flv_in, info, body_length - sizeof(flv_video_tag));
-                    if (result != FLV_OK) {
-                        return result;
-                    }
-
-                    if (info->video_width > 0 && info->video_height > 0) {
-                        have_video_size = 1;
-                    }
-                    /* if we cannot fetch that information from the first tag, we'll try
-                       for each following video key frame */
-                }
-
-                /* add keyframe to list */
-                if (flv_video_tag_frame_type(&vt) == FLV_VIDEO_TAG_FRAME_TYPE_KEYFRAME) {
-                    /* do not add keyframe if the previous one has the same timestamp */
-                    if (!info->have_keyframes
-                    || (info->have_keyframes && info->last_keyframe_timestamp != timestamp)
-                    || opts->all_keyframes) {
-                        info->have_keyframes = 1;
-                        info->last_keyframe_timestamp = timestamp;
-                        amf_array_push(info->times, amf_number_new(timestamp / 1000.0));
-                        amf_array_push(info->filepositions, amf_number_new((number64)offset));
-                    }
-                    /* is last frame a key frame ? if so, we can seek to end */
-                    info->can_seek_to_end = 1;
-                }
-                else {
-                    info->can_seek_to_end = 0;
-                }
-
-                info->real_video_data_size += (body_length - 1);
+                flvmeta_stats_enter(stats, FLVMETA_PHASE_INFO);
+                result = flv_info_add_video_tag(&state, info, flv_in, &vt, body_length, offset, opts);
+                flvmeta_stats_enter(stats, FLVMETA_PHASE_TAGS);
             }
-
-            info->video_frames_number++;
-
-            /*
-                we assume all video frames have the same size as the first one
-            */
-            if (info->video_frame_duration == 0) {
-                info->video_frame_duration = timestamp - info->video_first_timestamp;
+            if (result != FLV_OK) {
+                return result;
             }
-
-            info->last_media_frame_type = FLV_TAG_TYPE_VIDEO;
-
-            info->video_data_size += (body_length + FLV_TAG_SIZE);
-            info->total_prev_tags_size += sizeof(uint32_be);
         }
         else if (ft.type == FLV_TAG_TYPE_AUDIO) {
             flv_audio_tag at;
@@ -483,34 +556,20 @@ int get_flv_info(flv_stream * flv_in, flv_info * info, const flvmeta_opts * opts
             /* do not take audio frame into account if body length is zero and we ignore errors */
             if (body_length == 0) {
                 if (opts->verbose) {
-                    fprintf(stdout, "Warning: empty audio tag at 0x%" FILE_OFFSET_PRINTF_FORMAT "X\n", FILE_OFFSET_PRINTF_TYPE(offset));
+                    flvmeta_message(opts, "Warning: empty audio tag at 0x%" FILE_OFFSET_PRINTF_FORMAT "X\n", FILE_OFFSET_PRINTF_TYPE(offset));
                 }
+                flvmeta_stats_enter(stats, FLVMETA_PHASE_INFO);
+                flv_info_add_audio_tag(&state, info, NULL, body_length);
+                flvmeta_stats_enter(stats, FLVMETA_PHASE_TAGS);
             }
             else {
                 if (flv_read_audio_tag(flv_in, &at) != FLV_OK) {
                     return ERROR_EOF;
                 }
-
-                if (info->have_audio != 1) {
-                    info->have_audio = 1;
-                    info->audio_codec = flv_audio_tag_sound_format(at);
-                    info->audio_rate = flv_audio_tag_sound_rate(at);
-                    info->audio_size = flv_audio_tag_sound_size(at);
-                    info->audio_stereo = flv_audio_tag_sound_type(at);
-                    info->audio_first_timestamp = timestamp;
-                }
-                /* we assume all audio frames have the same size as the first one */
-                if (info->audio_frame_duration == 0) {
-                    info->audio_frame_duration = timestamp - info->audio_first_timestamp;
-                }
-
-                info->real_audio_data_size += (body_length - 1);
+                flvmeta_stats_enter(stats, FLVMETA_PHASE_INFO);
+                flv_info_add_audio_tag(&state, info, &at, body_length);
+                flvmeta_stats_enter(stats, FLVMETA_PHASE_TAGS);
             }
-
-            info->last_media_frame_type = FLV_TAG_TYPE_AUDIO;
-
-            info->audio_data_size += (body_length + FLV_TAG_SIZE);
-            info->total_prev_tags_size += sizeof(uint32_be);
         }
         else {
             if (opts->error_handling == FLVMETA_FIX_ERRORS) {
@@ -519,24 +578,50 @@ int get_flv_info(flv_stream * flv_in, flv_info * info, const flvmeta_opts * opts
             else if (opts->error_handling == FLVMETA_IGNORE_ERRORS) {
                 /* let's continue the parsing */
                 if (opts->verbose) {
-                    fprintf(stdout, "Warning: invalid tag at 0x%" FILE_OFFSET_PRINTF_FORMAT "X\n", FILE_OFFSET_PRINTF_TYPE(offset));
+                    flvmeta_message(opts, "Warning: invalid tag at 0x%" FILE_OFFSET_PRINTF_FORMAT "X\n", FILE_OFFSET_PRINTF_TYPE(offset));
                 }
-                info->total_prev_tags_size += sizeof(uint32_be);
+                flvmeta_stats_enter(stats, FLVMETA_PHASE_INFO);
+                flv_info_add_unknown_tag(info);
+                flvmeta_stats_enter(stats, FLVMETA_PHASE_TAGS);
             }
             else {
                 return ERROR_INVALID_TAG;
             }
         }
-        ++tag_number;
+
+        next_offset = offset + FLV_TAG_SIZE + body_length + sizeof(uint32_be);
     }
 
     if (opts->verbose) {
-        fprintf(stdout, "Found %d tags\n", tag_number);
+        flvmeta_message(opts, "Found %d tags\n", state.tag_number);
+    }
+
+    /* save the analysis for the next refresh, which only reads the tags appended */
+    if (opts->state_file != NULL) {
+        info->end_offset = next_offset;
+        if (resume_save(opts->state_file, flv_in, opts, &state, info, next_offset) != OK && opts->verbose) {
+            flvmeta_message(opts, "Warning: cannot save the analysis to %s\n", opts->state_file);
+        }
     }
 
     return OK;
 }
 
+number64 flv_info_get_duration(const flv_info * info, const flvmeta_opts * opts) {
+    number64 first_timestamp = opts->reset_timestamps ? 0.0 : (number64)info->first_timestamp;
+
+    if (info->last_media_frame_type == FLV_TAG_TYPE_AUDIO) {
+        return ((number64)info->last_timestamp - first_timestamp + info->audio_frame_duration) / 1000.0;
+    }
+    else if (info->last_media_frame_type == FLV_TAG_TYPE_VIDEO) {
+        return ((number64)info->last_timestamp - first_timestamp + info->video_frame_duration) / 1000.0;
+    }
+    else {
+        /* no last frame type means no audio and no video, therefore no duration */
+        return 0.0;
+    }
+}
+
 /*
     compute the metadata
 */
@@ -550,7 +635,7 @@ void compute_metadata(flv_info * info, flv_metadata * meta, const flvmeta_opts *
     amf_node * node_f;
 
     if (opts->verbose) {
-        fprintf(stdout, "Computing metadata...\n");
+        flvmeta_message(opts, "Computing metadata...\n");
     }
 
     meta->on_last_second_name = amf_str("onLastSecond");
@@ -568,17 +653,7 @@ void compute_metadata(flv_info * info, flv_metadata * meta, const flvmeta_opts *
     amf_associative_array_add(meta->on_metadata, "hasVideo", amf_boolean_new(info->have_video));
     amf_associative_array_add(meta->on_metadata, "hasAudio", amf_boolean_new(info->have_audio));
 
-    if (info->last_media_frame_type == FLV_TAG_TYPE_AUDIO) {
-        duration = ((number64)info->last_timestamp - (opts->reset_timestamps ? 0.0 : (number64)info->first_timestamp) + info->audio_frame_duration) / 1000.0;
-    }
-    else if (info->last_media_frame_type == FLV_TAG_TYPE_VIDEO) {
-        duration = ((number64)info->last_timestamp - (opts->reset_timestamps ? 0.0 : (number64)info->first_timestamp) + info->video_frame_duration) / 1000.0;
-    }
-    else {
-        /* no last frame type means no audio and no video, therefore no duration */
-        duration = 0.0;
-    }
-
+    duration = flv_info_get_duration(info, opts);
     amf_associative_array_add(meta->on_metadata, "duration", amf_number_new(duration));
 
     amf_associative_array_add(meta->on_metadata, "lasttimestamp", amf_number_new(info->last_timestamp / 1000.0));
@@ -23,6 +23,7 @@
 #define __INFO_H__
 
 #include "flvmeta.h"
+#include "stats.h"
 
 typedef struct __flv_info {
     flv_header header;
@@ -56,12 +57,27 @@ typedef struct __flv_info {
     file_offset_t total_prev_tags_size;
     uint8 have_on_last_second;
     uint8 last_media_frame_type;
+    file_offset_t end_offset; /* end of the analyzed tags of a growing file, 0 if the whole file was read */
     amf_data * original_on_metadata;
     amf_data * keyframes;
     amf_data * times;
     amf_data * filepositions;
 } flv_info;
 
+/* state of the tag by tag computation of the info structure */
+typedef struct __flv_info_state {
+    uint32 prev_timestamp_video;
+    uint32 prev_timestamp_audio;
+    uint32 prev_timestamp_meta;
+    uint8 timestamp_extended_video;
+    uint8 timestamp_extended_audio;
+    uint8 timestamp_extended_meta;
+    uint8 have_video_size;
+    uint8 have_first_timestamp;
+    uint32 tag_number;
+    uint32 timestamp; /* fixed timestamp of the current tag */
+} flv_info_state;
+
 typedef struct __flv_metadata {
     amf_data * on_last_second_name;
     amf_data * on_last_second;
@@ -73,7 +89,19 @@ typedef struct __flv_metadata {
 extern "C" {
 #endif /* __cplusplus */
 
-int get_flv_info(flv_stream * flv_in, flv_info * info, const flvmeta_opts * opts);
+/* collect the file information, charging the time spent to stats if not NULL */
+int get_flv_info(flv_stream * flv_in, flv_info * info, const flvmeta_opts * opts, flvmeta_stats * stats);
+
+/* tag by tag computation, allowing callers to collect info while reading the file */
+void flv_info_init(flv_info_state * state, flv_info * info);
+uint32 flv_info_start_tag(flv_info_state * state, flv_info * info, const flv_tag * tag, const flvmeta_opts * opts);
+void flv_info_add_metadata_tag(flv_info * info, amf_data * name, amf_data * data, uint32 body_length, file_offset_t offset, const flvmeta_opts * opts);
+int flv_info_add_video_tag(flv_info_state * state, flv_info * info, flv_stream * flv_in, flv_video_tag * vt, uint32 body_length, file_offset_t offset, const flvmeta_opts * opts);
+void flv_info_add_audio_tag(flv_info_state * state, flv_info * info, const flv_audio_tag * at, uint32 body_length);
+void flv_info_add_unknown_tag(flv_info * info);
+
+/* duration of the file in seconds, including its last frame */
+number64 flv_info_get_duration(const flv_info * info, const flvmeta_opts * opts);
 
 void compute_metadata(flv_info * info, flv_metadata * meta, const flvmeta_opts * opts);
 
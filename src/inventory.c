@@ -0,0 +1,659 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "inventory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch.h"
+#include "check.h"
+#include "dump.h"
+#include "info.h"
+#include "json.h"
+#include "pool.h"
+#include "util.h"
+
+/* name of the codecs of the files without video or audio */
+#define INVENTORY_NONE "none"
+
+/* summary of a single input file, computed by a worker */
+typedef struct __inventory_file {
+    flvmeta_task task;
+    flvmeta_opts options;
+    char * input_file;
+    int submitted;
+    int result; /* OK, or the error preventing the analysis */
+    char code[7]; /* first error found by the quick check, if any */
+    char * message;
+    file_offset_t filesize;
+    number64 duration;
+    uint8 have_video;
+    uint8 have_audio;
+    uint32_be video_codec;
+    uint8 audio_codec;
+    uint32 video_width;
+    uint32 video_height;
+    uint8 have_on_metadata;
+    uint8 have_keyframes;
+} inventory_file;
+
+/* number of files sharing a codec */
+typedef struct __inventory_name_count {
+    const char * name;
+    unsigned long files;
+} inventory_name_count;
+
+/* number of files sharing a resolution, 0x0 if unknown */
+typedef struct __inventory_resolution_count {
+    uint32 width;
+    uint32 height;
+    unsigned long files;
+} inventory_resolution_count;
+
+/* file failing the analysis or the quick check */
+typedef struct __inventory_failure {
+    char * input_file;
+    char code[7]; /* empty if the file could not be analyzed */
+    char * message;
+} inventory_failure;
+
+/* summary of the whole archive */
+typedef struct __inventory {
+    const flvmeta_opts * options;
+    flvmeta_pool * pool;
+    inventory_file * jobs;
+    size_t jobs_number;
+    size_t first_job;
+    size_t pending_jobs;
+    int result;
+
+    unsigned long files;
+    unsigned long analyzed_files;
+    file_offset_t total_size;
+    number64 total_duration;
+    inventory_name_count * video_codecs;
+    size_t video_codecs_number;
+    inventory_name_count * audio_formats;
+    size_t audio_formats_number;
+    inventory_resolution_count * resolutions;
+    size_t resolutions_number;
+    unsigned long bitrates[INVENTORY_BITRATE_CLASSES_NUMBER];
+    unsigned long unknown_bitrates;
+    unsigned long missing_on_metadata;
+    unsigned long missing_keyframes;
+    inventory_failure * failures;
+    size_t failures_number;
+} inventory;
+
+static const uint32 inventory_bitrate_classes[INVENTORY_BITRATE_CLASSES_NUMBER - 1] = INVENTORY_BITRATE_CLASSES;
+
+/* copy of a string */
+static char * inventory_strdup(const char * str) {
+    size_t size = strlen(str) + 1;
+    char * copy = (char *)malloc(size);
+
+    if (copy != NULL) {
+        memcpy(copy, str, size);
+    }
+    return copy;
+}
+
+/* description of the errors preventing the analysis of a file */
+static const char * inventory_get_error_string(int result) {
+    switch (result) {
+        case ERROR_OPEN_READ: return "cannot open for reading";
+        case ERROR_NO_FLV: return "not a valid FLV file";
+        case ERROR_EOF: return "unexpected end of file";
+        case ERROR_MEMORY: return "memory allocation error";
+        case ERROR_EMPTY_TAG: return "empty FLV tag";
+        case ERROR_INVALID_TAG: return "invalid FLV tag";
+        default: return "cannot be analyzed";
+    }
+}
+
+/* whether the onMetaData tag at the given offset has a keyframes index */
+static int inventory_has_keyframes(flv_stream * flv_in, file_offset_t offset) {
+    flv_tag tag;
+    amf_data * name;
+    amf_data * data;
+    amf_data * keyframes;
+    int have_keyframes;
+
+    if (flv_seek_tag(flv_in, offset) != FLV_OK || flv_read_tag(flv_in, &tag) != FLV_OK) {
+        return 0;
+    }
+
+    name = NULL;
+    data = NULL;
+    have_keyframes = 0;
+    if (flv_read_metadata(flv_in, &name, &data) == FLV_OK
+    && (amf_data_get_type(data) == AMF_TYPE_ASSOCIATIVE_ARRAY || amf_data_get_type(data) == AMF_TYPE_OBJECT)) {
+        keyframes = amf_object_get(data, "keyframes");
+        have_keyframes = (keyframes != NULL && amf_data_get_type(keyframes) == AMF_TYPE_OBJECT
+            && amf_object_get(keyframes, "times") != NULL
+            && amf_object_get(keyframes, "filepositions") != NULL);
+    }
+
+    amf_data_free(name);
+    amf_data_free(data);
+    return have_keyframes;
+}
+
+/* worker task: quick check and file information of an input file */
+static void inventory_analyze(void * data) {
+    inventory_file * file = (inventory_file *)data;
+    flv_stream * flv_in;
+    check_result findings;
+    flv_info info;
+    size_t i;
+
+    if (flvmeta_filesize(file->input_file, &file->filesize) == 0) {
+        file->result = ERROR_OPEN_READ;
+        return;
+    }
+
+    flv_in = flv_open(file->input_file);
+    if (flv_in == NULL) {
+        file->result = ERROR_OPEN_READ;
+        return;
+    }
+
+    /* the first error found by the quick check, which stops there */
+    check_flv_stream(flv_in, &file->options, &findings);
+    for (i = 0; i < findings.findings_number; ++i) {
+        if (findings.findings[i].level >= FLVMETA_CHECK_LEVEL_ERROR) {
+            memcpy(file->code, findings.findings[i].code, sizeof(file->code));
+            file->message = findings.findings[i].message;
+            findings.findings[i].message = NULL;
+            break;
+        }
+    }
+    check_result_free(&findings);
+
+    flv_reset(flv_in);
+    file->result = get_flv_info(flv_in, &info, &file->options, NULL);
+    if (file->result == OK) {
+        file->duration = flv_info_get_duration(&info, &file->options);
+        file->have_video = info.have_video;
+        file->have_audio = info.have_audio;
+        file->video_codec = info.video_codec;
+        file->audio_codec = info.audio_codec;
+        file->video_width = info.video_width;
+        file->video_height = info.video_height;
+        file->have_on_metadata = (info.on_metadata_size > 0);
+        if (file->have_on_metadata) {
+            file->have_keyframes = inventory_has_keyframes(flv_in, info.on_metadata_offset);
+        }
+    }
+
+    amf_data_free(info.keyframes);
+    amf_data_free(info.original_on_metadata);
+    flv_close(flv_in);
+}
+
+/* prepare the analysis of an input file, and submit it unless it has already failed */
+static void inventory_start_job(inventory * inv, char * input_file, int result) {
+    inventory_file * file;
+
+    file = &inv->jobs[(inv->first_job + inv->pending_jobs) % inv->jobs_number];
+    inv->pending_jobs++;
+
+    memset(file, 0, sizeof(inventory_file));
+    memcpy(&file->options, inv->options, sizeof(flvmeta_opts));
+    file->options.input_file = input_file;
+    file->options.output_file = input_file;
+    file->options.metadata = NULL;
+    file->options.state_file = NULL;
+    file->options.preserve_metadata = 0;
+    file->options.check_level = FLVMETA_CHECK_LEVEL_ERROR;
+    file->options.check_quick = 1;
+    file->options.check_fail_fast = 1;
+    file->options.stats = 0;
+    file->options.verbose = 0;
+    file->options.message_proc = NULL;
+    file->options.jobs = 1;
+    file->input_file = input_file;
+    file->result = result;
+
+    if (result == OK) {
+        file->submitted = 1;
+        flvmeta_pool_submit(inv->pool, &file->task, inventory_analyze, file);
+    }
+}
+
+/* add a file to the count of its codec */
+static int inventory_count_name(inventory_name_count ** counts, size_t * counts_number, const char * name) {
+    inventory_name_count * new_counts;
+    size_t i;
+
+    for (i = 0; i < *counts_number; ++i) {
+        if (!strcmp((*counts)[i].name, name)) {
+            (*counts)[i].files++;
+            return OK;
+        }
+    }
+
+    new_counts = (inventory_name_count *)realloc(*counts, (*counts_number + 1) * sizeof(inventory_name_count));
+    if (new_counts == NULL) {
+        return ERROR_MEMORY;
+    }
+    new_counts[*counts_number].name = name;
+    new_counts[*counts_number].files = 1;
+    *counts = new_counts;
+    (*counts_number)++;
+    return OK;
+}
+
+/* add a file to the count of its resolution */
+static int inventory_count_resolution(inventory * inv, uint32 width, uint32 height) {
+    inventory_resolution_count * resolutions;
+    size_t i;
+
+    for (i = 0; i < inv->resolutions_number; ++i) {
+        if (inv->resolutions[i].width == width && inv->resolutions[i].height == height) {
+            inv->resolutions[i].files++;
+            return OK;
+        }
+    }
+
+    resolutions = (inventory_resolution_count *)realloc(inv->resolutions,
+        (inv->resolutions_number + 1) * sizeof(inventory_resolution_count));
+    if (resolutions == NULL) {
+        return ERROR_MEMORY;
+    }
+    resolutions[inv->resolutions_number].width = width;
+    resolutions[inv->resolutions_number].height = height;
+    resolutions[inv->resolutions_number].files = 1;
+    inv->resolutions = resolutions;
+    inv->resolutions_number++;
+    return OK;
+}
+
+/* add a file to the list of the failed files */
+static int inventory_add_failure(inventory * inv, inventory_file * file) {
+    inventory_failure * failures;
+    inventory_failure * failure;
+
+    failures = (inventory_failure *)realloc(inv->failures, (inv->failures_number + 1) * sizeof(inventory_failure));
+    if (failures == NULL) {
+        return ERROR_MEMORY;
+    }
+    inv->failures = failures;
+
+    failure = &failures[inv->failures_number];
+    if (file->message != NULL) {
+        memcpy(failure->code, file->code, sizeof(failure->code));
+        failure->message = file->message;
+    }
+    else {
+        failure->code[0] = '\0';
+        failure->message = inventory_strdup(inventory_get_error_string(file->result));
+        if (failure->message == NULL) {
+            return ERROR_MEMORY;
+        }
+    }
+    failure->input_file = file->input_file;
+    file->message = NULL;
+    file->input_file = NULL;
+    inv->failures_number++;
+    return OK;
+}
+
+/* add the summary of a file to the summary of the archive */
+static int inventory_add_file(inventory * inv, inventory_file * file) {
+    number64 bitrate;
+    const char * name;
+    int result;
+    size_t i;
+
+    inv->files++;
+    if (file->result != OK || file->message != NULL) {
+        result = inventory_add_failure(inv, file);
+        if (result != OK || file->result != OK) {
+            return result;
+        }
+    }
+
+    inv->analyzed_files++;
+    inv->total_size += file->filesize;
+    inv->total_duration += file->duration;
+
+    name = file->have_video ? dump_string_get_video_codec_id(file->video_codec) : INVENTORY_NONE;
+    result = inventory_count_name(&inv->video_codecs, &inv->video_codecs_number, name);
+    if (result != OK) {
+        return result;
+    }
+
+    name = file->have_audio ? dump_string_get_sound_format_id(file->audio_codec) : INVENTORY_NONE;
+    result = inventory_count_name(&inv->audio_formats, &inv->audio_formats_number, name);
+    if (result != OK) {
+        return result;
+    }
+
+    if (file->have_video) {
+        result = inventory_count_resolution(inv, file->video_width, file->video_height);
+        if (result != OK) {
+            return result;
+        }
+    }
+
+    /* overall bitrate of the file, including the container overhead */
+    if (file->duration > 0) {
+        bitrate = (number64)file->filesize * 8.0 / 1000.0 / file->duration;
+        for (i = 0; i < INVENTORY_BITRATE_CLASSES_NUMBER - 1; ++i) {
+            if (bitrate < inventory_bitrate_classes[i]) {
+                break;
+            }
+        }
+        inv->bitrates[i]++;
+    }
+    else {
+        inv->unknown_bitrates++;
+    }
+
+    if (!file->have_on_metadata) {
+        inv->missing_on_metadata++;
+    }
+    if (file->have_video && !file->have_keyframes) {
+        inv->missing_keyframes++;
+    }
+    return OK;
+}
+
+/* wait for the oldest input file, and add it to the summary */
+static void inventory_finish_job(inventory * inv) {
+    inventory_file * file = &inv->jobs[inv->first_job];
+    int result;
+
+    if (file->submitted) {
+        flvmeta_pool_wait(inv->pool, &file->task);
+    }
+
+    result = inventory_add_file(inv, file);
+    if (result != OK && inv->result == OK) {
+        inv->result = result;
+    }
+
+    free(file->input_file);
+    free(file->message);
+    inv->first_job = (inv->first_job + 1) % inv->jobs_number;
+    inv->pending_jobs--;
+}
+
+/* most frequent first, then in alphabetical order */
+static int inventory_compare_names(const void * a, const void * b) {
+    const inventory_name_count * na = (const inventory_name_count *)a;
+    const inventory_name_count * nb = (const inventory_name_count *)b;
+
+    if (na->files != nb->files) {
+        return (na->files > nb->files) ? -1 : 1;
+    }
+    return strcmp(na->name, nb->name);
+}
+
+/* most frequent first, then by decreasing size */
+static int inventory_compare_resolutions(const void * a, const void * b) {
+    const inventory_resolution_count * ra = (const inventory_resolution_count *)a;
+    const inventory_resolution_count * rb = (const inventory_resolution_count *)b;
+
+    if (ra->files != rb->files) {
+        return (ra->files > rb->files) ? -1 : 1;
+    }
+    if (ra->width != rb->width) {
+        return (ra->width > rb->width) ? -1 : 1;
+    }
+    if (ra->height != rb->height) {
+        return (ra->height > rb->height) ? -1 : 1;
+    }
+    return 0;
+}
+
+/* format a resolution as WIDTHxHEIGHT, or unknown */
+static void inventory_format_resolution(char * buffer, size_t size, const inventory_resolution_count * resolution) {
+    if (resolution->width == 0 || resolution->height == 0) {
+        snprintf(buffer, size, "unknown");
+    }
+    else {
+        snprintf(buffer, size, "%ux%u", resolution->width, resolution->height);
+    }
+}
+
+/* format a bitrate class as MIN-MAX, or MIN+ for the last one */
+static void inventory_format_bitrate_class(char * buffer, size_t size, size_t index) {
+    uint32 min = (index > 0) ? inventory_bitrate_classes[index - 1] : 0;
+
+    if (index < INVENTORY_BITRATE_CLASSES_NUMBER - 1) {
+        snprintf(buffer, size, "%u-%u", min, inventory_bitrate_classes[index]);
+    }
+    else {
+        snprintf(buffer, size, "%u+", min);
+    }
+}
+
+/* print the summary as text */
+static void inventory_print_raw(const inventory * inv, FILE * out) {
+    char buffer[32];
+    size_t i;
+
+    fprintf(out, "files: %lu\n", inv->files);
+    fprintf(out, "analyzed files: %lu\n", inv->analyzed_files);
+    fprintf(out, "total size: %" FILE_OFFSET_PRINTF_FORMAT "d bytes\n", FILE_OFFSET_PRINTF_TYPE(inv->total_size));
+    fprintf(out, "total duration: %.3f s\n", inv->total_duration);
+
+    fprintf(out, "video codecs:\n");
+    for (i = 0; i < inv->video_codecs_number; ++i) {
+        fprintf(out, "  %s: %lu\n", inv->video_codecs[i].name, inv->video_codecs[i].files);
+    }
+
+    fprintf(out, "audio formats:\n");
+    for (i = 0; i < inv->audio_formats_number; ++i) {
+        fprintf(out, "  %s: %lu\n", inv->audio_formats[i].name, inv->audio_formats[i].files);
+    }
+
+    fprintf(out, "resolutions:\n");
+    for (i = 0; i < inv->resolutions_number; ++i) {
+        inventory_format_resolution(buffer, sizeof(buffer), &inv->resolutions[i]);
+        fprintf(out, "  %s: %lu\n", buffer, inv->resolutions[i].files);
+    }
+
+    fprintf(out, "bitrates (kbit/s):\n");
+    for (i = 0; i < INVENTORY_BITRATE_CLASSES_NUMBER; ++i) {
+        inventory_format_bitrate_class(buffer, sizeof(buffer), i);
+        fprintf(out, "  %s: %lu\n", buffer, inv->bitrates[i]);
+    }
+    fprintf(out, "  unknown: %lu\n", inv->unknown_bitrates);
+
+    fprintf(out, "missing onMetaData: %lu\n", inv->missing_on_metadata);
+    fprintf(out, "missing keyframes: %lu\n", inv->missing_keyframes);
+
+    fprintf(out, "failed files: %lu\n", (unsigned long)inv->failures_number);
+    for (i = 0; i < inv->failures_number; ++i) {
+        if (inv->failures[i].code[0] != '\0') {
+            fprintf(out, "  %s: %s %s\n", inv->failures[i].input_file, inv->failures[i].code, inv->failures[i].message);
+        }
+        else {
+            fprintf(out, "  %s: %s\n", inv->failures[i].input_file, inv->failures[i].message);
+        }
+    }
+}
+
+/* print the summary as a JSON object */
+static void inventory_print_json(const inventory * inv, FILE * out) {
+    json_emitter je;
+    char buffer[32];
+    size_t i;
+
+    json_emit_init_file(&je, out);
+    json_emit_object_start(&je);
+
+    json_emit_object_key_z(&je, "files");
+    json_emit_file_offset(&je, inv->files);
+    json_emit_object_key_z(&je, "analyzed_files");
+    json_emit_file_offset(&je, inv->analyzed_files);
+    json_emit_object_key_z(&je, "total_size");
+    json_emit_file_offset(&je, inv->total_size);
+    json_emit_object_key_z(&je, "total_duration");
+    json_emit_number(&je, inv->total_duration);
+
+    json_emit_object_key_z(&je, "video_codecs");
+    json_emit_object_start(&je);
+    for (i = 0; i < inv->video_codecs_number; ++i) {
+        json_emit_object_key_z(&je, inv->video_codecs[i].name);
+        json_emit_file_offset(&je, inv->video_codecs[i].files);
+    }
+    json_emit_object_end(&je);
+
+    json_emit_object_key_z(&je, "audio_formats");
+    json_emit_object_start(&je);
+    for (i = 0; i < inv->audio_formats_number; ++i) {
+        json_emit_object_key_z(&je, inv->audio_formats[i].name);
+        json_emit_file_offset(&je, inv->audio_formats[i].files);
+    }
+    json_emit_object_end(&je);
+
+    json_emit_object_key_z(&je, "resolutions");
+    json_emit_object_start(&je);
+    for (i = 0; i < inv->resolutions_number; ++i) {
+        inventory_format_resolution(buffer, sizeof(buffer), &inv->resolutions[i]);
+        json_emit_object_key_z(&je, buffer);
+        json_emit_file_offset(&je, inv->resolutions[i].files);
+    }
+    json_emit_object_end(&je);
+
+    json_emit_object_key_z(&je, "bitrates");
+    json_emit_object_start(&je);
+    for (i = 0; i < INVENTORY_BITRATE_CLASSES_NUMBER; ++i) {
+        inventory_format_bitrate_class(buffer, sizeof(buffer), i);
+        json_emit_object_key_z(&je, buffer);
+        json_emit_file_offset(&je, inv->bitrates[i]);
+    }
+    json_emit_object_key_z(&je, "unknown");
+    json_emit_file_offset(&je, inv->unknown_bitrates);
+    json_emit_object_end(&je);
+
+    json_emit_object_key_z(&je, "missing_on_metadata");
+    json_emit_file_offset(&je, inv->missing_on_metadata);
+    json_emit_object_key_z(&je, "missing_keyframes");
+    json_emit_file_offset(&je, inv->missing_keyframes);
+
+    json_emit_object_key_z(&je, "failed_files");
+    json_emit_array_start(&je);
+    for (i = 0; i < inv->failures_number; ++i) {
+        json_emit_object_start(&je);
+        json_emit_object_key_z(&je, "file");
+        json_emit_string_z(&je, inv->failures[i].input_file);
+        if (inv->failures[i].code[0] != '\0') {
+            json_emit_object_key_z(&je, "code");
+            json_emit_string_z(&je, inv->failures[i].code);
+        }
+        json_emit_object_key_z(&je, "message");
+        json_emit_string_z(&je, inv->failures[i].message);
+        json_emit_object_end(&je);
+    }
+    json_emit_array_end(&je);
+
+    json_emit_object_end(&je);
+    fprintf(out, "\n");
+}
+
+int inventory_run(const flvmeta_opts * options) {
+    inventory inv;
+    batch_source * source;
+    char * input_file;
+    int result;
+    size_t i;
+
+    memset(&inv, 0, sizeof(inventory));
+    inv.options = options;
+    inv.result = OK;
+
+    source = batch_source_new(options);
+    if (source == NULL) {
+        return ERROR_MEMORY;
+    }
+
+    inv.pool = flvmeta_pool_new(options->jobs);
+    if (inv.pool == NULL) {
+        batch_source_free(source);
+        return ERROR_MEMORY;
+    }
+
+    inv.jobs_number = (size_t)flvmeta_pool_get_threads(inv.pool) * BATCH_JOBS_PER_THREAD;
+    inv.jobs = (inventory_file *)calloc(inv.jobs_number, sizeof(inventory_file));
+    if (inv.jobs == NULL) {
+        flvmeta_pool_free(inv.pool);
+        batch_source_free(source);
+        return ERROR_MEMORY;
+    }
+
+    while (inv.result == OK) {
+        if (inv.pending_jobs == inv.jobs_number) {
+            inventory_finish_job(&inv);
+            continue;
+        }
+
+        /* unreadable lists and directories are reported as failed files */
+        input_file = batch_source_next(source, &result);
+        if (input_file == NULL) {
+            if (result != OK) {
+                inv.result = result;
+            }
+            break;
+        }
+        inventory_start_job(&inv, input_file, result);
+    }
+
+    while (inv.pending_jobs > 0) {
+        inventory_finish_job(&inv);
+    }
+
+    batch_source_free(source);
+    flvmeta_pool_free(inv.pool);
+    free(inv.jobs);
+
+    if (inv.result == OK) {
+        qsort(inv.video_codecs, inv.video_codecs_number, sizeof(inventory_name_count), inventory_compare_names);
+        qsort(inv.audio_formats, inv.audio_formats_number, sizeof(inventory_name_count), inventory_compare_names);
+        qsort(inv.resolutions, inv.resolutions_number, sizeof(inventory_resolution_count), inventory_compare_resolutions);
+
+        if (options->check_report_format == FLVMETA_FORMAT_JSON) {
+            inventory_print_json(&inv, options->out);
+        }
+        else {
+            inventory_print_raw(&inv, options->out);
+        }
+        if (fflush(options->out) != 0 || ferror(options->out)) {
+            inv.result = ERROR_WRITE;
+        }
+    }
+
+    for (i = 0; i < inv.failures_number; ++i) {
+        free(inv.failures[i].input_file);
+        free(inv.failures[i].message);
+    }
+    free(inv.failures);
+    free(inv.video_codecs);
+    free(inv.audio_formats);
+    free(inv.resolutions);
+    return inv.result;
+}
@@ -0,0 +1,55 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#ifndef __INVENTORY_H__
+#define __INVENTORY_H__
+
+#include "flvmeta.h"
+
+/**
+    Inventory of an archive.
+    Every input file given as argument, found in a directory, or listed in a
+    file, is analyzed on a pool of worker threads, running the quick check and
+    collecting its file information, and a single summary of the whole archive
+    is printed: codecs, resolutions, duration, bitrates, missing metadata, and
+    the files failing the check.
+*/
+
+/* upper bounds in kbit/s of the bitrate distribution, the last class having none */
+#define INVENTORY_BITRATE_CLASSES { 250, 500, 1000, 2000, 4000, 8000 }
+#define INVENTORY_BITRATE_CLASSES_NUMBER 7
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+    print the summary of the input files of the options in their check report
+    format, returns OK unless the summary cannot be computed or written,
+    whether some files failed or not
+*/
+int inventory_run(const flvmeta_opts * options);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __INVENTORY_H__ */
@@ -33,98 +33,119 @@
 # define isfinite flvmeta_isfinite
 #endif
 
-static void json_print_string(const char * str, size_t bytes) {
-    size_t i;
-    printf("\"");
+static void json_print_string(FILE * out, const char * str, size_t bytes) {
+    size_t i, start;
+    const char * escape;
+
+    fputc('\"', out);
+    start = 0;
     for (i = 0; i < bytes; ++i) {
         switch (str[i]) {
-            case '\"': printf("\\\""); break;
-            case '\\': printf("\\\\"); break;
-            case '/':  printf("\\/");  break;
-            case '\b': printf("\\b");  break;
-            case '\f': printf("\\f");  break;
-            case '\n': printf("\\n");  break;
-            case '\r': printf("\\r");  break;
-            case '\t': printf("\\t");  break;
-
-            default: 
-                if (iscntrl(str[i])) {
-                    printf("\\u%.4u", str[i]);
-                }
-                else {
-                    printf("%c", str[i]);
+            case '\"': escape = "\\\""; break;
+            case '\\': escape = "\\\\"; break;
+            case '/':  escape = "\\/";  break;
+            case '\b': escape = "\\b";  break;
+            case '\f': escape = "\\f";  break;
+            case '\n': escape = "\\n";  break;
+            case '\r': escape = "\\r";  break;
+            case '\t': escape = "\\t";  break;
+            default:
+                escape = NULL;
+                if (!iscntrl(str[i])) {
+                    continue;
                 }
         }
+
+        /* write the pending run of unescaped characters */
+        if (i > start) {
+            fwrite(str + start, 1, i - start, out);
+        }
+        start = i + 1;
+
+        if (escape != NULL) {
+            fputs(escape, out);
+        }
+        else {
+            fprintf(out, "\\u%.4u", str[i]);
+        }
+    }
+    if (bytes > start) {
+        fwrite(str + start, 1, bytes - start, out);
     }
-    printf("\"");
+    fputc('\"', out);
 }
 
 static void json_print_comma(json_emitter * je) {
     if (je->print_comma != 0) {
-        printf(",");
+        fputc(',', je->out);
         je->print_comma = 0;
     }
 }
 
 void json_emit_init(json_emitter * je) {
+    json_emit_init_file(je, stdout);
+}
+
+void json_emit_init_file(json_emitter * je, FILE * out) {
     je->print_comma = 0;
+    je->out = out;
 }
 
 void json_emit_object_start(json_emitter * je) {
     json_print_comma(je);
-    printf("{");
+    fputc('{', je->out);
 }
 
 void json_emit_object_key(json_emitter * je, const char * str, size_t bytes) {
     json_print_comma(je);
-    json_print_string(str, bytes);
-    printf(":");
+    json_print_string(je->out, str, bytes);
+    fputc(':', je->out);
     je->print_comma = 0;
 }
 
 void json_emit_object_key_z(json_emitter * je, const char * str) {
     json_print_comma(je);
-    json_print_string(str, strlen(str));
-    printf(":");
+    json_print_string(je->out, str, strlen(str));
+    fputc(':', je->out);
     je->print_comma = 0;
 }
 
 void json_emit_object_end(json_emitter * je) {
-    printf("}");
+    fputc('}', je->out);
     je->print_comma = 1;
 }
 
 void json_emit_array_start(json_emitter * je) {
     json_print_comma(je);
-    printf("[");
+    fputc('[', je->out);
 }
 
 void json_emit_array_end(json_emitter * je) {
-    printf("]");
+    fputc(']', je->out);
     je->print_comma = 1;
 }
 
 void json_emit_boolean(json_emitter * je, byte value) {
     json_print_comma(je);
-    printf("%s", value != 0 ? "true" : "false");
+    fputs(value != 0 ? "true" : "false", je->out);
     je->print_comma = 1;
 }
 
 void json_emit_null(json_emitter * je) {
     json_print_comma(je);
-    printf("null");
+    fputs("null", je->out);
     je->print_comma = 1;
 }
 
 void json_emit_integer(json_emitter * je, int value) {
     json_print_comma(je);
-    printf("%i", value);
+    fprintf(je->out, "%i", value);
     je->print_comma = 1;
 }
 
 void json_emit_file_offset(json_emitter * je, file_offset_t value) {
     json_print_comma(je);
-    printf("%" FILE_OFFSET_PRINTF_FORMAT "u", FILE_OFFSET_PRINTF_TYPE(value));
+    fprintf(je->out, "%" FILE_OFFSET_PRINTF_FORMAT "u", FILE_OFFSET_PRINTF_TYPE(value));
     je->print_comma = 1;
 }
 
@@ -139,18 +160,18 @@ void json_emit_number(json_emitter * je, number64 value) {
     }
 
     json_print_comma(je);
-    printf("%.12g", value);
+    fprintf(je->out, "%.12g", value);
     je->print_comma = 1;
 }
 
 void json_emit_string(json_emitter * je, const char * str, size_t bytes) {
     json_print_comma(je);
-    json_print_string(str, bytes);
+    json_print_string(je->out, str, bytes);
     je->print_comma = 1;
 }
 
 void json_emit_string_z(json_emitter * je, const char * str) {
     json_print_comma(je);
-    json_print_string(str, strlen(str));
+    json_print_string(je->out, str, strlen(str));
     je->print_comma = 1;
 }
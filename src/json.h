@@ -27,13 +27,14 @@
 
 /**
     This is a basic JSON emitter.
-    It prints JSON-formatted data to stdout without creating
-    an in-memory tree.
+    It prints JSON-formatted data to stdout, or to the given stream,
+    without creating an in-memory tree.
 */
 
 /* json emitter structure */
 typedef struct __json_emitter {
     byte print_comma;
+    FILE * out;
 } json_emitter;
 
 
@@ -43,6 +44,8 @@ extern "C" {
 
 void json_emit_init(json_emitter * je);
 
+void json_emit_init_file(json_emitter * je, FILE * out);
+
 void json_emit_object_start(json_emitter * je);
 
 void json_emit_object_key(json_emitter * je, const char * str, size_t bytes);
@@ -0,0 +1,194 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "libflvmeta.h"
+#include "update.h"
+#include "watch.h"
+
+/* maximum length of an informative message */
+#define FLVMETA_MESSAGE_SIZE 1024
+
+void flvmeta_opts_init(flvmeta_opts * opts) {
+    opts->command = FLVMETA_DEFAULT_COMMAND;
+    opts->input_file = NULL;
+    opts->output_file = NULL;
+    opts->metadata = NULL;
+    opts->check_level = FLVMETA_CHECK_LEVEL_WARNING;
+    opts->check_quick = 0;
+    opts->check_structure = 0;
+    opts->check_nal_units = 0;
+    opts->check_fail_fast = 0;
+    opts->check_disabled_rules = NULL;
+    opts->check_disabled_rules_number = 0;
+    opts->quiet = 0;
+    opts->check_report_format = FLVMETA_FORMAT_RAW;
+    opts->dump_metadata = 0;
+    opts->insert_onlastsecond = 1;
+    opts->reset_timestamps = 0;
+    opts->all_keyframes = 0;
+    opts->preserve_metadata = 0;
+    opts->max_memory = 0;
+    opts->state_file = NULL;
+    opts->error_handling = FLVMETA_EXIT_ON_ERROR;
+    opts->dump_format = FLVMETA_FORMAT_XML;
+    opts->verbose = 0;
+    opts->message_proc = NULL;
+    opts->message_user_data = NULL;
+    opts->out = stdout;
+    opts->stats = 0;
+    opts->metadata_events = NULL;
+    opts->metadata_events_number = 0;
+    opts->dump_tag_types = FLVMETA_DUMP_TAG_TYPE_ALL;
+    opts->dump_keyframes_only = 0;
+    opts->dump_start_time = 0;
+    opts->dump_end_time = FLVMETA_DUMP_NO_END_TIME;
+    opts->dump_start_offset = 0;
+    opts->dump_end_offset = FLVMETA_DUMP_NO_END_OFFSET;
+    opts->jobs = 1;
+    opts->dump_hash = 0;
+    opts->filter = NULL;
+    opts->batch = 0;
+    opts->batch_files = NULL;
+    opts->batch_files_number = 0;
+    opts->batch_list = NULL;
+    opts->batch_output_dir = NULL;
+    opts->server_socket = NULL;
+    opts->watch_dir = NULL;
+    opts->watch_delay = WATCH_DEFAULT_DELAY;
+    opts->cache_file = NULL;
+    opts->cache = NULL;
+}
+
+void flvmeta_message(const flvmeta_opts * opts, const char * format, ...) {
+    char message[FLVMETA_MESSAGE_SIZE];
+    va_list args;
+
+    if (opts->message_proc == NULL) {
+        return;
+    }
+
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    opts->message_proc(message, opts->message_user_data);
+}
+
+void flvmeta_context_init(flvmeta_context * ctxt) {
+    flvmeta_opts_init(&ctxt->opts);
+}
+
+void flvmeta_context_set_message_handler(flvmeta_context * ctxt, flvmeta_message_proc proc, void * user_data) {
+    ctxt->opts.message_proc = proc;
+    ctxt->opts.message_user_data = user_data;
+}
+
+int flvmeta_context_compute_metadata(flvmeta_context * ctxt, const char * file, flv_info * info, flv_metadata * meta) {
+    flvmeta_opts opts;
+    flv_stream * flv_in;
+    int res;
+
+    opts = ctxt->opts;
+    opts.input_file = (char *)file;
+
+    flv_in = flv_open(file);
+    if (flv_in == NULL) {
+        return ERROR_OPEN_READ;
+    }
+
+    /* the added metadata become part of the computed onMetaData event */
+    if (opts.metadata != NULL) {
+        opts.metadata = amf_data_clone(opts.metadata);
+        if (opts.metadata == NULL) {
+            flv_close(flv_in);
+            return ERROR_MEMORY;
+        }
+    }
+
+    res = get_flv_info(flv_in, info, &opts, NULL);
+    flv_close(flv_in);
+    if (res != OK) {
+        amf_data_free(opts.metadata);
+        amf_data_free(info->keyframes);
+        amf_data_free(info->original_on_metadata);
+        info->keyframes = NULL;
+        info->original_on_metadata = NULL;
+        return res;
+    }
+
+    compute_metadata(info, meta, &opts);
+    return OK;
+}
+
+void flvmeta_metadata_free(flv_info * info, flv_metadata * meta) {
+    /* the keyframes index belongs to the onMetaData event */
+    amf_data_free(meta->on_last_second_name);
+    amf_data_free(meta->on_last_second);
+    amf_data_free(meta->on_metadata_name);
+    amf_data_free(meta->on_metadata);
+    amf_data_free(info->original_on_metadata);
+    info->original_on_metadata = NULL;
+    info->keyframes = NULL;
+}
+
+int flvmeta_context_update(flvmeta_context * ctxt, const char * input_file, const char * output_file) {
+    flvmeta_opts opts;
+
+    opts = ctxt->opts;
+    opts.input_file = (char *)input_file;
+    opts.output_file = (char *)output_file;
+
+    /* nothing is printed apart from the messages */
+    opts.dump_metadata = 0;
+    opts.stats = 0;
+
+    /* the added metadata are released with the written onMetaData event */
+    if (opts.metadata != NULL) {
+        opts.metadata = amf_data_clone(opts.metadata);
+        if (opts.metadata == NULL) {
+            return ERROR_MEMORY;
+        }
+    }
+
+    return update_metadata(&opts);
+}
+
+int flvmeta_context_check(flvmeta_context * ctxt, const char * file, check_result * result) {
+    flv_stream * flv_in;
+    int res;
+
+    flv_in = flv_open(file);
+    if (flv_in == NULL) {
+        result->findings = NULL;
+        result->findings_number = 0;
+        result->findings_capacity = 0;
+        result->errors = 0;
+        result->warnings = 0;
+        return ERROR_OPEN_READ;
+    }
+
+    res = check_flv_stream(flv_in, &ctxt->opts, result);
+    flv_close(flv_in);
+    return res;
+}
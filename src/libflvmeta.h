@@ -0,0 +1,73 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#ifndef __LIBFLVMETA_H__
+#define __LIBFLVMETA_H__
+
+#include "flvmeta.h"
+#include "amf.h"
+#include "check.h"
+#include "flv.h"
+#include "info.h"
+
+/*
+    Library context: the options of a sequence of operations, which never
+    print to the standard output on their own; verbose messages are sent
+    to the message handler, and check findings are returned to the caller.
+    Contexts share no state, so several threads can each use their own.
+*/
+typedef struct __flvmeta_context {
+    flvmeta_opts opts;
+} flvmeta_context;
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* initialize a context with the default options */
+void flvmeta_context_init(flvmeta_context * ctxt);
+
+/* set the handler receiving the verbose messages */
+void flvmeta_context_set_message_handler(flvmeta_context * ctxt, flvmeta_message_proc proc, void * user_data);
+
+/*
+    compute the file information and the metadata of a file, which must be
+    released with flvmeta_metadata_free()
+*/
+int flvmeta_context_compute_metadata(flvmeta_context * ctxt, const char * file, flv_info * info, flv_metadata * meta);
+
+/* release the metadata computed by flvmeta_context_compute_metadata() */
+void flvmeta_metadata_free(flv_info * info, flv_metadata * meta);
+
+/* write a copy of a file with updated metadata, possibly in place */
+int flvmeta_context_update(flvmeta_context * ctxt, const char * input_file, const char * output_file);
+
+/*
+    check a file, collecting the findings into result, which must be
+    released with check_result_free()
+*/
+int flvmeta_context_check(flvmeta_context * ctxt, const char * file, check_result * result);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __LIBFLVMETA_H__ */
@@ -0,0 +1,233 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#ifdef WIN32
+# define WIN32_LEAN_AND_MEAN
+# include <windows.h>
+#else /* !WIN32 */
+# include <unistd.h>
+#endif /* WIN32 */
+
+#include <stdlib.h>
+
+#include "pool.h"
+
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+#ifdef HAVE_PTHREAD
+
+struct __flvmeta_pool {
+    pthread_mutex_t mutex;
+    pthread_cond_t task_available;
+    pthread_cond_t task_done;
+    flvmeta_task * first_task;
+    flvmeta_task * last_task;
+    pthread_t * threads;
+    int threads_number;
+    int stopping;
+};
+
+static void * flvmeta_pool_worker(void * arg) {
+    flvmeta_pool * pool = (flvmeta_pool *)arg;
+    flvmeta_task * task;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (pool->first_task == NULL && !pool->stopping) {
+            pthread_cond_wait(&pool->task_available, &pool->mutex);
+        }
+
+        /* stop only once the queue is empty */
+        task = pool->first_task;
+        if (task == NULL) {
+            break;
+        }
+
+        pool->first_task = task->next;
+        if (pool->first_task == NULL) {
+            pool->last_task = NULL;
+        }
+
+        pthread_mutex_unlock(&pool->mutex);
+        task->function(task->data);
+        pthread_mutex_lock(&pool->mutex);
+
+        task->done = 1;
+        pthread_cond_broadcast(&pool->task_done);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+flvmeta_pool * flvmeta_pool_new(int threads) {
+    flvmeta_pool * pool;
+    int i;
+
+    if (threads <= 0) {
+        threads = flvmeta_cpu_count();
+    }
+
+    pool = (flvmeta_pool *)malloc(sizeof(flvmeta_pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    pool->threads = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    if (pool->threads == NULL) {
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->task_available, NULL);
+    pthread_cond_init(&pool->task_done, NULL);
+    pool->first_task = NULL;
+    pool->last_task = NULL;
+    pool->threads_number = 0;
+    pool->stopping = 0;
+
+    for (i = 0; i < threads; ++i) {
+        if (pthread_create(&pool->threads[i], NULL, flvmeta_pool_worker, pool) != 0) {
+            break;
+        }
+        pool->threads_number++;
+    }
+
+    if (pool->threads_number == 0) {
+        flvmeta_pool_free(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+void flvmeta_pool_submit(flvmeta_pool * pool, flvmeta_task * task, flvmeta_task_function function, void * data) {
+    task->function = function;
+    task->data = data;
+    task->done = 0;
+    task->next = NULL;
+
+    pthread_mutex_lock(&pool->mutex);
+    if (pool->last_task != NULL) {
+        pool->last_task->next = task;
+    }
+    else {
+        pool->first_task = task;
+    }
+    pool->last_task = task;
+    pthread_cond_signal(&pool->task_available);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void flvmeta_pool_wait(flvmeta_pool * pool, flvmeta_task * task) {
+    pthread_mutex_lock(&pool->mutex);
+    while (!task->done) {
+        pthread_cond_wait(&pool->task_done, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+int flvmeta_pool_is_done(flvmeta_pool * pool, flvmeta_task * task) {
+    int done;
+
+    pthread_mutex_lock(&pool->mutex);
+    done = task->done;
+    pthread_mutex_unlock(&pool->mutex);
+    return done;
+}
+
+void flvmeta_pool_free(flvmeta_pool * pool) {
+    int i;
+
+    if (pool != NULL) {
+        pthread_mutex_lock(&pool->mutex);
+        pool->stopping = 1;
+        pthread_cond_broadcast(&pool->task_available);
+        pthread_mutex_unlock(&pool->mutex);
+
+        for (i = 0; i < pool->threads_number; ++i) {
+            pthread_join(pool->threads[i], NULL);
+        }
+
+        pthread_cond_destroy(&pool->task_done);
+        pthread_cond_destroy(&pool->task_available);
+        pthread_mutex_destroy(&pool->mutex);
+        free(pool->threads);
+        free(pool);
+    }
+}
+
+#else /* !HAVE_PTHREAD */
+
+/* without thread support, tasks are run synchronously */
+struct __flvmeta_pool {
+    int threads_number;
+};
+
+flvmeta_pool * flvmeta_pool_new(int threads) {
+    flvmeta_pool * pool = (flvmeta_pool *)malloc(sizeof(flvmeta_pool));
+    if (pool != NULL) {
+        pool->threads_number = 1;
+    }
+    return pool;
+}
+
+void flvmeta_pool_submit(flvmeta_pool * pool, flvmeta_task * task, flvmeta_task_function function, void * data) {
+    task->function = function;
+    task->data = data;
+    task->next = NULL;
+    function(data);
+    task->done = 1;
+}
+
+void flvmeta_pool_wait(flvmeta_pool * pool, flvmeta_task * task) {
+    /* tasks are already complete */
+}
+
+int flvmeta_pool_is_done(flvmeta_pool * pool, flvmeta_task * task) {
+    return task->done;
+}
+
+void flvmeta_pool_free(flvmeta_pool * pool) {
+    free(pool);
+}
+
+#endif /* HAVE_PTHREAD */
+
+int flvmeta_pool_get_threads(const flvmeta_pool * pool) {
+    return (pool != NULL) ? pool->threads_number : 0;
+}
+
+int flvmeta_cpu_count(void) {
+#ifdef WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (info.dwNumberOfProcessors > 0) ? (int)info.dwNumberOfProcessors : 1;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (int)count : 1;
+#else
+    return 1;
+#endif
+}
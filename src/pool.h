@@ -0,0 +1,78 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#ifndef __POOL_H__
+#define __POOL_H__
+
+/* Configuration of the sources */
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+/**
+    This is a minimal worker thread pool.
+    Tasks are run in submission order by the first available thread.
+    Without thread support, tasks are run synchronously on submission.
+*/
+
+/* task function */
+typedef void (* flvmeta_task_function)(void * data);
+
+/* task submitted to a pool, owned by the caller until completed */
+typedef struct __flvmeta_task {
+    flvmeta_task_function function;
+    void * data;
+    int done;
+    struct __flvmeta_task * next;
+} flvmeta_task;
+
+typedef struct __flvmeta_pool flvmeta_pool;
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* create a pool of the given number of threads, or one per processor if zero */
+flvmeta_pool * flvmeta_pool_new(int threads);
+
+/* number of threads in the pool */
+int flvmeta_pool_get_threads(const flvmeta_pool * pool);
+
+/* queue a task for execution */
+void flvmeta_pool_submit(flvmeta_pool * pool, flvmeta_task * task, flvmeta_task_function function, void * data);
+
+/* wait for the completion of a submitted task */
+void flvmeta_pool_wait(flvmeta_pool * pool, flvmeta_task * task);
+
+/* whether a submitted task is completed, without waiting for it */
+int flvmeta_pool_is_done(flvmeta_pool * pool, flvmeta_task * task);
+
+/* wait for the completion of all submitted tasks, and release the pool */
+void flvmeta_pool_free(flvmeta_pool * pool);
+
+/* number of online processors */
+int flvmeta_cpu_count(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __POOL_H__ */
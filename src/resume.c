@@ -0,0 +1,385 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "resume.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "amf.h"
+#include "hash.h"
+
+/* types of the saved fields */
+#define RESUME_UINT8    0
+#define RESUME_UINT32   1
+#define RESUME_OFFSET   2
+#define RESUME_INT      3
+
+/* size of the fingerprint as an hexadecimal string, including the terminator */
+#define RESUME_FINGERPRINT_STRING_SIZE 17
+
+/* field of a structure saved as a number */
+typedef struct __resume_field {
+    const char * name;
+    size_t offset;
+    int type;
+} resume_field;
+
+#define RESUME_FIELD(s, f, t) { #f, offsetof(s, f), t }
+
+/* file information, the header being read again */
+static const resume_field resume_info_fields[] = {
+    RESUME_FIELD(flv_info, have_video, RESUME_UINT8),
+    RESUME_FIELD(flv_info, have_audio, RESUME_UINT8),
+    RESUME_FIELD(flv_info, video_width, RESUME_UINT32),
+    RESUME_FIELD(flv_info, video_height, RESUME_UINT32),
+    RESUME_FIELD(flv_info, video_codec, RESUME_UINT32),
+    RESUME_FIELD(flv_info, video_frames_number, RESUME_UINT32),
+    RESUME_FIELD(flv_info, audio_codec, RESUME_UINT8),
+    RESUME_FIELD(flv_info, audio_size, RESUME_UINT8),
+    RESUME_FIELD(flv_info, audio_rate, RESUME_UINT8),
+    RESUME_FIELD(flv_info, audio_stereo, RESUME_UINT8),
+    RESUME_FIELD(flv_info, video_data_size, RESUME_OFFSET),
+    RESUME_FIELD(flv_info, audio_data_size, RESUME_OFFSET),
+    RESUME_FIELD(flv_info, meta_data_size, RESUME_OFFSET),
+    RESUME_FIELD(flv_info, real_video_data_size, RESUME_OFFSET),
+    RESUME_FIELD(flv_info, real_audio_data_size, RESUME_OFFSET),
+    RESUME_FIELD(flv_info, video_first_timestamp, RESUME_UINT32),
+    RESUME_FIELD(flv_info, audio_first_timestamp, RESUME_UINT32),
+    RESUME_FIELD(flv_info, first_timestamp, RESUME_UINT32),
+    RESUME_FIELD(flv_info, can_seek_to_end, RESUME_UINT8),
+    RESUME_FIELD(flv_info, have_keyframes, RESUME_UINT8),
+    RESUME_FIELD(flv_info, last_keyframe_timestamp, RESUME_UINT32),
+    RESUME_FIELD(flv_info, on_metadata_size, RESUME_UINT32),
+    RESUME_FIELD(flv_info, on_metadata_offset, RESUME_OFFSET),
+    RESUME_FIELD(flv_info, biggest_tag_body_size, RESUME_UINT32),
+    RESUME_FIELD(flv_info, last_timestamp, RESUME_UINT32),
+    RESUME_FIELD(flv_info, video_frame_duration, RESUME_UINT32),
+    RESUME_FIELD(flv_info, audio_frame_duration, RESUME_UINT32),
+    RESUME_FIELD(flv_info, total_prev_tags_size, RESUME_OFFSET),
+    RESUME_FIELD(flv_info, have_on_last_second, RESUME_UINT8),
+    RESUME_FIELD(flv_info, last_media_frame_type, RESUME_UINT8)
+};
+
+/* computation state, including the extended timestamp counters */
+static const resume_field resume_state_fields[] = {
+    RESUME_FIELD(flv_info_state, prev_timestamp_video, RESUME_UINT32),
+    RESUME_FIELD(flv_info_state, prev_timestamp_audio, RESUME_UINT32),
+    RESUME_FIELD(flv_info_state, prev_timestamp_meta, RESUME_UINT32),
+    RESUME_FIELD(flv_info_state, timestamp_extended_video, RESUME_UINT8),
+    RESUME_FIELD(flv_info_state, timestamp_extended_audio, RESUME_UINT8),
+    RESUME_FIELD(flv_info_state, timestamp_extended_meta, RESUME_UINT8),
+    RESUME_FIELD(flv_info_state, have_video_size, RESUME_UINT8),
+    RESUME_FIELD(flv_info_state, have_first_timestamp, RESUME_UINT8),
+    RESUME_FIELD(flv_info_state, tag_number, RESUME_UINT32),
+    RESUME_FIELD(flv_info_state, timestamp, RESUME_UINT32)
+};
+
+/* options the information depends on, which must be unchanged to resume */
+static const resume_field resume_option_fields[] = {
+    RESUME_FIELD(flvmeta_opts, reset_timestamps, RESUME_INT),
+    RESUME_FIELD(flvmeta_opts, all_keyframes, RESUME_INT),
+    RESUME_FIELD(flvmeta_opts, preserve_metadata, RESUME_INT),
+    RESUME_FIELD(flvmeta_opts, error_handling, RESUME_INT)
+};
+
+#define RESUME_FIELDS_NUMBER(fields) (sizeof(fields) / sizeof(resume_field))
+
+/* value of a field of a structure */
+static number64 resume_get_field(const void * base, const resume_field * field) {
+    const char * p = (const char *)base + field->offset;
+
+    switch (field->type) {
+        case RESUME_UINT8: return (number64)*(const uint8 *)p;
+        case RESUME_UINT32: return (number64)*(const uint32 *)p;
+        case RESUME_OFFSET: return (number64)*(const file_offset_t *)p;
+        default: return (number64)*(const int *)p;
+    }
+}
+
+/* set a field of a structure, returning zero if the value is out of its range */
+static int resume_set_field(void * base, const resume_field * field, number64 value) {
+    char * p = (char *)base + field->offset;
+
+    if (field->type != RESUME_INT && value < 0) {
+        return 0;
+    }
+    switch (field->type) {
+        case RESUME_UINT8:
+            if (value > 0xFF) {
+                return 0;
+            }
+            *(uint8 *)p = (uint8)value;
+            break;
+        case RESUME_UINT32:
+            if (value > 0xFFFFFFFF) {
+                return 0;
+            }
+            *(uint32 *)p = (uint32)value;
+            break;
+        case RESUME_OFFSET:
+            *(file_offset_t *)p = (file_offset_t)value;
+            break;
+        default:
+            *(int *)p = (int)value;
+    }
+    return 1;
+}
+
+/* add the fields of a structure to the saved state */
+static void resume_add_fields(amf_data * data, const void * base, const resume_field * fields, size_t fields_number) {
+    size_t i;
+
+    for (i = 0; i < fields_number; ++i) {
+        amf_associative_array_add(data, fields[i].name, amf_number_new(resume_get_field(base, &fields[i])));
+    }
+}
+
+/* saved value, whose name must match exactly */
+static amf_data * resume_get(const amf_data * data, const char * name) {
+    amf_node * node;
+    amf_data * node_name;
+    size_t length;
+
+    if (amf_data_get_type(data) != AMF_TYPE_ASSOCIATIVE_ARRAY && amf_data_get_type(data) != AMF_TYPE_OBJECT) {
+        return NULL;
+    }
+    length = strlen(name);
+    for (node = amf_object_first(data); node != NULL; node = amf_object_next(node)) {
+        node_name = amf_object_get_name(node);
+        if (amf_string_get_size(node_name) == length && memcmp(amf_string_get_bytes(node_name), name, length) == 0) {
+            return amf_object_get_data(node);
+        }
+    }
+    return NULL;
+}
+
+/* saved number, returning zero if it is missing */
+static int resume_get_number(const amf_data * data, const char * name, number64 * value) {
+    amf_data * number = resume_get(data, name);
+
+    if (amf_data_get_type(number) != AMF_TYPE_NUMBER) {
+        return 0;
+    }
+    *value = amf_number_get_value(number);
+    return 1;
+}
+
+/* read the fields of a structure from the saved state, returning zero if one is missing or invalid */
+static int resume_read_fields(const amf_data * data, void * base, const resume_field * fields, size_t fields_number) {
+    number64 value;
+    size_t i;
+
+    for (i = 0; i < fields_number; ++i) {
+        if (!resume_get_number(data, fields[i].name, &value) || !resume_set_field(base, &fields[i], value)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* whether the saved options are the current ones */
+static int resume_check_options(const amf_data * data, const flvmeta_opts * opts) {
+    number64 value;
+    size_t i;
+
+    for (i = 0; i < RESUME_FIELDS_NUMBER(resume_option_fields); ++i) {
+        if (!resume_get_number(data, resume_option_fields[i].name, &value)
+        || value != resume_get_field(opts, &resume_option_fields[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* add a range of the file to its fingerprint */
+static int resume_hash_range(flv_stream * flv_in, file_offset_t start, size_t size, xxh64_state * hash) {
+    byte buffer[RESUME_FINGERPRINT_SIZE];
+
+    if (flv_stream_seek(flv_in, start, SEEK_SET) != 0 || flv_stream_read(flv_in, buffer, 1, size) < size) {
+        return ERROR_EOF;
+    }
+    xxh64_update(hash, buffer, size);
+    return OK;
+}
+
+/*
+    hash of the beginning of the file and of the bytes before the offset
+    of the next tag, identifying the file and the point where the analysis
+    stopped, written as an hexadecimal string
+*/
+static int resume_get_fingerprint(flv_stream * flv_in, file_offset_t offset, char * fingerprint) {
+    xxh64_state state;
+    file_offset_t tail_start;
+    size_t head_size;
+    uint64 hash;
+
+    head_size = (offset < RESUME_FINGERPRINT_SIZE) ? (size_t)offset : RESUME_FINGERPRINT_SIZE;
+    tail_start = (offset - (file_offset_t)head_size > RESUME_FINGERPRINT_SIZE) ? offset - RESUME_FINGERPRINT_SIZE : (file_offset_t)head_size;
+
+    xxh64_reset(&state, 0);
+    if (resume_hash_range(flv_in, 0, head_size, &state) != OK
+    || resume_hash_range(flv_in, tail_start, (size_t)(offset - tail_start), &state) != OK) {
+        return ERROR_EOF;
+    }
+
+    hash = xxh64_digest(&state);
+    sprintf(fingerprint, "%08lx%08lx", (unsigned long)(hash >> 32), (unsigned long)(hash & 0xFFFFFFFF));
+    return OK;
+}
+
+int resume_load(const char * path, flv_stream * flv_in, const flvmeta_opts * opts, flv_info_state * state, flv_info * info, file_offset_t * offset) {
+    char fingerprint[RESUME_FINGERPRINT_STRING_SIZE];
+    flv_info_state loaded_state;
+    flv_info loaded_info;
+    file_offset_t loaded_offset;
+    amf_data * data, * keyframes, * times, * filepositions, * original, * saved_fingerprint;
+    number64 value;
+    FILE * in;
+    int valid;
+
+    in = fopen(path, "rb");
+    if (in == NULL) {
+        return ERROR_OPEN_READ;
+    }
+    data = amf_data_file_read(in);
+    fclose(in);
+
+    memcpy(&loaded_state, state, sizeof(flv_info_state));
+    memcpy(&loaded_info, info, sizeof(flv_info));
+
+    /* the version, options, and fields must match */
+    valid = (amf_data_get_error_code(data) == AMF_ERROR_OK
+        && amf_data_get_type(data) == AMF_TYPE_ASSOCIATIVE_ARRAY
+        && resume_get_number(data, "version", &value) && value == RESUME_VERSION
+        && resume_check_options(data, opts)
+        && resume_get_number(data, "offset", &value) && value >= FLV_HEADER_SIZE + sizeof(uint32_be)
+        && resume_read_fields(data, &loaded_info, resume_info_fields, RESUME_FIELDS_NUMBER(resume_info_fields))
+        && resume_read_fields(data, &loaded_state, resume_state_fields, RESUME_FIELDS_NUMBER(resume_state_fields)));
+
+    /* the keyframes index, and the preserved metadata if needed */
+    keyframes = resume_get(data, "keyframes");
+    times = resume_get(keyframes, "times");
+    filepositions = resume_get(keyframes, "filepositions");
+    original = resume_get(data, "original");
+    valid = (valid
+        && amf_data_get_type(keyframes) == AMF_TYPE_OBJECT
+        && amf_data_get_type(times) == AMF_TYPE_ARRAY
+        && amf_data_get_type(filepositions) == AMF_TYPE_ARRAY
+        && amf_array_size(times) == amf_array_size(filepositions)
+        && (original == NULL || amf_data_get_type(original) == AMF_TYPE_ASSOCIATIVE_ARRAY));
+
+    /* the file must have grown from the saved one */
+    if (valid) {
+        loaded_offset = (file_offset_t)value;
+        valid = (flv_stream_seek(flv_in, 0, SEEK_END) == 0
+            && lfs_ftell(flv_in->flvin) >= loaded_offset
+            && resume_get_fingerprint(flv_in, loaded_offset, fingerprint) == OK);
+    }
+    saved_fingerprint = resume_get(data, "fingerprint");
+    valid = (valid
+        && amf_data_get_type(saved_fingerprint) == AMF_TYPE_STRING
+        && amf_string_get_size(saved_fingerprint) == RESUME_FINGERPRINT_STRING_SIZE - 1
+        && memcmp(amf_string_get_bytes(saved_fingerprint), fingerprint, RESUME_FINGERPRINT_STRING_SIZE - 1) == 0);
+
+    /* copy the keyframes index and the preserved metadata from the saved state */
+    if (valid) {
+        keyframes = amf_object_new();
+        times = amf_data_clone(times);
+        filepositions = amf_data_clone(filepositions);
+        original = (original != NULL) ? amf_data_clone(original) : NULL;
+        amf_object_add(keyframes, "times", times);
+        amf_object_add(keyframes, "filepositions", filepositions);
+    }
+    amf_data_free(data);
+    if (!valid) {
+        return ERROR_OPEN_READ;
+    }
+
+    amf_data_free(loaded_info.keyframes);
+    amf_data_free(loaded_info.original_on_metadata);
+    loaded_info.keyframes = keyframes;
+    loaded_info.times = times;
+    loaded_info.filepositions = filepositions;
+    loaded_info.original_on_metadata = original;
+
+    memcpy(state, &loaded_state, sizeof(flv_info_state));
+    memcpy(info, &loaded_info, sizeof(flv_info));
+    *offset = loaded_offset;
+    return OK;
+}
+
+int resume_save(const char * path, flv_stream * flv_in, const flvmeta_opts * opts, const flv_info_state * state, const flv_info * info, file_offset_t offset) {
+    char fingerprint[RESUME_FINGERPRINT_STRING_SIZE];
+    amf_data * data;
+    char * temp_path;
+    size_t path_length;
+    FILE * out;
+    int result;
+
+    if (resume_get_fingerprint(flv_in, offset, fingerprint) != OK) {
+        return ERROR_EOF;
+    }
+
+    data = amf_associative_array_new();
+    amf_associative_array_add(data, "version", amf_number_new(RESUME_VERSION));
+    amf_associative_array_add(data, "offset", amf_number_new((number64)offset));
+    amf_associative_array_add(data, "fingerprint", amf_str(fingerprint));
+    resume_add_fields(data, opts, resume_option_fields, RESUME_FIELDS_NUMBER(resume_option_fields));
+    resume_add_fields(data, info, resume_info_fields, RESUME_FIELDS_NUMBER(resume_info_fields));
+    resume_add_fields(data, state, resume_state_fields, RESUME_FIELDS_NUMBER(resume_state_fields));
+
+    amf_associative_array_add(data, "keyframes", amf_data_clone(info->keyframes));
+    if (info->original_on_metadata != NULL) {
+        amf_associative_array_add(data, "original", amf_data_clone(info->original_on_metadata));
+    }
+
+    /* write to a temporary file, renamed over the previous state */
+    path_length = strlen(path);
+    temp_path = (char *)malloc(path_length + 5);
+    result = ERROR_WRITE;
+    if (temp_path != NULL) {
+        memcpy(temp_path, path, path_length);
+        memcpy(temp_path + path_length, ".tmp", 5);
+
+        out = fopen(temp_path, "wb");
+        if (out != NULL) {
+            size_t written = amf_data_file_write(data, out);
+            if (fclose(out) == 0 && written > 0) {
+#ifdef WIN32
+                remove(path);
+#endif /* WIN32 */
+                if (rename(temp_path, path) == 0) {
+                    result = OK;
+                }
+            }
+            if (result != OK) {
+                remove(temp_path);
+            }
+        }
+        free(temp_path);
+    }
+
+    amf_data_free(data);
+    return result;
+}
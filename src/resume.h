@@ -0,0 +1,68 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#ifndef __RESUME_H__
+#define __RESUME_H__
+
+#include "flvmeta.h"
+#include "info.h"
+
+/**
+    Resumable analysis of growing files.
+    The state of the tag by tag computation of the file information, the
+    partial information, and the offset of the first tag not analyzed yet
+    are saved to a state file, as an AMF associative array. The next
+    analysis of the same file resumes from that offset, reading only the
+    tags appended since, as long as the beginning of the file and the
+    options the information depends on are unchanged.
+*/
+
+/* version of the state file format */
+#define RESUME_VERSION 1
+
+/* size of the beginning of the file, and of the end of the analyzed tags, whose hash identifies it */
+#define RESUME_FINGERPRINT_SIZE 4096
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+    Load the saved analysis of the input file, replacing the initialized
+    state and info, and setting the offset of the next tag to analyze.
+    Returns OK if the analysis can be resumed, an error if the state file
+    does not exist, is invalid, or belongs to another file or options,
+    in which case the state and info are left unchanged.
+*/
+int resume_load(const char * path, flv_stream * flv_in, const flvmeta_opts * opts, flv_info_state * state, flv_info * info, file_offset_t * offset);
+
+/*
+    Save the analysis of the tags before the given offset,
+    replacing the state file atomically.
+    Returns OK, or ERROR_WRITE if the state file cannot be written.
+*/
+int resume_save(const char * path, flv_stream * flv_in, const flvmeta_opts * opts, const flv_info_state * state, const flv_info * info, file_offset_t offset);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __RESUME_H__ */
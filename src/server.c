@@ -0,0 +1,888 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "server.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_SYS_UN_H
+# include <sys/types.h>
+# include <sys/socket.h>
+# include <sys/stat.h>
+# include <sys/time.h>
+# include <sys/un.h>
+# include <errno.h>
+# include <fcntl.h>
+# include <poll.h>
+# include <signal.h>
+# include <unistd.h>
+#endif /* HAVE_SYS_UN_H */
+
+#include "amf.h"
+#include "check.h"
+#include "dump.h"
+#include "json.h"
+#include "libflvmeta.h"
+#include "pool.h"
+#include "update.h"
+#include "util.h"
+
+#ifdef HAVE_SYS_UN_H
+
+/* time allowed to receive the rest of a started request, in seconds */
+#define SERVER_READ_TIMEOUT 10
+
+/* nesting limit of the ignored request fields */
+#define SERVER_MAX_DEPTH 32
+
+/* request id types */
+#define SERVER_NO_ID        0
+#define SERVER_NUMBER_ID    1
+#define SERVER_STRING_ID    2
+
+/* request fields, pointing into the request buffer */
+typedef struct __server_request {
+    char * command;
+    char * file;
+    char * output;
+    char * format;
+    int id_type;
+    char * id_string;
+    number64 id_number;
+} server_request;
+
+/*
+    connection slot, watched by the server thread while idle, and handed
+    to a pool thread for each request
+*/
+typedef struct __server_connection {
+    flvmeta_task task;
+    const flvmeta_opts * options;
+    int fd; /* -1 if the slot is free */
+    int wake_fd; /* written once the request is answered */
+    int busy; /* a request task is submitted, only used by the server thread */
+    volatile int finished; /* set by the request task when it returns */
+    int lost; /* set by the request task if the connection must be closed */
+    char * request; /* buffer reused by the successive requests of the slot */
+    size_t request_size;
+} server_connection;
+
+/* write end of the pipe waking up the server, -1 if no server is running */
+static volatile sig_atomic_t server_stop_fd = -1;
+
+/* number of server_stop calls that may be writing to the pipe, which stays open until they return */
+static volatile sig_atomic_t server_stop_calls = 0;
+
+void server_stop(void) {
+    int fd;
+
+    flvmeta_atomic_add(&server_stop_calls, 1);
+    fd = flvmeta_atomic_load(&server_stop_fd);
+    if (fd >= 0) {
+        char c = 0;
+        ssize_t written = write(fd, &c, 1);
+        (void)written;
+    }
+    flvmeta_atomic_add(&server_stop_calls, -1);
+}
+
+/* stop waking up the server, before its pipe is closed */
+static void server_clear_stop_fd(void) {
+    flvmeta_atomic_store(&server_stop_fd, -1);
+    while (flvmeta_atomic_load(&server_stop_calls) > 0) {
+        poll(NULL, 0, 1);
+    }
+}
+
+static void server_handle_signal(int signal_number) {
+    (void)signal_number;
+    server_stop();
+}
+
+/*
+    Request parsing.
+    Requests are parsed in place, strings being unescaped in the buffer.
+*/
+static char * server_skip_space(char * p) {
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+        ++p;
+    }
+    return p;
+}
+
+/* value of four hexadecimal digits, or -1 */
+static long server_parse_hex(const char * p) {
+    long value;
+    int i;
+
+    value = 0;
+    for (i = 0; i < 4; ++i) {
+        if (p[i] >= '0' && p[i] <= '9') {
+            value = (value << 4) | (p[i] - '0');
+        }
+        else if (p[i] >= 'a' && p[i] <= 'f') {
+            value = (value << 4) | (p[i] - 'a' + 10);
+        }
+        else if (p[i] >= 'A' && p[i] <= 'F') {
+            value = (value << 4) | (p[i] - 'A' + 10);
+        }
+        else {
+            return -1;
+        }
+    }
+    return value;
+}
+
+/* encode a code point as UTF-8, which is never longer than its escape sequence */
+static char * server_put_utf8(char * out, unsigned long c) {
+    if (c < 0x80) {
+        *out++ = (char)c;
+    }
+    else if (c < 0x800) {
+        *out++ = (char)(0xC0 | (c >> 6));
+        *out++ = (char)(0x80 | (c & 0x3F));
+    }
+    else if (c < 0x10000) {
+        *out++ = (char)(0xE0 | (c >> 12));
+        *out++ = (char)(0x80 | ((c >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (c & 0x3F));
+    }
+    else {
+        *out++ = (char)(0xF0 | (c >> 18));
+        *out++ = (char)(0x80 | ((c >> 12) & 0x3F));
+        *out++ = (char)(0x80 | ((c >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (c & 0x3F));
+    }
+    return out;
+}
+
+/* parse a string, returning the position following it, or NULL if invalid */
+static char * server_parse_string(char * p, char ** value) {
+    char * out;
+    long c, low;
+
+    if (*p != '\"') {
+        return NULL;
+    }
+
+    *value = out = ++p;
+    while (*p != '\"') {
+        if ((unsigned char)*p < 0x20) {
+            /* end of the request, or unescaped control character */
+            return NULL;
+        }
+        if (*p != '\\') {
+            *out++ = *p++;
+            continue;
+        }
+
+        ++p;
+        switch (*p) {
+            case '\"':
+            case '\\':
+            case '/': *out++ = *p; break;
+            case 'b': *out++ = '\b'; break;
+            case 'f': *out++ = '\f'; break;
+            case 'n': *out++ = '\n'; break;
+            case 'r': *out++ = '\r'; break;
+            case 't': *out++ = '\t'; break;
+            case 'u':
+                c = server_parse_hex(p + 1);
+                if (c < 0) {
+                    return NULL;
+                }
+                p += 4;
+                /* surrogate pair */
+                if (c >= 0xD800 && c <= 0xDBFF && p[1] == '\\' && p[2] == 'u') {
+                    low = server_parse_hex(p + 3);
+                    if (low >= 0xDC00 && low <= 0xDFFF) {
+                        c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                        p += 6;
+                    }
+                }
+                out = server_put_utf8(out, (unsigned long)c);
+                break;
+            default:
+                return NULL;
+        }
+        ++p;
+    }
+    *out = '\0';
+    return p + 1;
+}
+
+/* parse a number, returning the position following it, or NULL if invalid */
+static char * server_parse_number(char * p, number64 * value) {
+    char * end;
+
+    if (*p != '-' && (*p < '0' || *p > '9')) {
+        return NULL;
+    }
+    *value = strtod(p, &end);
+    return (end == p) ? NULL : end;
+}
+
+/* skip a value of any type, returning the position following it, or NULL if invalid */
+static char * server_skip_value(char * p, int depth) {
+    char * str;
+    number64 number;
+    char end;
+
+    if (*p == '\"') {
+        return server_parse_string(p, &str);
+    }
+    if (*p == '{' || *p == '[') {
+        end = (*p == '{') ? '}' : ']';
+        if (depth >= SERVER_MAX_DEPTH) {
+            return NULL;
+        }
+        p = server_skip_space(p + 1);
+        if (*p == end) {
+            return p + 1;
+        }
+        for (;;) {
+            if (end == '}') {
+                p = server_parse_string(p, &str);
+                if (p == NULL) {
+                    return NULL;
+                }
+                p = server_skip_space(p);
+                if (*p != ':') {
+                    return NULL;
+                }
+                p = server_skip_space(p + 1);
+            }
+            p = server_skip_value(p, depth + 1);
+            if (p == NULL) {
+                return NULL;
+            }
+            p = server_skip_space(p);
+            if (*p == end) {
+                return p + 1;
+            }
+            if (*p != ',') {
+                return NULL;
+            }
+            p = server_skip_space(p + 1);
+        }
+    }
+    if (!strncmp(p, "true", 4) || !strncmp(p, "null", 4)) {
+        return p + 4;
+    }
+    if (!strncmp(p, "false", 5)) {
+        return p + 5;
+    }
+    return server_parse_number(p, &number);
+}
+
+/* parse a request object, returning a non-zero value if it is valid */
+static int server_parse_request(char * p, server_request * request) {
+    char * name;
+    char ** field;
+
+    memset(request, 0, sizeof(server_request));
+
+    p = server_skip_space(p);
+    if (*p != '{') {
+        return 0;
+    }
+    p = server_skip_space(p + 1);
+
+    while (*p != '}') {
+        p = server_parse_string(p, &name);
+        if (p == NULL) {
+            return 0;
+        }
+        p = server_skip_space(p);
+        if (*p != ':') {
+            return 0;
+        }
+        p = server_skip_space(p + 1);
+
+        field = NULL;
+        if (!strcmp(name, "command")) {
+            field = &request->command;
+        }
+        else if (!strcmp(name, "file")) {
+            field = &request->file;
+        }
+        else if (!strcmp(name, "output")) {
+            field = &request->output;
+        }
+        else if (!strcmp(name, "format")) {
+            field = &request->format;
+        }
+
+        if (field != NULL) {
+            p = server_parse_string(p, field);
+        }
+        else if (!strcmp(name, "id") && *p == '\"') {
+            request->id_type = SERVER_STRING_ID;
+            p = server_parse_string(p, &request->id_string);
+        }
+        else if (!strcmp(name, "id")) {
+            request->id_type = SERVER_NUMBER_ID;
+            p = server_parse_number(p, &request->id_number);
+        }
+        else {
+            /* unknown fields are ignored */
+            p = server_skip_value(p, 0);
+        }
+        if (p == NULL) {
+            return 0;
+        }
+
+        p = server_skip_space(p);
+        if (*p == ',') {
+            p = server_skip_space(p + 1);
+            if (*p == '}') {
+                return 0;
+            }
+        }
+        else if (*p != '}') {
+            return 0;
+        }
+    }
+
+    p = server_skip_space(p + 1);
+    return (*p == '\0' && request->command != NULL && request->file != NULL);
+}
+
+/*
+    Request execution.
+*/
+static int server_set_format(flvmeta_opts * options, const char * format) {
+    if (!strcmp(format, "xml")) {
+        options->dump_format = FLVMETA_FORMAT_XML;
+    }
+    else if (!strcmp(format, "json")) {
+        options->dump_format = FLVMETA_FORMAT_JSON;
+    }
+    else if (!strcmp(format, "yaml")) {
+        options->dump_format = FLVMETA_FORMAT_YAML;
+    }
+    else if (!strcmp(format, "raw")) {
+        options->dump_format = FLVMETA_FORMAT_RAW;
+    }
+    else {
+        return 0;
+    }
+    /* check reports have no YAML format */
+    options->check_report_format = options->dump_format;
+    return 1;
+}
+
+/* write the informative messages of a request along with its output */
+static void server_print_message(const char * message, void * user_data) {
+    fputs(message, (FILE *)user_data);
+}
+
+static int server_run_command(const char * command, flvmeta_opts * options) {
+    flvmeta_context ctxt;
+    flv_info info;
+    flv_metadata meta;
+    int result;
+
+    if (!strcmp(command, "check")) {
+        if (options->check_report_format == FLVMETA_FORMAT_YAML) {
+            return ERROR_INVALID_REQUEST;
+        }
+        return check_flv_file(options);
+    }
+    else if (!strcmp(command, "dump-metadata")) {
+        return dump_metadata(options);
+    }
+    else if (!strcmp(command, "info")) {
+        /* the metadata an update would write */
+        ctxt.opts = *options;
+        result = flvmeta_context_compute_metadata(&ctxt, options->input_file, &info, &meta);
+        if (result == OK) {
+            result = dump_amf_data(meta.on_metadata, options);
+            flvmeta_metadata_free(&info, &meta);
+        }
+        return result;
+    }
+    else if (!strcmp(command, "update")) {
+        /* each update consumes its own copy of the added metadata */
+        if (options->metadata != NULL) {
+            options->metadata = amf_data_clone(options->metadata);
+            if (options->metadata == NULL) {
+                return ERROR_MEMORY;
+            }
+        }
+        return update_metadata(options);
+    }
+    return ERROR_INVALID_REQUEST;
+}
+
+/* error message of a response */
+static const char * server_get_error(int status) {
+    switch (status) {
+        case ERROR_OPEN_READ: return "cannot open the input file for reading";
+        case ERROR_NO_FLV: return "the input file is not a valid FLV file";
+        case ERROR_EOF: return "unexpected end of file";
+        case ERROR_MEMORY: return "memory allocation error";
+        case ERROR_EMPTY_TAG: return "empty FLV tag";
+        case ERROR_OPEN_WRITE: return "cannot open the output file for writing";
+        case ERROR_INVALID_TAG: return "invalid FLV tag";
+        case ERROR_WRITE: return "unable to write the output";
+        case ERROR_INVALID_FLV_FILE: return "the input file contains errors";
+        case ERROR_MEMORY_LIMIT: return "the input file cannot be updated within the memory limit";
+        case ERROR_INVALID_REQUEST: return "invalid request";
+        default: return NULL;
+    }
+}
+
+/*
+    Connection I/O.
+*/
+static int server_read(int fd, void * buffer, size_t size) {
+    char * p = (char *)buffer;
+    ssize_t bytes;
+
+    while (size > 0) {
+        bytes = read(fd, p, size);
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            return 0;
+        }
+        p += bytes;
+        size -= (size_t)bytes;
+    }
+    return 1;
+}
+
+static int server_write(int fd, const void * buffer, size_t size) {
+    const char * p = (const char *)buffer;
+    ssize_t bytes;
+
+    while (size > 0) {
+        bytes = write(fd, p, size);
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            return 0;
+        }
+        p += bytes;
+        size -= (size_t)bytes;
+    }
+    return 1;
+}
+
+/* answer the request in the buffer of a connection, returning zero if the connection is lost */
+static int server_handle_request(server_connection * connection) {
+    server_request request;
+    flvmeta_opts options;
+    flvmeta_buffer buffer;
+    json_emitter je;
+    char * output, * response;
+    size_t output_size, response_size;
+    uint32_be size;
+    const char * error;
+    int status, result;
+
+    output = NULL;
+    output_size = 0;
+    options = *connection->options;
+
+    if (!server_parse_request(connection->request, &request)
+    || (request.format != NULL && !server_set_format(&options, request.format))) {
+        status = ERROR_INVALID_REQUEST;
+    }
+    else if (!flvmeta_buffer_open(&buffer)) {
+        status = ERROR_MEMORY;
+    }
+    else {
+        options.input_file = request.file;
+        options.output_file = (request.output != NULL) ? request.output : request.file;
+        options.out = buffer.stream;
+        options.jobs = 1;
+        if (options.message_proc != NULL) {
+            options.message_proc = server_print_message;
+            options.message_user_data = buffer.stream;
+        }
+
+        status = server_run_command(request.command, &options);
+        output = flvmeta_buffer_release(&buffer, &output_size);
+        if (output == NULL && status == OK) {
+            status = ERROR_WRITE;
+        }
+    }
+
+    /* the response is set aside to be sent after its size */
+    if (!flvmeta_buffer_open(&buffer)) {
+        free(output);
+        return 0;
+    }
+
+    json_emit_init_file(&je, buffer.stream);
+    json_emit_object_start(&je);
+    if (request.id_type == SERVER_STRING_ID) {
+        json_emit_object_key_z(&je, "id");
+        json_emit_string_z(&je, request.id_string);
+    }
+    else if (request.id_type == SERVER_NUMBER_ID) {
+        json_emit_object_key_z(&je, "id");
+        json_emit_number(&je, request.id_number);
+    }
+    json_emit_object_key_z(&je, "status");
+    json_emit_integer(&je, status);
+    error = server_get_error(status);
+    if (error != NULL) {
+        json_emit_object_key_z(&je, "error");
+        json_emit_string_z(&je, error);
+    }
+    json_emit_object_key_z(&je, "output");
+    json_emit_string(&je, (output != NULL) ? output : "", output_size);
+    json_emit_object_end(&je);
+    free(output);
+
+    response = flvmeta_buffer_release(&buffer, &response_size);
+    if (response == NULL) {
+        return 0;
+    }
+
+    size = swap_uint32((uint32)response_size);
+    result = server_write(connection->fd, &size, sizeof(uint32_be))
+        && server_write(connection->fd, response, response_size);
+    free(response);
+    return result;
+}
+
+/* read the request of a connection into its buffer, returning zero if the connection is lost */
+static int server_read_request(server_connection * connection) {
+    uint32_be size_be;
+    uint32 size;
+    char * request;
+
+    if (!server_read(connection->fd, &size_be, sizeof(uint32_be))) {
+        return 0;
+    }
+    size = swap_uint32(size_be);
+    if (size > SERVER_MAX_REQUEST_SIZE) {
+        return 0;
+    }
+
+    if (size >= connection->request_size) {
+        request = (char *)realloc(connection->request, size + 1);
+        if (request == NULL) {
+            return 0;
+        }
+        connection->request = request;
+        connection->request_size = size + 1;
+    }
+
+    if (!server_read(connection->fd, connection->request, size)) {
+        return 0;
+    }
+    connection->request[size] = '\0';
+    return 1;
+}
+
+/* worker task: answer the request available on a connection, then wake up the server thread */
+static void server_serve_request(void * data) {
+    server_connection * connection = (server_connection *)data;
+    char c = 0;
+    ssize_t written;
+
+    if (!server_read_request(connection) || !server_handle_request(connection)) {
+        connection->lost = 1;
+    }
+
+    flvmeta_atomic_store(&connection->finished, 1);
+    written = write(connection->wake_fd, &c, 1);
+    (void)written;
+}
+
+/*
+    Socket management.
+*/
+
+/* whether a server is still listening on a socket */
+static int server_is_listening(const struct sockaddr_un * address) {
+    int fd, listening;
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return 1;
+    }
+    listening = (connect(fd, (const struct sockaddr *)address, sizeof(struct sockaddr_un)) == 0 || errno != ECONNREFUSED);
+    close(fd);
+    return listening;
+}
+
+/* create the listening socket, or return -1 */
+static int server_listen(const char * path) {
+    struct sockaddr_un address;
+    struct stat st;
+    int fd;
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        /* replace the socket left by a server that did not stop */
+        if (errno != EADDRINUSE
+        || lstat(path, &st) != 0 || !S_ISSOCK(st.st_mode)
+        || server_is_listening(&address)
+        || unlink(path) != 0
+        || bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+
+    if (listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+    take back the connections whose request is answered, closing the lost
+    ones, and return a free slot or NULL
+*/
+static server_connection * server_reap_connections(flvmeta_pool * pool, server_connection * connections, size_t connections_number) {
+    server_connection * free_connection;
+    size_t i;
+
+    free_connection = NULL;
+    for (i = 0; i < connections_number; ++i) {
+        if (connections[i].busy && flvmeta_atomic_load(&connections[i].finished)) {
+            /* the task is returning, if not already completed */
+            flvmeta_pool_wait(pool, &connections[i].task);
+            connections[i].busy = 0;
+            if (connections[i].lost) {
+                close(connections[i].fd);
+                connections[i].fd = -1;
+            }
+        }
+        if (connections[i].fd < 0 && free_connection == NULL) {
+            free_connection = &connections[i];
+        }
+    }
+    return free_connection;
+}
+
+/* hand a connection with a pending request to the pool */
+static void server_submit_request(flvmeta_pool * pool, server_connection * connection) {
+    connection->busy = 1;
+    connection->lost = 0;
+    flvmeta_atomic_store(&connection->finished, 0);
+    flvmeta_pool_submit(pool, &connection->task, server_serve_request, connection);
+}
+
+int server_run(const char * path, const flvmeta_opts * options) {
+    struct sigaction action, old_int_action, old_term_action, old_pipe_action;
+    struct timeval timeout;
+    struct pollfd * fds;
+    flvmeta_pool * pool;
+    server_connection * connections, * connection, ** polled;
+    size_t connections_number, polled_number, i;
+    nfds_t fds_number;
+    int stop_pipe[2], wake_pipe[2];
+    int listen_fd, fd, threads, result;
+    char drain[64];
+
+    if (pipe(stop_pipe) != 0) {
+        return ERROR_SOCKET;
+    }
+    if (pipe(wake_pipe) != 0) {
+        close(stop_pipe[0]);
+        close(stop_pipe[1]);
+        return ERROR_SOCKET;
+    }
+    /* the wake-up only matters while the pipe is empty */
+    fcntl(wake_pipe[1], F_SETFL, fcntl(wake_pipe[1], F_GETFL) | O_NONBLOCK);
+    flvmeta_atomic_store(&server_stop_fd, stop_pipe[1]);
+
+    listen_fd = server_listen(path);
+    if (listen_fd < 0) {
+        server_clear_stop_fd();
+        close(stop_pipe[0]);
+        close(stop_pipe[1]);
+        close(wake_pipe[0]);
+        close(wake_pipe[1]);
+        return ERROR_SOCKET;
+    }
+
+    pool = flvmeta_pool_new(options->jobs);
+    threads = flvmeta_pool_get_threads(pool);
+    connections_number = (size_t)threads * SERVER_CONNECTIONS_PER_THREAD;
+    connections = (server_connection *)calloc(connections_number, sizeof(server_connection));
+    fds = (struct pollfd *)calloc(connections_number + 3, sizeof(struct pollfd));
+    polled = (server_connection **)calloc(connections_number, sizeof(server_connection *));
+    if (pool == NULL || connections == NULL || fds == NULL || polled == NULL) {
+        flvmeta_pool_free(pool);
+        free(connections);
+        free(fds);
+        free(polled);
+        server_clear_stop_fd();
+        close(listen_fd);
+        unlink(path);
+        close(stop_pipe[0]);
+        close(stop_pipe[1]);
+        close(wake_pipe[0]);
+        close(wake_pipe[1]);
+        return ERROR_MEMORY;
+    }
+    for (i = 0; i < connections_number; ++i) {
+        connections[i].fd = -1;
+        connections[i].wake_fd = wake_pipe[1];
+        connections[i].options = options;
+    }
+
+    /* stop on interruption, and report lost clients as write errors */
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    action.sa_handler = server_handle_signal;
+    sigaction(SIGINT, &action, &old_int_action);
+    sigaction(SIGTERM, &action, &old_term_action);
+    action.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &action, &old_pipe_action);
+
+    if (options->verbose) {
+        flvmeta_message(options, "Listening on %s with %d threads\n", path, threads);
+    }
+
+    /* a client sending only part of a request does not hold a thread for long */
+    timeout.tv_sec = SERVER_READ_TIMEOUT;
+    timeout.tv_usec = 0;
+
+    result = OK;
+    for (;;) {
+        /* accept connections only when a slot is free, and watch the idle ones */
+        connection = server_reap_connections(pool, connections, connections_number);
+        fds[0].fd = stop_pipe[0];
+        fds[0].events = POLLIN;
+        fds[1].fd = wake_pipe[0];
+        fds[1].events = POLLIN;
+        fds[2].fd = (connection != NULL) ? listen_fd : -1;
+        fds[2].events = POLLIN;
+        fds_number = 3;
+        polled_number = 0;
+        for (i = 0; i < connections_number; ++i) {
+            if (connections[i].fd >= 0 && !connections[i].busy) {
+                fds[fds_number].fd = connections[i].fd;
+                fds[fds_number].events = POLLIN;
+                ++fds_number;
+                polled[polled_number++] = &connections[i];
+            }
+        }
+        for (i = 0; i < fds_number; ++i) {
+            fds[i].revents = 0;
+        }
+
+        if (poll(fds, fds_number, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            result = ERROR_SOCKET;
+            break;
+        }
+        if (fds[0].revents != 0) {
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            ssize_t drained = read(wake_pipe[0], drain, sizeof(drain));
+            (void)drained;
+        }
+
+        /* a readable or closed connection is handed to the pool, which finds out which */
+        for (i = 0; i < polled_number; ++i) {
+            if (fds[i + 3].revents != 0) {
+                server_submit_request(pool, polled[i]);
+            }
+        }
+
+        if (fds[2].revents & POLLIN) {
+            fd = accept(listen_fd, NULL, NULL);
+            if (fd >= 0) {
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                connection->fd = fd;
+            }
+        }
+    }
+
+    /* interrupt the requests being read, and wait for their threads */
+    server_clear_stop_fd();
+    for (i = 0; i < connections_number; ++i) {
+        if (connections[i].fd >= 0) {
+            shutdown(connections[i].fd, SHUT_RDWR);
+        }
+    }
+    flvmeta_pool_free(pool);
+
+    for (i = 0; i < connections_number; ++i) {
+        if (connections[i].fd >= 0) {
+            close(connections[i].fd);
+        }
+        free(connections[i].request);
+    }
+    free(connections);
+    free(fds);
+    free(polled);
+
+    close(listen_fd);
+    unlink(path);
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+    close(wake_pipe[0]);
+    close(wake_pipe[1]);
+
+    sigaction(SIGINT, &old_int_action, NULL);
+    sigaction(SIGTERM, &old_term_action, NULL);
+    sigaction(SIGPIPE, &old_pipe_action, NULL);
+
+    if (options->verbose) {
+        flvmeta_message(options, "Server on %s stopped\n", path);
+    }
+    return result;
+}
+
+#else /* !HAVE_SYS_UN_H */
+
+/* without Unix domain sockets, there is no server mode */
+int server_run(const char * path, const flvmeta_opts * options) {
+    return ERROR_SOCKET;
+}
+
+void server_stop(void) {
+}
+
+#endif /* HAVE_SYS_UN_H */
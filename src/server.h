@@ -0,0 +1,74 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include "flvmeta.h"
+
+/**
+    Local server mode.
+    Requests are read from the connections of a Unix domain socket, and
+    answered on the same connection, in order. Each request and response
+    is a JSON object preceded by its size in bytes, as a 32-bit big endian
+    integer. Idle connections are watched by the server thread, and each
+    request is answered by one of a pool of --jobs threads, so that a
+    client keeping its connection open does not hold a thread.
+
+    Request fields:
+        "command": "check", "info", "update", or "dump-metadata"
+        "file": input file
+        "output": output file of the update command (default is in place)
+        "format": "xml", "json", "yaml", or "raw" (default from the options)
+        "id": number or string echoed in the response
+
+    Response fields:
+        "id": the request id, if any
+        "status": exit status of the command
+        "error": error message if the status is an error
+        "output": report, dump, or metadata written by the command
+*/
+
+/* requests bigger than this size are refused, and their connection closed */
+#define SERVER_MAX_REQUEST_SIZE (1024 * 1024)
+
+/* connections accepted per thread, their requests waiting for a thread if all are busy */
+#define SERVER_CONNECTIONS_PER_THREAD 4
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+    Serve requests on the socket at the given path, with the given options
+    as defaults, until server_stop() is called or SIGINT or SIGTERM is
+    received. Returns ERROR_SOCKET if the socket cannot be created.
+*/
+int server_run(const char * path, const flvmeta_opts * options);
+
+/* stop the running server, from any thread or from a signal handler */
+void server_stop(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __SERVER_H__ */
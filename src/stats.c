@@ -0,0 +1,137 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "stats.h"
+
+#include <time.h>
+
+#ifdef WIN32
+# define WIN32_LEAN_AND_MEAN
+# include <windows.h>
+#elif defined(HAVE_GETRUSAGE)
+# include <sys/resource.h>
+#endif
+
+static const char * phase_names[FLVMETA_PHASES_NUMBER] = {
+    "header",
+    "tags",
+    "metadata",
+    "info",
+    "comparison",
+    "write"
+};
+
+/* monotonic wall clock time in seconds */
+static double flvmeta_stats_get_time(void) {
+#ifdef WIN32
+    LARGE_INTEGER frequency, counter;
+    if (QueryPerformanceFrequency(&frequency) && QueryPerformanceCounter(&counter)) {
+        return (double)counter.QuadPart / (double)frequency.QuadPart;
+    }
+#elif defined(HAVE_CLOCK_GETTIME)
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+        return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+    }
+#endif
+    return (double)time(NULL);
+}
+
+/* peak resident set size of the process in kilobytes, 0 if unknown */
+static long flvmeta_stats_get_peak_rss(void) {
+#if !defined(WIN32) && defined(HAVE_GETRUSAGE)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+# ifdef __APPLE__
+        return (long)(usage.ru_maxrss / 1024); /* bytes on macOS */
+# else
+        return (long)usage.ru_maxrss;
+# endif
+    }
+#endif
+    return 0;
+}
+
+void flvmeta_stats_init(flvmeta_stats * stats) {
+    int i;
+
+    stats->phase = FLVMETA_PHASE_NONE;
+    stats->phase_start = flvmeta_stats_get_time();
+    for (i = 0; i < FLVMETA_PHASES_NUMBER; ++i) {
+        stats->phase_times[i] = 0;
+    }
+    stats->bytes_read = 0;
+    stats->reads = 0;
+    stats->seeks = 0;
+    stats->amf_nodes = 0;
+    stats->peak_rss = 0;
+}
+
+int flvmeta_stats_enter(flvmeta_stats * stats, int phase) {
+    double now;
+    int previous;
+
+    if (stats == NULL) {
+        return FLVMETA_PHASE_NONE;
+    }
+
+    previous = stats->phase;
+    if (phase != previous) {
+        now = flvmeta_stats_get_time();
+        if (previous != FLVMETA_PHASE_NONE) {
+            stats->phase_times[previous] += now - stats->phase_start;
+        }
+        stats->phase = phase;
+        stats->phase_start = now;
+    }
+    return previous;
+}
+
+void flvmeta_stats_end(flvmeta_stats * stats, const flv_stream * stream) {
+    if (stats == NULL) {
+        return;
+    }
+
+    flvmeta_stats_enter(stats, FLVMETA_PHASE_NONE);
+    if (stream != NULL) {
+        stats->bytes_read = stream->bytes_read;
+        stats->reads = stream->reads;
+        stats->seeks = stream->seeks;
+    }
+    stats->peak_rss = flvmeta_stats_get_peak_rss();
+}
+
+const char * flvmeta_stats_get_phase_name(int phase) {
+    return (phase >= 0 && phase < FLVMETA_PHASES_NUMBER) ? phase_names[phase] : "none";
+}
+
+void flvmeta_stats_print(const flvmeta_stats * stats, FILE * out) {
+    int i;
+
+    for (i = 0; i < FLVMETA_PHASES_NUMBER; ++i) {
+        fprintf(out, "%s time: %.6f s\n", phase_names[i], stats->phase_times[i]);
+    }
+    fprintf(out, "bytes read: %" PRI_LL "u\n", (unsigned long long)stats->bytes_read);
+    fprintf(out, "read calls: %" PRI_LL "u\n", (unsigned long long)stats->reads);
+    fprintf(out, "seek calls: %" PRI_LL "u\n", (unsigned long long)stats->seeks);
+    fprintf(out, "AMF nodes: %" PRI_LL "u\n", (unsigned long long)stats->amf_nodes);
+    fprintf(out, "peak RSS: %ld kB\n", stats->peak_rss);
+}
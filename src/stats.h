@@ -0,0 +1,78 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdio.h>
+
+#include "flv.h"
+
+/* processing phases */
+#define FLVMETA_PHASE_NONE          -1
+#define FLVMETA_PHASE_HEADER        0 /* file header */
+#define FLVMETA_PHASE_TAGS          1 /* tag walk, excluding the nested phases */
+#define FLVMETA_PHASE_METADATA      2 /* script data decoding */
+#define FLVMETA_PHASE_INFO          3 /* file information computation */
+#define FLVMETA_PHASE_COMPARISON    4 /* comparison with the existing metadata */
+#define FLVMETA_PHASE_WRITE         5 /* output file writing */
+#define FLVMETA_PHASES_NUMBER       6
+
+/* performance counters of a command */
+typedef struct __flvmeta_stats {
+    int phase; /* current phase */
+    double phase_start; /* start time of the current phase, in seconds */
+    double phase_times[FLVMETA_PHASES_NUMBER]; /* wall time spent in each phase */
+    uint64 bytes_read;
+    uint64 reads;
+    uint64 seeks;
+    uint64 amf_nodes; /* AMF data objects decoded or computed */
+    long peak_rss; /* peak resident set size in kilobytes, 0 if unknown */
+} flvmeta_stats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* start counting, outside of any phase */
+void flvmeta_stats_init(flvmeta_stats * stats);
+
+/*
+    charge the time elapsed since the last call to the current phase, then
+    switch to the given phase and return the previous one; does nothing
+    and returns FLVMETA_PHASE_NONE if stats is NULL
+*/
+int flvmeta_stats_enter(flvmeta_stats * stats, int phase);
+
+/* stop counting, collecting the I/O counters of the stream and the peak RSS */
+void flvmeta_stats_end(flvmeta_stats * stats, const flv_stream * stream);
+
+/* name of a phase */
+const char * flvmeta_stats_get_phase_name(int phase);
+
+/* print the counters as plain text */
+void flvmeta_stats_print(const flvmeta_stats * stats, FILE * out);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __STATS_H__ */
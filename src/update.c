@@ -24,6 +24,7 @@
 #include "amf.h"
 #include "dump.h"
 #include "info.h"
+#include "stats.h"
 #include "update.h"
 #include "util.h"
 
@@ -33,10 +34,104 @@
 
 #define COPY_BUFFER_SIZE 4096
 
+/* memory estimation of capped updates */
+/* in-memory size of the parsed script data, per byte of its AMF encoding */
+#define MEMORY_AMF_EXPANSION    16
+/* in-memory size of a computed keyframes index entry: two numbers in their lists */
+#define MEMORY_KEYFRAME_SIZE    (2 * (sizeof(amf_data) + sizeof(amf_node)))
+/* stream buffers and computed metadata fields */
+#define MEMORY_BASE_SIZE        65536
+
+/*
+    Estimate the memory needed by the update from the tag headers,
+    and size the copy buffer so the whole update stays under the cap,
+    copying tag bodies in chunks if they do not fit
+*/
+static int plan_memory(flv_stream * flv_in, const flvmeta_opts * opts, size_t * copy_buffer_size) {
+    flv_header header;
+    flv_tag ft;
+    flv_video_tag vt;
+    uint32 keyframes, biggest_body, biggest_metadata;
+    uint64 needed, available;
+    int result;
+
+    result = flv_read_header(flv_in, &header);
+    if (result != FLV_OK) {
+        flv_reset(flv_in);
+        return (result == FLV_ERROR_NO_FLV) ? ERROR_NO_FLV : ERROR_EOF;
+    }
+
+    keyframes = biggest_body = biggest_metadata = 0;
+    while (flv_read_tag(flv_in, &ft) == FLV_OK) {
+        uint32 body_length = flv_tag_get_body_length(ft);
+
+        if (body_length > biggest_body) {
+            biggest_body = body_length;
+        }
+        if (ft.type == FLV_TAG_TYPE_META) {
+            if (body_length > biggest_metadata) {
+                biggest_metadata = body_length;
+            }
+        }
+        /* an upper bound, since keyframes can share their timestamps */
+        else if (ft.type == FLV_TAG_TYPE_VIDEO && body_length > 0
+        && flv_read_video_tag(flv_in, &vt) == FLV_OK
+        && flv_video_tag_frame_type(&vt) == FLV_VIDEO_TAG_FRAME_TYPE_KEYFRAME) {
+            ++keyframes;
+        }
+    }
+    flv_reset(flv_in);
+
+    /* script data is parsed one tag at a time, but the preserved
+       onMetaData tag is kept along with the computed one */
+    needed = MEMORY_BASE_SIZE
+        + (uint64)keyframes * MEMORY_KEYFRAME_SIZE
+        + (uint64)biggest_metadata * MEMORY_AMF_EXPANSION * (opts->preserve_metadata ? 2 : 1);
+
+    if (needed + COPY_BUFFER_SIZE > opts->max_memory) {
+        if (opts->verbose) {
+            flvmeta_message(opts, "Estimated memory of %" FILE_OFFSET_PRINTF_FORMAT "d bytes exceeds the limit of %" FILE_OFFSET_PRINTF_FORMAT "d bytes\n",
+                FILE_OFFSET_PRINTF_TYPE(needed + COPY_BUFFER_SIZE), FILE_OFFSET_PRINTF_TYPE(opts->max_memory));
+        }
+        return ERROR_MEMORY_LIMIT;
+    }
+
+    available = opts->max_memory - needed;
+    if (available > (uint64)biggest_body + FLV_TAG_SIZE) {
+        available = (uint64)biggest_body + FLV_TAG_SIZE;
+    }
+    *copy_buffer_size = (size_t)available;
+
+    if (opts->verbose) {
+        flvmeta_message(opts, "Estimated memory of %" FILE_OFFSET_PRINTF_FORMAT "d bytes, copying tags through %lu bytes\n",
+            FILE_OFFSET_PRINTF_TYPE(needed + available), (unsigned long)available);
+    }
+    return OK;
+}
+
+/*
+    Copy the next length bytes of the current tag body,
+    through a copy buffer that can be smaller than the body
+*/
+static int copy_tag_body(flv_stream * flv_in, FILE * flv_out, byte * copy_buffer, size_t copy_buffer_size, uint32 length) {
+    while (length > 0) {
+        size_t chunk = (length < copy_buffer_size) ? (size_t)length : copy_buffer_size;
+
+        if (flv_read_tag_body(flv_in, copy_buffer, chunk) < chunk) {
+            return ERROR_EOF;
+        }
+        if (fwrite(copy_buffer, 1, chunk, flv_out) < chunk) {
+            return ERROR_WRITE;
+        }
+        length -= (uint32)chunk;
+    }
+    return OK;
+}
+
 /*
     Write the flv output file
 */
-static int write_flv(flv_stream * flv_in, FILE * flv_out, const flv_info * info, const flv_metadata * meta, const flvmeta_opts * opts) {
+static int write_flv(flv_stream * flv_in, FILE * flv_out, const flv_info * info, const flv_metadata * meta, size_t copy_buffer_size, const flvmeta_opts * opts) {
     uint32_be size;
     uint32 on_metadata_name_size;
     uint32 on_metadata_size;
@@ -47,11 +142,16 @@ static int write_flv(flv_stream * flv_in, FILE * flv_out, const flv_info * info,
     uint8 timestamp_extended_audio;
     uint8 timestamp_extended_meta;
     byte * copy_buffer;
+    file_offset_t input_size;
     flv_tag ft, omft;
     int have_on_last_second;
 
+    if (flvmeta_filesize(opts->input_file, &input_size) == 0) {
+        return ERROR_OPEN_READ;
+    }
+
     if (opts->verbose) {
-        fprintf(stdout, "Writing %s...\n", opts->output_file);
+        flvmeta_message(opts, "Writing %s...\n", opts->output_file);
     }
 
     /* write the flv header */
@@ -100,7 +200,10 @@ static int write_flv(flv_stream * flv_in, FILE * flv_out, const flv_info * info,
     /* copy the tags verbatim */
     flv_reset(flv_in);
 
-    copy_buffer = (byte *)malloc(info->biggest_tag_body_size + FLV_TAG_SIZE);
+    copy_buffer = (byte *)malloc(copy_buffer_size);
+    if (copy_buffer == NULL) {
+        return ERROR_MEMORY;
+    }
     have_on_last_second = 0;
     while (flv_read_tag(flv_in, &ft) == FLV_OK) {
         file_offset_t offset;
@@ -111,6 +214,11 @@ static int write_flv(flv_stream * flv_in, FILE * flv_out, const flv_info * info,
         body_length = flv_tag_get_body_length(ft);
         timestamp = flv_tag_get_timestamp(ft);
 
+        /* the tags of a growing file written after its analysis are left out */
+        if (info->end_offset > 0 && offset >= info->end_offset) {
+            break;
+        }
+
         /* extended timestamp fixing */
         if (ft.type == FLV_TAG_TYPE_META) {
             if (timestamp < prev_timestamp_meta
@@ -168,7 +276,8 @@ static int write_flv(flv_stream * flv_in, FILE * flv_out, const flv_info * info,
             }
         }
         else {
-            size_t read_body;
+            file_offset_t available_body;
+            int result;
             
             /* insert an onLastSecond metadata tag */
             if (opts->insert_onlastsecond && !have_on_last_second && !info->have_on_last_second && (info->last_timestamp - timestamp) <= 1000) {
@@ -199,15 +308,15 @@ static int write_flv(flv_stream * flv_in, FILE * flv_out, const flv_info * info,
 
             /* if the tag is bigger than expected, it means that
                it's an unknown tag type. In this case, we only
-               copy as much data as the copy buffer can contain */
+               copy as much data as the biggest known tag */
             if (body_length > info->biggest_tag_body_size) {
                 body_length = info->biggest_tag_body_size;
             }
 
-            /* copy the tag verbatim */
-            read_body = flv_read_tag_body(flv_in, copy_buffer, body_length);
-            if (read_body < body_length) {
-                /* we have reached end of file on an incomplete tag */
+            /* the body is streamed in chunks, so check before writing anything
+               whether the end of file is reached on an incomplete tag */
+            available_body = input_size - (offset + FLV_TAG_SIZE);
+            if (available_body < (file_offset_t)body_length) {
                 if (opts->error_handling == FLVMETA_EXIT_ON_ERROR) {
                     free(copy_buffer);
                     return ERROR_EOF;
@@ -222,19 +331,26 @@ static int write_flv(flv_stream * flv_in, FILE * flv_out, const flv_info * info,
                 }
                 else if (opts->error_handling == FLVMETA_IGNORE_ERRORS) {
                     /* just copy the whole tag and exit */
+                    uint32 read_body = (available_body > 0) ? (uint32)available_body : 0;
                     flv_write_tag(flv_out, &ft);
-                    fwrite(copy_buffer, 1, read_body, flv_out);
+                    copy_tag_body(flv_in, flv_out, copy_buffer, copy_buffer_size, read_body);
                     free(copy_buffer);
                     size = swap_uint32(FLV_TAG_SIZE + read_body);
                     fwrite(&size, sizeof(uint32_be), 1, flv_out);
                     return OK;
                 }
             }
-            if (flv_write_tag(flv_out, &ft) != 1
-            || fwrite(copy_buffer, 1, body_length, flv_out) < body_length) {
+
+            /* copy the tag verbatim */
+            if (flv_write_tag(flv_out, &ft) != 1) {
                 free(copy_buffer);
                 return ERROR_WRITE;
             }
+            result = copy_tag_body(flv_in, flv_out, copy_buffer, copy_buffer_size, body_length);
+            if (result != OK) {
+                free(copy_buffer);
+                return result;
+            }
 
             /* previous tag length */
             size = swap_uint32(FLV_TAG_SIZE + body_length);
@@ -246,7 +362,7 @@ static int write_flv(flv_stream * flv_in, FILE * flv_out, const flv_info * info,
     }
 
     if (opts->verbose) {
-        fprintf(stdout, "%s successfully written\n", opts->output_file);
+        flvmeta_message(opts, "%s successfully written\n", opts->output_file);
     }
 
     free(copy_buffer);
@@ -256,27 +372,62 @@ static int write_flv(flv_stream * flv_in, FILE * flv_out, const flv_info * info,
 /* copy a FLV file while adding onMetaData and optionnally onLastSecond events */
 int update_metadata(const flvmeta_opts * opts) {
     int res, in_place_update;
+    size_t copy_buffer_size, planned_buffer_size;
     flv_stream * flv_in;
     FILE * flv_out;
     flv_info info;
     flv_metadata meta;
+    flvmeta_stats stats, * pstats;
+
+    pstats = NULL;
+    if (opts->stats) {
+        flvmeta_stats_init(&stats);
+        pstats = &stats;
+    }
 
+    /* the added metadata are consumed even if the update fails early */
     flv_in = flv_open(opts->input_file);
     if (flv_in == NULL) {
+        amf_data_free(opts->metadata);
         return ERROR_OPEN_READ;
     }
 
+    /*
+        fail fast if the update cannot stay under the memory cap
+    */
+    planned_buffer_size = 0;
+    if (opts->max_memory > 0) {
+        res = plan_memory(flv_in, opts, &planned_buffer_size);
+        if (res != OK) {
+            flv_close(flv_in);
+            amf_data_free(opts->metadata);
+            return res;
+        }
+    }
+
     /*
         get all necessary information from the flv file
     */
-    res = get_flv_info(flv_in, &info, opts);
+    res = get_flv_info(flv_in, &info, opts, pstats);
     if (res != OK) {
         flv_close(flv_in);
         amf_data_free(info.keyframes);
+        amf_data_free(info.original_on_metadata);
+        amf_data_free(opts->metadata);
         return res;
     }
 
+    /* copy whole tag bodies unless the memory cap requires chunks */
+    copy_buffer_size = info.biggest_tag_body_size + FLV_TAG_SIZE;
+    if (planned_buffer_size > 0 && planned_buffer_size < copy_buffer_size) {
+        copy_buffer_size = planned_buffer_size;
+    }
+
+    flvmeta_stats_enter(pstats, FLVMETA_PHASE_INFO);
     compute_metadata(&info, &meta, opts);
+    if (pstats != NULL) {
+        stats.amf_nodes += amf_data_count_nodes(meta.on_metadata) + amf_data_count_nodes(meta.on_last_second);
+    }
 
     /*
         open output file
@@ -304,8 +455,10 @@ int update_metadata(const flvmeta_opts * opts) {
     /*
         write the output file
     */
-    res = write_flv(flv_in, flv_out, &info, &meta, opts);
+    flvmeta_stats_enter(pstats, FLVMETA_PHASE_WRITE);
+    res = write_flv(flv_in, flv_out, &info, &meta, copy_buffer_size, opts);
 
+    flvmeta_stats_end(pstats, flv_in);
     flv_close(flv_in);
     amf_data_free(meta.on_last_second_name);
     amf_data_free(meta.on_last_second);
@@ -354,5 +507,10 @@ int update_metadata(const flvmeta_opts * opts) {
     }
     
     amf_data_free(meta.on_metadata);
+
+    /* print the performance counters if requested */
+    if (pstats != NULL) {
+        flvmeta_stats_print(pstats, opts->out);
+    }
     return res;
 }
@@ -26,11 +26,24 @@
 #else /* !WIN32 */
 # include <sys/types.h>
 # include <sys/stat.h>
+# include <dirent.h>
 # include <unistd.h>
 #endif /* WIN32 */
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "util.h"
 
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+
+/* time zone initialization */
+static pthread_once_t flvmeta_tzset_once = PTHREAD_ONCE_INIT;
+#else /* HAVE_PTHREAD */
+static int flvmeta_tzset_done = 0;
+#endif /* HAVE_PTHREAD */
+
 int flvmeta_same_file(const char * file1, const char * file2) {
 #ifdef WIN32
     /* in Windows, we have to open the files and use GetFileInformationByHandle */
@@ -142,6 +155,216 @@ int flvmeta_filesize(const char *filename, file_offset_t *filesize) {
 #endif /* WIN32 */
 }
 
+int flvmeta_is_directory(const char * path) {
+#ifdef WIN32
+    DWORD attributes;
+
+    attributes = GetFileAttributes(path);
+    return (attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY));
+#else /* !WIN32 */
+    struct stat fs;
+
+    return (stat(path, &fs) == 0 && S_ISDIR(fs.st_mode));
+#endif /* WIN32 */
+}
+
+#ifdef WIN32
+
+struct __flvmeta_dir {
+    HANDLE handle;
+    WIN32_FIND_DATA data;
+    int first;
+};
+
+flvmeta_dir * flvmeta_dir_open(const char * path) {
+    flvmeta_dir * dir;
+    char * pattern;
+    size_t length;
+
+    length = strlen(path);
+    pattern = (char *)malloc(length + 3);
+    if (pattern == NULL) {
+        return NULL;
+    }
+    memcpy(pattern, path, length);
+    strcpy(pattern + length, "\\*");
+
+    dir = (flvmeta_dir *)malloc(sizeof(flvmeta_dir));
+    if (dir != NULL) {
+        dir->handle = FindFirstFile(pattern, &dir->data);
+        dir->first = 1;
+        if (dir->handle == INVALID_HANDLE_VALUE) {
+            free(dir);
+            dir = NULL;
+        }
+    }
+    free(pattern);
+    return dir;
+}
+
+const char * flvmeta_dir_read(flvmeta_dir * dir) {
+    do {
+        if (!dir->first && !FindNextFile(dir->handle, &dir->data)) {
+            return NULL;
+        }
+        dir->first = 0;
+    } while (!strcmp(dir->data.cFileName, ".") || !strcmp(dir->data.cFileName, ".."));
+
+    return dir->data.cFileName;
+}
+
+void flvmeta_dir_close(flvmeta_dir * dir) {
+    FindClose(dir->handle);
+    free(dir);
+}
+
+#else /* !WIN32 */
+
+struct __flvmeta_dir {
+    DIR * handle;
+};
+
+flvmeta_dir * flvmeta_dir_open(const char * path) {
+    flvmeta_dir * dir;
+
+    dir = (flvmeta_dir *)malloc(sizeof(flvmeta_dir));
+    if (dir != NULL) {
+        dir->handle = opendir(path);
+        if (dir->handle == NULL) {
+            free(dir);
+            dir = NULL;
+        }
+    }
+    return dir;
+}
+
+const char * flvmeta_dir_read(flvmeta_dir * dir) {
+    struct dirent * entry;
+
+    do {
+        entry = readdir(dir->handle);
+        if (entry == NULL) {
+            return NULL;
+        }
+    } while (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."));
+
+    return entry->d_name;
+}
+
+void flvmeta_dir_close(flvmeta_dir * dir) {
+    closedir(dir->handle);
+    free(dir);
+}
+
+#endif /* WIN32 */
+
+int flvmeta_buffer_open(flvmeta_buffer * buffer) {
+#ifdef HAVE_OPEN_MEMSTREAM
+    buffer->data = NULL;
+    buffer->size = 0;
+    buffer->stream = open_memstream(&buffer->data, &buffer->size);
+#else /* HAVE_OPEN_MEMSTREAM */
+    buffer->stream = flvmeta_tmpfile();
+#endif /* HAVE_OPEN_MEMSTREAM */
+    return (buffer->stream != NULL);
+}
+
+int flvmeta_buffer_write(flvmeta_buffer * buffer, FILE * out) {
+#ifdef HAVE_OPEN_MEMSTREAM
+    int result;
+
+    /* closing the stream makes the buffer contents available */
+    result = (fclose(buffer->stream) == 0);
+    if (result && buffer->size > 0) {
+        result = (fwrite(buffer->data, 1, buffer->size, out) == buffer->size);
+    }
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->size = 0;
+#else /* HAVE_OPEN_MEMSTREAM */
+    char data[4096];
+    size_t size;
+    int result;
+
+    result = (fflush(buffer->stream) == 0);
+    rewind(buffer->stream);
+    while (result && (size = fread(data, 1, sizeof(data), buffer->stream)) > 0) {
+        result = (fwrite(data, 1, size, out) == size);
+    }
+    fclose(buffer->stream);
+#endif /* HAVE_OPEN_MEMSTREAM */
+    buffer->stream = NULL;
+    return result;
+}
+
+char * flvmeta_buffer_release(flvmeta_buffer * buffer, size_t * size) {
+    char * data;
+#ifdef HAVE_OPEN_MEMSTREAM
+    /* closing the stream makes the buffer contents available */
+    if (fclose(buffer->stream) != 0) {
+        free(buffer->data);
+        data = NULL;
+    }
+    else {
+        data = buffer->data;
+        *size = buffer->size;
+    }
+    buffer->data = NULL;
+    buffer->size = 0;
+#else /* HAVE_OPEN_MEMSTREAM */
+    long length;
+
+    data = NULL;
+    if (fflush(buffer->stream) == 0 && (length = ftell(buffer->stream)) >= 0) {
+        data = (char *)malloc((size_t)length + 1);
+        rewind(buffer->stream);
+        if (data != NULL && fread(data, 1, (size_t)length, buffer->stream) == (size_t)length) {
+            data[length] = '\0';
+            *size = (size_t)length;
+        }
+        else {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(buffer->stream);
+#endif /* HAVE_OPEN_MEMSTREAM */
+    buffer->stream = NULL;
+    return data;
+}
+
+/* read the time zone from the environment */
+static void flvmeta_tzset(void) {
+    tzset();
+}
+
+struct tm * flvmeta_localtime(const time_t * timep, struct tm * result) {
+#ifndef HAVE_LOCALTIME_R
+    struct tm * t;
+#endif /* !HAVE_LOCALTIME_R */
+
+#ifdef HAVE_PTHREAD
+    pthread_once(&flvmeta_tzset_once, flvmeta_tzset);
+#else /* HAVE_PTHREAD */
+    if (!flvmeta_tzset_done) {
+        flvmeta_tzset();
+        flvmeta_tzset_done = 1;
+    }
+#endif /* HAVE_PTHREAD */
+
+#ifdef HAVE_LOCALTIME_R
+    return localtime_r(timep, result);
+#else /* HAVE_LOCALTIME_R */
+    /* the Windows C runtime keeps the result in thread local storage */
+    t = localtime(timep);
+    if (t == NULL) {
+        return NULL;
+    }
+    *result = *t;
+    return result;
+#endif /* HAVE_LOCALTIME_R */
+}
+
 #ifndef HAVE_ISFINITE
 int flvmeta_isfinite(double d) {
     /*
@@ -23,6 +23,7 @@
 #define __UTIL_H__
 
 #include <stdio.h>
+#include <time.h>
 
 #include "types.h"
 
@@ -51,6 +52,78 @@ FILE * flvmeta_tmpfile(void);
 */
 int flvmeta_filesize(const char * filename, file_offset_t * filesize);
 
+/*
+    Whether a path is an existing directory.
+    Returns a non-zero value if it is, zero otherwise.
+*/
+int flvmeta_is_directory(const char * path);
+
+/* directory listing */
+typedef struct __flvmeta_dir flvmeta_dir;
+
+/* open a directory for listing, returns NULL if it cannot be read */
+flvmeta_dir * flvmeta_dir_open(const char * path);
+
+/*
+    Name of the next entry of a directory, excluding "." and "..",
+    or NULL once all the entries have been listed.
+    The name is valid until the next call.
+*/
+const char * flvmeta_dir_read(flvmeta_dir * dir);
+
+/* close a directory */
+void flvmeta_dir_close(flvmeta_dir * dir);
+
+/*
+    Output buffer: a stream whose contents are set aside
+    to be written later to another stream.
+*/
+typedef struct __flvmeta_buffer {
+    FILE * stream;
+#ifdef HAVE_OPEN_MEMSTREAM
+    char * data;
+    size_t size;
+#endif /* HAVE_OPEN_MEMSTREAM */
+} flvmeta_buffer;
+
+/* open an output buffer, returns a non-zero value if successful */
+int flvmeta_buffer_open(flvmeta_buffer * buffer);
+
+/*
+    Write the contents of an output buffer to a stream and release it.
+    Returns a non-zero value if successful, zero otherwise.
+*/
+int flvmeta_buffer_write(flvmeta_buffer * buffer, FILE * out);
+
+/*
+    Release an output buffer, returning its null-terminated contents
+    and their size, or NULL if they cannot be read.
+    The contents must be freed by the caller.
+*/
+char * flvmeta_buffer_release(flvmeta_buffer * buffer, size_t * size);
+
+/*
+    Atomic accesses to the integers shared with signal handlers and other
+    threads, falling back to volatile accesses with other compilers.
+*/
+#if defined(__GNUC__)
+# define flvmeta_atomic_load(p)     __atomic_load_n((p), __ATOMIC_SEQ_CST)
+# define flvmeta_atomic_store(p, v) __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+# define flvmeta_atomic_add(p, v)   __atomic_add_fetch((p), (v), __ATOMIC_SEQ_CST)
+#else /* __GNUC__ */
+# define flvmeta_atomic_load(p)     (*(p))
+# define flvmeta_atomic_store(p, v) (*(p) = (v))
+# define flvmeta_atomic_add(p, v)   (*(p) += (v))
+#endif /* __GNUC__ */
+
+/*
+    Reentrant conversion of a time to the local time, stored in result.
+    The time zone is read from the environment once per process, since
+    tzset() is not safe to call while other threads convert times.
+    Returns result, or NULL if the time cannot be converted.
+*/
+struct tm * flvmeta_localtime(const time_t * timep, struct tm * result);
+
 #ifndef HAVE_ISFINITE
 /*
     Check whether a double is finite (not infinity or NaN)
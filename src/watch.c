@@ -0,0 +1,651 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "watch.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_SYS_INOTIFY_H
+# include <sys/types.h>
+# include <sys/inotify.h>
+# include <sys/stat.h>
+# include <errno.h>
+# include <fcntl.h>
+# include <poll.h>
+# include <signal.h>
+# include <time.h>
+# include <unistd.h>
+#endif /* HAVE_SYS_INOTIFY_H */
+
+#include "pool.h"
+#include "util.h"
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+/* interval between the checks for a finished file while files are processed, in milliseconds */
+#define WATCH_POLL_INTERVAL 100
+
+/* size of the buffer reading the directory events */
+#define WATCH_EVENT_BUFFER_SIZE 4096
+
+/* file waiting for its writes to settle, in the order of its last write */
+typedef struct __watch_file {
+    char * name;
+    double deadline; /* time after which the file can be processed */
+    struct __watch_file * next;
+} watch_file;
+
+/* file being processed by a worker */
+typedef struct __watch_job {
+    flvmeta_task task;
+    flvmeta_opts options;
+    batch_command_proc command;
+    char * name; /* NULL if the slot is free */
+    char * input_file;
+    char * output_file;
+    char * temp_file;
+    FILE * out;
+    int result;
+} watch_job;
+
+/* watch state */
+typedef struct __watch {
+    const flvmeta_opts * options;
+    batch_command_proc command;
+    batch_result_proc on_result;
+    void * user_data;
+    flvmeta_pool * pool;
+    watch_job * jobs;
+    size_t jobs_number;
+    watch_file * first_file;
+    watch_file * last_file;
+} watch;
+
+/* write end of the pipe waking up the watch, -1 if no watch is running */
+static volatile sig_atomic_t watch_stop_fd = -1;
+
+/* number of watch_stop calls that may be writing to the pipe, which stays open until they return */
+static volatile sig_atomic_t watch_stop_calls = 0;
+
+void watch_stop(void) {
+    int fd;
+
+    flvmeta_atomic_add(&watch_stop_calls, 1);
+    fd = flvmeta_atomic_load(&watch_stop_fd);
+    if (fd >= 0) {
+        char c = 0;
+        ssize_t written = write(fd, &c, 1);
+        (void)written;
+    }
+    flvmeta_atomic_add(&watch_stop_calls, -1);
+}
+
+/* stop waking up the watch, before its pipe is closed */
+static void watch_clear_stop_fd(void) {
+    flvmeta_atomic_store(&watch_stop_fd, -1);
+    while (flvmeta_atomic_load(&watch_stop_calls) > 0) {
+        poll(NULL, 0, 1);
+    }
+}
+
+static void watch_handle_signal(int signal_number) {
+    (void)signal_number;
+    watch_stop();
+}
+
+/* monotonic time in milliseconds */
+static double watch_get_time(void) {
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        return (double)time(NULL) * 1000;
+    }
+    return (double)ts.tv_sec * 1000 + (double)ts.tv_nsec / 1e6;
+}
+
+/* final path of the result of a file */
+static char * watch_get_output_file(const flvmeta_opts * options, const char * name) {
+    if (options->command == FLVMETA_UPDATE_COMMAND) {
+        return batch_join_path(options->batch_output_dir, name, NULL);
+    }
+    return batch_join_path(options->batch_output_dir, name, batch_get_output_extension(options));
+}
+
+/* whether a file name is the one of a result being written */
+static int watch_is_temp_file(const char * name) {
+    size_t length = strlen(name);
+    size_t suffix_length = strlen(WATCH_TEMP_SUFFIX);
+
+    return (length > suffix_length && strcmp(name + length - suffix_length, WATCH_TEMP_SUFFIX) == 0);
+}
+
+/* whether a file is being processed */
+static int watch_is_busy(const watch * w, const char * name) {
+    size_t i;
+
+    for (i = 0; i < w->jobs_number; ++i) {
+        if (w->jobs[i].name != NULL && strcmp(w->jobs[i].name, name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* remove a file from the waiting files, returning it */
+static watch_file * watch_unlink_file(watch * w, const char * name) {
+    watch_file * file, * previous;
+
+    previous = NULL;
+    for (file = w->first_file; file != NULL; file = file->next) {
+        if (strcmp(file->name, name) == 0) {
+            if (previous != NULL) {
+                previous->next = file->next;
+            }
+            else {
+                w->first_file = file->next;
+            }
+            if (w->last_file == file) {
+                w->last_file = previous;
+            }
+            file->next = NULL;
+            return file;
+        }
+        previous = file;
+    }
+    return NULL;
+}
+
+/* forget a file that is no longer waiting to be processed */
+static void watch_remove_file(watch * w, const char * name) {
+    watch_file * file = watch_unlink_file(w, name);
+
+    if (file != NULL) {
+        free(file->name);
+        free(file);
+    }
+}
+
+/* record a write to a file, delaying its processing */
+static int watch_add_file(watch * w, const char * name) {
+    watch_file * file;
+
+    file = watch_unlink_file(w, name);
+    if (file == NULL) {
+        file = (watch_file *)malloc(sizeof(watch_file));
+        if (file == NULL) {
+            return ERROR_MEMORY;
+        }
+        file->name = batch_join_path("", name, NULL);
+        if (file->name == NULL) {
+            free(file);
+            return ERROR_MEMORY;
+        }
+        file->next = NULL;
+    }
+
+    /* the delay being constant, the files stay sorted by deadline */
+    file->deadline = watch_get_time() + (double)w->options->watch_delay;
+    if (w->last_file != NULL) {
+        w->last_file->next = file;
+    }
+    else {
+        w->first_file = file;
+    }
+    w->last_file = file;
+    return OK;
+}
+
+/* whether the result of a file is missing or older than the file */
+static int watch_is_outdated(const watch * w, const char * name) {
+    struct stat input_stat, output_stat;
+    char * input_file, * output_file;
+    int outdated;
+
+    input_file = batch_join_path(w->options->watch_dir, name, NULL);
+    output_file = watch_get_output_file(w->options, name);
+    outdated = (input_file != NULL && output_file != NULL
+        && stat(input_file, &input_stat) == 0 && S_ISREG(input_stat.st_mode)
+        && (stat(output_file, &output_stat) != 0 || output_stat.st_mtime < input_stat.st_mtime));
+    free(input_file);
+    free(output_file);
+    return outdated;
+}
+
+/*
+    Queue the files of the watched directory whose result is outdated,
+    when the watch starts or after missed events. The results left
+    incomplete by an interrupted watch are removed first.
+*/
+static int watch_scan(watch * w, int remove_temp_files) {
+    flvmeta_dir * dir;
+    const char * name;
+    char * path;
+    int result;
+
+    if (remove_temp_files) {
+        dir = flvmeta_dir_open(w->options->batch_output_dir);
+        if (dir == NULL) {
+            return ERROR_OPEN_WRITE;
+        }
+        while ((name = flvmeta_dir_read(dir)) != NULL) {
+            if (watch_is_temp_file(name)) {
+                path = batch_join_path(w->options->batch_output_dir, name, NULL);
+                if (path != NULL) {
+                    unlink(path);
+                    free(path);
+                }
+            }
+        }
+        flvmeta_dir_close(dir);
+    }
+
+    dir = flvmeta_dir_open(w->options->watch_dir);
+    if (dir == NULL) {
+        return ERROR_WATCH;
+    }
+    result = OK;
+    while (result == OK && (name = flvmeta_dir_read(dir)) != NULL) {
+        if (batch_has_flv_extension(name) && watch_is_outdated(w, name)) {
+            result = watch_add_file(w, name);
+        }
+    }
+    flvmeta_dir_close(dir);
+    return result;
+}
+
+/* write the informative messages of a file along with its output */
+static void watch_print_message(const char * message, void * user_data) {
+    fputs(message, (FILE *)user_data);
+}
+
+/* make the result durable before it is renamed */
+static int watch_sync_result(watch_job * job) {
+    int fd, result;
+
+    if (job->options.command != FLVMETA_UPDATE_COMMAND) {
+        return (fflush(job->out) == 0 && fsync(fileno(job->out)) == 0) ? OK : ERROR_WRITE;
+    }
+
+    fd = open(job->temp_file, O_RDONLY);
+    if (fd < 0) {
+        return ERROR_WRITE;
+    }
+    result = (fsync(fd) == 0) ? OK : ERROR_WRITE;
+    close(fd);
+    return result;
+}
+
+/* worker task */
+static void watch_run_job(void * data) {
+    watch_job * job = (watch_job *)data;
+
+    job->result = job->command(&job->options);
+
+    /* check reports are written for invalid files too */
+    if (job->result == OK || (job->options.command == FLVMETA_CHECK_COMMAND && job->result == ERROR_INVALID_FLV_FILE)) {
+        int result = watch_sync_result(job);
+        if (result != OK) {
+            job->result = result;
+        }
+    }
+}
+
+/* release a job, making its slot free */
+static void watch_free_job(watch_job * job) {
+    free(job->name);
+    free(job->input_file);
+    free(job->output_file);
+    free(job->temp_file);
+    job->name = NULL;
+    job->input_file = NULL;
+    job->output_file = NULL;
+    job->temp_file = NULL;
+}
+
+/* prepare the processing of a file, and submit it to the pool */
+static int watch_start_job(watch * w, watch_job * job, watch_file * file) {
+    const flvmeta_opts * options = w->options;
+
+    memcpy(&job->options, options, sizeof(flvmeta_opts));
+    job->options.metadata = NULL;
+    job->options.jobs = 1;
+    job->command = w->command;
+    job->name = file->name;
+    job->out = NULL;
+    job->result = OK;
+    job->options.input_file = job->name;
+    free(file);
+
+    job->input_file = batch_join_path(options->watch_dir, job->name, NULL);
+    job->output_file = watch_get_output_file(options, job->name);
+    if (job->input_file == NULL || job->output_file == NULL) {
+        return ERROR_MEMORY;
+    }
+    job->temp_file = batch_join_path("", job->output_file, WATCH_TEMP_SUFFIX);
+    if (job->temp_file == NULL) {
+        return ERROR_MEMORY;
+    }
+
+    job->options.input_file = job->input_file;
+    job->options.output_file = job->temp_file;
+
+    /* reports are written to the result, and updates print to the standard output */
+    if (options->command == FLVMETA_UPDATE_COMMAND) {
+        job->out = flvmeta_tmpfile();
+        if (job->out == NULL) {
+            return ERROR_WRITE;
+        }
+    }
+    else {
+        job->out = fopen(job->temp_file, "w");
+        if (job->out == NULL) {
+            return ERROR_OPEN_WRITE;
+        }
+    }
+    job->options.out = job->out;
+    if (job->options.message_proc != NULL) {
+        job->options.message_proc = watch_print_message;
+        job->options.message_user_data = job->out;
+    }
+
+    /* each update consumes its own copy of the added metadata */
+    if (options->metadata != NULL && options->command == FLVMETA_UPDATE_COMMAND) {
+        job->options.metadata = amf_data_clone(options->metadata);
+        if (job->options.metadata == NULL) {
+            return ERROR_MEMORY;
+        }
+    }
+
+    flvmeta_pool_submit(w->pool, &job->task, watch_run_job, job);
+    return OK;
+}
+
+/* rename the result of a finished file into place, and report it */
+static void watch_finish_job(watch * w, watch_job * job) {
+    int keep;
+
+    if (job->out != NULL) {
+        if (job->options.command == FLVMETA_UPDATE_COMMAND) {
+            batch_copy_output(job->out, w->options->out, job->input_file);
+            fclose(job->out);
+        }
+        else if (fclose(job->out) != 0 && job->result == OK) {
+            job->result = ERROR_WRITE;
+        }
+        job->out = NULL;
+    }
+
+    keep = (job->result == OK || (job->options.command == FLVMETA_CHECK_COMMAND && job->result == ERROR_INVALID_FLV_FILE));
+    if (keep && rename(job->temp_file, job->output_file) != 0) {
+        job->result = ERROR_WRITE;
+        keep = 0;
+    }
+    if (!keep && job->temp_file != NULL) {
+        unlink(job->temp_file);
+    }
+
+    /* errors name the final output file */
+    job->options.output_file = job->output_file;
+    if (keep && w->options->verbose) {
+        flvmeta_message(w->options, "Processed %s into %s\n", job->input_file, job->output_file);
+    }
+    w->on_result(&job->options, job->result, w->user_data);
+    watch_free_job(job);
+}
+
+/* report the files whose processing is done, returning the number of files still processed */
+static size_t watch_reap_jobs(watch * w) {
+    size_t i, busy;
+
+    busy = 0;
+    for (i = 0; i < w->jobs_number; ++i) {
+        if (w->jobs[i].name != NULL) {
+            if (flvmeta_pool_is_done(w->pool, &w->jobs[i].task)) {
+                watch_finish_job(w, &w->jobs[i]);
+            }
+            else {
+                ++busy;
+            }
+        }
+    }
+    return busy;
+}
+
+/*
+    Submit the files whose writes have settled to the free slots,
+    returning the delay until the next file can be submitted, or -1
+*/
+static int watch_submit_jobs(watch * w, size_t * busy) {
+    watch_file * file, * next;
+    double now;
+    int timeout, result;
+    size_t i;
+
+    now = watch_get_time();
+    timeout = -1;
+    i = 0;
+    for (file = w->first_file; file != NULL && *busy < w->jobs_number; file = next) {
+        next = file->next;
+
+        /* a file written again while processed waits for the current result */
+        if (watch_is_busy(w, file->name)) {
+            continue;
+        }
+        if (file->deadline > now) {
+            double delay = file->deadline - now + 1;
+            timeout = (delay < (double)INT_MAX) ? (int)delay : INT_MAX;
+            break;
+        }
+
+        while (w->jobs[i].name != NULL) {
+            ++i;
+        }
+        watch_unlink_file(w, file->name);
+        ++*busy;
+        result = watch_start_job(w, &w->jobs[i], file);
+        if (result != OK) {
+            w->jobs[i].result = result;
+            watch_finish_job(w, &w->jobs[i]);
+            --*busy;
+        }
+    }
+    return timeout;
+}
+
+/* read the directory events, queueing the written files */
+static int watch_read_events(watch * w, int fd) {
+    union {
+        struct inotify_event event; /* alignment of the events */
+        char data[WATCH_EVENT_BUFFER_SIZE];
+    } buffer;
+    const struct inotify_event * event;
+    ssize_t size;
+    char * p;
+    int result;
+
+    for (;;) {
+        size = read(fd, buffer.data, sizeof(buffer.data));
+        if (size < 0) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? OK : ERROR_WATCH;
+        }
+
+        for (p = buffer.data; p < buffer.data + size; p += sizeof(struct inotify_event) + event->len) {
+            event = (const struct inotify_event *)p;
+
+            /* the watched directory was removed */
+            if (event->mask & IN_IGNORED) {
+                return ERROR_WATCH;
+            }
+
+            /* events were lost, the directory is scanned again */
+            if (event->mask & IN_Q_OVERFLOW) {
+                result = watch_scan(w, 0);
+                if (result != OK) {
+                    return result;
+                }
+                continue;
+            }
+
+            if (event->len == 0 || (event->mask & IN_ISDIR) || !batch_has_flv_extension(event->name)) {
+                continue;
+            }
+            if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                result = watch_add_file(w, event->name);
+                if (result != OK) {
+                    return result;
+                }
+            }
+            else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                watch_remove_file(w, event->name);
+            }
+        }
+    }
+}
+
+int watch_run(const flvmeta_opts * options, batch_command_proc command, batch_result_proc on_result, void * user_data) {
+    struct sigaction action, old_int_action, old_term_action;
+    struct pollfd fds[2];
+    watch w;
+    watch_file * file;
+    size_t busy;
+    int stop_pipe[2];
+    int inotify_fd, threads, timeout, result;
+
+    if (pipe(stop_pipe) != 0) {
+        return ERROR_WATCH;
+    }
+
+    /* the directory is watched before it is scanned, so no file is missed */
+    inotify_fd = inotify_init();
+    if (inotify_fd < 0 || fcntl(inotify_fd, F_SETFL, O_NONBLOCK) != 0
+    || inotify_add_watch(inotify_fd, options->watch_dir,
+        IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ONLYDIR) < 0) {
+        if (inotify_fd >= 0) {
+            close(inotify_fd);
+        }
+        close(stop_pipe[0]);
+        close(stop_pipe[1]);
+        return ERROR_WATCH;
+    }
+
+    w.options = options;
+    w.command = command;
+    w.on_result = on_result;
+    w.user_data = user_data;
+    w.first_file = NULL;
+    w.last_file = NULL;
+    w.pool = flvmeta_pool_new(options->jobs);
+    threads = flvmeta_pool_get_threads(w.pool);
+    w.jobs_number = (size_t)threads;
+    w.jobs = (watch_job *)calloc(w.jobs_number, sizeof(watch_job));
+    if (w.pool == NULL || w.jobs == NULL) {
+        flvmeta_pool_free(w.pool);
+        free(w.jobs);
+        close(inotify_fd);
+        close(stop_pipe[0]);
+        close(stop_pipe[1]);
+        return ERROR_MEMORY;
+    }
+
+    flvmeta_atomic_store(&watch_stop_fd, stop_pipe[1]);
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    action.sa_handler = watch_handle_signal;
+    sigaction(SIGINT, &action, &old_int_action);
+    sigaction(SIGTERM, &action, &old_term_action);
+
+    result = watch_scan(&w, 1);
+    if (result == OK && options->verbose) {
+        flvmeta_message(options, "Watching %s with %d threads\n", options->watch_dir, threads);
+    }
+
+    while (result == OK) {
+        busy = watch_reap_jobs(&w);
+        timeout = watch_submit_jobs(&w, &busy);
+        if (busy > 0 && (timeout < 0 || timeout > WATCH_POLL_INTERVAL)) {
+            timeout = WATCH_POLL_INTERVAL;
+        }
+
+        fds[0].fd = stop_pipe[0];
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = inotify_fd;
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+        if (poll(fds, 2, timeout) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            result = ERROR_WATCH;
+            break;
+        }
+        if (fds[0].revents != 0) {
+            break;
+        }
+        if (fds[1].revents != 0) {
+            result = watch_read_events(&w, inotify_fd);
+        }
+    }
+
+    /* the files being processed are finished, the waiting ones are left for the next watch */
+    watch_clear_stop_fd();
+    flvmeta_pool_free(w.pool);
+    w.pool = NULL;
+    for (busy = 0; busy < w.jobs_number; ++busy) {
+        if (w.jobs[busy].name != NULL) {
+            watch_finish_job(&w, &w.jobs[busy]);
+        }
+    }
+    free(w.jobs);
+    while (w.first_file != NULL) {
+        file = w.first_file;
+        w.first_file = file->next;
+        free(file->name);
+        free(file);
+    }
+
+    close(inotify_fd);
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+
+    sigaction(SIGINT, &old_int_action, NULL);
+    sigaction(SIGTERM, &old_term_action, NULL);
+
+    if (options->verbose) {
+        flvmeta_message(options, "Watch of %s stopped\n", options->watch_dir);
+    }
+    return result;
+}
+
+#else /* !HAVE_SYS_INOTIFY_H */
+
+/* without inotify, there is no watch mode */
+int watch_run(const flvmeta_opts * options, batch_command_proc command, batch_result_proc on_result, void * user_data) {
+    return ERROR_WATCH;
+}
+
+void watch_stop(void) {
+}
+
+#endif /* HAVE_SYS_INOTIFY_H */
@@ -0,0 +1,64 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#ifndef __WATCH_H__
+#define __WATCH_H__
+
+#include "flvmeta.h"
+#include "batch.h"
+
+/**
+    Watch mode.
+    The .flv files closed after writing, or moved into the watched directory,
+    are processed once no other write has been seen for the watch delay, on a
+    pool of --jobs threads. Each result is written to a temporary file of the
+    output directory, synced, then renamed to its final name, so the output
+    directory only ever holds complete results. When the watch starts, the
+    files whose result is missing or older than the file itself are queued
+    too, catching up with the files written while no watch was running.
+*/
+
+/* default delay without writes before a file is processed, in milliseconds */
+#define WATCH_DEFAULT_DELAY 2000
+
+/* suffix of the results being written, removed when the watch starts */
+#define WATCH_TEMP_SUFFIX ".flvmeta-part"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+    Run a command on the files of the watched directory of the options until
+    watch_stop() is called or SIGINT or SIGTERM is received, reporting the
+    result of each file. Returns ERROR_WATCH if the directory cannot be
+    watched, or OK once stopped.
+*/
+int watch_run(const flvmeta_opts * options, batch_command_proc command, batch_result_proc on_result, void * user_data);
+
+/* stop the running watch, from any thread or from a signal handler */
+void watch_stop(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __WATCH_H__ */
@@ -0,0 +1,83 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "unity.h"
+#include "src/aac.h"
+
+static void test_aac_read_audio_specific_config(void) {
+    /* AAC LC, 44100 Hz, stereo */
+    const byte lc[] = { 0x12, 0x10 };
+    /* escaped object type 32 + 10, explicit 50000 Hz, mono */
+    const byte escaped[] = { 0xF9, 0x5E, 0x01, 0x86, 0xA0, 0x20 };
+    aac_config config;
+
+    TEST_ASSERT_TRUE(aac_read_audio_specific_config(lc, sizeof(lc), &config));
+    TEST_ASSERT_EQUAL_UINT32(AAC_OBJECT_TYPE_LC, config.object_type);
+    TEST_ASSERT_EQUAL_UINT32(44100, config.sampling_frequency);
+    TEST_ASSERT_EQUAL_UINT32(2, config.channel_configuration);
+
+    TEST_ASSERT_TRUE(aac_read_audio_specific_config(escaped, sizeof(escaped), &config));
+    TEST_ASSERT_EQUAL_UINT32(42, config.object_type);
+    TEST_ASSERT_EQUAL_UINT32(50000, config.sampling_frequency);
+    TEST_ASSERT_EQUAL_UINT32(1, config.channel_configuration);
+}
+
+static void test_aac_read_audio_specific_config_invalid(void) {
+    /* null object type */
+    const byte null_type[] = { 0x02, 0x10 };
+    /* reserved sampling frequency index 13 */
+    const byte reserved_rate[] = { 0x16, 0x90 };
+    aac_config config;
+
+    TEST_ASSERT_FALSE(aac_read_audio_specific_config(null_type, sizeof(null_type), &config));
+    TEST_ASSERT_FALSE(aac_read_audio_specific_config(reserved_rate, sizeof(reserved_rate), &config));
+
+    /* truncated before the channel configuration */
+    TEST_ASSERT_FALSE(aac_read_audio_specific_config(null_type, 1, &config));
+}
+
+static void test_aac_read_adts_header(void) {
+    /* MPEG-4, no CRC, AAC LC, 48000 Hz, stereo */
+    const byte adts[] = { 0xFF, 0xF1, 0x4C, 0x80, 0x2E, 0x7F, 0xFC };
+    const byte raw[] = { 0x21, 0x10, 0x04, 0x60, 0x8C, 0x1C, 0x00 };
+    aac_config config, expected;
+
+    TEST_ASSERT_TRUE(aac_read_adts_header(adts, sizeof(adts), &config));
+    TEST_ASSERT_EQUAL_UINT32(AAC_OBJECT_TYPE_LC, config.object_type);
+    TEST_ASSERT_EQUAL_UINT32(48000, config.sampling_frequency);
+    TEST_ASSERT_EQUAL_UINT32(2, config.channel_configuration);
+
+    expected.object_type = AAC_OBJECT_TYPE_LC;
+    expected.sampling_frequency = 48000;
+    expected.channel_configuration = 2;
+    TEST_ASSERT_TRUE(aac_config_equals(&config, &expected));
+
+    TEST_ASSERT_FALSE(aac_read_adts_header(raw, sizeof(raw), &config));
+    TEST_ASSERT_FALSE(aac_read_adts_header(adts, AAC_ADTS_HEADER_SIZE - 1, &config));
+}
+
+void run_aac_tests(void) {
+    UnitySetTestFile(__FILE__);
+
+    RUN_TEST(test_aac_read_audio_specific_config);
+    RUN_TEST(test_aac_read_audio_specific_config_invalid);
+    RUN_TEST(test_aac_read_adts_header);
+}
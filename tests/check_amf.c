@@ -126,6 +126,44 @@ static void test_amf_string_null(void) {
     TEST_ASSERT_NULL(amf_string_get_bytes(NULL));
 }
 
+/**
+    AMF data trees
+*/
+static void test_amf_data_count_nodes(void) {
+    amf_data * array;
+
+    data = amf_associative_array_new();
+    amf_associative_array_add(data, "duration", amf_number_new(12));
+    array = amf_array_new();
+    amf_array_push(array, amf_number_new(0));
+    amf_array_push(array, amf_number_new(2));
+    amf_associative_array_add(data, "times", array);
+
+    /* the array itself, two names, and four values */
+    TEST_ASSERT_EQUAL_size_t(7, amf_data_count_nodes(data));
+    TEST_ASSERT_EQUAL_size_t(3, amf_data_count_nodes(array));
+    TEST_ASSERT_EQUAL_size_t(0, amf_data_count_nodes(NULL));
+}
+
+static void test_amf_associative_array_delete(void) {
+    amf_data * removed;
+
+    data = amf_associative_array_new();
+    amf_associative_array_add(data, "duration", amf_number_new(12));
+    amf_associative_array_add(data, "keyframes", amf_array_new());
+    amf_associative_array_add(data, "width", amf_number_new(320));
+
+    removed = amf_associative_array_delete(data, "keyframes");
+    TEST_ASSERT_NOT_NULL(removed);
+    TEST_ASSERT_EQUAL_INT(AMF_TYPE_ARRAY, amf_data_get_type(removed));
+    amf_data_free(removed);
+
+    TEST_ASSERT_NULL(amf_associative_array_get(data, "keyframes"));
+    TEST_ASSERT_EQUAL_DOUBLE(12, amf_number_get_value(amf_associative_array_get(data, "duration")));
+    TEST_ASSERT_EQUAL_DOUBLE(320, amf_number_get_value(amf_associative_array_get(data, "width")));
+    TEST_ASSERT_NULL(amf_associative_array_delete(data, "height"));
+}
+
 void run_amf_tests(void) {
     UnitySetTestFile(__FILE__);
 
@@ -140,4 +178,6 @@ void run_amf_tests(void) {
     RUN_TEST(test_amf_string_new);
     RUN_TEST(test_amf_string_new_null);
     RUN_TEST(test_amf_string_null);
+    RUN_TEST(test_amf_data_count_nodes);
+    RUN_TEST(test_amf_associative_array_delete);
 }
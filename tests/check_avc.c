@@ -0,0 +1,102 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2016 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "unity.h"
+#include "src/avc.h"
+
+#include <string.h>
+
+/* AVCDecoderConfigurationRecord with 4-byte NAL unit lengths, one SPS, and one PPS */
+static const byte config[] = {
+    0x01, 0x42, 0xC0, 0x1E, 0xFF,
+    0xE1, 0x00, 0x04, 0x67, 0x42, 0xC0, 0x1E,
+    0x01, 0x00, 0x03, 0x68, 0xCE, 0x3C
+};
+
+static void test_avc_get_nal_length_size(void) {
+    byte invalid[sizeof(config)];
+
+    TEST_ASSERT_EQUAL_UINT(4, avc_get_nal_length_size(config, sizeof(config)));
+
+    /* lengthSizeMinusOne cannot be 2 */
+    memcpy(invalid, config, sizeof(config));
+    invalid[4] = 0xFE;
+    TEST_ASSERT_EQUAL_UINT(0, avc_get_nal_length_size(invalid, sizeof(invalid)));
+
+    /* truncated record */
+    TEST_ASSERT_EQUAL_UINT(0, avc_get_nal_length_size(config, 4));
+}
+
+static void test_avc_has_parameter_set(void) {
+    const byte sps[] = { 0x67, 0x42, 0xC0, 0x1E };
+    const byte pps[] = { 0x68, 0xCE, 0x3C };
+    const byte other_sps[] = { 0x67, 0x42, 0xC0, 0x1F };
+
+    TEST_ASSERT_TRUE(avc_has_parameter_set(config, sizeof(config), sps, sizeof(sps)));
+    TEST_ASSERT_TRUE(avc_has_parameter_set(config, sizeof(config), pps, sizeof(pps)));
+    TEST_ASSERT_FALSE(avc_has_parameter_set(config, sizeof(config), other_sps, sizeof(other_sps)));
+    TEST_ASSERT_FALSE(avc_has_parameter_set(config, sizeof(config), sps, sizeof(sps) - 1));
+
+    /* the PPS list is missing from a truncated record */
+    TEST_ASSERT_FALSE(avc_has_parameter_set(config, 12, pps, sizeof(pps)));
+}
+
+static void test_avc_get_next_nal_unit(void) {
+    const byte data[] = {
+        0x00, 0x02, 0x65, 0x88,
+        0x00, 0x00,
+        0x00, 0x01, 0x41
+    };
+    const byte * nal;
+    size_t pos, nal_size;
+
+    pos = 0;
+    TEST_ASSERT_EQUAL_INT(1, avc_get_next_nal_unit(data, sizeof(data), 2, &pos, &nal, &nal_size));
+    TEST_ASSERT_EQUAL_UINT(2, nal_size);
+    TEST_ASSERT_EQUAL_HEX8(0x65, nal[0]);
+    TEST_ASSERT_EQUAL_INT(AVC_NAL_UNIT_TYPE_IDR, avc_nal_unit_type(nal));
+
+    /* empty NAL unit */
+    TEST_ASSERT_EQUAL_INT(1, avc_get_next_nal_unit(data, sizeof(data), 2, &pos, &nal, &nal_size));
+    TEST_ASSERT_EQUAL_UINT(0, nal_size);
+
+    TEST_ASSERT_EQUAL_INT(1, avc_get_next_nal_unit(data, sizeof(data), 2, &pos, &nal, &nal_size));
+    TEST_ASSERT_EQUAL_UINT(1, nal_size);
+    TEST_ASSERT_EQUAL_UINT(sizeof(data), pos);
+
+    TEST_ASSERT_EQUAL_INT(0, avc_get_next_nal_unit(data, sizeof(data), 2, &pos, &nal, &nal_size));
+
+    /* the length exceeds the data */
+    pos = 0;
+    TEST_ASSERT_EQUAL_INT(-1, avc_get_next_nal_unit(data, 3, 2, &pos, &nal, &nal_size));
+
+    /* the length itself is incomplete */
+    pos = 0;
+    TEST_ASSERT_EQUAL_INT(-1, avc_get_next_nal_unit(data, 3, 4, &pos, &nal, &nal_size));
+}
+
+void run_avc_tests(void) {
+    UnitySetTestFile(__FILE__);
+
+    RUN_TEST(test_avc_get_nal_length_size);
+    RUN_TEST(test_avc_has_parameter_set);
+    RUN_TEST(test_avc_get_next_nal_unit);
+}
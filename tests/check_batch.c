@@ -0,0 +1,279 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2016 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "src/batch.h"
+#include "src/libflvmeta.h"
+#include "src/util.h"
+#include "test_util.h"
+
+#define BATCH_TEST_MAX_RESULTS 8
+
+/* build the path of a file in a directory */
+static void make_path(char * path, size_t path_size, const char * directory, const char * filename) {
+    int written = snprintf(path, path_size, "%s/%s", directory, filename);
+
+    TEST_ASSERT_TRUE(written > 0);
+    TEST_ASSERT_TRUE((size_t)written < path_size);
+}
+
+static void make_directory(const char * path) {
+#if defined(_WIN32)
+    TEST_ASSERT_EQUAL_INT(0, _mkdir(path));
+#else
+    TEST_ASSERT_EQUAL_INT(0, mkdir(path, 0755));
+#endif
+}
+
+static void remove_directory(const char * path) {
+#if defined(_WIN32)
+    TEST_ASSERT_EQUAL_INT(0, _rmdir(path));
+#else
+    TEST_ASSERT_EQUAL_INT(0, rmdir(path));
+#endif
+}
+
+static void write_file(const char * path, const char * contents) {
+    FILE * file = fopen(path, "w");
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_TRUE(fputs(contents, file) >= 0);
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+}
+
+static void read_file(FILE * file, char * buffer, size_t size) {
+    size_t length;
+
+    rewind(file);
+    length = fread(buffer, 1, size - 1, file);
+    buffer[length] = '\0';
+}
+
+/* results of a batch, in the order they are reported */
+typedef struct __batch_test_results {
+    char files[BATCH_TEST_MAX_RESULTS][FLVMETA_TEST_PATH_SIZE];
+    int results[BATCH_TEST_MAX_RESULTS];
+    size_t number;
+} batch_test_results;
+
+/* print the file name, and fail with the files named "bad" */
+static int test_command(const flvmeta_opts * options) {
+    fprintf(options->out, "output of %s\n", options->input_file);
+    flvmeta_message(options, "message\n");
+    return (strstr(options->input_file, "bad") != NULL) ? ERROR_NO_FLV : OK;
+}
+
+static void record_result(const flvmeta_opts * options, int result, void * user_data) {
+    batch_test_results * results = (batch_test_results *)user_data;
+
+    TEST_ASSERT_TRUE(results->number < BATCH_TEST_MAX_RESULTS);
+    strcpy(results->files[results->number], options->input_file);
+    results->results[results->number] = result;
+    ++results->number;
+}
+
+/* index of a reported file, or -1 */
+static int find_result(const batch_test_results * results, const char * file) {
+    size_t i;
+
+    for (i = 0; i < results->number; ++i) {
+        if (!strcmp(results->files[i], file)) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static void ignore_message(const char * message, void * user_data) {
+}
+
+static void test_batch_combined_output(void) {
+    flvmeta_opts options;
+    batch_test_results results;
+    char * files[3];
+    char output[256];
+    FILE * out;
+
+    files[0] = "first.flv";
+    files[1] = "bad.flv";
+    files[2] = "empty.flv";
+
+    out = flvmeta_tmpfile();
+    TEST_ASSERT_NOT_NULL(out);
+
+    flvmeta_opts_init(&options);
+    options.command = FLVMETA_CHECK_COMMAND;
+    options.batch = 1;
+    options.batch_files = files;
+    options.batch_files_number = 3;
+    options.jobs = 2;
+    options.out = out;
+    options.message_proc = ignore_message;
+
+    /* outputs and results follow the order of the input files */
+    memset(&results, 0, sizeof(results));
+    TEST_ASSERT_EQUAL_INT(OK, batch_run(&options, test_command, record_result, &results));
+    TEST_ASSERT_EQUAL_size_t(3, results.number);
+    TEST_ASSERT_EQUAL_STRING("first.flv", results.files[0]);
+    TEST_ASSERT_EQUAL_INT(OK, results.results[0]);
+    TEST_ASSERT_EQUAL_STRING("bad.flv", results.files[1]);
+    TEST_ASSERT_EQUAL_INT(ERROR_NO_FLV, results.results[1]);
+    TEST_ASSERT_EQUAL_STRING("empty.flv", results.files[2]);
+
+    /* messages are written along with the output of each file */
+    read_file(out, output, sizeof(output));
+    TEST_ASSERT_EQUAL_STRING(
+        "==> first.flv <==\noutput of first.flv\nmessage\n"
+        "==> bad.flv <==\noutput of bad.flv\nmessage\n"
+        "==> empty.flv <==\noutput of empty.flv\nmessage\n",
+        output
+    );
+    fclose(out);
+}
+
+static void test_batch_list_and_directory(void) {
+    flvmeta_opts options;
+    batch_test_results results;
+    char directory[FLVMETA_TEST_PATH_SIZE];
+    char subdirectory[FLVMETA_TEST_PATH_SIZE];
+    char list[FLVMETA_TEST_PATH_SIZE];
+    char missing_list[FLVMETA_TEST_PATH_SIZE];
+    char path[FLVMETA_TEST_PATH_SIZE];
+    char * files[1];
+    int index;
+
+    /* directory holding a.flv, b.txt, and sub/c.FLV */
+    make_temp_path(directory, sizeof(directory), "batch");
+    make_directory(directory);
+    make_path(subdirectory, sizeof(subdirectory), directory, "sub");
+    make_directory(subdirectory);
+    make_path(path, sizeof(path), directory, "a.flv");
+    write_file(path, "");
+    make_path(path, sizeof(path), directory, "b.txt");
+    write_file(path, "");
+    make_path(path, sizeof(path), subdirectory, "c.FLV");
+    write_file(path, "");
+
+    /* list with an empty line and DOS line terminators */
+    make_temp_path(list, sizeof(list), "batch-list.txt");
+    write_file(list, "listed.flv\r\n\nbad.flv\nlast.flv");
+    make_temp_path(missing_list, sizeof(missing_list), "batch-missing-list.txt");
+
+    flvmeta_opts_init(&options);
+    options.command = FLVMETA_CHECK_COMMAND;
+    options.batch = 1;
+    files[0] = directory;
+    options.batch_files = files;
+    options.batch_files_number = 1;
+    options.batch_list = list;
+    options.out = flvmeta_tmpfile();
+    TEST_ASSERT_NOT_NULL(options.out);
+
+    /* directories are listed recursively for .flv files, before the list */
+    memset(&results, 0, sizeof(results));
+    TEST_ASSERT_EQUAL_INT(OK, batch_run(&options, test_command, record_result, &results));
+    TEST_ASSERT_EQUAL_size_t(5, results.number);
+    make_path(path, sizeof(path), directory, "a.flv");
+    index = find_result(&results, path);
+    TEST_ASSERT_TRUE(index >= 0 && index < 2);
+    make_path(path, sizeof(path), subdirectory, "c.FLV");
+    index = find_result(&results, path);
+    TEST_ASSERT_TRUE(index >= 0 && index < 2);
+    TEST_ASSERT_EQUAL_STRING("listed.flv", results.files[2]);
+    TEST_ASSERT_EQUAL_STRING("bad.flv", results.files[3]);
+    TEST_ASSERT_EQUAL_INT(ERROR_NO_FLV, results.results[3]);
+    TEST_ASSERT_EQUAL_STRING("last.flv", results.files[4]);
+
+    /* an unreadable list is reported as a failed input file */
+    options.batch_files_number = 0;
+    options.batch_list = missing_list;
+    memset(&results, 0, sizeof(results));
+    TEST_ASSERT_EQUAL_INT(OK, batch_run(&options, test_command, record_result, &results));
+    TEST_ASSERT_EQUAL_size_t(1, results.number);
+    TEST_ASSERT_EQUAL_STRING(missing_list, results.files[0]);
+    TEST_ASSERT_EQUAL_INT(ERROR_OPEN_READ, results.results[0]);
+
+    fclose(options.out);
+    TEST_ASSERT_EQUAL_INT(0, remove(list));
+    make_path(path, sizeof(path), subdirectory, "c.FLV");
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+    remove_directory(subdirectory);
+    make_path(path, sizeof(path), directory, "a.flv");
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+    make_path(path, sizeof(path), directory, "b.txt");
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+    remove_directory(directory);
+}
+
+static void test_batch_output_directory(void) {
+    flvmeta_opts options;
+    batch_test_results results;
+    char directory[FLVMETA_TEST_PATH_SIZE];
+    char path[FLVMETA_TEST_PATH_SIZE];
+    char output[256];
+    char * files[1];
+    FILE * file;
+
+    make_temp_path(directory, sizeof(directory), "batch-output");
+    make_directory(directory);
+
+    flvmeta_opts_init(&options);
+    options.command = FLVMETA_CHECK_COMMAND;
+    options.check_report_format = FLVMETA_FORMAT_JSON;
+    options.batch = 1;
+    files[0] = "input/file.flv";
+    options.batch_files = files;
+    options.batch_files_number = 1;
+    options.batch_output_dir = directory;
+    options.out = NULL;
+
+    /* reports are named after the input files and the report format */
+    memset(&results, 0, sizeof(results));
+    TEST_ASSERT_EQUAL_INT(OK, batch_run(&options, test_command, record_result, &results));
+    TEST_ASSERT_EQUAL_size_t(1, results.number);
+    TEST_ASSERT_EQUAL_INT(OK, results.results[0]);
+
+    make_path(path, sizeof(path), directory, "file.flv.json");
+    file = fopen(path, "r");
+    TEST_ASSERT_NOT_NULL(file);
+    read_file(file, output, sizeof(output));
+    fclose(file);
+    TEST_ASSERT_EQUAL_STRING("output of input/file.flv\n", output);
+
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+    remove_directory(directory);
+}
+
+void run_batch_tests(void) {
+    UnitySetTestFile(__FILE__);
+
+    RUN_TEST(test_batch_combined_output);
+    RUN_TEST(test_batch_list_and_directory);
+    RUN_TEST(test_batch_output_directory);
+}
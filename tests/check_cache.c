@@ -0,0 +1,171 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "src/cache.h"
+#include "src/libflvmeta.h"
+#include "test_util.h"
+
+#define CACHE_TEST_REPORT_SIZE 256
+
+/* number of times the command was actually run */
+static int runs;
+
+static void write_file(const char * path, const char * mode, const char * contents) {
+    FILE * file = fopen(path, mode);
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_TRUE(fputs(contents, file) >= 0);
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+}
+
+/* report the input file as invalid, or copy it to the output file */
+static int test_command(const flvmeta_opts * options) {
+    ++runs;
+    if (options->command == FLVMETA_CHECK_COMMAND) {
+        fprintf(options->out, "report of %s at level %d\n", options->input_file, options->check_level);
+        return ERROR_INVALID_FLV_FILE;
+    }
+    write_file(options->output_file, "w", options->input_file);
+    return OK;
+}
+
+/* run the check command through the cache, returning its report */
+static int run_check(flvmeta_cache * cache, flvmeta_opts * options, char * report) {
+    size_t size;
+    int result;
+
+    options->out = tmpfile();
+    TEST_ASSERT_NOT_NULL(options->out);
+    result = flvmeta_cache_run(cache, options, test_command);
+
+    rewind(options->out);
+    size = fread(report, 1, CACHE_TEST_REPORT_SIZE - 1, options->out);
+    report[size] = '\0';
+    fclose(options->out);
+    return result;
+}
+
+static void test_cache_check(void) {
+    flvmeta_cache * cache;
+    flvmeta_opts options;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    char cache_path[FLVMETA_TEST_PATH_SIZE];
+    char report[CACHE_TEST_REPORT_SIZE];
+    char cached_report[CACHE_TEST_REPORT_SIZE];
+
+    make_temp_path(path, sizeof(path), "cache_check.flv");
+    make_temp_path(cache_path, sizeof(cache_path), "cache_check.cache");
+    write_file(path, "w", "FLV contents");
+    remove(cache_path);
+
+    flvmeta_opts_init(&options);
+    options.command = FLVMETA_CHECK_COMMAND;
+    options.input_file = path;
+    cache = flvmeta_cache_open(cache_path);
+    TEST_ASSERT_NOT_NULL(cache);
+
+    /* the report of an unchanged file is printed again */
+    runs = 0;
+    TEST_ASSERT_EQUAL_INT(ERROR_INVALID_FLV_FILE, run_check(cache, &options, report));
+    TEST_ASSERT_EQUAL_INT(ERROR_INVALID_FLV_FILE, run_check(cache, &options, cached_report));
+    TEST_ASSERT_EQUAL_INT(1, runs);
+    TEST_ASSERT_EQUAL_STRING(report, cached_report);
+
+    /* other options, or a modified file, are checked again */
+    options.check_level = FLVMETA_CHECK_LEVEL_ERROR;
+    TEST_ASSERT_EQUAL_INT(ERROR_INVALID_FLV_FILE, run_check(cache, &options, report));
+    TEST_ASSERT_EQUAL_INT(2, runs);
+    write_file(path, "a", " appended");
+    TEST_ASSERT_EQUAL_INT(ERROR_INVALID_FLV_FILE, run_check(cache, &options, report));
+    TEST_ASSERT_EQUAL_INT(3, runs);
+    flvmeta_cache_close(cache);
+
+    /* the results are kept in the log, whose truncated records are ignored */
+    write_file(cache_path, "ab", "\x01\x02");
+    cache = flvmeta_cache_open(cache_path);
+    TEST_ASSERT_NOT_NULL(cache);
+    TEST_ASSERT_EQUAL_INT(ERROR_INVALID_FLV_FILE, run_check(cache, &options, cached_report));
+    TEST_ASSERT_EQUAL_INT(3, runs);
+    TEST_ASSERT_EQUAL_STRING(report, cached_report);
+    flvmeta_cache_close(cache);
+
+    /* files that are not caches are not opened */
+    TEST_ASSERT_NULL(flvmeta_cache_open(path));
+
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+    TEST_ASSERT_EQUAL_INT(0, remove(cache_path));
+}
+
+static void test_cache_update(void) {
+    flvmeta_cache * cache;
+    flvmeta_opts options;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    char output_path[FLVMETA_TEST_PATH_SIZE];
+    char cache_path[FLVMETA_TEST_PATH_SIZE];
+
+    make_temp_path(path, sizeof(path), "cache_update.flv");
+    make_temp_path(output_path, sizeof(output_path), "cache_update_output.flv");
+    make_temp_path(cache_path, sizeof(cache_path), "cache_update.cache");
+    write_file(path, "w", "FLV contents");
+    remove(cache_path);
+
+    flvmeta_opts_init(&options);
+    options.command = FLVMETA_UPDATE_COMMAND;
+    options.input_file = path;
+    options.output_file = output_path;
+    cache = flvmeta_cache_open(cache_path);
+    TEST_ASSERT_NOT_NULL(cache);
+
+    /* an unchanged file is not updated again while its output is in place */
+    runs = 0;
+    TEST_ASSERT_EQUAL_INT(OK, flvmeta_cache_run(cache, &options, test_command));
+    TEST_ASSERT_EQUAL_INT(OK, flvmeta_cache_run(cache, &options, test_command));
+    TEST_ASSERT_EQUAL_INT(1, runs);
+    TEST_ASSERT_EQUAL_INT(0, remove(output_path));
+    TEST_ASSERT_EQUAL_INT(OK, flvmeta_cache_run(cache, &options, test_command));
+    TEST_ASSERT_EQUAL_INT(2, runs);
+
+    /* a file updated in place is identified by its updated contents */
+    options.output_file = path;
+    TEST_ASSERT_EQUAL_INT(OK, flvmeta_cache_run(cache, &options, test_command));
+    TEST_ASSERT_EQUAL_INT(OK, flvmeta_cache_run(cache, &options, test_command));
+    TEST_ASSERT_EQUAL_INT(3, runs);
+
+    /* the metadata dumped after updates is not cached */
+    options.dump_metadata = 1;
+    TEST_ASSERT_EQUAL_INT(OK, flvmeta_cache_run(cache, &options, test_command));
+    TEST_ASSERT_EQUAL_INT(4, runs);
+
+    flvmeta_cache_close(cache);
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+    TEST_ASSERT_EQUAL_INT(0, remove(output_path));
+    TEST_ASSERT_EQUAL_INT(0, remove(cache_path));
+}
+
+void run_cache_tests(void) {
+    UnitySetTestFile(__FILE__);
+
+    RUN_TEST(test_cache_check);
+    RUN_TEST(test_cache_update);
+}
@@ -0,0 +1,838 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "src/check.h"
+#include "src/flv.h"
+#include "test_util.h"
+
+/* number of keyframes of the test files, one every 480 milliseconds */
+#define CHECK_TEST_KEYFRAMES 5
+#define CHECK_TEST_KEYFRAME_INTERVAL 480
+
+/* size of a screen video tag, with its previous tag size */
+#define CHECK_TEST_SCREEN_TAG_SIZE (FLV_TAG_SIZE + sizeof(screen_keyframe) + sizeof(uint32_be))
+
+/* screen video keyframe of 64x48 pixels */
+static const byte screen_keyframe[] = {0x13, 0x00, 0x40, 0x00, 0x30};
+
+/* write a file of screen video keyframes every 40 milliseconds, without metadata */
+static void create_screen_file(const char * filename, char * path, size_t path_size, uint32 frames_number) {
+    FILE * file;
+    uint32 i;
+
+    file = create_temp_file(filename, path, path_size);
+    write_flv_header(file, FLV_FLAG_VIDEO);
+    for (i = 0; i < frames_number; ++i) {
+        write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, i * 40, screen_keyframe, sizeof(screen_keyframe));
+    }
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+}
+
+/* overwrite the bytes of a file at the given offset */
+static void patch_file(const char * path, long offset, const void * data, size_t size) {
+    FILE * file;
+
+    file = fopen(path, "r+b");
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_EQUAL_INT(0, fseek(file, offset, SEEK_SET));
+    TEST_ASSERT_EQUAL_size_t(size, fwrite(data, 1, size, file));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+}
+
+/* append bytes to a file */
+static void append_file(const char * path, const void * data, size_t size) {
+    FILE * file;
+
+    file = fopen(path, "ab");
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_EQUAL_size_t(size, fwrite(data, 1, size, file));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+}
+
+/* cut the given number of bytes from the end of a file */
+static void truncate_file(const char * path, size_t removed) {
+    FILE * file;
+    byte * buffer;
+    long size;
+
+    file = fopen(path, "rb");
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_EQUAL_INT(0, fseek(file, 0, SEEK_END));
+    size = ftell(file);
+    TEST_ASSERT_TRUE(size > (long)removed);
+    size -= (long)removed;
+    buffer = (byte *)malloc((size_t)size);
+    TEST_ASSERT_NOT_NULL(buffer);
+    rewind(file);
+    TEST_ASSERT_EQUAL_size_t((size_t)size, fread(buffer, 1, (size_t)size, file));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+
+    file = fopen(path, "wb");
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_EQUAL_size_t((size_t)size, fwrite(buffer, 1, (size_t)size, file));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+    free(buffer);
+}
+
+/*
+    write a file of screen video keyframes whose onMetaData keyframes index
+    holds the given times, in seconds, and the given shift added to the
+    actual positions of the matching keyframes
+*/
+static void create_keyframes_file(const char * filename, char * path, size_t path_size,
+    const number64 * times, size_t times_number, number64 shift) {
+    FILE * file;
+    amf_data * name, * data, * keyframes, * amf_times, * amf_positions;
+    amf_node * node;
+    uint32 meta_size, first_offset, i;
+    size_t j;
+
+    name = amf_str("onMetaData");
+    data = amf_associative_array_new();
+    keyframes = amf_object_new();
+    amf_times = amf_array_new();
+    amf_positions = amf_array_new();
+    amf_object_add(keyframes, "times", amf_times);
+    amf_object_add(keyframes, "filepositions", amf_positions);
+    amf_associative_array_add(data, "keyframes", keyframes);
+
+    for (j = 0; j < times_number; ++j) {
+        amf_array_push(amf_times, amf_number_new(times[j]));
+        amf_array_push(amf_positions, amf_number_new(0));
+    }
+
+    /* the positions do not change the size of the metadata */
+    meta_size = (uint32)(amf_data_size(name) + amf_data_size(data));
+    first_offset = FLV_HEADER_SIZE + sizeof(uint32_be) + FLV_TAG_SIZE + meta_size + sizeof(uint32_be);
+    node = amf_array_first(amf_positions);
+    for (j = 0; j < times_number; ++j) {
+        uint32 index = (uint32)(times[j] * 1000 / CHECK_TEST_KEYFRAME_INTERVAL + 0.5);
+        number64 position = first_offset + index * CHECK_TEST_SCREEN_TAG_SIZE;
+        amf_number_set_value(amf_array_get(node), position + shift);
+        node = amf_array_next(node);
+    }
+
+    file = create_temp_file(filename, path, path_size);
+    write_flv_header(file, FLV_FLAG_VIDEO);
+    write_flv_script_tag(file, 0, name, data);
+    amf_data_free(name);
+    amf_data_free(data);
+    for (i = 0; i < CHECK_TEST_KEYFRAMES; ++i) {
+        write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, i * CHECK_TEST_KEYFRAME_INTERVAL, screen_keyframe, sizeof(screen_keyframe));
+    }
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+}
+
+/* check a file with the given options */
+static int check_file_with_options(const char * path, const flvmeta_opts * options, check_result * result) {
+    flv_stream * stream;
+    int status;
+
+    stream = flv_open(path);
+    TEST_ASSERT_NOT_NULL(stream);
+    status = check_flv_stream(stream, options, result);
+    flv_close(stream);
+    return status;
+}
+
+/* check a file at the given level */
+static void check_file_at_level(const char * path, int level, check_result * result) {
+    flvmeta_opts options;
+
+    flvmeta_opts_init(&options);
+    options.check_level = level;
+    check_file_with_options(path, &options, result);
+}
+
+/* check a file at the information level */
+static void check_file(const char * path, check_result * result) {
+    check_file_at_level(path, FLVMETA_CHECK_LEVEL_INFO, result);
+}
+
+/* number of findings of the given code */
+static size_t count_findings(const check_result * result, const char * code) {
+    size_t i, count;
+
+    count = 0;
+    for (i = 0; i < result->findings_number; ++i) {
+        if (!strcmp(result->findings[i].code, code)) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+/* message of the first finding of the given code */
+static const char * get_finding_message(const check_result * result, const char * code) {
+    size_t i;
+
+    for (i = 0; i < result->findings_number; ++i) {
+        if (!strcmp(result->findings[i].code, code)) {
+            return result->findings[i].message;
+        }
+    }
+    return "";
+}
+
+/* assert that two checks have the same findings */
+static void assert_same_findings(const check_result * expected, const check_result * actual) {
+    size_t i;
+
+    TEST_ASSERT_EQUAL_size_t(expected->findings_number, actual->findings_number);
+    for (i = 0; i < expected->findings_number; ++i) {
+        TEST_ASSERT_EQUAL_STRING(expected->findings[i].code, actual->findings[i].code);
+        TEST_ASSERT_TRUE(expected->findings[i].offset == actual->findings[i].offset);
+        TEST_ASSERT_EQUAL_STRING(expected->findings[i].message, actual->findings[i].message);
+    }
+    TEST_ASSERT_EQUAL_UINT32(expected->errors, actual->errors);
+    TEST_ASSERT_EQUAL_UINT32(expected->warnings, actual->warnings);
+}
+
+/* rule table */
+
+static void test_rule_table(void) {
+    char number[16];
+    const char * code;
+    int id;
+
+    /* every rule is found at the index given by its code */
+    for (id = 1; (code = check_get_rule_code(id)) != NULL; ++id) {
+        TEST_ASSERT_EQUAL_size_t(6, strlen(code));
+        TEST_ASSERT_EQUAL_INT(id, atoi(code + 3));
+        TEST_ASSERT_EQUAL_INT(id, check_get_rule_id(code));
+        sprintf(number, "%d", id);
+        TEST_ASSERT_EQUAL_INT(id, check_get_rule_id(number));
+    }
+    TEST_ASSERT_EQUAL_INT(check_get_rule_id(INFO_KEYFRAMES_ALIGNMENT) + 1, id);
+
+    TEST_ASSERT_NULL(check_get_rule_code(0));
+    TEST_ASSERT_EQUAL_INT(-1, check_get_rule_id("0"));
+    TEST_ASSERT_EQUAL_INT(-1, check_get_rule_id("E51094"));
+    TEST_ASSERT_EQUAL_INT(-1, check_get_rule_id("X"));
+}
+
+/* collected findings */
+
+static void test_check_result(void) {
+    check_result result;
+    flvmeta_opts options;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    uint32_be size = swap_uint32(5);
+    size_t i, warnings;
+
+    create_screen_file("check_result.flv", path, sizeof(path), 3);
+    patch_file(path, FLV_HEADER_SIZE, &size, sizeof(size));
+
+    flvmeta_opts_init(&options);
+    options.check_level = FLVMETA_CHECK_LEVEL_INFO;
+    TEST_ASSERT_EQUAL_INT(ERROR_INVALID_FLV_FILE, check_file_with_options(path, &options, &result));
+
+    /* the header finding comes first, then the error */
+    TEST_ASSERT_TRUE(result.findings_number > 2);
+    TEST_ASSERT_EQUAL_STRING(INFO_HEADER_NO_AUDIO, result.findings[0].code);
+    TEST_ASSERT_EQUAL_INT(FLVMETA_CHECK_LEVEL_INFO, result.findings[0].level);
+    TEST_ASSERT_TRUE(result.findings[0].offset == 4);
+    TEST_ASSERT_EQUAL_STRING(ERROR_PREV_TAG_SIZE_BAD_FIRST, result.findings[1].code);
+    TEST_ASSERT_EQUAL_INT(check_get_rule_id(ERROR_PREV_TAG_SIZE_BAD_FIRST), result.findings[1].id);
+    TEST_ASSERT_EQUAL_INT(FLVMETA_CHECK_LEVEL_ERROR, result.findings[1].level);
+    TEST_ASSERT_TRUE(result.findings[1].offset == 9);
+    TEST_ASSERT_EQUAL_STRING("first previous tag size should be 0, 5 found instead", result.findings[1].message);
+
+    /* the counters match the findings */
+    warnings = 0;
+    for (i = 0; i < result.findings_number; ++i) {
+        TEST_ASSERT_EQUAL_INT(check_get_rule_id(result.findings[i].code), result.findings[i].id);
+        if (result.findings[i].level == FLVMETA_CHECK_LEVEL_WARNING) {
+            TEST_ASSERT_EQUAL_INT('W', result.findings[i].code[0]);
+            ++warnings;
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, result.errors);
+    TEST_ASSERT_EQUAL_UINT32(warnings, result.warnings);
+    TEST_ASSERT_EQUAL_size_t(1, count_findings(&result, WARNING_METADATA_NOT_PRESENT));
+    TEST_ASSERT_EQUAL_STRING("video codec is Screen video", get_finding_message(&result, INFO_VIDEO_CODEC));
+
+    check_result_free(&result);
+    TEST_ASSERT_NULL(result.findings);
+    TEST_ASSERT_EQUAL_size_t(0, result.findings_number);
+
+    /* findings below the requested level are left out */
+    options.check_level = FLVMETA_CHECK_LEVEL_ERROR;
+    TEST_ASSERT_EQUAL_INT(ERROR_INVALID_FLV_FILE, check_file_with_options(path, &options, &result));
+    TEST_ASSERT_EQUAL_size_t(1, result.findings_number);
+    TEST_ASSERT_EQUAL_UINT32(0, result.warnings);
+    check_result_free(&result);
+
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+static void test_disable_rule(void) {
+    check_result result;
+    flvmeta_opts options;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    uint32_be size = swap_uint32(5);
+    int disabled[1];
+
+    create_screen_file("disable_rule.flv", path, sizeof(path), 3);
+    patch_file(path, FLV_HEADER_SIZE, &size, sizeof(size));
+
+    flvmeta_opts_init(&options);
+    disabled[0] = check_get_rule_id(ERROR_PREV_TAG_SIZE_BAD_FIRST);
+    options.check_disabled_rules = disabled;
+    options.check_disabled_rules_number = 1;
+    TEST_ASSERT_EQUAL_INT(OK, check_file_with_options(path, &options, &result));
+    TEST_ASSERT_EQUAL_size_t(0, count_findings(&result, ERROR_PREV_TAG_SIZE_BAD_FIRST));
+    TEST_ASSERT_EQUAL_UINT32(0, result.errors);
+    TEST_ASSERT_EQUAL_size_t(1, count_findings(&result, WARNING_METADATA_NOT_PRESENT));
+    check_result_free(&result);
+
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+static void test_fail_fast(void) {
+    check_result result;
+    flvmeta_opts options;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    amf_data * name, * data;
+    FILE * file;
+
+    /* metadata missing both the width and the height */
+    file = create_temp_file("fail_fast.flv", path, sizeof(path));
+    write_flv_header(file, FLV_FLAG_VIDEO);
+    data = amf_associative_array_new();
+    amf_associative_array_add(data, "duration", amf_number_new(0.12));
+    name = amf_str("onMetaData");
+    write_flv_script_tag(file, 0, name, data);
+    amf_data_free(name);
+    amf_data_free(data);
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 0, screen_keyframe, sizeof(screen_keyframe));
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 40, screen_keyframe, sizeof(screen_keyframe));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+
+    flvmeta_opts_init(&options);
+    check_file_with_options(path, &options, &result);
+    TEST_ASSERT_EQUAL_size_t(1, count_findings(&result, ERROR_VIDEO_WIDTH_MISSING));
+    TEST_ASSERT_EQUAL_size_t(1, count_findings(&result, ERROR_VIDEO_HEIGHT_MISSING));
+    TEST_ASSERT_EQUAL_UINT32(2, result.errors);
+    check_result_free(&result);
+
+    /* nothing is reported after the first error */
+    options.check_fail_fast = 1;
+    check_file_with_options(path, &options, &result);
+    TEST_ASSERT_EQUAL_UINT32(1, result.errors);
+    TEST_ASSERT_EQUAL_STRING(ERROR_VIDEO_WIDTH_MISSING, result.findings[result.findings_number - 1].code);
+    check_result_free(&result);
+
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+/* quick check */
+
+static void check_file_quick(const char * path, check_result * result) {
+    flvmeta_opts options;
+
+    flvmeta_opts_init(&options);
+    options.check_level = FLVMETA_CHECK_LEVEL_INFO;
+    options.check_quick = 1;
+    check_file_with_options(path, &options, result);
+}
+
+static void test_quick_complete(void) {
+    check_result result;
+    char path[FLVMETA_TEST_PATH_SIZE];
+
+    create_screen_file("quick_complete.flv", path, sizeof(path), 5);
+    check_file_quick(path, &result);
+
+    TEST_ASSERT_EQUAL_size_t(1, result.findings_number);
+    TEST_ASSERT_EQUAL_STRING("last timestamp is 160 ms", get_finding_message(&result, INFO_TIMESTAMP_LAST));
+    TEST_ASSERT_TRUE(result.findings[0].offset == FLV_HEADER_SIZE + sizeof(uint32_be) + 4 * CHECK_TEST_SCREEN_TAG_SIZE);
+    check_result_free(&result);
+
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+static void test_quick_truncated(void) {
+    check_result result;
+    char path[FLVMETA_TEST_PATH_SIZE];
+
+    /* the last tag misses the end of its previous tag size */
+    create_screen_file("quick_truncated.flv", path, sizeof(path), 5);
+    truncate_file(path, 3);
+    check_file_quick(path, &result);
+
+    TEST_ASSERT_EQUAL_size_t(1, count_findings(&result, ERROR_GENERAL_TRUNCATED));
+    TEST_ASSERT_EQUAL_STRING("file is truncated, tag is incomplete with 3 bytes missing",
+        get_finding_message(&result, ERROR_GENERAL_TRUNCATED));
+    TEST_ASSERT_EQUAL_STRING("last timestamp is 120 ms", get_finding_message(&result, INFO_TIMESTAMP_LAST));
+    check_result_free(&result);
+
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+static void test_quick_trailing_garbage(void) {
+    check_result result;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    byte garbage[] = {1, 2, 3, 4, 5, 6, 7};
+
+    create_screen_file("quick_garbage.flv", path, sizeof(path), 5);
+    append_file(path, garbage, sizeof(garbage));
+    check_file_quick(path, &result);
+
+    TEST_ASSERT_EQUAL_size_t(1, count_findings(&result, ERROR_GENERAL_TRUNCATED));
+    TEST_ASSERT_EQUAL_STRING("file does not end with a complete tag, 7 bytes found after the last one",
+        get_finding_message(&result, ERROR_GENERAL_TRUNCATED));
+    TEST_ASSERT_EQUAL_STRING("last timestamp is 160 ms", get_finding_message(&result, INFO_TIMESTAMP_LAST));
+    check_result_free(&result);
+
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+static void test_quick_broken_chain(void) {
+    check_result result;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    uint32_be size = swap_uint32(1000);
+
+    /* the previous tag size of the second tag is wrong */
+    create_screen_file("quick_chain.flv", path, sizeof(path), 5);
+    patch_file(path, (long)(FLV_HEADER_SIZE + 2 * CHECK_TEST_SCREEN_TAG_SIZE), &size, sizeof(size));
+    check_file_quick(path, &result);
+
+    TEST_ASSERT_EQUAL_size_t(0, count_findings(&result, ERROR_GENERAL_TRUNCATED));
+    TEST_ASSERT_EQUAL_size_t(1, count_findings(&result, ERROR_PREV_TAG_SIZE_BAD));
+    TEST_ASSERT_EQUAL_STRING("last timestamp is 160 ms", get_finding_message(&result, INFO_TIMESTAMP_LAST));
+    check_result_free(&result);
+
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+/* structural check */
+
+/*
+    write a file whose second tag body is larger than the blocks read by
+    the structural check
+*/
+static void create_large_tag_file(const char * filename, char * path, size_t path_size) {
+    FILE * file;
+    byte * body;
+    uint32 body_length = 1536 * 1024;
+
+    body = (byte *)calloc(body_length, 1);
+    TEST_ASSERT_NOT_NULL(body);
+    memcpy(body, screen_keyframe, sizeof(screen_keyframe));
+
+    file = create_temp_file(filename, path, path_size);
+    write_flv_header(file, FLV_FLAG_VIDEO);
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 0, screen_keyframe, sizeof(screen_keyframe));
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 40, body, body_length);
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 80, screen_keyframe, sizeof(screen_keyframe));
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 120, screen_keyframe, sizeof(screen_keyframe));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+    free(body);
+}
+
+/* assert that the structural and full checks agree on a file at the error level */
+static void assert_structure_matches_full(const char * path) {
+    check_result full_result, structure_result;
+    flvmeta_opts options;
+
+    flvmeta_opts_init(&options);
+    options.check_level = FLVMETA_CHECK_LEVEL_ERROR;
+    check_file_with_options(path, &options, &full_result);
+    options.check_structure = 1;
+    check_file_with_options(path, &options, &structure_result);
+
+    assert_same_findings(&full_result, &structure_result);
+    check_result_free(&full_result);
+    check_result_free(&structure_result);
+}
+
+static void test_structure_valid(void) {
+    char path[FLVMETA_TEST_PATH_SIZE];
+
+    create_large_tag_file("structure_valid.flv", path, sizeof(path));
+    assert_structure_matches_full(path);
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+static void test_structure_truncated(void) {
+    check_result result;
+    char path[FLVMETA_TEST_PATH_SIZE];
+
+    create_large_tag_file("structure_truncated.flv", path, sizeof(path));
+    truncate_file(path, CHECK_TEST_SCREEN_TAG_SIZE + 2);
+    assert_structure_matches_full(path);
+
+    check_file_at_level(path, FLVMETA_CHECK_LEVEL_ERROR, &result);
+    TEST_ASSERT_EQUAL_size_t(1, count_findings(&result, FATAL_PREV_TAG_SIZE_EOF));
+    check_result_free(&result);
+
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+static void test_structure_bad_prev_tag_size(void) {
+    check_result result;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    uint32_be size = swap_uint32(1000);
+
+    /* the previous tag size following the large tag is wrong */
+    create_large_tag_file("structure_prev_tag_size.flv", path, sizeof(path));
+    patch_file(path, (long)(FLV_HEADER_SIZE + sizeof(uint32_be) + CHECK_TEST_SCREEN_TAG_SIZE + FLV_TAG_SIZE + 1536 * 1024),
+        &size, sizeof(size));
+    assert_structure_matches_full(path);
+
+    check_file_at_level(path, FLVMETA_CHECK_LEVEL_ERROR, &result);
+    TEST_ASSERT_EQUAL_size_t(1, count_findings(&result, ERROR_PREV_TAG_SIZE_BAD));
+    check_result_free(&result);
+
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+static void test_fatal_level_truncated(void) {
+    check_result result, fatal_result;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    number64 times[] = {0, 0.48, 0.96, 1.44, 1.92};
+
+    create_keyframes_file("fatal_truncated.flv", path, sizeof(path), times, 5, 0);
+    truncate_file(path, 2);
+    check_file(path, &result);
+
+    /* without the tag bodies, the same fatal finding is reported alone */
+    check_file_at_level(path, FLVMETA_CHECK_LEVEL_FATAL, &fatal_result);
+    TEST_ASSERT_TRUE(result.findings_number > 0);
+    TEST_ASSERT_EQUAL_STRING(FATAL_PREV_TAG_SIZE_EOF, result.findings[result.findings_number - 1].code);
+    TEST_ASSERT_EQUAL_size_t(1, fatal_result.findings_number);
+    TEST_ASSERT_EQUAL_STRING(FATAL_PREV_TAG_SIZE_EOF, fatal_result.findings[0].code);
+    TEST_ASSERT_EQUAL_STRING(result.findings[result.findings_number - 1].message, fatal_result.findings[0].message);
+    TEST_ASSERT_TRUE(result.findings[result.findings_number - 1].offset == fatal_result.findings[0].offset);
+
+    check_result_free(&result);
+    check_result_free(&fatal_result);
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+/* file information collected along with the checks */
+
+static void test_info_video_size_error(void) {
+    check_result result;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    amf_data * name, * data;
+    FILE * file;
+    /* AVC sequence header announcing a longer SPS than the tag holds */
+    byte sequence_header[] = {0x17, 0x00, 0x00, 0x00, 0x00, 0x01, 0x64, 0x00, 0x1F, 0xFF, 0xE1, 0x00, 0x10, 0x67, 0x64, 0, 0, 0, 0, 0, 0, 0, 0};
+    byte frame[] = {0x27, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x41};
+
+    file = create_temp_file("info_size_error.flv", path, sizeof(path));
+    write_flv_header(file, FLV_FLAG_VIDEO);
+    data = amf_associative_array_new();
+    amf_associative_array_add(data, "width", amf_number_new(64));
+    amf_associative_array_add(data, "height", amf_number_new(48));
+    name = amf_str("onMetaData");
+    write_flv_script_tag(file, 0, name, data);
+    amf_data_free(name);
+    amf_data_free(data);
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 0, sequence_header, sizeof(sequence_header));
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 0, NULL, 0);
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 40, frame, sizeof(frame));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+
+    /* the empty tag following the failure does not hide it */
+    check_file(path, &result);
+    TEST_ASSERT_EQUAL_size_t(1, count_findings(&result, FATAL_INFO_COMPUTATION_ERROR));
+    check_result_free(&result);
+
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+static void test_info_without_metadata(void) {
+    check_result result;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    FILE * file;
+    uint32 i;
+    /* H.263 keyframe without picture start code, and MP3 frame */
+    byte video[] = {0x12, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    byte audio[] = {0x2F, 0xFF, 0xFB, 0x90};
+
+    file = create_temp_file("info_no_metadata.flv", path, sizeof(path));
+    write_flv_header(file, FLV_FLAG_VIDEO | FLV_FLAG_AUDIO);
+    for (i = 0; i < 3; ++i) {
+        write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, i * 40, video, sizeof(video));
+        write_flv_tag_with_size(file, FLV_TAG_TYPE_AUDIO, i * 40, audio, sizeof(audio));
+    }
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+
+    check_file(path, &result);
+    TEST_ASSERT_EQUAL_size_t(1, count_findings(&result, WARNING_METADATA_NOT_PRESENT));
+    TEST_ASSERT_EQUAL_size_t(1, count_findings(&result, WARNING_VIDEO_SIZE_ERROR));
+    TEST_ASSERT_EQUAL_STRING("video codec is Sorenson H.263", get_finding_message(&result, INFO_VIDEO_CODEC));
+    TEST_ASSERT_EQUAL_STRING("audio format is MP3 (stereo, 16-bit, 44 kHz)", get_finding_message(&result, INFO_AUDIO_FORMAT));
+    check_result_free(&result);
+
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+/* read counters */
+
+static void test_level_read_counters(void) {
+    check_result result;
+    flvmeta_opts options;
+    flv_stream * stream;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    const char * body_rules[] = {
+        ERROR_VIDEO_FRAME_TYPE_UNKNOWN, ERROR_VIDEO_CODEC_UNKNOWN, ERROR_EXTENDED_VIDEO_CODEC_UNKNOWN,
+        ERROR_METADATA_NAME_INVALID, ERROR_METADATA_DATA_INVALID, ERROR_METADATA_NAME_INVALID_TYPE,
+        ERROR_METADATA_DATA_INVALID_TYPE, ERROR_VIDEO_WIDTH_MISSING, ERROR_VIDEO_HEIGHT_MISSING,
+        ERROR_AAC_SEQUENCE_HEADER_INVALID, ERROR_AAC_NO_SEQUENCE_HEADER, ERROR_AAC_RAW_FRAME_ADTS
+    };
+    int disabled[sizeof(body_rules) / sizeof(body_rules[0])];
+    size_t i;
+
+    for (i = 0; i < sizeof(body_rules) / sizeof(body_rules[0]); ++i) {
+        disabled[i] = check_get_rule_id(body_rules[i]);
+        TEST_ASSERT_TRUE(disabled[i] > 0);
+    }
+    create_screen_file("read_counters.flv", path, sizeof(path), 50);
+    flvmeta_opts_init(&options);
+
+    /* the error rules read the video tag bodies */
+    options.check_level = FLVMETA_CHECK_LEVEL_ERROR;
+    stream = flv_open(path);
+    TEST_ASSERT_NOT_NULL(stream);
+    TEST_ASSERT_EQUAL_INT(OK, check_flv_stream(stream, &options, &result));
+    TEST_ASSERT_TRUE(stream->reads > 50);
+    flv_close(stream);
+    check_result_free(&result);
+
+    /* without them, the file is read in large blocks */
+    options.check_disabled_rules = disabled;
+    options.check_disabled_rules_number = sizeof(disabled) / sizeof(disabled[0]);
+    stream = flv_open(path);
+    TEST_ASSERT_NOT_NULL(stream);
+    TEST_ASSERT_EQUAL_INT(OK, check_flv_stream(stream, &options, &result));
+    TEST_ASSERT_TRUE(stream->reads <= 2);
+    TEST_ASSERT_TRUE(stream->seeks <= 2);
+    flv_close(stream);
+    check_result_free(&result);
+
+    /* fatal findings never need the tag bodies */
+    options.check_level = FLVMETA_CHECK_LEVEL_FATAL;
+    options.check_disabled_rules = NULL;
+    options.check_disabled_rules_number = 0;
+    stream = flv_open(path);
+    TEST_ASSERT_NOT_NULL(stream);
+    TEST_ASSERT_EQUAL_INT(OK, check_flv_stream(stream, &options, &result));
+    TEST_ASSERT_TRUE(stream->reads <= 2);
+    flv_close(stream);
+    check_result_free(&result);
+
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+/* AAC checks */
+
+/* check a file of AAC audio tags with the given bodies, all of the given length */
+static void check_aac_tags(const char * filename, const byte * bodies, size_t tags_number, uint32 body_length, check_result * result) {
+    char path[FLVMETA_TEST_PATH_SIZE];
+    FILE * file;
+    size_t i;
+
+    file = create_temp_file(filename, path, sizeof(path));
+    write_flv_header(file, FLV_FLAG_AUDIO);
+    for (i = 0; i < tags_number; ++i) {
+        write_flv_tag_with_size(file, FLV_TAG_TYPE_AUDIO, (uint32)(i * 23), bodies + i * body_length, body_length);
+    }
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+
+    check_file(path, result);
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+/* number of findings of the AAC rules */
+static size_t count_aac_findings(const check_result * result) {
+    return count_findings(result, ERROR_AAC_SEQUENCE_HEADER_INVALID)
+        + count_findings(result, WARNING_AAC_CHANNELS_MISMATCH)
+        + count_findings(result, WARNING_AAC_CONFIG_CHANGED)
+        + count_findings(result, ERROR_AAC_NO_SEQUENCE_HEADER)
+        + count_findings(result, ERROR_AAC_RAW_FRAME_ADTS)
+        + count_findings(result, WARNING_AAC_RAW_FRAME_ELEMENT_BAD);
+}
+
+static void test_aac_channels(void) {
+    check_result result;
+    /* AAC LC at 44.1 kHz, sequence header then raw single channel or channel pair element */
+    byte mono_stereo_flag[] = {0xAF, 0x00, 0x12, 0x08, 0xAF, 0x01, 0x00, 0x00};
+    byte mono_mono_flag[] = {0xAE, 0x00, 0x12, 0x08, 0xAE, 0x01, 0x00, 0x00};
+    byte stereo_mono_flag[] = {0xAE, 0x00, 0x12, 0x10, 0xAE, 0x01, 0x20, 0x00};
+
+    /* the stereo flag is mandatory for AAC, even for a mono stream */
+    check_aac_tags("aac_mono.flv", mono_stereo_flag, 2, 4, &result);
+    TEST_ASSERT_EQUAL_size_t(0, count_aac_findings(&result));
+    TEST_ASSERT_EQUAL_size_t(0, count_findings(&result, WARNING_AUDIO_CODEC_AAC_MONO));
+    check_result_free(&result);
+
+    /* a mono flag is reported by the audio format rule only */
+    check_aac_tags("aac_mono_flag.flv", mono_mono_flag, 2, 4, &result);
+    TEST_ASSERT_EQUAL_size_t(0, count_aac_findings(&result));
+    TEST_ASSERT_EQUAL_size_t(2, count_findings(&result, WARNING_AUDIO_CODEC_AAC_MONO));
+    check_result_free(&result);
+
+    check_aac_tags("aac_stereo_mono_flag.flv", stereo_mono_flag, 2, 4, &result);
+    TEST_ASSERT_EQUAL_size_t(1, count_findings(&result, WARNING_AAC_CHANNELS_MISMATCH));
+    TEST_ASSERT_EQUAL_STRING("AAC sequence header declares 2 channel(s) while the audio tag is flagged as mono",
+        get_finding_message(&result, WARNING_AAC_CHANNELS_MISMATCH));
+    TEST_ASSERT_EQUAL_size_t(1, count_aac_findings(&result));
+    check_result_free(&result);
+}
+
+static void test_aac_sequence_headers(void) {
+    check_result result;
+    byte invalid[] = {0xAF, 0x00, 0x00, 0x00};
+    byte changed[] = {0xAF, 0x00, 0x12, 0x10, 0xAF, 0x00, 0x11, 0x90};
+    byte missing[] = {0xAF, 0x01, 0x20, 0x00, 0xAF, 0x01, 0x20, 0x00};
+
+    check_aac_tags("aac_invalid.flv", invalid, 1, 4, &result);
+    TEST_ASSERT_EQUAL_size_t(1, count_findings(&result, ERROR_AAC_SEQUENCE_HEADER_INVALID));
+    TEST_ASSERT_EQUAL_size_t(1, count_aac_findings(&result));
+    check_result_free(&result);
+
+    check_aac_tags("aac_changed.flv", changed, 2, 4, &result);
+    TEST_ASSERT_EQUAL_size_t(1, count_findings(&result, WARNING_AAC_CONFIG_CHANGED));
+    TEST_ASSERT_EQUAL_STRING("AAC configuration changed from object type 2, 44100 Hz, 2 channel(s) to object type 2, 48000 Hz, 2 channel(s)",
+        get_finding_message(&result, WARNING_AAC_CONFIG_CHANGED));
+    TEST_ASSERT_EQUAL_size_t(1, count_aac_findings(&result));
+    check_result_free(&result);
+
+    /* raw frames without configuration are reported once */
+    check_aac_tags("aac_missing.flv", missing, 2, 4, &result);
+    TEST_ASSERT_EQUAL_size_t(1, count_findings(&result, ERROR_AAC_NO_SEQUENCE_HEADER));
+    TEST_ASSERT_EQUAL_size_t(1, count_aac_findings(&result));
+    check_result_free(&result);
+}
+
+static void test_aac_raw_frames(void) {
+    check_result result;
+    byte adts[] = {
+        0xAF, 0x00, 0x12, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0xAF, 0x01, 0xFF, 0xF1, 0x50, 0x80, 0x00, 0x1F, 0xFC
+    };
+    byte element[] = {0xAF, 0x00, 0x12, 0x08, 0xAF, 0x01, 0x20, 0x00, 0xAF, 0x01, 0x20, 0x00};
+
+    check_aac_tags("aac_adts.flv", adts, 2, 9, &result);
+    TEST_ASSERT_EQUAL_size_t(1, count_findings(&result, ERROR_AAC_RAW_FRAME_ADTS));
+    TEST_ASSERT_EQUAL_size_t(1, count_aac_findings(&result));
+    check_result_free(&result);
+
+    /* a channel pair in a mono stream is reported once */
+    check_aac_tags("aac_element.flv", element, 3, 4, &result);
+    TEST_ASSERT_EQUAL_size_t(1, count_findings(&result, WARNING_AAC_RAW_FRAME_ELEMENT_BAD));
+    TEST_ASSERT_EQUAL_size_t(1, count_aac_findings(&result));
+    check_result_free(&result);
+}
+
+/* keyframes index alignment */
+
+static void test_keyframes_align_missing(void) {
+    check_result result;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    number64 times[] = {0, 0.48, 1.44, 1.92};
+
+    create_keyframes_file("keyframes_missing.flv", path, sizeof(path), times, 4, 0);
+    check_file(path, &result);
+
+    /* only the dropped entry is reported, the later ones stay paired */
+    TEST_ASSERT_EQUAL_size_t(1, count_findings(&result, WARNING_KEYFRAMES_ENTRY_MISSING));
+    TEST_ASSERT_EQUAL_size_t(0, count_findings(&result, WARNING_KEYFRAMES_ENTRY_EXTRA));
+    TEST_ASSERT_EQUAL_size_t(0, count_findings(&result, WARNING_KEYFRAMES_POS_SHIFTED));
+    TEST_ASSERT_NOT_NULL(strstr(get_finding_message(&result, WARNING_KEYFRAMES_ENTRY_MISSING), "at 0.96,"));
+    TEST_ASSERT_EQUAL_STRING("keyframes index alignment: 4 matched, 1 missing, 0 extra, 0 shifted",
+        get_finding_message(&result, INFO_KEYFRAMES_ALIGNMENT));
+
+    check_result_free(&result);
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+static void test_keyframes_align_extra(void) {
+    check_result result;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    number64 times[] = {0, 0.48, 0.96, 1.2, 1.44, 1.92};
+
+    create_keyframes_file("keyframes_extra.flv", path, sizeof(path), times, 6, 0);
+    check_file(path, &result);
+
+    TEST_ASSERT_EQUAL_size_t(0, count_findings(&result, WARNING_KEYFRAMES_ENTRY_MISSING));
+    TEST_ASSERT_EQUAL_size_t(1, count_findings(&result, WARNING_KEYFRAMES_ENTRY_EXTRA));
+    TEST_ASSERT_EQUAL_size_t(0, count_findings(&result, WARNING_KEYFRAMES_POS_SHIFTED));
+    TEST_ASSERT_NOT_NULL(strstr(get_finding_message(&result, WARNING_KEYFRAMES_ENTRY_EXTRA), "at 1.2,"));
+    TEST_ASSERT_EQUAL_STRING("keyframes index alignment: 5 matched, 0 missing, 1 extra, 0 shifted",
+        get_finding_message(&result, INFO_KEYFRAMES_ALIGNMENT));
+
+    check_result_free(&result);
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+static void test_keyframes_align_shifted(void) {
+    check_result result;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    number64 times[] = {0, 0.48, 0.96, 1.44};
+
+    /* a file whose index misses the last entry and precedes new metadata */
+    create_keyframes_file("keyframes_shifted.flv", path, sizeof(path), times, 4, 100);
+    check_file(path, &result);
+
+    TEST_ASSERT_EQUAL_size_t(1, count_findings(&result, WARNING_KEYFRAMES_ENTRY_MISSING));
+    TEST_ASSERT_EQUAL_size_t(0, count_findings(&result, WARNING_KEYFRAMES_ENTRY_EXTRA));
+    TEST_ASSERT_EQUAL_size_t(4, count_findings(&result, WARNING_KEYFRAMES_POS_SHIFTED));
+    TEST_ASSERT_EQUAL_STRING("keyframes index alignment: 4 matched, 1 missing, 0 extra, 4 shifted by +100 bytes",
+        get_finding_message(&result, INFO_KEYFRAMES_ALIGNMENT));
+
+    check_result_free(&result);
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+void run_check_tests(void) {
+    UnitySetTestFile(__FILE__);
+
+    RUN_TEST(test_rule_table);
+    RUN_TEST(test_check_result);
+    RUN_TEST(test_disable_rule);
+    RUN_TEST(test_fail_fast);
+    RUN_TEST(test_quick_complete);
+    RUN_TEST(test_quick_truncated);
+    RUN_TEST(test_quick_trailing_garbage);
+    RUN_TEST(test_quick_broken_chain);
+    RUN_TEST(test_structure_valid);
+    RUN_TEST(test_structure_truncated);
+    RUN_TEST(test_structure_bad_prev_tag_size);
+    RUN_TEST(test_fatal_level_truncated);
+    RUN_TEST(test_info_video_size_error);
+    RUN_TEST(test_info_without_metadata);
+    RUN_TEST(test_level_read_counters);
+    RUN_TEST(test_aac_channels);
+    RUN_TEST(test_aac_sequence_headers);
+    RUN_TEST(test_aac_raw_frames);
+    RUN_TEST(test_keyframes_align_missing);
+    RUN_TEST(test_keyframes_align_extra);
+    RUN_TEST(test_keyframes_align_shifted);
+}
@@ -0,0 +1,139 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "src/diff.h"
+#include "src/util.h"
+#include "test_util.h"
+
+#define DIFF_TEST_OUTPUT_SIZE 4096
+#define DIFF_TEST_FILE_SIZE 1024
+
+/* write a video only file of four frames of distinct contents */
+static size_t create_test_file(const char * filename, char * path, size_t path_size) {
+    FILE * file;
+    byte frame[] = {0x17, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+    byte i;
+    long size;
+
+    file = create_temp_file(filename, path, path_size);
+
+    write_flv_header(file, FLV_FLAG_VIDEO);
+
+    for (i = 0; i < 4; ++i) {
+        frame[sizeof(frame) - 1] = i;
+        write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, i * 40, frame, sizeof(frame));
+    }
+
+    size = ftell(file);
+    TEST_ASSERT_TRUE(size > 0);
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+    return (size_t)size;
+}
+
+/* copy the first bytes of a file */
+static void copy_file_start(const char * from, const char * to, size_t size) {
+    FILE * file;
+    byte buffer[DIFF_TEST_FILE_SIZE];
+
+    TEST_ASSERT_TRUE(size <= sizeof(buffer));
+    file = fopen(from, "rb");
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_EQUAL_size_t(size, fread(buffer, 1, size, file));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+
+    file = fopen(to, "wb");
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_EQUAL_size_t(size, fwrite(buffer, 1, size, file));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+}
+
+/* compare two files, returning the status and the printed differences */
+static int run_diff(const char * file1, const char * file2, char * output) {
+    flvmeta_opts options;
+    size_t size;
+    int retval;
+
+    flvmeta_opts_init(&options);
+    options.command = FLVMETA_DIFF_COMMAND;
+    options.input_file = (char *)file1;
+    options.output_file = (char *)file2;
+    options.out = flvmeta_tmpfile();
+    TEST_ASSERT_NOT_NULL(options.out);
+
+    retval = diff_flv_files(&options);
+
+    rewind(options.out);
+    size = fread(output, 1, DIFF_TEST_OUTPUT_SIZE - 1, options.out);
+    output[size] = '\0';
+    fclose(options.out);
+    return retval;
+}
+
+static void test_diff_identical(void) {
+    char path[FLVMETA_TEST_PATH_SIZE];
+    char output[DIFF_TEST_OUTPUT_SIZE];
+
+    create_test_file("diff_identical.flv", path, sizeof(path));
+
+    TEST_ASSERT_EQUAL_INT(OK, run_diff(path, path, output));
+    TEST_ASSERT_NOT_NULL(strstr(output, "4 identical, 0 changed, 0 removed, 0 inserted tags"));
+
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+static void test_diff_truncated(void) {
+    char path[FLVMETA_TEST_PATH_SIZE];
+    char truncated_path[FLVMETA_TEST_PATH_SIZE];
+    char output[DIFF_TEST_OUTPUT_SIZE];
+    size_t size;
+
+    /* the third tag loses the end of its body, the fourth one is missing */
+    size = create_test_file("diff_complete.flv", path, sizeof(path));
+    make_temp_path(truncated_path, sizeof(truncated_path), "diff_truncated.flv");
+    copy_file_start(path, truncated_path, size - (FLV_TAG_SIZE + 12 + 4) - 4 - 6);
+
+    TEST_ASSERT_EQUAL_INT(FLVMETA_FILES_DIFFER, run_diff(path, truncated_path, output));
+    TEST_ASSERT_NOT_NULL(strstr(output, "changed tag #3 -> #3: video -> video, timestamp 80 -> 80, 12 -> 12 (truncated) bytes\n"));
+    TEST_ASSERT_NOT_NULL(strstr(output, "removed tag #4: video, timestamp 120, 12 bytes, offset"));
+    TEST_ASSERT_NOT_NULL(strstr(output, "2 identical, 1 changed, 1 removed, 0 inserted tags"));
+
+    TEST_ASSERT_EQUAL_INT(FLVMETA_FILES_DIFFER, run_diff(truncated_path, path, output));
+    TEST_ASSERT_NOT_NULL(strstr(output, "12 (truncated) -> 12 bytes\n"));
+    TEST_ASSERT_NOT_NULL(strstr(output, "2 identical, 1 changed, 0 removed, 1 inserted tags"));
+
+    /* files cut inside their header are reported with flvmeta error codes */
+    copy_file_start(path, truncated_path, 5);
+    TEST_ASSERT_EQUAL_INT(ERROR_EOF, run_diff(path, truncated_path, output));
+
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+    TEST_ASSERT_EQUAL_INT(0, remove(truncated_path));
+}
+
+void run_diff_tests(void) {
+    UnitySetTestFile(__FILE__);
+
+    RUN_TEST(test_diff_identical);
+    RUN_TEST(test_diff_truncated);
+}
@@ -0,0 +1,511 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "src/dump.h"
+#include "src/util.h"
+#include "test_util.h"
+
+#define DUMP_TEST_OUTPUT_SIZE 65536
+
+/* video frames every 40 ms, keyframes every 160 ms, audio frames in between */
+#define DUMP_TEST_FRAMES 10
+#define DUMP_TEST_MAX_TAGS (2 * DUMP_TEST_FRAMES + 1)
+#define DUMP_TEST_TAG_TYPE_UNKNOWN 15
+
+typedef struct __dump_test_tag {
+    uint8 type;
+    uint32 timestamp;
+    byte body[2];
+    file_offset_t offset;
+} dump_test_tag;
+
+typedef struct __dump_test_file {
+    char path[FLVMETA_TEST_PATH_SIZE];
+    dump_test_tag tags[DUMP_TEST_MAX_TAGS];
+    size_t tags_number;
+} dump_test_file;
+
+static void add_tag(dump_test_file * df, uint8 type, uint32 timestamp, byte first, byte second) {
+    dump_test_tag * tag = &df->tags[df->tags_number++];
+
+    tag->type = type;
+    tag->timestamp = timestamp;
+    tag->body[0] = first;
+    tag->body[1] = second;
+}
+
+/*
+    write a file of H.263 video and MP3 audio frames with an unknown tag
+    of the given timestamp after the second video frame, preceded by the
+    given script tags; when index_shift is not negative, an onMetaData tag
+    holds a keyframes index whose positions are moved by index_shift tags
+*/
+static void create_test_file(const char * filename, dump_test_file * df, int index_shift,
+    amf_data ** events, size_t events_number, uint32 unknown_timestamp)
+{
+    FILE * file;
+    amf_data * name, * data, * keyframes, * times, * positions;
+    amf_node * node;
+    file_offset_t offset;
+    uint32 meta_size, i;
+    size_t j;
+
+    memset(df, 0, sizeof(dump_test_file));
+    for (i = 0; i < DUMP_TEST_FRAMES; ++i) {
+        add_tag(df, FLV_TAG_TYPE_VIDEO, i * 40, (i % 4 == 0) ? 0x12 : 0x22, (byte)i);
+        if (i == 1) {
+            add_tag(df, DUMP_TEST_TAG_TYPE_UNKNOWN, unknown_timestamp, 0, 0);
+        }
+        add_tag(df, FLV_TAG_TYPE_AUDIO, i * 40 + 20, 0x2F, (byte)i);
+    }
+
+    /* the keyframe positions do not change the size of the metadata */
+    name = amf_str("onMetaData");
+    data = amf_associative_array_new();
+    keyframes = amf_object_new();
+    times = amf_array_new();
+    positions = amf_array_new();
+    amf_object_add(keyframes, "times", times);
+    amf_object_add(keyframes, "filepositions", positions);
+    amf_associative_array_add(data, "keyframes", keyframes);
+    for (j = 0; j < df->tags_number; ++j) {
+        if (df->tags[j].type == FLV_TAG_TYPE_VIDEO && df->tags[j].body[0] == 0x12) {
+            amf_array_push(times, amf_number_new(df->tags[j].timestamp / 1000.0));
+            amf_array_push(positions, amf_number_new(0));
+        }
+    }
+    meta_size = (uint32)(amf_data_size(name) + amf_data_size(data));
+
+    offset = FLV_HEADER_SIZE + sizeof(uint32_be);
+    if (index_shift >= 0) {
+        offset += FLV_TAG_SIZE + meta_size + sizeof(uint32_be);
+    }
+    for (j = 0; j < events_number; ++j) {
+        offset += FLV_TAG_SIZE + amf_data_size(events[2 * j]) + amf_data_size(events[2 * j + 1]) + sizeof(uint32_be);
+    }
+    node = amf_array_first(positions);
+    for (j = 0; j < df->tags_number; ++j) {
+        df->tags[j].offset = offset;
+        offset += FLV_TAG_SIZE + sizeof(df->tags[j].body) + sizeof(uint32_be);
+        if (df->tags[j].type == FLV_TAG_TYPE_VIDEO && df->tags[j].body[0] == 0x12) {
+            amf_number_set_value(amf_array_get(node), (number64)df->tags[j + (size_t)index_shift].offset);
+            node = amf_array_next(node);
+        }
+    }
+
+    file = create_temp_file(filename, df->path, sizeof(df->path));
+
+    write_flv_header(file, FLV_FLAG_VIDEO | FLV_FLAG_AUDIO);
+
+    if (index_shift >= 0) {
+        write_flv_script_tag(file, 0, name, data);
+    }
+
+    for (j = 0; j < events_number; ++j) {
+        write_flv_script_tag(file, 0, events[2 * j], events[2 * j + 1]);
+    }
+
+    for (j = 0; j < df->tags_number; ++j) {
+        write_flv_tag_with_size(file, df->tags[j].type, df->tags[j].timestamp, df->tags[j].body, sizeof(df->tags[j].body));
+    }
+
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+    amf_data_free(name);
+    amf_data_free(data);
+}
+
+/* run a dump command, returning its status and its output */
+static int run_dump(flvmeta_opts * options, const char * path, char * output) {
+    size_t size;
+    int retval;
+
+    options->input_file = (char *)path;
+    options->out = flvmeta_tmpfile();
+    TEST_ASSERT_NOT_NULL(options->out);
+
+    if (options->command == FLVMETA_FULL_DUMP_COMMAND) {
+        retval = dump_flv_file(options);
+    }
+    else {
+        retval = dump_metadata(options);
+    }
+
+    rewind(options->out);
+    size = fread(output, 1, DUMP_TEST_OUTPUT_SIZE - 1, options->out);
+    output[size] = '\0';
+    fclose(options->out);
+    options->out = NULL;
+    return retval;
+}
+
+/* prepare the options of a raw full dump */
+static void init_full_dump(flvmeta_opts * options) {
+    flvmeta_opts_init(options);
+    options->command = FLVMETA_FULL_DUMP_COMMAND;
+    options->dump_format = FLVMETA_FORMAT_RAW;
+}
+
+/* number of occurrences of a string */
+static size_t count_string(const char * output, const char * str) {
+    size_t count = 0;
+
+    while ((output = strstr(output, str)) != NULL) {
+        ++count;
+        output += strlen(str);
+    }
+    return count;
+}
+
+/* timestamp of the first dumped tag */
+static long get_first_timestamp(const char * output) {
+    const char * line = strstr(output, "Timestamp: ");
+    return (line != NULL) ? strtol(line + 11, NULL, 10) : -1;
+}
+
+/* timestamp of the last dumped tag */
+static long get_last_timestamp(const char * output) {
+    const char * line = NULL;
+    const char * next = output;
+
+    while ((next = strstr(next, "Timestamp: ")) != NULL) {
+        line = next;
+        next += 11;
+    }
+    return (line != NULL) ? strtol(line + 11, NULL, 10) : -1;
+}
+
+/* cut a file after its first bytes */
+static void truncate_file(const char * path, size_t size) {
+    FILE * file;
+    byte * buffer = (byte *)malloc(size);
+
+    TEST_ASSERT_NOT_NULL(buffer);
+    file = fopen(path, "rb");
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_EQUAL_size_t(size, fread(buffer, 1, size, file));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+
+    file = fopen(path, "wb");
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_EQUAL_size_t(size, fwrite(buffer, 1, size, file));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+    free(buffer);
+}
+
+/* write a file of many video and audio tags, following an onMetaData tag */
+static void create_large_file(const char * filename, char * path, size_t path_size, uint32 frames_number) {
+    FILE * file;
+    amf_data * name, * data;
+    byte video[] = {0x12, 0x00}, audio[] = {0x2F, 0x00};
+    uint32 i;
+
+    file = create_temp_file(filename, path, path_size);
+    write_flv_header(file, FLV_FLAG_VIDEO | FLV_FLAG_AUDIO);
+
+    name = amf_str("onMetaData");
+    data = amf_associative_array_new();
+    amf_associative_array_add(data, "duration", amf_number_new(frames_number * 0.04));
+    write_flv_script_tag(file, 0, name, data);
+    amf_data_free(name);
+    amf_data_free(data);
+
+    for (i = 0; i < frames_number; ++i) {
+        video[0] = (i % 4 == 0) ? 0x12 : 0x22;
+        video[1] = audio[1] = (byte)i;
+        write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, i * 40, video, sizeof(video));
+        write_flv_tag_with_size(file, FLV_TAG_TYPE_AUDIO, i * 40 + 20, audio, sizeof(audio));
+    }
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+}
+
+/* run a full JSON dump with the given number of jobs, returning its whole output */
+static char * run_json_dump(const char * path, int jobs, size_t * output_size) {
+    flvmeta_opts options;
+    char * output;
+    long size;
+
+    flvmeta_opts_init(&options);
+    options.command = FLVMETA_FULL_DUMP_COMMAND;
+    options.dump_format = FLVMETA_FORMAT_JSON;
+    options.jobs = jobs;
+    options.input_file = (char *)path;
+    options.out = flvmeta_tmpfile();
+    TEST_ASSERT_NOT_NULL(options.out);
+    TEST_ASSERT_EQUAL_INT(OK, dump_flv_file(&options));
+
+    TEST_ASSERT_EQUAL_INT(0, fseek(options.out, 0, SEEK_END));
+    size = ftell(options.out);
+    TEST_ASSERT_TRUE(size > 0);
+    rewind(options.out);
+    output = (char *)malloc((size_t)size + 1);
+    TEST_ASSERT_NOT_NULL(output);
+    TEST_ASSERT_EQUAL_size_t((size_t)size, fread(output, 1, (size_t)size, options.out));
+    output[size] = '\0';
+    fclose(options.out);
+
+    *output_size = (size_t)size;
+    return output;
+}
+
+/*
+    write a file holding three onCuePoint events numbered from 1, with an
+    onTextData event after the first one
+*/
+static void create_events_file(const char * filename, dump_test_file * df) {
+    amf_data * events[8];
+    size_t i;
+
+    events[0] = amf_str("onCuePoint");
+    events[1] = amf_number_new(1);
+    events[2] = amf_str("onTextData");
+    events[3] = amf_str("text");
+    events[4] = amf_str("onCuePoint");
+    events[5] = amf_number_new(2);
+    events[6] = amf_str("onCuePoint");
+    events[7] = amf_number_new(3);
+
+    create_test_file(filename, df, -1, events, 4, 50);
+    for (i = 0; i < 8; ++i) {
+        amf_data_free(events[i]);
+    }
+}
+
+/* prepare the options of a JSON metadata dump of the given events */
+static void init_events_dump(flvmeta_opts * options, flvmeta_event * events, size_t events_number) {
+    flvmeta_opts_init(options);
+    options->command = FLVMETA_DUMP_COMMAND;
+    options->dump_format = FLVMETA_FORMAT_JSON;
+    options->metadata_events = events;
+    options->metadata_events_number = events_number;
+}
+
+static void test_dump_tag_types(void) {
+    flvmeta_opts options;
+    dump_test_file df;
+    char * output = (char *)malloc(DUMP_TEST_OUTPUT_SIZE);
+
+    TEST_ASSERT_NOT_NULL(output);
+    create_test_file("dump_types.flv", &df, -1, NULL, 0, 50);
+    init_full_dump(&options);
+
+    /* all types by default, including unknown ones */
+    TEST_ASSERT_EQUAL_INT(OK, run_dump(&options, df.path, output));
+    TEST_ASSERT_EQUAL_size_t(21, count_string(output, "--- Tag #"));
+    TEST_ASSERT_EQUAL_size_t(1, count_string(output, "Tag type: Unknown\n"));
+
+    options.dump_tag_types = FLVMETA_DUMP_TAG_TYPE_VIDEO;
+    TEST_ASSERT_EQUAL_INT(OK, run_dump(&options, df.path, output));
+    TEST_ASSERT_EQUAL_size_t(10, count_string(output, "--- Tag #"));
+    TEST_ASSERT_EQUAL_size_t(10, count_string(output, "Tag type: video\n"));
+
+    options.dump_tag_types = FLVMETA_DUMP_TAG_TYPE_AUDIO | FLVMETA_DUMP_TAG_TYPE_META;
+    TEST_ASSERT_EQUAL_INT(OK, run_dump(&options, df.path, output));
+    TEST_ASSERT_EQUAL_size_t(10, count_string(output, "--- Tag #"));
+    TEST_ASSERT_EQUAL_size_t(10, count_string(output, "Tag type: audio\n"));
+
+    /* the keyframes filter only restricts video tags */
+    options.dump_tag_types = FLVMETA_DUMP_TAG_TYPE_VIDEO;
+    options.dump_keyframes_only = 1;
+    TEST_ASSERT_EQUAL_INT(OK, run_dump(&options, df.path, output));
+    TEST_ASSERT_EQUAL_size_t(3, count_string(output, "--- Tag #"));
+    TEST_ASSERT_EQUAL_size_t(3, count_string(output, "* Video frame type: keyframe\n"));
+
+    free(output);
+    TEST_ASSERT_EQUAL_INT(0, remove(df.path));
+}
+
+static void test_dump_ranges(void) {
+    flvmeta_opts options;
+    dump_test_file df;
+    char * output = (char *)malloc(DUMP_TEST_OUTPUT_SIZE);
+
+    TEST_ASSERT_NOT_NULL(output);
+    create_test_file("dump_ranges.flv", &df, -1, NULL, 0, 50);
+    init_full_dump(&options);
+
+    /* both time bounds are inclusive */
+    options.dump_start_time = 80;
+    options.dump_end_time = 160;
+    TEST_ASSERT_EQUAL_INT(OK, run_dump(&options, df.path, output));
+    TEST_ASSERT_EQUAL_size_t(5, count_string(output, "--- Tag #"));
+    TEST_ASSERT_EQUAL_INT(80, get_first_timestamp(output));
+    TEST_ASSERT_EQUAL_INT(160, get_last_timestamp(output));
+
+    /* byte offsets select the tags starting within the range */
+    init_full_dump(&options);
+    options.dump_start_offset = df.tags[5].offset;
+    options.dump_end_offset = df.tags[9].offset;
+    TEST_ASSERT_EQUAL_INT(OK, run_dump(&options, df.path, output));
+    TEST_ASSERT_EQUAL_size_t(5, count_string(output, "--- Tag #"));
+    TEST_ASSERT_EQUAL_INT(df.tags[5].timestamp, get_first_timestamp(output));
+    TEST_ASSERT_EQUAL_INT(df.tags[9].timestamp, get_last_timestamp(output));
+
+    /* an empty range dumps the header only */
+    init_full_dump(&options);
+    options.dump_start_time = 1000;
+    TEST_ASSERT_EQUAL_INT(OK, run_dump(&options, df.path, output));
+    TEST_ASSERT_EQUAL_size_t(0, count_string(output, "--- Tag #"));
+    TEST_ASSERT_NOT_NULL(strstr(output, "Magic: FLV\n"));
+
+    free(output);
+    TEST_ASSERT_EQUAL_INT(0, remove(df.path));
+}
+
+static void test_dump_seek_start(void) {
+    flvmeta_opts options;
+    dump_test_file df;
+    char * output = (char *)malloc(DUMP_TEST_OUTPUT_SIZE);
+
+    TEST_ASSERT_NOT_NULL(output);
+    init_full_dump(&options);
+    options.dump_start_time = 200;
+
+    /*
+        the unknown tag stored before the keyframe at 160 ms is only seen
+        when the dump does not start from that keyframe
+    */
+    create_test_file("dump_seek.flv", &df, 0, NULL, 0, 1000);
+    TEST_ASSERT_EQUAL_INT(OK, run_dump(&options, df.path, output));
+    TEST_ASSERT_EQUAL_size_t(10, count_string(output, "--- Tag #"));
+    TEST_ASSERT_EQUAL_size_t(0, count_string(output, "Tag type: Unknown\n"));
+    TEST_ASSERT_EQUAL_INT(200, get_first_timestamp(output));
+    TEST_ASSERT_EQUAL_size_t(0, count_string(output, "Tag type: scriptData\n"));
+    TEST_ASSERT_EQUAL_INT(0, remove(df.path));
+
+    /* an index pointing to the wrong tags is ignored */
+    create_test_file("dump_seek_bad.flv", &df, 1, NULL, 0, 1000);
+    TEST_ASSERT_EQUAL_INT(OK, run_dump(&options, df.path, output));
+    TEST_ASSERT_EQUAL_size_t(11, count_string(output, "--- Tag #"));
+    TEST_ASSERT_EQUAL_size_t(1, count_string(output, "Tag type: Unknown\n"));
+    TEST_ASSERT_EQUAL_INT(0, remove(df.path));
+
+    /* without an index, the dump starts from the first tag */
+    create_test_file("dump_seek_none.flv", &df, -1, NULL, 0, 1000);
+    TEST_ASSERT_EQUAL_INT(OK, run_dump(&options, df.path, output));
+    TEST_ASSERT_EQUAL_size_t(11, count_string(output, "--- Tag #"));
+    TEST_ASSERT_EQUAL_INT(0, remove(df.path));
+
+    free(output);
+}
+
+static void test_dump_events(void) {
+    flvmeta_opts options;
+    flvmeta_event events[2];
+    dump_test_file df;
+    char * output = (char *)malloc(DUMP_TEST_OUTPUT_SIZE);
+
+    TEST_ASSERT_NOT_NULL(output);
+    create_events_file("dump_events.flv", &df);
+
+    /* a single payload is dumped as is */
+    events[0].name = "onCuePoint";
+    events[0].limit = 1;
+    init_events_dump(&options, events, 1);
+    TEST_ASSERT_EQUAL_INT(OK, run_dump(&options, df.path, output));
+    TEST_ASSERT_EQUAL_STRING("1\n", output);
+
+    /* several payloads are grouped by event, in the requested order */
+    events[0].limit = 2;
+    events[1].name = "onTextData";
+    events[1].limit = 0;
+    init_events_dump(&options, events, 2);
+    TEST_ASSERT_EQUAL_INT(OK, run_dump(&options, df.path, output));
+    TEST_ASSERT_EQUAL_STRING("{\"onCuePoint\":[1,2],\"onTextData\":[\"text\"]}\n", output);
+
+    /* events that are not found get an empty list */
+    events[0].name = "onLastSecond";
+    events[0].limit = 1;
+    events[1].name = "onCuePoint";
+    init_events_dump(&options, events, 2);
+    TEST_ASSERT_EQUAL_INT(OK, run_dump(&options, df.path, output));
+    TEST_ASSERT_EQUAL_STRING("{\"onLastSecond\":[],\"onCuePoint\":[1,2,3]}\n", output);
+
+    /* XML output is a single document */
+    options.dump_format = FLVMETA_FORMAT_XML;
+    TEST_ASSERT_EQUAL_INT(OK, run_dump(&options, df.path, output));
+    TEST_ASSERT_EQUAL_size_t(1, count_string(output, "<?xml"));
+    TEST_ASSERT_EQUAL_size_t(3, count_string(output, "<number "));
+
+    free(output);
+    TEST_ASSERT_EQUAL_INT(0, remove(df.path));
+}
+
+static void test_dump_events_stop(void) {
+    flvmeta_opts options;
+    flvmeta_event events[2];
+    dump_test_file df;
+    char * output = (char *)malloc(DUMP_TEST_OUTPUT_SIZE);
+
+    TEST_ASSERT_NOT_NULL(output);
+    create_events_file("dump_events_stop.flv", &df);
+    truncate_file(df.path, (size_t)df.tags[20].offset + FLV_TAG_SIZE + 1);
+
+    /* parsing stops once every limit is reached, before the truncated tag */
+    events[0].name = "onCuePoint";
+    events[0].limit = 2;
+    events[1].name = "onTextData";
+    events[1].limit = 1;
+    init_events_dump(&options, events, 2);
+    TEST_ASSERT_EQUAL_INT(OK, run_dump(&options, df.path, output));
+    TEST_ASSERT_EQUAL_STRING("{\"onCuePoint\":[1,2],\"onTextData\":[\"text\"]}\n", output);
+
+    /* an unlimited event reads the whole file, the found events are still dumped */
+    events[1].limit = 0;
+    TEST_ASSERT_EQUAL_INT(ERROR_EOF, run_dump(&options, df.path, output));
+    TEST_ASSERT_EQUAL_STRING("{\"onCuePoint\":[1,2],\"onTextData\":[\"text\"]}\n", output);
+
+    free(output);
+    TEST_ASSERT_EQUAL_INT(0, remove(df.path));
+}
+
+static void test_dump_json_jobs(void) {
+    char path[FLVMETA_TEST_PATH_SIZE];
+    char * sequential, * parallel;
+    size_t sequential_size, parallel_size;
+
+    /* several batches of records, the last one incomplete */
+    create_large_file("dump_json_jobs.flv", path, sizeof(path), 1500);
+    sequential = run_json_dump(path, 1, &sequential_size);
+    parallel = run_json_dump(path, 4, &parallel_size);
+
+    TEST_ASSERT_EQUAL_size_t(3001, count_string(sequential, "\"offset\":"));
+    TEST_ASSERT_EQUAL_size_t(sequential_size, parallel_size);
+    TEST_ASSERT_EQUAL_INT(0, memcmp(sequential, parallel, sequential_size));
+
+    free(sequential);
+    free(parallel);
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+void run_dump_tests(void) {
+    UnitySetTestFile(__FILE__);
+
+    RUN_TEST(test_dump_tag_types);
+    RUN_TEST(test_dump_ranges);
+    RUN_TEST(test_dump_seek_start);
+    RUN_TEST(test_dump_events);
+    RUN_TEST(test_dump_events_stop);
+    RUN_TEST(test_dump_json_jobs);
+}
@@ -0,0 +1,162 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2016 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "unity.h"
+#include "src/filter.h"
+
+#include <string.h>
+
+/* build the filter fields of a tag */
+static void make_tag(flvmeta_filter_tag * ft, uint8 type, uint32 timestamp, const byte * body, size_t size) {
+    flv_tag tag;
+
+    memset(&tag, 0, sizeof(flv_tag));
+    tag.type = type;
+    tag.body_length = uint32_to_uint24_be((uint32)size);
+    flv_tag_set_timestamp(&tag, timestamp);
+
+    flvmeta_filter_tag_init(ft, &tag, 13);
+    flvmeta_filter_tag_set_body(ft, body, size);
+}
+
+static int match(const char * expression, const flvmeta_filter_tag * ft) {
+    size_t position;
+    flvmeta_filter * filter;
+    int result;
+
+    filter = flvmeta_filter_compile(expression, &position);
+    TEST_ASSERT_NOT_NULL(filter);
+    result = flvmeta_filter_match(filter, ft);
+    flvmeta_filter_free(filter);
+    return result;
+}
+
+static void test_filter_video(void) {
+    byte keyframe[] = { 0x17, 0x01, 0x00, 0x00, 0x00 };
+    byte inter[] = { 0x27, 0x01, 0x00, 0x00, 0x00 };
+    byte header[] = { 0x17, 0x00, 0x00, 0x00, 0x00 };
+    flvmeta_filter_tag ft;
+
+    make_tag(&ft, FLV_TAG_TYPE_VIDEO, 65000, keyframe, sizeof(keyframe));
+    TEST_ASSERT_TRUE(match("type==video && keyframe && ts>=60000", &ft));
+    TEST_ASSERT_TRUE(match("codec==AVC && packet==nalu", &ft));
+    TEST_ASSERT_FALSE(match("type==video && keyframe && ts<60000", &ft));
+    TEST_ASSERT_TRUE(match("frame == keyframe && size == 5 && offset == 13", &ft));
+
+    make_tag(&ft, FLV_TAG_TYPE_VIDEO, 65000, inter, sizeof(inter));
+    TEST_ASSERT_FALSE(match("type==video && keyframe", &ft));
+    TEST_ASSERT_TRUE(match("!keyframe && frame==inter", &ft));
+
+    make_tag(&ft, FLV_TAG_TYPE_VIDEO, 0, header, sizeof(header));
+    TEST_ASSERT_TRUE(match("codec==avc && packet==seqhdr", &ft));
+}
+
+static void test_filter_extended_video(void) {
+    byte hevc[] = { 0x91, 'h', 'v', 'c', '1' };
+    flvmeta_filter_tag ft;
+
+    make_tag(&ft, FLV_TAG_TYPE_VIDEO, 0, hevc, sizeof(hevc));
+    TEST_ASSERT_TRUE(match("codec==HEVC && keyframe && packet==frame", &ft));
+    TEST_ASSERT_FALSE(match("codec==AVC", &ft));
+}
+
+static void test_filter_audio(void) {
+    byte aac[] = { 0xAF, 0x01 };
+    flvmeta_filter_tag ft;
+
+    make_tag(&ft, FLV_TAG_TYPE_AUDIO, 100, aac, sizeof(aac));
+    TEST_ASSERT_TRUE(match("codec==AAC && packet==raw", &ft));
+    TEST_ASSERT_FALSE(match("codec==MP3", &ft));
+
+    /* fields not applying to the tag */
+    TEST_ASSERT_FALSE(match("keyframe", &ft));
+    TEST_ASSERT_FALSE(match("frame==keyframe", &ft));
+    TEST_ASSERT_TRUE(match("frame!=keyframe", &ft));
+    TEST_ASSERT_FALSE(match("frame>=0", &ft));
+}
+
+static void test_filter_event(void) {
+    byte script[] = { 0x02, 0x00, 0x0A, 'o', 'n', 'C', 'u', 'e', 'P', 'o', 'i', 'n', 't', 0x05 };
+    flvmeta_filter_tag ft;
+
+    make_tag(&ft, FLV_TAG_TYPE_META, 0, script, sizeof(script));
+    TEST_ASSERT_TRUE(match("type==script && event==onCuePoint", &ft));
+    TEST_ASSERT_TRUE(match("event=='onCuePoint'", &ft));
+    TEST_ASSERT_FALSE(match("event==onMetaData", &ft));
+    TEST_ASSERT_TRUE(match("event!=\"onMetaData\"", &ft));
+}
+
+static void test_filter_precedence(void) {
+    byte aac[] = { 0xAF, 0x01 };
+    flvmeta_filter_tag ft;
+
+    make_tag(&ft, FLV_TAG_TYPE_AUDIO, 100, aac, sizeof(aac));
+    TEST_ASSERT_TRUE(match("type==video && ts>1000 || type==audio", &ft));
+    TEST_ASSERT_FALSE(match("type==video && (ts>1000 || type==audio)", &ft));
+    TEST_ASSERT_TRUE(match("!(type==video) && !!(ts==100)", &ft));
+}
+
+static void test_filter_needs_body(void) {
+    size_t position;
+    flvmeta_filter * filter;
+
+    filter = flvmeta_filter_compile("type==audio && ts>0", &position);
+    TEST_ASSERT_NOT_NULL(filter);
+    TEST_ASSERT_FALSE(flvmeta_filter_needs_body(filter));
+    flvmeta_filter_free(filter);
+
+    filter = flvmeta_filter_compile("type==video && keyframe", &position);
+    TEST_ASSERT_NOT_NULL(filter);
+    TEST_ASSERT_TRUE(flvmeta_filter_needs_body(filter));
+    flvmeta_filter_free(filter);
+}
+
+static void test_filter_errors(void) {
+    size_t position;
+
+    TEST_ASSERT_NULL(flvmeta_filter_compile("", &position));
+    TEST_ASSERT_EQUAL(0, position);
+    TEST_ASSERT_NULL(flvmeta_filter_compile("type==video &&", &position));
+    TEST_ASSERT_EQUAL(14, position);
+    TEST_ASSERT_NULL(flvmeta_filter_compile("color==red", &position));
+    TEST_ASSERT_EQUAL(0, position);
+    TEST_ASSERT_NULL(flvmeta_filter_compile("type==movie", &position));
+    TEST_ASSERT_EQUAL(6, position);
+    TEST_ASSERT_NULL(flvmeta_filter_compile("event>abc", &position));
+    TEST_ASSERT_NULL(flvmeta_filter_compile("(type==audio", &position));
+    TEST_ASSERT_NULL(flvmeta_filter_compile("type==audio)", &position));
+    TEST_ASSERT_EQUAL(11, position);
+    TEST_ASSERT_NULL(flvmeta_filter_compile("event=='onCuePoint", &position));
+    TEST_ASSERT_NULL(flvmeta_filter_compile("ts==99999999999999999999", &position));
+    TEST_ASSERT_NULL(flvmeta_filter_compile("type = video", &position));
+}
+
+void run_filter_tests(void) {
+    UnitySetTestFile(__FILE__);
+
+    RUN_TEST(test_filter_video);
+    RUN_TEST(test_filter_extended_video);
+    RUN_TEST(test_filter_audio);
+    RUN_TEST(test_filter_event);
+    RUN_TEST(test_filter_precedence);
+    RUN_TEST(test_filter_needs_body);
+    RUN_TEST(test_filter_errors);
+}
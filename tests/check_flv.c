@@ -22,50 +22,10 @@
 #include "unity.h"
 #include <stdio.h>
 #include <stdlib.h>
-#if defined(_WIN32)
-#include <process.h>
-#else
-#include <unistd.h>
-#endif
+#include <string.h>
 #include "src/flv.h"
-
-#ifndef FLVMETA_TEST_TMP_DIR
-#define FLVMETA_TEST_TMP_DIR "."
-#endif
-
-#define FLVMETA_TEST_PATH_SIZE 1024
-
-static unsigned long get_test_process_id(void) {
-#if defined(_WIN32)
-    return (unsigned long)_getpid();
-#else
-    return (unsigned long)getpid();
-#endif
-}
-
-static void make_temp_path(char * path, size_t path_size, const char * filename) {
-    int written = snprintf(
-        path,
-        path_size,
-        "%s/flvmeta-test-%lu-%s",
-        FLVMETA_TEST_TMP_DIR,
-        get_test_process_id(),
-        filename
-    );
-
-    TEST_ASSERT_TRUE(written > 0);
-    TEST_ASSERT_TRUE((size_t)written < path_size);
-}
-
-static FILE * create_temp_file(const char * filename, char * path, size_t path_size) {
-    FILE * file;
-
-    make_temp_path(path, path_size, filename);
-    file = fopen(path, "wb");
-    TEST_ASSERT_NOT_NULL(file);
-
-    return file;
-}
+#include "src/hash.h"
+#include "test_util.h"
 
 /**
     FLV types
@@ -252,23 +212,6 @@ static void test_flv_tag_set_timestamp_extended(void) {
     TEST_ASSERT_EQUAL_UINT8(0x44, tag.timestamp_extended);
 }
 
-static void write_flv_header(FILE * file) {
-    flv_header header;
-    uint32_be previous_tag_size;
-
-    header.signature[0] = 'F';
-    header.signature[1] = 'L';
-    header.signature[2] = 'V';
-    header.version = 1;
-    header.flags = 0;
-    header.offset = swap_uint32(FLV_HEADER_SIZE);
-
-    TEST_ASSERT_EQUAL_size_t(1, flv_write_header(file, &header));
-
-    previous_tag_size = swap_uint32(0);
-    TEST_ASSERT_EQUAL_size_t(1, fwrite(&previous_tag_size, sizeof(previous_tag_size), 1, file));
-}
-
 static void write_flv_video_tag(FILE * file, uint8_t frame_type, byte fourcc[FLV_VIDEO_FOURCC_SIZE]) {
     flv_tag tag;
     flv_video_tag video_tag;
@@ -308,7 +251,7 @@ static void test_flv_reader_no_extended(void) {
     vt.fourcc = 101;     /* set to random value */
 
     file = create_temp_file("flvmeta_no_extended.flv", path, sizeof(path));
-    write_flv_header(file);
+    write_flv_header(file, 0);
     write_flv_video_tag(file, 0x07, fourcc_av1);
     TEST_ASSERT_EQUAL_INT(0, fclose(file));
 
@@ -343,7 +286,7 @@ static void test_flv_reader_av1(void) {
     byte fourcc_av1[FLV_VIDEO_FOURCC_SIZE] = {'a', 'v', '0', '1'};
 
     file = create_temp_file("flvmeta_av1.flv", path, sizeof(path));
-    write_flv_header(file);
+    write_flv_header(file, 0);
     write_flv_video_tag(file, 0x87, fourcc_av1);
     TEST_ASSERT_EQUAL_INT(0, fclose(file));
 
@@ -376,7 +319,7 @@ static void test_flv_reader_hevc(void) {
     byte fourcc_hevc[FLV_VIDEO_FOURCC_SIZE] = {'h', 'v', 'c', '1'};
 
     file = create_temp_file("flvmeta_hevc.flv", path, sizeof(path));
-    write_flv_header(file);
+    write_flv_header(file, 0);
     write_flv_video_tag(file, 0x87, fourcc_hevc);
     TEST_ASSERT_EQUAL_INT(0, fclose(file));
 
@@ -397,6 +340,376 @@ static void test_flv_reader_hevc(void) {
     TEST_ASSERT_EQUAL_INT(0, remove(path));
 }
 
+static void test_flv_seek_tag(void) {
+    flv_header header;
+    flv_tag tag;
+    flv_video_tag vt;
+    flv_stream * stream;
+    FILE * file;
+    file_offset_t second_tag_offset;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    byte keyframe[] = {0x12, 0x00};
+    byte interframe[] = {0x22, 0x00, 0x00};
+
+    file = create_temp_file("flvmeta_seek.flv", path, sizeof(path));
+    write_flv_header(file, 0);
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 0, keyframe, sizeof(keyframe));
+    second_tag_offset = FLV_HEADER_SIZE + sizeof(uint32_be) + FLV_TAG_SIZE + sizeof(keyframe) + sizeof(uint32_be);
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 40, interframe, sizeof(interframe));
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 80, keyframe, sizeof(keyframe));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+
+    stream = flv_open(path);
+    TEST_ASSERT_NOT_NULL(stream);
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_header(stream, &header));
+
+    /* jump over the first tag */
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_seek_tag(stream, second_tag_offset));
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_tag(stream, &tag));
+    TEST_ASSERT_EQUAL_UINT32(40, flv_tag_get_timestamp(tag));
+    TEST_ASSERT_EQUAL_INT64(second_tag_offset, flv_get_current_tag_offset(stream));
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_video_tag(stream, &vt));
+    TEST_ASSERT_EQUAL_INT(FLV_VIDEO_TAG_FRAME_TYPE_INTERFRAME, flv_video_tag_frame_type(&vt));
+
+    /* reading resumes normally after the sought tag */
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_tag(stream, &tag));
+    TEST_ASSERT_EQUAL_UINT32(80, flv_tag_get_timestamp(tag));
+    TEST_ASSERT_EQUAL_INT(FLV_ERROR_EOF, flv_read_tag(stream, &tag));
+
+    /* seeking back after reaching the end of file */
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_seek_tag(stream, second_tag_offset));
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_tag(stream, &tag));
+    TEST_ASSERT_EQUAL_UINT32(40, flv_tag_get_timestamp(tag));
+
+    flv_close(stream);
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+static void test_flv_hash_tag_body(void) {
+    flv_header header;
+    flv_tag tag;
+    flv_stream * stream;
+    FILE * file;
+    uint64 hash;
+    uint32 prev_tag_size;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    byte body[] = {0x27, 0x01, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03};
+
+    file = create_temp_file("flvmeta_hash.flv", path, sizeof(path));
+    write_flv_header(file, 0);
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 0, body, sizeof(body));
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 40, body, 0);
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+
+    stream = flv_open(path);
+    TEST_ASSERT_NOT_NULL(stream);
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_header(stream, &header));
+
+    /* the whole body is hashed and skipped */
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_tag(stream, &tag));
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_hash_tag_body(stream, &hash));
+    TEST_ASSERT_TRUE(hash == xxh64(body, sizeof(body), 0));
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_prev_tag_size(stream, &prev_tag_size));
+    TEST_ASSERT_EQUAL_UINT32(FLV_TAG_SIZE + sizeof(body), prev_tag_size);
+
+    /* empty bodies */
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_tag(stream, &tag));
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_hash_tag_body(stream, &hash));
+    TEST_ASSERT_TRUE(hash == xxh64(body, 0, 0));
+    TEST_ASSERT_EQUAL_INT(FLV_ERROR_EOF, flv_read_tag(stream, &tag));
+
+    flv_close(stream);
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+static void test_flv_stream_counters(void) {
+    flv_header header;
+    flv_tag tag;
+    flv_stream * stream;
+    FILE * file;
+    uint32 prev_tag_size;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    byte body[] = {0x27, 0x01, 0x00, 0x00, 0x00};
+
+    file = create_temp_file("flvmeta_counters.flv", path, sizeof(path));
+    write_flv_header(file, 0);
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 0, body, sizeof(body));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+
+    stream = flv_open(path);
+    TEST_ASSERT_NOT_NULL(stream);
+    TEST_ASSERT_TRUE(stream->bytes_read == 0 && stream->reads == 0 && stream->seeks == 0);
+
+    /* header and first previous tag size */
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_header(stream, &header));
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_prev_tag_size(stream, &prev_tag_size));
+    TEST_ASSERT_TRUE(stream->bytes_read == FLV_HEADER_SIZE + sizeof(uint32_be));
+    TEST_ASSERT_TRUE(stream->seeks == 0);
+
+    /* the unread body is skipped by seeking */
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_tag(stream, &tag));
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_prev_tag_size(stream, &prev_tag_size));
+    TEST_ASSERT_TRUE(stream->bytes_read == FLV_HEADER_SIZE + 2 * sizeof(uint32_be) + FLV_TAG_SIZE);
+    TEST_ASSERT_TRUE(stream->seeks == 1);
+
+    flv_close(stream);
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+static void test_flv_read_prev_tag(void) {
+    flv_header header;
+    flv_tag tag;
+    flv_stream * stream;
+    FILE * file;
+    uint32_be bad_size;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    byte buffer[8];
+    byte audio[] = {0xAF, 0x01, 0x02};
+    byte video[] = {0x17, 0x01, 0x00, 0x00, 0x00, 0x01};
+
+    file = create_temp_file("flvmeta_reverse.flv", path, sizeof(path));
+    write_flv_header(file, 0);
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_AUDIO, 0, audio, sizeof(audio));
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 0x01000010, video, sizeof(video));
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_AUDIO, 0x01000020, audio, 0);
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_AUDIO, 0x01000030, audio, sizeof(audio));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+
+    stream = flv_open(path);
+    TEST_ASSERT_NOT_NULL(stream);
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_header(stream, &header));
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_seek_end(stream));
+
+    /* last tag, with its body */
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_prev_tag(stream, &tag));
+    TEST_ASSERT_EQUAL_UINT8(FLV_TAG_TYPE_AUDIO, tag.type);
+    TEST_ASSERT_EQUAL_UINT32(0x01000030, flv_tag_get_timestamp(tag));
+    TEST_ASSERT_EQUAL_size_t(sizeof(audio), flv_read_tag_body(stream, buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_MEMORY(audio, buffer, sizeof(audio));
+
+    /* empty tag */
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_prev_tag(stream, &tag));
+    TEST_ASSERT_EQUAL_UINT32(0x01000020, flv_tag_get_timestamp(tag));
+    TEST_ASSERT_EQUAL_UINT32(0, flv_tag_get_body_length(tag));
+
+    /* extended timestamp */
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_prev_tag(stream, &tag));
+    TEST_ASSERT_EQUAL_UINT8(FLV_TAG_TYPE_VIDEO, tag.type);
+    TEST_ASSERT_EQUAL_UINT32(0x01000010, flv_tag_get_timestamp(tag));
+    TEST_ASSERT_EQUAL_UINT32(13 + FLV_TAG_SIZE + sizeof(audio) + 4, flv_get_current_tag_offset(stream));
+
+    /* first tag, then the beginning of the file */
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_prev_tag(stream, &tag));
+    TEST_ASSERT_EQUAL_UINT32(0, flv_tag_get_timestamp(tag));
+    TEST_ASSERT_EQUAL_UINT32(13, flv_get_current_tag_offset(stream));
+    TEST_ASSERT_EQUAL_INT(FLV_ERROR_EOF, flv_read_prev_tag(stream, &tag));
+
+    /* reading forward again */
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_tag(stream, &tag));
+    TEST_ASSERT_EQUAL_UINT8(FLV_TAG_TYPE_VIDEO, tag.type);
+
+    flv_close(stream);
+
+    /* inconsistent previous tag size */
+    file = fopen(path, "r+b");
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_EQUAL_INT(0, fseek(file, -4, SEEK_END));
+    bad_size = swap_uint32(FLV_TAG_SIZE + sizeof(audio) + 1);
+    TEST_ASSERT_EQUAL_size_t(1, fwrite(&bad_size, sizeof(bad_size), 1, file));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+
+    stream = flv_open(path);
+    TEST_ASSERT_NOT_NULL(stream);
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_seek_end(stream));
+    TEST_ASSERT_EQUAL_INT(FLV_ERROR_INVALID_PREV_TAG_SIZE, flv_read_prev_tag(stream, &tag));
+    flv_close(stream);
+
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+static void test_flv_read_prev_tag_header_offset(void) {
+    flv_header header;
+    flv_tag tag;
+    flv_stream * stream;
+    FILE * file;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    byte padding[7] = {0, 0, 0, 0, 0, 0, 0};
+    byte audio[] = {0xAF, 0x01, 0x02};
+
+    /* header followed by extra data before the first previous tag size */
+    file = create_temp_file("flvmeta_reverse_offset.flv", path, sizeof(path));
+    header.signature[0] = 'F';
+    header.signature[1] = 'L';
+    header.signature[2] = 'V';
+    header.version = 1;
+    header.flags = FLV_FLAG_AUDIO;
+    header.offset = swap_uint32(FLV_HEADER_SIZE + sizeof(padding));
+    TEST_ASSERT_EQUAL_size_t(1, flv_write_header(file, &header));
+    TEST_ASSERT_EQUAL_size_t(1, fwrite(padding, sizeof(padding), 1, file));
+    write_flv_prev_tag_size(file, 0);
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_AUDIO, 0, audio, sizeof(audio));
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_AUDIO, 10, audio, sizeof(audio));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+
+    stream = flv_open(path);
+    TEST_ASSERT_NOT_NULL(stream);
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_header(stream, &header));
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_seek_end(stream));
+
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_prev_tag(stream, &tag));
+    TEST_ASSERT_EQUAL_UINT32(10, flv_tag_get_timestamp(tag));
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_read_prev_tag(stream, &tag));
+    TEST_ASSERT_EQUAL_UINT32(0, flv_tag_get_timestamp(tag));
+    TEST_ASSERT_EQUAL_UINT32(FLV_HEADER_SIZE + sizeof(padding) + 4, flv_get_current_tag_offset(stream));
+
+    /* the header data is not read as a tag */
+    TEST_ASSERT_EQUAL_INT(FLV_ERROR_EOF, flv_read_prev_tag(stream, &tag));
+
+    flv_close(stream);
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+static int hash_test_on_video_tag(flv_tag * tag, flv_video_tag vt, flv_parser * parser) {
+    byte buffer[16];
+    uint64 * hashes = (uint64 *)parser->user_data;
+
+    /* the body can still be read by the callbacks */
+    size_t size = flv_read_tag_body(parser->stream, buffer, sizeof(buffer));
+    hashes[0] = parser->tag_body_hash;
+    hashes[1] = xxh64(buffer, size, 0);
+    return FLV_OK;
+}
+
+static void test_flv_parse_hash_tag_bodies(void) {
+    flv_parser parser;
+    FILE * file;
+    uint64 hashes[2];
+    char path[FLVMETA_TEST_PATH_SIZE];
+    byte body[] = {0x27, 0x01, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03};
+
+    file = create_temp_file("flvmeta_parse_hash.flv", path, sizeof(path));
+    write_flv_header(file, 0);
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 0, body, sizeof(body));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+
+    memset(&parser, 0, sizeof(flv_parser));
+    memset(hashes, 0, sizeof(hashes));
+    parser.user_data = hashes;
+    parser.hash_tag_bodies = 1;
+    parser.on_video_tag = hash_test_on_video_tag;
+
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_parse(path, &parser));
+    TEST_ASSERT_TRUE(hashes[0] == xxh64(body, sizeof(body), 0));
+    TEST_ASSERT_TRUE(hashes[1] == xxh64(body + 1, sizeof(body) - 1, 0));
+
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+static int iter_test_on_tag(flv_tag * tag, flv_parser * parser) {
+    (void)tag;
+    ++*(int *)parser->user_data;
+    return FLV_OK;
+}
+
+static void test_flv_iter_lockstep(void) {
+    flv_stream * streams[2];
+    flv_iter iters[2];
+    flv_tag_view views[2];
+    flv_parser parser;
+    amf_data * name, * data, * cached_name;
+    FILE * file;
+    uint32 prev_tag_size;
+    int tags_number;
+    char paths[2][FLVMETA_TEST_PATH_SIZE];
+    byte meta[] = {
+        0x02, 0x00, 0x0A, 'o', 'n', 'M', 'e', 't', 'a', 'D', 'a', 't', 'a',
+        0x00, 0x40, 0x45, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    };
+    byte audio[] = {0x2F, 0x01, 0x02};
+    byte avc[] = {0x17, 0x01, 0x00, 0x00, 0x00};
+    byte hevc[] = {0x90, 'h', 'v', 'c', '1', 0x00};
+
+    file = create_temp_file("flvmeta_iter_1.flv", paths[0], sizeof(paths[0]));
+    write_flv_header(file, 0);
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_META, 0, meta, sizeof(meta));
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_AUDIO, 10, audio, sizeof(audio));
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 20, hevc, sizeof(hevc));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+
+    file = create_temp_file("flvmeta_iter_2.flv", paths[1], sizeof(paths[1]));
+    write_flv_header(file, 0);
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_META, 0, meta, sizeof(meta));
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_AUDIO, 10, audio, sizeof(audio));
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 0x1000020, avc, sizeof(avc));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+
+    streams[0] = flv_open(paths[0]);
+    streams[1] = flv_open(paths[1]);
+    TEST_ASSERT_NOT_NULL(streams[0]);
+    TEST_ASSERT_NOT_NULL(streams[1]);
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_iter_init(&iters[0], streams[0]));
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_iter_init(&iters[1], streams[1]));
+
+    /* script payloads are decoded once, on demand */
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_iter_next(&iters[0], &views[0]));
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_iter_next(&iters[1], &views[1]));
+    TEST_ASSERT_EQUAL_UINT8(FLV_TAG_TYPE_META, views[0].tag.type);
+    TEST_ASSERT_EQUAL_UINT8(FLV_TAG_TYPE_META, views[1].tag.type);
+    TEST_ASSERT_EQUAL_UINT32(sizeof(meta), views[0].body_length);
+    TEST_ASSERT_EQUAL_INT(FLV_HEADER_SIZE + sizeof(uint32_be), (int)views[0].offset);
+    TEST_ASSERT_EQUAL_INT(0, iters[0].metadata_read);
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_iter_get_metadata(&iters[0], &name, &data));
+    TEST_ASSERT_EQUAL_STRING("onMetaData", (char *)amf_string_get_bytes(name));
+    TEST_ASSERT_TRUE(amf_number_get_value(data) == 42.0);
+    cached_name = name;
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_iter_get_metadata(&iters[0], &name, &data));
+    TEST_ASSERT_TRUE(name == cached_name);
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_iter_finish_tag(&iters[0], &prev_tag_size));
+    TEST_ASSERT_EQUAL_UINT32(FLV_TAG_SIZE + sizeof(meta), prev_tag_size);
+
+    /* unfinished tags are skipped by the next step */
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_iter_next(&iters[0], &views[0]));
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_iter_next(&iters[1], &views[1]));
+    TEST_ASSERT_EQUAL_INT(0, iters[0].metadata_read);
+    TEST_ASSERT_EQUAL_INT(FLV_ERROR_INVALID_METADATA, flv_iter_get_metadata(&iters[0], &name, &data));
+    TEST_ASSERT_EQUAL_UINT8(FLV_TAG_TYPE_AUDIO, views[1].tag.type);
+    TEST_ASSERT_EQUAL_UINT32(10, views[1].timestamp);
+    TEST_ASSERT_EQUAL_INT(1, views[1].has_media_header);
+    TEST_ASSERT_EQUAL_UINT8(0x2F, views[1].audio_tag);
+    TEST_ASSERT_EQUAL_UINT32(views[0].timestamp, views[1].timestamp);
+
+    /* media headers are decoded without consuming the body */
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_iter_next(&iters[0], &views[0]));
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_iter_next(&iters[1], &views[1]));
+    TEST_ASSERT_EQUAL_INT(1, views[0].has_media_header);
+    TEST_ASSERT_EQUAL_INT(1, flv_video_tag_is_ext_header(&views[0].video_tag));
+    TEST_ASSERT_EQUAL_UINT32(FLV_VIDEO_FOURCC_HEVC, flv_video_tag_codec_id(&views[0].video_tag));
+    TEST_ASSERT_EQUAL_UINT32(0x1000020, views[1].timestamp);
+    TEST_ASSERT_EQUAL_INT(1, views[1].has_media_header);
+    TEST_ASSERT_EQUAL_INT(FLV_VIDEO_TAG_FRAME_TYPE_KEYFRAME, flv_video_tag_frame_type(&views[1].video_tag));
+    TEST_ASSERT_EQUAL_size_t(sizeof(avc), flv_read_tag_body(streams[1], avc, sizeof(avc)));
+    TEST_ASSERT_EQUAL_UINT8(0x17, avc[0]);
+
+    TEST_ASSERT_EQUAL_INT(FLV_ERROR_EOF, flv_iter_next(&iters[0], &views[0]));
+    TEST_ASSERT_EQUAL_INT(FLV_ERROR_EOF, flv_iter_next(&iters[1], &views[1]));
+
+    flv_iter_free(&iters[0]);
+    flv_iter_free(&iters[1]);
+    flv_close(streams[0]);
+    flv_close(streams[1]);
+
+    /* the callback parser steps through the same tags */
+    memset(&parser, 0, sizeof(flv_parser));
+    tags_number = 0;
+    parser.user_data = &tags_number;
+    parser.on_tag = iter_test_on_tag;
+    TEST_ASSERT_EQUAL_INT(FLV_OK, flv_parse(paths[0], &parser));
+    TEST_ASSERT_EQUAL_INT(3, tags_number);
+
+    TEST_ASSERT_EQUAL_INT(0, remove(paths[0]));
+    TEST_ASSERT_EQUAL_INT(0, remove(paths[1]));
+}
+
 void run_flv_tests(void) {
     UnitySetTestFile(__FILE__);
 
@@ -418,4 +731,11 @@ void run_flv_tests(void) {
     RUN_TEST(test_flv_reader_no_extended);
     RUN_TEST(test_flv_reader_av1);
     RUN_TEST(test_flv_reader_hevc);
+    RUN_TEST(test_flv_seek_tag);
+    RUN_TEST(test_flv_hash_tag_body);
+    RUN_TEST(test_flv_parse_hash_tag_bodies);
+    RUN_TEST(test_flv_read_prev_tag);
+    RUN_TEST(test_flv_read_prev_tag_header_offset);
+    RUN_TEST(test_flv_stream_counters);
+    RUN_TEST(test_flv_iter_lockstep);
 }
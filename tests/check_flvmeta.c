@@ -22,8 +22,22 @@
 #include "unity.h"
 
 extern void amf_tests_teardown(void);
+extern void run_aac_tests(void);
 extern void run_amf_tests(void);
+extern void run_avc_tests(void);
+extern void run_batch_tests(void);
+extern void run_cache_tests(void);
+extern void run_check_tests(void);
+extern void run_diff_tests(void);
+extern void run_dump_tests(void);
 extern void run_flv_tests(void);
+extern void run_hash_tests(void);
+extern void run_filter_tests(void);
+extern void run_inventory_tests(void);
+extern void run_libflvmeta_tests(void);
+extern void run_server_tests(void);
+extern void run_threads_tests(void);
+extern void run_watch_tests(void);
 
 void setUp(void) {
 }
@@ -34,7 +48,21 @@ void tearDown(void) {
 
 int main(void) {
     UNITY_BEGIN();
+    run_aac_tests();
     run_amf_tests();
+    run_avc_tests();
+    run_batch_tests();
+    run_cache_tests();
+    run_check_tests();
+    run_diff_tests();
+    run_dump_tests();
     run_flv_tests();
+    run_hash_tests();
+    run_filter_tests();
+    run_inventory_tests();
+    run_libflvmeta_tests();
+    run_server_tests();
+    run_threads_tests();
+    run_watch_tests();
     return UNITY_END();
 }
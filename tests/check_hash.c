@@ -0,0 +1,80 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2016 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "unity.h"
+#include "src/hash.h"
+
+/* reference values from the xxHash implementation */
+
+static void test_xxh64_empty(void) {
+    TEST_ASSERT_TRUE(xxh64("", 0, 0) == 0xEF46DB3751D8E999ULL);
+}
+
+static void test_xxh64_short(void) {
+    TEST_ASSERT_TRUE(xxh64("abc", 3, 0) == 0x44BC2CF5AD770999ULL);
+}
+
+static void test_xxh64_seed(void) {
+    TEST_ASSERT_TRUE(xxh64("abc", 3, 1) == 0xBEA9CA8199328908ULL);
+}
+
+static void test_xxh64_long(void) {
+    byte data[771];
+    int i;
+
+    for (i = 0; i < 768; ++i) {
+        data[i] = (byte)i;
+    }
+    data[768] = 'x';
+    data[769] = 'y';
+    data[770] = 'z';
+
+    TEST_ASSERT_TRUE(xxh64(data, sizeof(data), 0) == 0xE921A1B45BD779F8ULL);
+}
+
+static void test_xxh64_streaming(void) {
+    byte data[771];
+    xxh64_state state;
+    size_t i, length;
+
+    for (i = 0; i < sizeof(data); ++i) {
+        data[i] = (byte)(i * 7);
+    }
+
+    /* hashing by chunks of any size gives the same result */
+    for (length = 1; length < 70; length += 13) {
+        xxh64_reset(&state, 0);
+        for (i = 0; i < sizeof(data); i += length) {
+            xxh64_update(&state, data + i, (sizeof(data) - i < length) ? sizeof(data) - i : length);
+        }
+        TEST_ASSERT_TRUE(xxh64_digest(&state) == xxh64(data, sizeof(data), 0));
+    }
+}
+
+void run_hash_tests(void) {
+    UnitySetTestFile(__FILE__);
+
+    RUN_TEST(test_xxh64_empty);
+    RUN_TEST(test_xxh64_short);
+    RUN_TEST(test_xxh64_seed);
+    RUN_TEST(test_xxh64_long);
+    RUN_TEST(test_xxh64_streaming);
+}
@@ -0,0 +1,157 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2016 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "src/flv.h"
+#include "src/inventory.h"
+#include "src/util.h"
+#include "test_util.h"
+
+#define INVENTORY_TEST_SUMMARY_SIZE 2048
+
+/* build the path of a file in a directory */
+static void make_path(char * path, size_t path_size, const char * directory, const char * filename) {
+    int written = snprintf(path, path_size, "%s/%s", directory, filename);
+
+    TEST_ASSERT_TRUE(written > 0);
+    TEST_ASSERT_TRUE((size_t)written < path_size);
+}
+
+static void make_directory(const char * path) {
+#if defined(_WIN32)
+    TEST_ASSERT_EQUAL_INT(0, _mkdir(path));
+#else
+    TEST_ASSERT_EQUAL_INT(0, mkdir(path, 0755));
+#endif
+}
+
+static void remove_directory(const char * path) {
+#if defined(_WIN32)
+    TEST_ASSERT_EQUAL_INT(0, _rmdir(path));
+#else
+    TEST_ASSERT_EQUAL_INT(0, rmdir(path));
+#endif
+}
+
+static void write_file(const char * path, const char * contents) {
+    FILE * file = fopen(path, "w");
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_TRUE(fputs(contents, file) >= 0);
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+}
+
+/* audio only file of one second made of MP3 tags, without onMetaData */
+static void write_audio_file(const char * path) {
+    byte body[4] = { 0x2F, 0xFF, 0xFB, 0x90 };
+    uint32 timestamp;
+    FILE * file;
+
+    file = fopen(path, "wb");
+    TEST_ASSERT_NOT_NULL(file);
+
+    write_flv_header(file, FLV_FLAG_AUDIO);
+
+    for (timestamp = 0; timestamp < 1000; timestamp += 100) {
+        write_flv_tag_with_size(file, FLV_TAG_TYPE_AUDIO, timestamp, body, sizeof(body));
+    }
+
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+}
+
+/* run the inventory in the given format, returning its summary */
+static void run_inventory(flvmeta_opts * options, int format, char * summary) {
+    size_t size;
+
+    options->check_report_format = format;
+    options->out = flvmeta_tmpfile();
+    TEST_ASSERT_NOT_NULL(options->out);
+    TEST_ASSERT_EQUAL_INT(OK, inventory_run(options));
+
+    rewind(options->out);
+    size = fread(summary, 1, INVENTORY_TEST_SUMMARY_SIZE - 1, options->out);
+    summary[size] = '\0';
+    fclose(options->out);
+}
+
+static void test_inventory_summary(void) {
+    flvmeta_opts options;
+    char directory[FLVMETA_TEST_PATH_SIZE];
+    char audio[FLVMETA_TEST_PATH_SIZE];
+    char bad[FLVMETA_TEST_PATH_SIZE];
+    char other[FLVMETA_TEST_PATH_SIZE];
+    char summary[INVENTORY_TEST_SUMMARY_SIZE];
+    char expected[FLVMETA_TEST_PATH_SIZE + 64];
+    char * files[1];
+    int written;
+
+    /* directory holding a valid file, an invalid file, and a file ignored for its extension */
+    make_temp_path(directory, sizeof(directory), "inventory");
+    make_directory(directory);
+    make_path(audio, sizeof(audio), directory, "audio.flv");
+    write_audio_file(audio);
+    make_path(bad, sizeof(bad), directory, "bad.flv");
+    write_file(bad, "not an FLV file");
+    make_path(other, sizeof(other), directory, "other.txt");
+    write_file(other, "");
+
+    flvmeta_opts_init(&options);
+    options.command = FLVMETA_INVENTORY_COMMAND;
+    options.jobs = 2;
+    files[0] = directory;
+    options.batch_files = files;
+    options.batch_files_number = 1;
+
+    run_inventory(&options, FLVMETA_FORMAT_RAW, summary);
+    TEST_ASSERT_NOT_NULL(strstr(summary, "files: 2\nanalyzed files: 1\n"));
+    TEST_ASSERT_NOT_NULL(strstr(summary, "total duration: 1.000 s\n"));
+    TEST_ASSERT_NOT_NULL(strstr(summary, "video codecs:\n  none: 1\naudio formats:\n  MP3: 1\nresolutions:\n"));
+    TEST_ASSERT_NOT_NULL(strstr(summary, "  0-250: 1\n"));
+    TEST_ASSERT_NOT_NULL(strstr(summary, "missing onMetaData: 1\nmissing keyframes: 0\nfailed files: 1\n"));
+    written = snprintf(expected, sizeof(expected), "  %s: F", bad);
+    TEST_ASSERT_TRUE(written > 0 && (size_t)written < sizeof(expected));
+    TEST_ASSERT_NOT_NULL(strstr(summary, expected));
+
+    run_inventory(&options, FLVMETA_FORMAT_JSON, summary);
+    TEST_ASSERT_NOT_NULL(strstr(summary, "\"files\":2,\"analyzed_files\":1,"));
+    TEST_ASSERT_NOT_NULL(strstr(summary, "\"audio_formats\":{\"MP3\":1}"));
+    TEST_ASSERT_NOT_NULL(strstr(summary, "\"missing_on_metadata\":1"));
+    TEST_ASSERT_NOT_NULL(strstr(summary, "\"failed_files\":[{\"file\":"));
+
+    TEST_ASSERT_EQUAL_INT(0, remove(audio));
+    TEST_ASSERT_EQUAL_INT(0, remove(bad));
+    TEST_ASSERT_EQUAL_INT(0, remove(other));
+    remove_directory(directory);
+}
+
+void run_inventory_tests(void) {
+    UnitySetTestFile(__FILE__);
+
+    RUN_TEST(test_inventory_summary);
+}
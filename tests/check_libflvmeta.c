@@ -0,0 +1,235 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2016 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "src/libflvmeta.h"
+#include "src/util.h"
+#include "test_util.h"
+
+/* write a video only file of screen video frames, without metadata */
+static void create_test_file(const char * filename, char * path, size_t path_size) {
+    FILE * file;
+    byte keyframe[] = {0x13, 0x00, 0x40, 0x00, 0x30};
+    byte interframe[] = {0x23, 0x00, 0x40, 0x00, 0x30};
+
+    file = create_temp_file(filename, path, path_size);
+
+    write_flv_header(file, FLV_FLAG_VIDEO);
+
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 0, keyframe, sizeof(keyframe));
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 40, interframe, sizeof(interframe));
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 80, keyframe, sizeof(keyframe));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+}
+
+/* count the messages received */
+static void count_message(const char * message, void * user_data) {
+    TEST_ASSERT_NOT_NULL(message);
+    ++(*(int *)user_data);
+}
+
+/* record whether the analysis was resumed */
+static void find_resume_message(const char * message, void * user_data) {
+    if (!strncmp(message, "Resuming", 8)) {
+        *(int *)user_data = 1;
+    }
+}
+
+/* whether a check result holds a finding of the given code */
+static int has_finding(const check_result * result, const char * code) {
+    size_t i;
+
+    for (i = 0; i < result->findings_number; ++i) {
+        if (!strcmp(result->findings[i].code, code)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void test_context_compute_metadata(void) {
+    flvmeta_context ctxt;
+    flv_info info;
+    flv_metadata meta;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    int messages;
+
+    create_test_file("lib_info.flv", path, sizeof(path));
+
+    /* verbose messages go to the handler only */
+    messages = 0;
+    flvmeta_context_init(&ctxt);
+    flvmeta_context_set_message_handler(&ctxt, count_message, &messages);
+    ctxt.opts.verbose = 1;
+
+    TEST_ASSERT_EQUAL_INT(OK, flvmeta_context_compute_metadata(&ctxt, path, &info, &meta));
+    TEST_ASSERT_TRUE(messages > 0);
+    TEST_ASSERT_EQUAL_INT(1, info.have_video);
+    TEST_ASSERT_EQUAL_UINT32(64, info.video_width);
+    TEST_ASSERT_EQUAL_UINT32(48, info.video_height);
+    TEST_ASSERT_EQUAL_UINT32(2, amf_array_size(info.times));
+    TEST_ASSERT_NOT_NULL(amf_associative_array_get(meta.on_metadata, "keyframes"));
+
+    flvmeta_metadata_free(&info, &meta);
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+static void test_context_update_and_check(void) {
+    flvmeta_context ctxt;
+    check_result result;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    char updated_path[FLVMETA_TEST_PATH_SIZE];
+
+    create_test_file("lib_check.flv", path, sizeof(path));
+    make_temp_path(updated_path, sizeof(updated_path), "lib_check_updated.flv");
+    flvmeta_context_init(&ctxt);
+
+    /* findings are returned, not printed */
+    TEST_ASSERT_EQUAL_INT(OK, flvmeta_context_check(&ctxt, path, &result));
+    TEST_ASSERT_EQUAL_UINT32(0, result.errors);
+    TEST_ASSERT_TRUE(has_finding(&result, WARNING_METADATA_NOT_PRESENT));
+    check_result_free(&result);
+
+    /* the updated file has metadata */
+    TEST_ASSERT_EQUAL_INT(OK, flvmeta_context_update(&ctxt, path, updated_path));
+    TEST_ASSERT_EQUAL_INT(OK, flvmeta_context_check(&ctxt, updated_path, &result));
+    TEST_ASSERT_FALSE(has_finding(&result, WARNING_METADATA_NOT_PRESENT));
+    check_result_free(&result);
+
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+    TEST_ASSERT_EQUAL_INT(0, remove(updated_path));
+
+    /* missing files */
+    TEST_ASSERT_EQUAL_INT(ERROR_OPEN_READ, flvmeta_context_check(&ctxt, path, &result));
+    TEST_ASSERT_EQUAL_size_t(0, result.findings_number);
+}
+
+static void test_context_update_memory_limit(void) {
+    flvmeta_context ctxt;
+    check_result result;
+    FILE * file;
+    byte * big_frame;
+    file_offset_t whole_size, chunked_size;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    char updated_path[FLVMETA_TEST_PATH_SIZE];
+
+    /* append a frame much bigger than the copy buffer allowed by the cap */
+    create_test_file("lib_memory.flv", path, sizeof(path));
+    make_temp_path(updated_path, sizeof(updated_path), "lib_memory_updated.flv");
+    big_frame = (byte *)calloc(1, 200000);
+    TEST_ASSERT_NOT_NULL(big_frame);
+    big_frame[0] = 0x23;
+    file = fopen(path, "ab");
+    TEST_ASSERT_NOT_NULL(file);
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 120, big_frame, 200000);
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+    free(big_frame);
+
+    flvmeta_context_init(&ctxt);
+    TEST_ASSERT_EQUAL_INT(OK, flvmeta_context_update(&ctxt, path, updated_path));
+    TEST_ASSERT_EQUAL_INT(1, flvmeta_filesize(updated_path, &whole_size));
+
+    /* the big frame is copied in chunks */
+    ctxt.opts.max_memory = 80 * 1024;
+    TEST_ASSERT_EQUAL_INT(OK, flvmeta_context_update(&ctxt, path, updated_path));
+    TEST_ASSERT_EQUAL_INT(1, flvmeta_filesize(updated_path, &chunked_size));
+    TEST_ASSERT_TRUE(whole_size == chunked_size);
+    TEST_ASSERT_EQUAL_INT(OK, flvmeta_context_check(&ctxt, updated_path, &result));
+    TEST_ASSERT_EQUAL_UINT32(0, result.errors);
+    check_result_free(&result);
+    TEST_ASSERT_EQUAL_INT(0, remove(updated_path));
+
+    /* a cap that cannot be met fails before writing anything */
+    ctxt.opts.max_memory = 1024;
+    TEST_ASSERT_EQUAL_INT(ERROR_MEMORY_LIMIT, flvmeta_context_update(&ctxt, path, updated_path));
+    TEST_ASSERT_NULL(fopen(updated_path, "rb"));
+
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+}
+
+static void test_context_resume_growing_file(void) {
+    flvmeta_context ctxt;
+    flv_info info;
+    flv_metadata meta;
+    FILE * file;
+    char path[FLVMETA_TEST_PATH_SIZE];
+    char state_path[FLVMETA_TEST_PATH_SIZE];
+    byte keyframe[] = {0x13, 0x00, 0x40, 0x00, 0x30};
+    int resumed;
+
+    create_test_file("lib_resume.flv", path, sizeof(path));
+    make_temp_path(state_path, sizeof(state_path), "lib_resume.state");
+    resumed = 0;
+    flvmeta_context_init(&ctxt);
+    flvmeta_context_set_message_handler(&ctxt, find_resume_message, &resumed);
+    ctxt.opts.verbose = 1;
+    ctxt.opts.state_file = state_path;
+
+    /* the first analysis reads the whole file and saves its state */
+    TEST_ASSERT_EQUAL_INT(OK, flvmeta_context_compute_metadata(&ctxt, path, &info, &meta));
+    TEST_ASSERT_FALSE(resumed);
+    TEST_ASSERT_EQUAL_UINT32(3, info.video_frames_number);
+    TEST_ASSERT_TRUE(info.end_offset == 73);
+    flvmeta_metadata_free(&info, &meta);
+
+    /* append a whole frame, and the header of a frame still being written */
+    file = fopen(path, "ab");
+    TEST_ASSERT_NOT_NULL(file);
+    write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, 120, keyframe, sizeof(keyframe));
+    write_flv_tag_header(file, FLV_TAG_TYPE_VIDEO, 160, sizeof(keyframe));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+
+    /* the analysis resumes after the saved tags, and stops before the partial one */
+    TEST_ASSERT_EQUAL_INT(OK, flvmeta_context_compute_metadata(&ctxt, path, &info, &meta));
+    TEST_ASSERT_TRUE(resumed);
+    TEST_ASSERT_EQUAL_UINT32(4, info.video_frames_number);
+    TEST_ASSERT_EQUAL_UINT32(3, amf_array_size(info.times));
+    TEST_ASSERT_EQUAL_UINT32(120, info.last_timestamp);
+    TEST_ASSERT_TRUE(info.end_offset == 93);
+    flvmeta_metadata_free(&info, &meta);
+
+    /* an unreadable state is ignored */
+    file = fopen(state_path, "wb");
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_EQUAL_size_t(1, fwrite(keyframe, sizeof(keyframe), 1, file));
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+    resumed = 0;
+    TEST_ASSERT_EQUAL_INT(OK, flvmeta_context_compute_metadata(&ctxt, path, &info, &meta));
+    TEST_ASSERT_FALSE(resumed);
+    TEST_ASSERT_EQUAL_UINT32(4, info.video_frames_number);
+    TEST_ASSERT_TRUE(info.end_offset == 93);
+    flvmeta_metadata_free(&info, &meta);
+
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+    TEST_ASSERT_EQUAL_INT(0, remove(state_path));
+}
+
+void run_libflvmeta_tests(void) {
+    UnitySetTestFile(__FILE__);
+
+    RUN_TEST(test_context_compute_metadata);
+    RUN_TEST(test_context_update_and_check);
+    RUN_TEST(test_context_update_memory_limit);
+    RUN_TEST(test_context_resume_growing_file);
+}
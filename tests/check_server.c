@@ -0,0 +1,245 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "src/pool.h"
+#include "src/server.h"
+#include "src/libflvmeta.h"
+#include "test_util.h"
+
+#if defined(HAVE_SYS_UN_H) && defined(HAVE_PTHREAD)
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define SERVER_TEST_CONNECT_ATTEMPTS 200
+/* time allowed for a response, in seconds */
+#define SERVER_TEST_TIMEOUT 5
+
+typedef struct __server_test {
+    const char * path;
+    flvmeta_opts options;
+    int result;
+} server_test;
+
+/* write a video only file of two screen video keyframes */
+static void create_test_file(const char * path) {
+    FILE * file;
+    byte keyframe[] = {0x13, 0x00, 0x40, 0x00, 0x30};
+    uint32 timestamp;
+
+    file = fopen(path, "wb");
+    TEST_ASSERT_NOT_NULL(file);
+
+    write_flv_header(file, FLV_FLAG_VIDEO);
+
+    for (timestamp = 0; timestamp <= 40; timestamp += 40) {
+        write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, timestamp, keyframe, sizeof(keyframe));
+    }
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+}
+
+static void run_server(void * data) {
+    server_test * test = (server_test *)data;
+
+    test->result = server_run(test->path, &test->options);
+}
+
+/* connect to the server, waiting for it to listen */
+static int connect_server(const char * path) {
+    struct sockaddr_un address;
+    struct timeval timeout;
+    int fd, attempt;
+
+    timeout.tv_sec = SERVER_TEST_TIMEOUT;
+    timeout.tv_usec = 0;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    TEST_ASSERT_TRUE(strlen(path) < sizeof(address.sun_path));
+    strcpy(address.sun_path, path);
+
+    for (attempt = 0; attempt < SERVER_TEST_CONNECT_ATTEMPTS; ++attempt) {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        TEST_ASSERT_TRUE(fd >= 0);
+        if (connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0) {
+            /* fail instead of waiting forever for a response */
+            TEST_ASSERT_EQUAL_INT(0, setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)));
+            return fd;
+        }
+        close(fd);
+        usleep(10000);
+    }
+    TEST_FAIL_MESSAGE("cannot connect to the server");
+    return -1;
+}
+
+/* send a request, returning the response, which must be freed */
+static char * send_request(int fd, const char * request) {
+    uint32_be size_be;
+    uint32 size;
+    char * response;
+    size_t received;
+    ssize_t bytes;
+
+    size_be = swap_uint32((uint32)strlen(request));
+    TEST_ASSERT_EQUAL_INT(sizeof(size_be), write(fd, &size_be, sizeof(size_be)));
+    TEST_ASSERT_EQUAL_INT(strlen(request), write(fd, request, strlen(request)));
+
+    TEST_ASSERT_EQUAL_INT(sizeof(size_be), read(fd, &size_be, sizeof(size_be)));
+    size = swap_uint32(size_be);
+    response = (char *)malloc(size + 1);
+    TEST_ASSERT_NOT_NULL(response);
+    for (received = 0; received < size; received += (size_t)bytes) {
+        bytes = read(fd, response + received, size - received);
+        TEST_ASSERT_TRUE(bytes > 0);
+    }
+    response[size] = '\0';
+    return response;
+}
+
+static void test_server_requests(void) {
+    server_test test;
+    flvmeta_pool * pool;
+    flvmeta_task task;
+    char socket_path[FLVMETA_TEST_PATH_SIZE];
+    char file_path[FLVMETA_TEST_PATH_SIZE];
+    char request[FLVMETA_TEST_PATH_SIZE * 2];
+    char * response;
+    int fd;
+
+    make_temp_path(socket_path, sizeof(socket_path), "server.sock");
+    make_temp_path(file_path, sizeof(file_path), "server.flv");
+    create_test_file(file_path);
+
+    test.path = socket_path;
+    flvmeta_opts_init(&test.options);
+    test.options.jobs = 2;
+    pool = flvmeta_pool_new(1);
+    TEST_ASSERT_NOT_NULL(pool);
+    flvmeta_pool_submit(pool, &task, run_server, &test);
+
+    fd = connect_server(socket_path);
+
+    /* successive requests on the same connection */
+    snprintf(request, sizeof(request), "{\"id\": 7, \"command\": \"info\", \"file\": \"%s\", \"format\": \"json\"}", file_path);
+    response = send_request(fd, request);
+    TEST_ASSERT_NOT_NULL(strstr(response, "\"id\":7"));
+    TEST_ASSERT_NOT_NULL(strstr(response, "\"status\":0"));
+    TEST_ASSERT_NOT_NULL(strstr(response, "hasKeyframes"));
+    free(response);
+
+    snprintf(request, sizeof(request), "{\"command\": \"check\", \"file\": \"%s\", \"extra\": [1, {\"a\": null}]}", file_path);
+    response = send_request(fd, request);
+    TEST_ASSERT_NOT_NULL(strstr(response, "\"status\":0"));
+    TEST_ASSERT_NOT_NULL(strstr(response, "onMetaData"));
+    free(response);
+
+    response = send_request(fd, "{\"id\": \"bad\", \"command\": \"check\"}");
+    TEST_ASSERT_NOT_NULL(strstr(response, "\"id\":\"bad\""));
+    TEST_ASSERT_NOT_NULL(strstr(response, "\"status\":15"));
+    free(response);
+
+    close(fd);
+
+    /* the socket is removed once stopped */
+    server_stop();
+    flvmeta_pool_wait(pool, &task);
+    flvmeta_pool_free(pool);
+    TEST_ASSERT_EQUAL_INT(OK, test.result);
+    TEST_ASSERT_NULL(fopen(socket_path, "rb"));
+
+    TEST_ASSERT_EQUAL_INT(0, remove(file_path));
+}
+
+static void test_server_idle_connections(void) {
+    server_test test;
+    flvmeta_pool * pool;
+    flvmeta_task task;
+    char socket_path[FLVMETA_TEST_PATH_SIZE];
+    char file_path[FLVMETA_TEST_PATH_SIZE];
+    char request[FLVMETA_TEST_PATH_SIZE * 2];
+    char * response;
+    int idle_fd, fd;
+
+    make_temp_path(socket_path, sizeof(socket_path), "server_idle.sock");
+    make_temp_path(file_path, sizeof(file_path), "server_idle.flv");
+    create_test_file(file_path);
+
+    test.path = socket_path;
+    flvmeta_opts_init(&test.options);
+    test.options.jobs = 1;
+    pool = flvmeta_pool_new(1);
+    TEST_ASSERT_NOT_NULL(pool);
+    flvmeta_pool_submit(pool, &task, run_server, &test);
+
+    /* an open connection without request does not hold the only thread */
+    idle_fd = connect_server(socket_path);
+    snprintf(request, sizeof(request), "{\"command\": \"check\", \"file\": \"%s\"}", file_path);
+    response = send_request(idle_fd, request);
+    TEST_ASSERT_NOT_NULL(strstr(response, "\"status\":0"));
+    free(response);
+
+    fd = connect_server(socket_path);
+    response = send_request(fd, request);
+    TEST_ASSERT_NOT_NULL(strstr(response, "\"status\":0"));
+    free(response);
+
+    /* both connections are still served */
+    response = send_request(idle_fd, request);
+    TEST_ASSERT_NOT_NULL(strstr(response, "\"status\":0"));
+    free(response);
+    response = send_request(fd, request);
+    TEST_ASSERT_NOT_NULL(strstr(response, "\"status\":0"));
+    free(response);
+
+    /* stopping does not wait for the idle clients */
+    server_stop();
+    flvmeta_pool_wait(pool, &task);
+    flvmeta_pool_free(pool);
+    TEST_ASSERT_EQUAL_INT(OK, test.result);
+    close(idle_fd);
+    close(fd);
+
+    TEST_ASSERT_EQUAL_INT(0, remove(file_path));
+}
+
+#else /* !(HAVE_SYS_UN_H && HAVE_PTHREAD) */
+
+static void test_server_requests(void) {
+    TEST_IGNORE_MESSAGE("no Unix domain socket or thread support");
+}
+
+static void test_server_idle_connections(void) {
+    TEST_IGNORE_MESSAGE("no Unix domain socket or thread support");
+}
+
+#endif /* HAVE_SYS_UN_H && HAVE_PTHREAD */
+
+void run_server_tests(void) {
+    UnitySetTestFile(__FILE__);
+
+    RUN_TEST(test_server_requests);
+    RUN_TEST(test_server_idle_connections);
+}
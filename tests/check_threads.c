@@ -0,0 +1,257 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2016 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "src/amf.h"
+#include "src/check.h"
+#include "src/dump.h"
+#include "src/flv.h"
+#include "src/info.h"
+#include "src/pool.h"
+#include "src/util.h"
+#include "test_util.h"
+
+
+/* files of the corpus, and runs over them in parallel */
+#define THREADS_TEST_FILES 3
+#define THREADS_TEST_RUNS 300
+#define THREADS_TEST_POOL_THREADS 8
+
+/* results of the parser, file information, check, and full dump of a file */
+typedef struct __threads_test_run {
+    flvmeta_task task;
+    const char * file;
+    int parse_result;
+    uint32 tags;
+    int info_result;
+    uint32 video_frames_number;
+    uint32 last_timestamp;
+    uint32 on_metadata_size;
+    int check_result;
+    size_t report_size; /* the creation date of the report changes, not its size */
+    int dump_result;
+    char * dump;
+    size_t dump_size;
+} threads_test_run;
+
+/* onMetaData event holding a date, dumped as local time */
+static void write_metadata_tag(FILE * file) {
+    amf_data * name;
+    amf_data * data;
+
+    name = amf_str("onMetaData");
+    data = amf_associative_array_new();
+    amf_associative_array_add(data, "duration", amf_number_new(2.0));
+    amf_associative_array_add(data, "creationdate", amf_date_new(1500000000000.0, 0));
+    write_flv_script_tag(file, 0, name, data);
+
+    amf_data_free(name);
+    amf_data_free(data);
+}
+
+/* two seconds of Sorenson H.263 video and MP3 audio, cut short if truncated */
+static void write_flv_file(const char * path, int truncated) {
+    byte video[16];
+    byte audio[8];
+    uint32 timestamp;
+    FILE * file;
+
+    file = fopen(path, "wb");
+    TEST_ASSERT_NOT_NULL(file);
+
+    write_flv_header(file, FLV_FLAG_VIDEO | FLV_FLAG_AUDIO);
+
+    write_metadata_tag(file);
+
+    memset(video, 0, sizeof(video));
+    memset(audio, 0x55, sizeof(audio));
+    audio[0] = 0x2F;
+    for (timestamp = 0; timestamp < 2000; timestamp += 40) {
+        video[0] = (timestamp % 1000 == 0) ? 0x12 : 0x22;
+        video[1] = (byte)timestamp;
+        write_flv_tag_with_size(file, FLV_TAG_TYPE_VIDEO, timestamp, video, sizeof(video));
+        write_flv_tag_with_size(file, FLV_TAG_TYPE_AUDIO, timestamp, audio, sizeof(audio));
+    }
+
+    /* the last tag is incomplete */
+    if (truncated) {
+        write_flv_tag_header(file, FLV_TAG_TYPE_AUDIO, timestamp, sizeof(audio));
+        TEST_ASSERT_EQUAL_size_t(2, fwrite(audio, 1, 2, file));
+    }
+
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+}
+
+static int count_tag(flv_tag * tag, flv_parser * parser) {
+    (void)tag;
+    ++(*(uint32 *)parser->user_data);
+    return FLV_OK;
+}
+
+/* contents written to a temporary stream, which is closed */
+static char * read_stream(FILE * stream, size_t * size) {
+    char * contents;
+    long length;
+
+    if (fseek(stream, 0, SEEK_END) != 0 || (length = ftell(stream)) < 0) {
+        fclose(stream);
+        return NULL;
+    }
+    rewind(stream);
+
+    contents = (char *)malloc((size_t)length + 1);
+    if (contents != NULL) {
+        *size = fread(contents, 1, (size_t)length, stream);
+        contents[*size] = '\0';
+    }
+    fclose(stream);
+    return contents;
+}
+
+/* worker task, or reference run, recording results without asserting */
+static void run_file(void * data) {
+    threads_test_run * run = (threads_test_run *)data;
+    flvmeta_opts options;
+    flv_parser parser;
+    flv_stream * stream;
+    flv_info info;
+
+    flvmeta_opts_init(&options);
+    options.input_file = (char *)run->file;
+    options.output_file = (char *)run->file;
+
+    memset(&parser, 0, sizeof(flv_parser));
+    parser.on_tag = count_tag;
+    parser.user_data = &run->tags;
+    run->parse_result = flv_parse(run->file, &parser);
+
+    stream = flv_open(run->file);
+    if (stream == NULL) {
+        run->info_result = ERROR_OPEN_READ;
+    }
+    else {
+        run->info_result = get_flv_info(stream, &info, &options, NULL);
+        run->video_frames_number = info.video_frames_number;
+        run->last_timestamp = info.last_timestamp;
+        run->on_metadata_size = info.on_metadata_size;
+        amf_data_free(info.keyframes);
+        amf_data_free(info.original_on_metadata);
+        flv_close(stream);
+    }
+
+    options.check_report_format = FLVMETA_FORMAT_JSON;
+    options.check_level = FLVMETA_CHECK_LEVEL_INFO;
+    options.out = flvmeta_tmpfile();
+    if (options.out != NULL) {
+        run->check_result = check_flv_file(&options);
+        free(read_stream(options.out, &run->report_size));
+    }
+
+    options.dump_format = FLVMETA_FORMAT_XML;
+    options.out = flvmeta_tmpfile();
+    if (options.out != NULL) {
+        run->dump_result = dump_flv_file(&options);
+        run->dump = read_stream(options.out, &run->dump_size);
+    }
+}
+
+static void test_threads_concurrent_runs(void) {
+    char paths[THREADS_TEST_FILES][FLVMETA_TEST_PATH_SIZE];
+    threads_test_run references[THREADS_TEST_FILES];
+    threads_test_run * runs;
+    threads_test_run * run;
+    threads_test_run * reference;
+    flvmeta_pool * pool;
+    FILE * file;
+    size_t i;
+
+    /* complete, truncated, and invalid files */
+    make_temp_path(paths[0], FLVMETA_TEST_PATH_SIZE, "threads_complete.flv");
+    write_flv_file(paths[0], 0);
+    make_temp_path(paths[1], FLVMETA_TEST_PATH_SIZE, "threads_truncated.flv");
+    write_flv_file(paths[1], 1);
+    make_temp_path(paths[2], FLVMETA_TEST_PATH_SIZE, "threads_invalid.flv");
+    file = fopen(paths[2], "w");
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_TRUE(fputs("not an FLV file", file) >= 0);
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+
+    /* results of sequential runs */
+    memset(references, 0, sizeof(references));
+    for (i = 0; i < THREADS_TEST_FILES; ++i) {
+        references[i].file = paths[i];
+        run_file(&references[i]);
+        TEST_ASSERT_NOT_NULL(references[i].dump);
+    }
+    TEST_ASSERT_EQUAL_INT(FLV_OK, references[0].parse_result);
+    TEST_ASSERT_EQUAL_UINT32(101, references[0].tags);
+    TEST_ASSERT_EQUAL_INT(OK, references[0].info_result);
+    TEST_ASSERT_EQUAL_UINT32(50, references[0].video_frames_number);
+    TEST_ASSERT_NOT_NULL(strstr(references[0].dump, "2017-07-14T"));
+    TEST_ASSERT_EQUAL_INT(ERROR_INVALID_FLV_FILE, references[1].check_result);
+    TEST_ASSERT_EQUAL_INT(ERROR_NO_FLV, references[2].info_result);
+
+    /* the same results when run concurrently */
+    runs = (threads_test_run *)calloc(THREADS_TEST_RUNS, sizeof(threads_test_run));
+    TEST_ASSERT_NOT_NULL(runs);
+    pool = flvmeta_pool_new(THREADS_TEST_POOL_THREADS);
+    TEST_ASSERT_NOT_NULL(pool);
+    for (i = 0; i < THREADS_TEST_RUNS; ++i) {
+        runs[i].file = paths[i % THREADS_TEST_FILES];
+        flvmeta_pool_submit(pool, &runs[i].task, run_file, &runs[i]);
+    }
+    flvmeta_pool_free(pool);
+
+    for (i = 0; i < THREADS_TEST_RUNS; ++i) {
+        run = &runs[i];
+        reference = &references[i % THREADS_TEST_FILES];
+        TEST_ASSERT_EQUAL_INT(reference->parse_result, run->parse_result);
+        TEST_ASSERT_EQUAL_UINT32(reference->tags, run->tags);
+        TEST_ASSERT_EQUAL_INT(reference->info_result, run->info_result);
+        TEST_ASSERT_EQUAL_UINT32(reference->video_frames_number, run->video_frames_number);
+        TEST_ASSERT_EQUAL_UINT32(reference->last_timestamp, run->last_timestamp);
+        TEST_ASSERT_EQUAL_UINT32(reference->on_metadata_size, run->on_metadata_size);
+        TEST_ASSERT_EQUAL_INT(reference->check_result, run->check_result);
+        TEST_ASSERT_EQUAL_size_t(reference->report_size, run->report_size);
+        TEST_ASSERT_EQUAL_INT(reference->dump_result, run->dump_result);
+        TEST_ASSERT_NOT_NULL(run->dump);
+        TEST_ASSERT_EQUAL_size_t(reference->dump_size, run->dump_size);
+        if (reference->dump_size > 0) {
+            TEST_ASSERT_EQUAL_MEMORY(reference->dump, run->dump, reference->dump_size);
+        }
+        free(run->dump);
+    }
+    free(runs);
+
+    for (i = 0; i < THREADS_TEST_FILES; ++i) {
+        free(references[i].dump);
+        TEST_ASSERT_EQUAL_INT(0, remove(paths[i]));
+    }
+}
+
+void run_threads_tests(void) {
+    UnitySetTestFile(__FILE__);
+
+    RUN_TEST(test_threads_concurrent_runs);
+}
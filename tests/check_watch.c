@@ -0,0 +1,178 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2019 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "src/pool.h"
+#include "src/watch.h"
+#include "src/libflvmeta.h"
+#include "test_util.h"
+
+#if defined(HAVE_SYS_INOTIFY_H) && defined(HAVE_PTHREAD)
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define WATCH_TEST_MAX_RESULTS 4
+#define WATCH_TEST_WAIT_ATTEMPTS 500
+
+/* watch running in a worker, and its reported files */
+typedef struct __watch_test {
+    flvmeta_opts options;
+    char files[WATCH_TEST_MAX_RESULTS][FLVMETA_TEST_PATH_SIZE];
+    int results[WATCH_TEST_MAX_RESULTS];
+    size_t number;
+    int result;
+} watch_test;
+
+static void write_file(const char * path, const char * contents) {
+    FILE * file = fopen(path, "w");
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_TRUE(fputs(contents, file) >= 0);
+    TEST_ASSERT_EQUAL_INT(0, fclose(file));
+}
+
+/* wait for a result to be renamed into place */
+static void wait_file(const char * path) {
+    int attempt;
+
+    for (attempt = 0; attempt < WATCH_TEST_WAIT_ATTEMPTS; ++attempt) {
+        if (access(path, F_OK) == 0) {
+            return;
+        }
+        usleep(10000);
+    }
+    TEST_FAIL_MESSAGE("result not written");
+}
+
+/* print the file name as the report */
+static int test_command(const flvmeta_opts * options) {
+    fprintf(options->out, "output of %s\n", options->input_file);
+    return OK;
+}
+
+static void record_result(const flvmeta_opts * options, int result, void * user_data) {
+    watch_test * test = (watch_test *)user_data;
+
+    if (test->number < WATCH_TEST_MAX_RESULTS) {
+        strcpy(test->files[test->number], options->input_file);
+        test->results[test->number] = result;
+    }
+    ++test->number;
+}
+
+static void run_watch(void * data) {
+    watch_test * test = (watch_test *)data;
+
+    test->result = watch_run(&test->options, test_command, record_result, test);
+}
+
+static void test_watch_directory(void) {
+    watch_test test;
+    flvmeta_pool * pool;
+    flvmeta_task task;
+    char directory[FLVMETA_TEST_PATH_SIZE];
+    char output_dir[FLVMETA_TEST_PATH_SIZE];
+    char path[FLVMETA_TEST_PATH_SIZE * 2];
+    char report[FLVMETA_TEST_PATH_SIZE * 2];
+    char expected[FLVMETA_TEST_PATH_SIZE * 2];
+    FILE * file;
+    size_t length;
+
+    make_temp_path(directory, sizeof(directory), "watch");
+    make_temp_path(output_dir, sizeof(output_dir), "watch-output");
+    TEST_ASSERT_EQUAL_INT(0, mkdir(directory, 0755));
+    TEST_ASSERT_EQUAL_INT(0, mkdir(output_dir, 0755));
+
+    /* a file written before the watch, and a result left incomplete */
+    sprintf(path, "%s/old.flv", directory);
+    write_file(path, "old");
+    sprintf(path, "%s/notes.txt", directory);
+    write_file(path, "notes");
+    sprintf(path, "%s/gone.flv.json" WATCH_TEMP_SUFFIX, output_dir);
+    write_file(path, "partial");
+
+    memset(&test, 0, sizeof(test));
+    flvmeta_opts_init(&test.options);
+    test.options.command = FLVMETA_CHECK_COMMAND;
+    test.options.check_report_format = FLVMETA_FORMAT_JSON;
+    test.options.watch_dir = directory;
+    test.options.watch_delay = 20;
+    test.options.batch_output_dir = output_dir;
+    pool = flvmeta_pool_new(1);
+    TEST_ASSERT_NOT_NULL(pool);
+    flvmeta_pool_submit(pool, &task, run_watch, &test);
+
+    /* the existing file is caught up with, then the new one is noticed */
+    sprintf(path, "%s/old.flv.json", output_dir);
+    wait_file(path);
+    sprintf(path, "%s/new.flv", directory);
+    write_file(path, "new");
+    sprintf(path, "%s/new.flv.json", output_dir);
+    wait_file(path);
+
+    watch_stop();
+    flvmeta_pool_wait(pool, &task);
+    flvmeta_pool_free(pool);
+    TEST_ASSERT_EQUAL_INT(OK, test.result);
+    TEST_ASSERT_EQUAL_size_t(2, test.number);
+    TEST_ASSERT_EQUAL_INT(OK, test.results[0]);
+    TEST_ASSERT_EQUAL_INT(OK, test.results[1]);
+
+    file = fopen(path, "r");
+    TEST_ASSERT_NOT_NULL(file);
+    length = fread(report, 1, sizeof(report) - 1, file);
+    report[length] = '\0';
+    fclose(file);
+    sprintf(expected, "output of %s/new.flv\n", directory);
+    TEST_ASSERT_EQUAL_STRING(expected, report);
+
+    sprintf(path, "%s/gone.flv.json" WATCH_TEMP_SUFFIX, output_dir);
+    TEST_ASSERT_NOT_EQUAL(0, access(path, F_OK));
+
+    sprintf(path, "%s/old.flv.json", output_dir);
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+    sprintf(path, "%s/new.flv.json", output_dir);
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+    sprintf(path, "%s/old.flv", directory);
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+    sprintf(path, "%s/new.flv", directory);
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+    sprintf(path, "%s/notes.txt", directory);
+    TEST_ASSERT_EQUAL_INT(0, remove(path));
+    TEST_ASSERT_EQUAL_INT(0, rmdir(output_dir));
+    TEST_ASSERT_EQUAL_INT(0, rmdir(directory));
+}
+
+#else /* !(HAVE_SYS_INOTIFY_H && HAVE_PTHREAD) */
+
+static void test_watch_directory(void) {
+    TEST_IGNORE_MESSAGE("no inotify or thread support");
+}
+
+#endif /* HAVE_SYS_INOTIFY_H && HAVE_PTHREAD */
+
+void run_watch_tests(void) {
+    UnitySetTestFile(__FILE__);
+
+    RUN_TEST(test_watch_directory);
+}
@@ -0,0 +1,111 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2016 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#include "unity.h"
+#include "test_util.h"
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifndef FLVMETA_TEST_TMP_DIR
+#define FLVMETA_TEST_TMP_DIR "."
+#endif
+
+static unsigned long get_test_process_id(void) {
+#if defined(_WIN32)
+    return (unsigned long)_getpid();
+#else
+    return (unsigned long)getpid();
+#endif
+}
+
+void make_temp_path(char * path, size_t path_size, const char * filename) {
+    int written = snprintf(
+        path,
+        path_size,
+        "%s/flvmeta-test-%lu-%s",
+        FLVMETA_TEST_TMP_DIR,
+        get_test_process_id(),
+        filename
+    );
+
+    TEST_ASSERT_TRUE(written > 0);
+    TEST_ASSERT_TRUE((size_t)written < path_size);
+}
+
+FILE * create_temp_file(const char * filename, char * path, size_t path_size) {
+    FILE * file;
+
+    make_temp_path(path, path_size, filename);
+    file = fopen(path, "wb");
+    TEST_ASSERT_NOT_NULL(file);
+
+    return file;
+}
+
+void write_flv_header(FILE * file, uint8 flags) {
+    flv_header header;
+
+    header.signature[0] = 'F';
+    header.signature[1] = 'L';
+    header.signature[2] = 'V';
+    header.version = 1;
+    header.flags = flags;
+    header.offset = swap_uint32(FLV_HEADER_SIZE);
+
+    TEST_ASSERT_EQUAL_size_t(1, flv_write_header(file, &header));
+    write_flv_prev_tag_size(file, 0);
+}
+
+void write_flv_tag_header(FILE * file, uint8 type, uint32 timestamp, uint32 body_length) {
+    flv_tag tag;
+
+    tag.type = type;
+    tag.body_length = uint32_to_uint24_be(body_length);
+    flv_tag_set_timestamp(&tag, timestamp);
+    tag.stream_id = uint32_to_uint24_be(0);
+
+    TEST_ASSERT_EQUAL_size_t(1, flv_write_tag(file, &tag));
+}
+
+void write_flv_prev_tag_size(FILE * file, uint32 prev_tag_size) {
+    uint32_be size = swap_uint32(prev_tag_size);
+
+    TEST_ASSERT_EQUAL_size_t(1, fwrite(&size, sizeof(size), 1, file));
+}
+
+void write_flv_tag_with_size(FILE * file, uint8 type, uint32 timestamp, const byte * body, uint32 body_length) {
+    write_flv_tag_header(file, type, timestamp, body_length);
+    TEST_ASSERT_EQUAL_size_t(body_length, fwrite(body, sizeof(byte), body_length, file));
+    write_flv_prev_tag_size(file, FLV_TAG_SIZE + body_length);
+}
+
+void write_flv_script_tag(FILE * file, uint32 timestamp, const amf_data * name, const amf_data * data) {
+    uint32 body_length = (uint32)(amf_data_size(name) + amf_data_size(data));
+
+    write_flv_tag_header(file, FLV_TAG_TYPE_META, timestamp, body_length);
+    TEST_ASSERT_EQUAL_size_t(amf_data_size(name), amf_data_file_write(name, file));
+    TEST_ASSERT_EQUAL_size_t(amf_data_size(data), amf_data_file_write(data, file));
+    write_flv_prev_tag_size(file, FLV_TAG_SIZE + body_length);
+}
@@ -0,0 +1,61 @@
+/*
+    FLVMeta - FLV Metadata Editor
+
+    Copyright (C) 2007-2016 Marc Noirot <marc.noirot AT gmail.com>
+
+    This file is part of FLVMeta.
+
+    FLVMeta is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    FLVMeta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with FLVMeta; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#ifndef __TEST_UTIL_H__
+#define __TEST_UTIL_H__
+
+#include <stdio.h>
+
+#include "src/amf.h"
+#include "src/flv.h"
+
+#define FLVMETA_TEST_PATH_SIZE 1024
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* build the path of a file of the temporary test directory, unique to the test process */
+void make_temp_path(char * path, size_t path_size, const char * filename);
+
+/* create a file of the temporary test directory, opened for writing */
+FILE * create_temp_file(const char * filename, char * path, size_t path_size);
+
+/* write a FLV header with the given flags, followed by the first previous tag size */
+void write_flv_header(FILE * file, uint8 flags);
+
+/* write a tag header */
+void write_flv_tag_header(FILE * file, uint8 type, uint32 timestamp, uint32 body_length);
+
+/* write a previous tag size */
+void write_flv_prev_tag_size(FILE * file, uint32 prev_tag_size);
+
+/* write a tag with its body, followed by its previous tag size */
+void write_flv_tag_with_size(FILE * file, uint8 type, uint32 timestamp, const byte * body, uint32 body_length);
+
+/* write a script data tag made of the given name and data, followed by its previous tag size */
+void write_flv_script_tag(FILE * file, uint32 timestamp, const amf_data * name, const amf_data * data);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __TEST_UTIL_H__ */